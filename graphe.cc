@@ -26,9 +26,27 @@
 #include <ctime>
 #include <stdio.h>
 #include <stdlib.h>
+#include <functional>
+#include <limits>
 #ifdef HAVE_LIBNAUTY
 #include "nautywrapper.h"
 #endif
+#if defined HAVE_SYS_MMAN_H && defined HAVE_UNISTD_H
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#define GRAPHE_MMAP 1
+#endif
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 using namespace std;
 
 #ifndef NO_NAMESPACE_GIAC
@@ -38,6 +56,7 @@ namespace giac {
 const gen graphe::VRAI=gen(1).change_subtype(_INT_BOOLEAN);
 const gen graphe::FAUX=gen(0).change_subtype(_INT_BOOLEAN);
 bool graphe::verbose=true;
+double graphe::barnes_hut_theta=0.9;
 int graphe::default_edge_color=_BLUE;
 int graphe::default_edge_width=_LINE_WIDTH_2;
 int graphe::bold_edge_width=_LINE_WIDTH_4;
@@ -94,6 +113,236 @@ void graphe::ivectors2vecteur(const ivectors &v,vecteur &res,bool sort_all) cons
     }
 }
 
+/* rng class implementation */
+
+graphe::rng::rng(unsigned long long seed) {
+    /* scramble the seed with splitmix64 so that consecutive seeds give independent streams */
+    unsigned long long z=seed+0x9E3779B97F4A7C15ULL;
+    z=(z^(z>>30))*0xBF58476D1CE4E5B9ULL;
+    z=(z^(z>>27))*0x94D049BB133111EBULL;
+    state=z^(z>>31);
+    if (state==0)
+        state=0x9E3779B97F4A7C15ULL;
+}
+
+unsigned long long graphe::rng::next() {
+    state^=state>>12;
+    state^=state<<25;
+    state^=state>>27;
+    return state*0x2545F4914F6CDD1DULL;
+}
+
+/* gt_profiler class implementation */
+
+#define GT_PROFILE_MAX_EVENTS 1048576
+
+struct gt_profile_phase {
+    longlong calls;
+    double total;
+    double max;
+    gt_profile_phase() { calls=0; total=max=0; }
+};
+
+struct gt_profile_event {
+    const char *name;
+    double start;
+    double duration;
+    int thread;
+};
+
+struct gt_profile_less {
+    bool operator()(const char *a,const char *b) const { return strcmp(a,b)<0; }
+};
+
+bool gt_profiler::enabled=false;
+bool gt_profiler::tracing=false;
+static double profile_origin=0;
+static gt_profiler::probe *profile_probes=NULL;
+static vector<gt_profile_event> profile_events;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t profile_mutex=PTHREAD_MUTEX_INITIALIZER;
+static vector<pthread_t> profile_threads;
+#endif
+
+class profile_lock { // locks the profiler data within the current scope
+public:
+#ifdef HAVE_LIBPTHREAD
+    profile_lock() { pthread_mutex_lock(&profile_mutex); }
+    ~profile_lock() { pthread_mutex_unlock(&profile_mutex); }
+#else
+    profile_lock() { }
+#endif
+};
+
+#ifndef __GNUC__
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t atomic_mutex=PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+void gt_atomic_lock() {
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_lock(&atomic_mutex);
+#endif
+}
+
+void gt_atomic_unlock() {
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_unlock(&atomic_mutex);
+#endif
+}
+#endif
+
+/* return the index of the calling thread in the trace (lock must be held) */
+static int profile_thread_index() {
+#ifdef HAVE_LIBPTHREAD
+    pthread_t self=pthread_self();
+    for (size_t i=0;i<profile_threads.size();++i) {
+        if (pthread_equal(profile_threads[i],self))
+            return i;
+    }
+    profile_threads.push_back(self);
+    return profile_threads.size()-1;
+#else
+    return 0;
+#endif
+}
+
+/* the probe is linked into the list of all probing sites on its first use */
+gt_profiler::probe::probe(const char *name,gt_probe_kind kind) {
+    m_name=name;
+    m_kind=kind;
+    m_calls=m_total=m_max=0;
+    profile_lock lock;
+    m_next=profile_probes;
+    profile_probes=this;
+}
+
+double gt_profiler::clock() {
+#ifdef HAVE_SYS_TIME_H
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    return tv.tv_sec+1e-6*tv.tv_usec;
+#else
+    return double(std::clock())/CLOCKS_PER_SEC;
+#endif
+}
+
+/* discard the collected data and start profiling, keep the individual events if trace is true */
+void gt_profiler::start(bool trace) {
+    profile_lock lock;
+    for (probe *p=profile_probes;p!=NULL;p=p->m_next) {
+        gt_atomic_store<longlong>(p->m_calls,0);
+        gt_atomic_store<longlong>(p->m_total,0);
+        gt_atomic_store<longlong>(p->m_max,0);
+    }
+    profile_events.clear();
+#ifdef HAVE_LIBPTHREAD
+    profile_threads.clear();
+#endif
+    profile_origin=clock();
+    gt_atomic_store(tracing,trace);
+    gt_atomic_store(enabled,true);
+}
+
+void gt_profiler::stop() {
+    gt_atomic_store(enabled,false);
+    gt_atomic_store(tracing,false);
+}
+
+/* add the event (which is kept only when tracing) to the statistics of the phase p */
+void gt_profiler::record(probe &p,double start,double end) {
+    double t=end-start;
+    longlong us=longlong(1e6*t+0.5);
+    gt_atomic_add<longlong>(p.m_calls,1);
+    gt_atomic_add(p.m_total,us);
+    gt_atomic_raise(p.m_max,us);
+    if (gt_atomic_load(tracing)) {
+        profile_lock lock;
+        if (profile_events.size()<GT_PROFILE_MAX_EVENTS) {
+            gt_profile_event ev;
+            ev.name=p.m_name;
+            ev.start=start-profile_origin;
+            ev.duration=t;
+            ev.thread=profile_thread_index();
+            profile_events.push_back(ev);
+        }
+    }
+}
+
+/* return the collected data as a map with entries "phases" (phase name -> map with
+ * call count, total and maximal wall time in seconds), "counters" and "memory"
+ * (high-water marks in bytes) */
+gen gt_profiler::report() {
+    map<const char*,gt_profile_phase,gt_profile_less> phase_map;
+    map<const char*,longlong,gt_profile_less> counter_map;
+    map<const char*,double,gt_profile_less> memory_map;
+    profile_lock lock;
+    for (probe *p=profile_probes;p!=NULL;p=p->m_next) {
+        longlong calls=gt_atomic_load(p->m_calls);
+        if (calls==0)
+            continue;
+        switch (p->m_kind) {
+        case _GT_PROBE_PHASE: {
+            gt_profile_phase &ph=phase_map[p->m_name];
+            ph.calls+=calls;
+            ph.total+=1e-6*gt_atomic_load(p->m_total);
+            ph.max=std::max(ph.max,1e-6*gt_atomic_load(p->m_max));
+            break;
+        }
+        case _GT_PROBE_COUNTER:
+            counter_map[p->m_name]+=gt_atomic_load(p->m_total);
+            break;
+        case _GT_PROBE_MEMORY: {
+            double &peak=memory_map[p->m_name];
+            peak=std::max(peak,double(gt_atomic_load(p->m_max)));
+            break;
+        }
+        }
+    }
+    gen_map phases,counters,memory,res;
+    for (map<const char*,gt_profile_phase,gt_profile_less>::const_iterator it=phase_map.begin();
+         it!=phase_map.end();++it) {
+        gen_map ph;
+        ph[string2gen("calls",false)]=gen(it->second.calls);
+        ph[string2gen("time",false)]=gen(it->second.total);
+        ph[string2gen("max",false)]=gen(it->second.max);
+        phases[string2gen(it->first,false)]=ph;
+    }
+    for (map<const char*,longlong,gt_profile_less>::const_iterator it=counter_map.begin();
+         it!=counter_map.end();++it) {
+        counters[string2gen(it->first,false)]=gen(it->second);
+    }
+    for (map<const char*,double,gt_profile_less>::const_iterator it=memory_map.begin();
+         it!=memory_map.end();++it) {
+        memory[string2gen(it->first,false)]=gen(it->second);
+    }
+    res[string2gen("phases",false)]=phases;
+    res[string2gen("counters",false)]=counters;
+    res[string2gen("memory",false)]=memory;
+    res[string2gen("elapsed",false)]=gen(gt_atomic_load(enabled)?clock()-profile_origin:0.0);
+    return res;
+}
+
+/* write the recorded events to filename in Chrome trace format (viewable in
+ * chrome://tracing or Perfetto), return the number of events or -1 on failure */
+int gt_profiler::write_trace(const string &filename) {
+    profile_lock lock;
+    ofstream out(filename.c_str());
+    if (!out.good())
+        return -1;
+    out << "{\"traceEvents\":[";
+    char buffer[64];
+    for (vector<gt_profile_event>::const_iterator it=profile_events.begin();it!=profile_events.end();++it) {
+        sprintf(buffer,"\"ts\":%.3f,\"dur\":%.3f",1e6*it->start,1e6*it->duration);
+        out << (it==profile_events.begin()?"\n":",\n") << "{\"name\":\"" << it->name
+            << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << it->thread << "," << buffer << "}";
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    out.close();
+    return profile_events.size();
+}
+
 /* vertex class implementation */
 void graphe::vertex::assign_defaults() {
     m_subgraph=-1;
@@ -223,6 +472,24 @@ void graphe::vertex::add_neighbor(int i,const attrib &attr) {
         copy_attributes(attr,(*m_neighbor_attributes)[i]);
 }
 
+/* merge the sorted range [first,last) of new neighbors into the neighbor list */
+void graphe::vertex::add_neighbors(const int *first,const int *last) {
+    if (first==last)
+        return;
+    size_t k=m_neighbors.size();
+    bool was_empty=k==0;
+    m_neighbors.insert(m_neighbors.end(),first,last);
+    if (!was_empty)
+        std::inplace_merge(m_neighbors.begin(),m_neighbors.begin()+k,m_neighbors.end());
+    if (supports_attributes()) {
+        for (const int *it=first;it!=last;++it) {
+            if (was_empty)
+                m_neighbor_attributes->insert(m_neighbor_attributes->end(),make_pair(*it,attrib()));
+            else m_neighbor_attributes->insert(make_pair(*it,attrib()));
+        }
+    }
+}
+
 bool graphe::vertex::is_temporary(int i) const {
     const attrib &attr=neighbor_attributes(i);
     attrib_iter it=attr.find(_GT_ATTRIB_TEMPORARY);
@@ -600,14 +867,68 @@ size_t graphe::intersect_linear(ivector_iter min1,ivector_iter max1,ivector_iter
     if (min1==max1 || min2==max2 || *min1>*(max2-1) || *min2>*(max1-1)) return 0;
     if (*min1>*min2) min2=binsearch(min2,max2,*min1);
     else if (*min2>*min1) min1=binsearch(min1,max1,*min2);
-    size_t result=0;
-    while (min1!=max1 && min2!=max2) {
-        if (*min1<*min2) ++min1;
-        else if (*min2<*min1) ++min2;
-        else {
-            result++;
-            ++min1; ++min2;
+    if (min1==max1 || min2==max2) return 0;
+    return intersect_sorted(&*min1,max1-min1,&*min2,max2-min2);
+}
+
+/* return the intersection size for strictly increasing arrays a and b of lengths na and nb.
+ * Blocks of four elements are compared all-against-all with SSE2 when available, the
+ * remaining elements are merged with a branch-free loop. If one array is much shorter
+ * than the other, its elements are searched for by galloping instead. */
+size_t graphe::intersect_sorted(const int *a,size_t na,const int *b,size_t nb) {
+    if (na>nb) {
+        std::swap(a,b);
+        std::swap(na,nb);
+    }
+    size_t result=0,i=0,j=0;
+    if (na==0)
+        return 0;
+    if (32*na<nb) {
+        size_t lo,hi,step;
+        for (i=0;i<na && j<nb;++i) {
+            /* gallop to an interval containing a[i], then bisect it */
+            for (step=1,hi=j;hi<nb && b[hi]<a[i];step*=2) {
+                j=hi+1;
+                hi=j+step;
+            }
+            hi=std::min(hi,nb);
+            lo=j;
+            while (lo<hi) {
+                size_t mid=lo+(hi-lo)/2;
+                if (b[mid]<a[i]) lo=mid+1;
+                else hi=mid;
+            }
+            j=lo;
+            if (j<nb && b[j]==a[i]) {
+                ++result;
+                ++j;
+            }
         }
+        return result;
+    }
+#ifdef __SSE2__
+    if (na>=4 && nb>=4) {
+        size_t na4=na&~size_t(3),nb4=nb&~size_t(3);
+        while (i<na4 && j<nb4) {
+            __m128i va=_mm_loadu_si128((const __m128i*)(a+i));
+            __m128i vb=_mm_loadu_si128((const __m128i*)(b+j));
+            __m128i eq=_mm_cmpeq_epi32(va,vb);
+            eq=_mm_or_si128(eq,_mm_cmpeq_epi32(va,_mm_shuffle_epi32(vb,_MM_SHUFFLE(0,3,2,1))));
+            eq=_mm_or_si128(eq,_mm_cmpeq_epi32(va,_mm_shuffle_epi32(vb,_MM_SHUFFLE(1,0,3,2))));
+            eq=_mm_or_si128(eq,_mm_cmpeq_epi32(va,_mm_shuffle_epi32(vb,_MM_SHUFFLE(2,1,0,3))));
+            int mask=_mm_movemask_ps(_mm_castsi128_ps(eq));
+            result+=(mask&1)+((mask>>1)&1)+((mask>>2)&1)+((mask>>3)&1);
+            int amax=a[i+3],bmax=b[j+3];
+            i+=amax<=bmax?4:0;
+            j+=bmax<=amax?4:0;
+        }
+    }
+#endif
+    while (i<na && j<nb) {
+        int x=a[i],y=b[j];
+        result+=x==y;
+        i+=x<=y;
+        j+=y<=x;
     }
     return result;
 }
@@ -616,6 +937,8 @@ size_t graphe::intersect_linear(ivector_iter min1,ivector_iter max1,ivector_iter
 graphe::graphe(GIAC_CONTEXT,bool support_attributes) {
     ctx=contextptr;
     m_supports_attributes=support_attributes;
+    m_adjacency_valid=false;
+    m_modifications=0;
     set_graph_attribute(_GT_ATTRIB_DIRECTED,FAUX);
     set_graph_attribute(_GT_ATTRIB_WEIGHTED,FAUX);
     //nodes.reserve(1024);
@@ -624,6 +947,8 @@ graphe::graphe(GIAC_CONTEXT,bool support_attributes) {
 /* graphe constructor, create a copy of G */
 graphe::graphe(const graphe &G) {
     m_supports_attributes=G.supports_attributes();
+    m_adjacency_valid=false;
+    m_modifications=0;
     set_graph_attribute(_GT_ATTRIB_DIRECTED,boole(G.is_directed()));
     set_graph_attribute(_GT_ATTRIB_WEIGHTED,boole(G.is_weighted()));
     ctx=G.giac_context();
@@ -634,6 +959,8 @@ graphe::graphe(const graphe &G) {
 graphe::graphe(const string &name,GIAC_CONTEXT) {
     ctx=contextptr;
     m_supports_attributes=true;
+    m_adjacency_valid=false;
+    m_modifications=0;
     set_graph_attribute(_GT_ATTRIB_DIRECTED,FAUX);
     set_graph_attribute(_GT_ATTRIB_WEIGHTED,FAUX);
     ivector hull;
@@ -1136,6 +1463,7 @@ bool graphe::is_simple() const {
 /* export this graph as a Giac gen object */
 gen graphe::to_gen() {
     assert(supports_attributes());
+    GT_PROFILE(profile,"to_gen");
     int n=node_count();
     vecteur res(2+int(user_tags.size())+n+edge_count()*(is_directed()?1:2));
     int cnt=0;
@@ -1162,7 +1490,9 @@ gen graphe::to_gen() {
             res[cnt++]=nattr;
         }
     }
-    return change_subtype(res,_GRAPH__VECT);
+    gen g=change_subtype(res,_GRAPH__VECT);
+    register_compiled(g);
+    return g;
 }
 
 /* allocate, initialize and return an integer array of adjacency lists of this graph,
@@ -1686,14 +2016,16 @@ int graphe::sum_of_edge_multiplicities() const {
 }
 
 /* write attributes to dot file */
-void graphe::write_attrib(ofstream &dotfile,const attrib &attr) const {
-    dotfile << "[";
+void graphe::write_attrib(buffered_writer &dotfile,const attrib &attr) const {
+    dotfile.put('[');
     for (attrib_iter it=attr.begin();it!=attr.end();++it) {
         if (it!=attr.begin())
-            dotfile << ",";
-        dotfile << index2tag(it->first) << "=" << it->second;
+            dotfile.put(',');
+        dotfile.write(index2tag(it->first));
+        dotfile.put('=');
+        dotfile.write(it->second.print(ctx));
     }
-    dotfile << "]";
+    dotfile.put(']');
 }
 
 /* export the drawing of this graph in latex format */
@@ -1712,31 +2044,36 @@ bool graphe::write_latex(const string &filename,const gen &drawing) const {
     return true;
 }
 
-/* export this graph to dot file */
+/* export this graph to dot file, writing through a buffer */
 bool graphe::write_dot(const string &filename) const {
-    ofstream dotfile;
-    dotfile.open(filename.c_str());
-    if (!dotfile.is_open())
+    buffered_writer dotfile;
+    if (!dotfile.open(filename))
         return false;
-    dotfile << "# this file was generated by " << giac_version() << "\n";
+    dotfile.write("# this file was generated by "+giac_version()+"\n");
     ivector u,v;
     string indent("  "),edgeop(is_directed()?" -> ":" -- ");
-    dotfile << (is_directed()?"digraph ":"graph ");
+    dotfile.write(is_directed()?"digraph ":"graph ");
     string graph_name=name();
     if (graph_name.empty())
-        dotfile << "{\n";
+        dotfile.write("{\n");
     else
-        dotfile << graph_name << " {\n";
+        dotfile.write(graph_name+" {\n");
     if (!attributes.empty()) {
-        dotfile << indent << "graph ";
+        dotfile.write(indent+"graph ");
         write_attrib(dotfile,attributes);
-        dotfile << "\n";
+        dotfile.put('\n');
+    }
+    int n=node_count();
+    vector<string> labels(n);
+    for (int i=0;i<n;++i) {
+        labels[i]=node(i).label().print(ctx);
     }
     for (node_iter it=nodes.begin();it!=nodes.end();++it) {
+        const string &lab=labels[it-nodes.begin()];
         if (!it->attributes().empty()) {
-            dotfile << indent << it->label() << " ";
+            dotfile.write(indent+lab+" ");
             write_attrib(dotfile,it->attributes());
-            dotfile << ";\n";
+            dotfile.write(";\n");
         }
         u.clear();
         v.clear();
@@ -1747,20 +2084,626 @@ bool graphe::write_dot(const string &filename) const {
                 v.push_back(*jt);
         }
         if (!u.empty()) {
-            dotfile << indent << it->label() << edgeop << "{ ";
+            dotfile.write(indent+lab+edgeop+"{ ");
             for (ivector_iter kt=u.begin();kt!=u.end();++kt) {
-                dotfile << node(*kt).label() << " ";
+                dotfile.write(labels[*kt]);
+                dotfile.put(' ');
             }
-            dotfile << "};\n";
+            dotfile.write("};\n");
         }
         for (ivector_iter kt=v.begin();kt!=v.end();++kt) {
-            dotfile << indent << it->label() << edgeop << node(*kt).label() << " ";
+            dotfile.write(indent+lab+edgeop+labels[*kt]+" ");
             write_attrib(dotfile,it->neighbor_attributes(*kt));
-            dotfile << ";\n";
+            dotfile.write(";\n");
+        }
+    }
+    dotfile.write("}\n");
+    return dotfile.close();
+}
+
+/* map the file for reading, or load it into memory if mapping is not supported */
+bool graphe::mapped_file::open(const string &filename) {
+    close();
+#ifdef GRAPHE_MMAP
+    int fd=::open(filename.c_str(),O_RDONLY);
+    if (fd<0)
+        return false;
+    struct stat st;
+    if (fstat(fd,&st)!=0) {
+        ::close(fd);
+        return false;
+    }
+    m_size=st.st_size;
+    if (m_size>0) {
+        void *p=mmap(NULL,m_size,PROT_READ,MAP_PRIVATE,fd,0);
+        if (p!=MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+            madvise(p,m_size,MADV_SEQUENTIAL);
+#endif
+            m_data=(const char*)p;
+            m_mapped=true;
+        }
+    }
+    ::close(fd);
+    if (m_mapped || m_size==0)
+        return true;
+#endif
+    FILE *f=fopen(filename.c_str(),"rb");
+    if (f==NULL)
+        return false;
+    long len=-1;
+    if (fseek(f,0,SEEK_END)==0)
+        len=ftell(f);
+    if (len<0 || fseek(f,0,SEEK_SET)!=0) {
+        fclose(f);
+        return false;
+    }
+    char *buf=new char[len>0?len:1];
+    m_size=fread(buf,1,len,f);
+    fclose(f);
+    m_data=buf;
+    return true;
+}
+
+/* release the file contents */
+void graphe::mapped_file::close() {
+    if (m_data!=NULL) {
+#ifdef GRAPHE_MMAP
+        if (m_mapped)
+            munmap((void*)m_data,m_size);
+        else
+#endif
+            delete[] m_data;
+    }
+    m_data=NULL;
+    m_size=m_pos=0;
+    m_mapped=false;
+}
+
+/* open the file for writing, return false on failure */
+bool graphe::buffered_writer::open(const string &filename) {
+    close();
+    m_file=fopen(filename.c_str(),"wb");
+    m_len=0;
+    m_failed=m_file==NULL;
+    return !m_failed;
+}
+
+/* write out the buffer contents */
+void graphe::buffered_writer::flush() {
+    if (m_len>0 && m_file!=NULL && fwrite(&m_buffer[0],1,m_len,m_file)!=m_len)
+        m_failed=true;
+    m_len=0;
+}
+
+/* flush and close the file, return false if some write operation failed */
+bool graphe::buffered_writer::close() {
+    if (m_file==NULL)
+        return false;
+    flush();
+    if (fclose(m_file)!=0)
+        m_failed=true;
+    m_file=NULL;
+    return !m_failed;
+}
+
+void graphe::buffered_writer::write(const char *str,size_t len) {
+    if (m_len+len>m_buffer.size()) {
+        flush();
+        if (len>=m_buffer.size()) {
+            if (m_file!=NULL && fwrite(str,1,len,m_file)!=len)
+                m_failed=true;
+            return;
+        }
+    }
+    memcpy(&m_buffer[m_len],str,len);
+    m_len+=len;
+}
+
+void graphe::buffered_writer::write_int(longlong a) {
+    char buf[24];
+    int k=sizeof(buf);
+    bool neg=a<0;
+    unsigned long long u=neg?0ULL-(unsigned long long)a:(unsigned long long)a;
+    do {
+        buf[--k]='0'+int(u%10);
+        u/=10;
+    } while (u>0);
+    if (neg)
+        buf[--k]='-';
+    write(buf+k,sizeof(buf)-k);
+}
+
+void graphe::buffered_writer::write_double(double d) {
+    char buf[32];
+    sprintf(buf,"%.17g",d);
+    write(buf,strlen(buf));
+}
+
+/* export this graph as a list of edges, one per line, with weights in the third column;
+ * isolated vertices are written alone on their lines */
+bool graphe::write_edge_list(const string &filename) const {
+    buffered_writer out;
+    if (!out.open(filename))
+        return false;
+    out.write("# this file was generated by "+giac_version()+"\n");
+    int n=node_count(),j;
+    bool isdir=is_directed(),isweighted=is_weighted();
+    vector<string> labels(n);
+    bvector isolated(n,true);
+    for (int i=0;i<n;++i) {
+        const vertex &v=node(i);
+        labels[i]=v.label().print(ctx);
+        for (ivector_iter it=v.neighbors().begin();it!=v.neighbors().end();++it) {
+            isolated[i]=isolated[*it]=false;
+        }
+    }
+    for (int i=0;i<n;++i) {
+        if (isolated[i]) {
+            out.write(labels[i]);
+            out.put('\n');
+            continue;
+        }
+        const vertex &v=node(i);
+        for (ivector_iter it=v.neighbors().begin();it!=v.neighbors().end();++it) {
+            if (!isdir && *it<i)
+                continue;
+            j=*it;
+            out.write(labels[i]);
+            out.put(' ');
+            out.write(labels[j]);
+            if (isweighted) {
+                gen w=weight(i,j);
+                out.put(' ');
+                if (w.type==_INT_)
+                    out.write_int(w.val);
+                else if (w.type==_DOUBLE_)
+                    out.write_double(w.DOUBLE_val());
+                else out.write(w.print(ctx));
+            }
+            out.put('\n');
+        }
+    }
+    return out.close();
+}
+
+/* a token referenced in place in the input buffer */
+struct text_token {
+    const char *first;
+    const char *last;
+    bool operator <(const text_token &other) const {
+        size_t l1=last-first,l2=other.last-other.first;
+        int c=memcmp(first,other.first,std::min(l1,l2));
+        return c<0 || (c==0 && l1<l2);
+    }
+};
+
+/* find the next token on the current line of an edge list, return false at the end of the
+ * line (p is then left at the newline), quotes surrounding the token are removed */
+static bool edge_list_token(const char *&p,const char *end,text_token &tok,bool &quoted) {
+    while (p<end && (*p==' ' || *p=='\t' || *p==',' || *p==';' || *p=='\r'))
+        ++p;
+    if (p==end || *p=='\n')
+        return false;
+    if ((quoted=(*p=='"'))) {
+        tok.first=++p;
+        while (p<end && *p!='"' && *p!='\n') ++p;
+        tok.last=p;
+        if (p<end && *p=='"') ++p;
+        return true;
+    }
+    tok.first=p;
+    while (p<end && !isspace((unsigned char)*p) && *p!=',' && *p!=';') ++p;
+    tok.last=p;
+    return true;
+}
+
+/* return true iff the token is a (not too large) integer, which is stored in a */
+static bool edge_list_integer(const text_token &tok,longlong &a) {
+    const char *p=tok.first;
+    bool neg=p<tok.last && *p=='-';
+    if (neg) ++p;
+    if (p==tok.last || tok.last-p>18)
+        return false;
+    a=0;
+    for (;p<tok.last;++p) {
+        if (!isdigit((unsigned char)*p))
+            return false;
+        a=10*a+(*p-'0');
+    }
+    if (neg) a=-a;
+    return true;
+}
+
+/* initialize graph from a list of edges, one per line, with optional weights in the third
+ * column; the file is memory-mapped and tokenized in place, lines starting with '#' or '%'
+ * are comments and lines containing a single vertex specify isolated vertices */
+bool graphe::read_edge_list(const string &filename,bool weights) {
+    mapped_file file;
+    if (!file.open(filename))
+        return false;
+    const char *p=file.data(),*end=p+file.size();
+    map<longlong,int> int_index;
+    map<text_token,int> str_index;
+    vecteur labels;
+    ipairs arcs;
+    vecteur W;
+    bool isdir=is_directed(),quoted;
+    text_token tok[3];
+    longlong a;
+    int k,ij[2],nw=0;
+    while (p<end) {
+        while (p<end && (*p==' ' || *p=='\t' || *p=='\r')) ++p;
+        if (p<end && (*p=='#' || *p=='%'))
+            while (p<end && *p!='\n') ++p;
+        for (k=0;k<3 && edge_list_token(p,end,tok[k],quoted);++k) {
+            if (k==2)
+                continue; // weight
+            if (!quoted && edge_list_integer(tok[k],a)) {
+                map<longlong,int>::iterator it=int_index.find(a);
+                if (it==int_index.end()) {
+                    it=int_index.insert(make_pair(a,int(labels.size()))).first;
+                    labels.push_back(a==(int)a?gen((int)a):gen(a));
+                }
+                ij[k]=it->second;
+            } else {
+                map<text_token,int>::iterator it=str_index.find(tok[k]);
+                if (it==str_index.end()) {
+                    it=str_index.insert(make_pair(tok[k],int(labels.size()))).first;
+                    labels.push_back(str2gen(string(tok[k].first,tok[k].last),true));
+                }
+                ij[k]=it->second;
+            }
+        }
+        while (p<end && *p++!='\n');
+        if (k<2 || ij[0]==ij[1])
+            continue;
+        if (!isdir && ij[0]>ij[1])
+            std::swap(ij[0],ij[1]);
+        arcs.push_back(make_pair(ij[0],ij[1]));
+        if (weights && k==3) {
+            if (W.empty())
+                W.resize(arcs.size()-1,1);
+            string wstr(tok[2].first,tok[2].last);
+            char *wend;
+            double d;
+            if (edge_list_integer(tok[2],a) && a==(int)a)
+                W.push_back((int)a);
+            else if ((d=strtod(wstr.c_str(),&wend)),*wend=='\0')
+                W.push_back(d);
+            else W.push_back(str2gen(wstr,false));
+            ++nw;
+        } else if (!W.empty())
+            W.push_back(1);
+    }
+    file.close();
+    int n=labels.size(),m=arcs.size();
+    /* distribute the arcs into adjacency lists, keeping the first of duplicate arcs */
+    ivector offsets(n+1,0);
+    for (ipairs_iter it=arcs.begin();it!=arcs.end();++it) {
+        ++offsets[it->first+1];
+        if (!isdir)
+            ++offsets[it->second+1];
+    }
+    for (int i=0;i<n;++i) {
+        offsets[i+1]+=offsets[i];
+    }
+    ipairs adj(offsets[n]);
+    ivector pos(offsets.begin(),offsets.end()-1);
+    for (k=0;k<m;++k) {
+        const ipair &e=arcs[k];
+        adj[pos[e.first]++]=make_pair(e.second,k);
+        if (!isdir)
+            adj[pos[e.second]++]=make_pair(e.first,k);
+    }
+    ipairs().swap(arcs);
+    ivector().swap(pos);
+    clear();
+    reserve_nodes(n);
+    for (const_iterateur it=labels.begin();it!=labels.end();++it) {
+        append_node(*it);
+    }
+    vecteur().swap(labels);
+    if (nw>0)
+        set_weighted(true);
+    attrib attr;
+    for (int i=0;i<n;++i) {
+        ipairs::iterator first=adj.begin()+offsets[i],last=adj.begin()+offsets[i+1];
+        std::sort(first,last);
+        vertex &v=node(i);
+        for (ipairs::iterator it=first;it!=last;++it) {
+            if (it!=first && it->first==(it-1)->first)
+                continue;
+            attr.clear();
+            if (nw>0 && (isdir || i<it->first))
+                attr[_GT_ATTRIB_WEIGHT]=W[it->second];
+            v.add_neighbor(it->first,attr);
+        }
+    }
+    invalidate_adjacency();
+    return true;
+}
+
+/* Binary graph format (version GT_BINARY_VERSION), in native byte order:
+ *  - header (see binary_header below),
+ *  - n+1 arc offsets (64-bit) and m arc heads (32-bit) in CSR order,
+ *  - m arc weights (doubles) if the weights are numeric,
+ *  - n+1 label offsets (64-bit) and label data: each label is a type byte
+ *    ('i' for 64-bit integer, 's' for string, 'g' for printed expression)
+ *    followed by the payload,
+ *  - optional attribute blob: printed list [G,V,E] where G=[tags,values] are
+ *    graph attributes, V=[[i,tags,values],..] are vertex attributes without
+ *    labels and E=[[k,tags,values],..] are attributes of k-th arc, without
+ *    numeric weights (for edges, stored with the arc leaving the smaller endpoint).
+ * Sections are padded to multiples of 8 bytes so that they can be read directly
+ * from the memory-mapped file. */
+static const char binary_magic[8]={'G','I','A','C','G','R','P','H'};
+
+#define GT_BINARY_DIRECTED 1
+#define GT_BINARY_WEIGHTED 2
+#define GT_BINARY_NUMERIC_WEIGHTS 4
+#define GT_BINARY_INTEGRAL_WEIGHTS 8
+
+struct binary_header {
+    char magic[8];
+    unsigned int version;
+    unsigned int flags;
+    longlong nodes;
+    longlong arcs;
+    longlong labels_size;
+    longlong blob_size;
+};
+
+static size_t binary_padding(size_t sz) {
+    return (8-sz%8)%8;
+}
+
+static void write_binary_padding(graphe::buffered_writer &out,size_t sz) {
+    static const char zeros[8]={0,0,0,0,0,0,0,0};
+    out.write(zeros,binary_padding(sz));
+}
+
+/* write this graph to file in binary format */
+bool graphe::write_binary(const string &filename) const {
+    const csr &A=adjacency();
+    int n=A.node_count(),m=A.arc_count(),i,j,k;
+    bool isdir=is_directed(),isweighted=is_weighted(),numeric=isweighted,integral=true;
+    dvector W;
+    /* numeric weights */
+    if (isweighted) {
+        W.resize(m);
+        for (i=0;i<n && numeric;++i) {
+            for (k=A.offsets[i];k<A.offsets[i+1];++k) {
+                j=A.columns[k];
+                const attrib &attr=edge_attributes(i,j);
+                attrib_iter it=attr.find(_GT_ATTRIB_WEIGHT);
+                if (it==attr.end() || (it->second.type!=_INT_ && it->second.type!=_DOUBLE_)) {
+                    numeric=false;
+                    break;
+                }
+                if (it->second.type==_INT_)
+                    W[k]=it->second.val;
+                else {
+                    W[k]=it->second.DOUBLE_val();
+                    integral=false;
+                }
+            }
+        }
+    }
+    /* labels */
+    string label_data;
+    vector<longlong> label_offsets(n+1);
+    for (i=0;i<n;++i) {
+        label_offsets[i]=label_data.size();
+        gen lab=node(i).label();
+        if (lab.type==_INT_) {
+            longlong a=lab.val;
+            label_data.push_back('i');
+            label_data.append((const char*)&a,sizeof(a));
+        } else if (lab.type==_STRNG) {
+            label_data.push_back('s');
+            label_data.append(genstring2str(lab));
+        } else {
+            label_data.push_back('g');
+            label_data.append(lab.print(ctx));
+        }
+    }
+    label_offsets[n]=label_data.size();
+    /* attribute blob */
+    vecteur tags,values,V,E;
+    attrib attr;
+    bool has_attr=false;
+    for (attrib_iter it=attributes.begin();it!=attributes.end();++it) {
+        if (it->first!=_GT_ATTRIB_DIRECTED && it->first!=_GT_ATTRIB_WEIGHTED)
+            attr.insert(*it);
+    }
+    attrib2vecteurs(attr,tags,values);
+    has_attr=!attr.empty();
+    gen G=makevecteur(tags,values);
+    for (i=0;i<n;++i) {
+        const attrib &va=node(i).attributes();
+        attr=va;
+        attr.erase(_GT_ATTRIB_LABEL);
+        if (!attr.empty()) {
+            tags.clear();
+            values.clear();
+            attrib2vecteurs(attr,tags,values);
+            V.push_back(makevecteur(i,tags,values));
+        }
+        for (k=A.offsets[i];k<A.offsets[i+1];++k) {
+            j=A.columns[k];
+            if (!isdir && j<i)
+                continue;
+            attr=node(i).neighbor_attributes(j);
+            if (numeric)
+                attr.erase(_GT_ATTRIB_WEIGHT);
+            if (!attr.empty()) {
+                tags.clear();
+                values.clear();
+                attrib2vecteurs(attr,tags,values);
+                E.push_back(makevecteur(k,tags,values));
+            }
+        }
+    }
+    string blob;
+    if (has_attr || !V.empty() || !E.empty())
+        blob=gen(makevecteur(G,V,E)).print(ctx);
+    /* write the file */
+    binary_header h;
+    memcpy(h.magic,binary_magic,8);
+    h.version=GT_BINARY_VERSION;
+    h.flags=(isdir?GT_BINARY_DIRECTED:0) | (isweighted?GT_BINARY_WEIGHTED:0) |
+            (numeric?GT_BINARY_NUMERIC_WEIGHTS:0) | (numeric && integral?GT_BINARY_INTEGRAL_WEIGHTS:0);
+    h.nodes=n;
+    h.arcs=m;
+    h.labels_size=label_data.size();
+    h.blob_size=blob.size();
+    buffered_writer out;
+    if (!out.open(filename))
+        return false;
+    out.write((const char*)&h,sizeof(h));
+    for (i=0;i<=n;++i) {
+        longlong a=A.offsets[i];
+        out.write((const char*)&a,sizeof(a));
+    }
+    if (m>0)
+        out.write((const char*)&A.columns.front(),m*sizeof(int));
+    write_binary_padding(out,m*sizeof(int));
+    if (numeric && m>0)
+        out.write((const char*)&W.front(),m*sizeof(double));
+    out.write((const char*)&label_offsets.front(),(n+1)*sizeof(longlong));
+    out.write(label_data);
+    write_binary_padding(out,label_data.size());
+    out.write(blob);
+    return out.close();
+}
+
+/* read the graph from file in binary format; the file is memory-mapped and its
+ * sections are decoded directly from the mapping, the topology being copied into
+ * the vertex lists and the adjacency snapshot. If all_attributes is false, only
+ * the weights are read from the attribute blob (needed when they are not numeric),
+ * and if weights is false, the graph is read as unweighted */
+bool graphe::read_binary(const string &filename,bool all_attributes,bool weights) {
+    mapped_file file;
+    if (!file.open(filename) || file.size()<sizeof(binary_header))
+        return false;
+    binary_header h;
+    memcpy(&h,file.data(),sizeof(h));
+    if (memcmp(h.magic,binary_magic,8)!=0 || h.version!=GT_BINARY_VERSION ||
+            h.nodes<0 || h.arcs<0 || h.nodes>=std::numeric_limits<int>::max() ||
+            h.arcs>std::numeric_limits<int>::max() ||
+            h.labels_size<0 || h.blob_size<0)
+        return false;
+    int n=h.nodes,m=h.arcs,i,j,k;
+    bool isdir=(h.flags & GT_BINARY_DIRECTED)!=0,numeric=(h.flags & GT_BINARY_NUMERIC_WEIGHTS)!=0;
+    bool integral=(h.flags & GT_BINARY_INTEGRAL_WEIGHTS)!=0;
+    size_t pos=sizeof(h),cols_pos,weights_pos,labels_pos,data_pos,blob_pos;
+    cols_pos=pos+(n+1)*sizeof(longlong);
+    weights_pos=cols_pos+m*sizeof(int)+binary_padding(m*sizeof(int));
+    labels_pos=weights_pos+(numeric?m*sizeof(double):0);
+    data_pos=labels_pos+(n+1)*sizeof(longlong);
+    blob_pos=data_pos+h.labels_size+binary_padding(h.labels_size);
+    if (file.size()<blob_pos+h.blob_size)
+        return false;
+    const longlong *off=(const longlong*)(file.data()+pos);
+    const int *cols=(const int*)(file.data()+cols_pos);
+    const double *W=(const double*)(file.data()+weights_pos);
+    const longlong *loff=(const longlong*)(file.data()+labels_pos);
+    const char *ldata=file.data()+data_pos;
+    /* validate the topology and label index */
+    if (off[0]!=0 || off[n]!=m || loff[0]!=0 || loff[n]!=h.labels_size)
+        return false;
+    for (i=0;i<n;++i) {
+        if (off[i+1]<off[i] || loff[i+1]<=loff[i])
+            return false;
+        for (k=off[i];k<off[i+1];++k) {
+            if ((j=cols[k])<0 || j>=n || (k>off[i] && cols[k-1]>=j))
+                return false;
+        }
+    }
+    clear();
+    set_directed(isdir);
+    bool isweighted=weights && (h.flags & GT_BINARY_WEIGHTED)!=0;
+    set_weighted(isweighted);
+    reserve_nodes(n);
+    for (i=0;i<n;++i) {
+        const char *p=ldata+loff[i];
+        size_t len=loff[i+1]-loff[i]-1;
+        switch (*p++) {
+        case 'i': {
+            longlong a;
+            if (len!=sizeof(a)) return false;
+            memcpy(&a,p,sizeof(a));
+            append_node(a==(int)a?gen((int)a):gen(a));
+            break;
+        }
+        case 's':
+            append_node(str2gen(string(p,len),true));
+            break;
+        case 'g':
+            append_node(gen(string(p,len),ctx));
+            break;
+        default:
+            return false;
+        }
+    }
+    attrib attr;
+    for (i=0;i<n;++i) {
+        vertex &v=node(i);
+        for (k=off[i];k<off[i+1];++k) {
+            j=cols[k];
+            attr.clear();
+            if (numeric && weights && (isdir || i<j))
+                attr[_GT_ATTRIB_WEIGHT]=integral?gen((int)W[k]):gen(W[k]);
+            v.add_neighbor(j,attr);
+        }
+    }
+    /* the stored topology becomes the adjacency snapshot */
+    m_adjacency.offsets.assign(off,off+n+1);
+    m_adjacency.columns.assign(cols,cols+m);
+    m_adjacency.weights.clear();
+    m_adjacency.integral=true;
+    m_adjacency.min_weight=m_adjacency.max_weight=1;
+    m_adjacency_valid=true;
+    /* non-numeric weights are stored in the blob, with other edge attributes */
+    bool blob_weights=isweighted && !numeric;
+    if ((!all_attributes && !blob_weights) || h.blob_size==0)
+        return true;
+    gen blob(string(file.data()+blob_pos,h.blob_size),ctx);
+    if (blob.type!=_VECT || blob._VECTptr->size()!=3)
+        return false;
+    const vecteur &bv=*blob._VECTptr;
+    if (bv[0].type!=_VECT || bv[0]._VECTptr->size()!=2 || bv[1].type!=_VECT || bv[2].type!=_VECT)
+        return false;
+    vecteur graph_items(1,makevecteur(-1,bv[0]._VECTptr->front(),bv[0]._VECTptr->back()));
+    for (int sec=all_attributes?0:2;sec<3;++sec) {
+        const vecteur &items=sec==0?graph_items:*bv[sec]._VECTptr;
+        for (const_iterateur it=items.begin();it!=items.end();++it) {
+            if (it->type!=_VECT || it->_VECTptr->size()!=3)
+                return false;
+            const gen &idx=it->_VECTptr->front(),&tg=(*it->_VECTptr)[1],&vl=it->_VECTptr->back();
+            if (!idx.is_integer() || tg.type!=_VECT || vl.type!=_VECT || tg._VECTptr->size()!=vl._VECTptr->size())
+                return false;
+            k=idx.val;
+            if ((sec==1 && (k<0 || k>=n)) || (sec==2 && (k<0 || k>=m)))
+                return false;
+            if (sec==2) /* find the tail of the k-th arc */
+                i=std::upper_bound(off,off+n+1,(longlong)k)-off-1;
+            for (const_iterateur jt=tg._VECTptr->begin(),vt=vl._VECTptr->begin();jt!=tg._VECTptr->end();++jt,++vt) {
+                if (jt->type!=_STRNG)
+                    return false;
+                string tag=genstring2str(*jt);
+                if ((!all_attributes && tag!="weight") || (!weights && tag=="weight"))
+                    continue;
+                int key=tag2index(tag);
+                if (sec==0)
+                    set_graph_attribute(key,*vt);
+                else if (sec==1)
+                    node(k).set_attribute(key,*vt);
+                else node(i).neighbor_attributes(cols[k])[key]=*vt;
+            }
         }
     }
-    dotfile << "}\n";
-    dotfile.close();
     return true;
 }
 
@@ -1770,6 +2713,8 @@ static bool dot_reading_attributes;
 static bool dot_reading_value;
 static int dot_newline_count;
 static int dot_token_type;
+static bool dot_all_attributes;
+static bool dot_keep_weights;
 
 /* returns true iff last read token is an identifier, number or string */
 bool dot_token_is_id() {
@@ -1785,7 +2730,7 @@ bool dot_is_id_delim(const char &c) {
 }
 
 /* read next token in dot file 'dotfile' */
-int dot_read_token(ifstream &dotfile,string &token) {
+int dot_read_token(graphe::mapped_file &dotfile,string &token) {
     char c=0,pc,nc;
     bool last=false;
     dot_token_type=0;
@@ -1921,9 +2866,10 @@ bool graphe::remove_attribute(attrib &attr,int key) {
 }
 
 /* parse attributes from dot file */
-bool graphe::dot_parse_attributes(ifstream &dotfile,attrib &attr) {
+bool graphe::dot_parse_attributes(mapped_file &dotfile,attrib &attr) {
     string token;
     int key;
+    bool skip;
     while(true) {
         if (dot_read_token(dotfile,token)!=1)
             return false;
@@ -1933,28 +2879,37 @@ bool graphe::dot_parse_attributes(ifstream &dotfile,attrib &attr) {
             continue;
         if (!dot_token_is_id())
             return false;
-        key=tag2index(token);
+        skip=!dot_all_attributes && (!dot_keep_weights || token!="weight");
+        key=skip?0:tag2index(token);
         if (key==-1 || dot_read_token(dotfile,token)!=1 || token!="=" ||
                 dot_read_token(dotfile,token)!=1 || dot_reading_value || !dot_token_is_id())
             return false;
+        if (skip)
+            continue;
         if (key==_GT_ATTRIB_WEIGHT && !is_weighted()) set_weighted(true);
         insert_attribute(attr,key,str2gen(token,dot_token_type==_GT_DOT_TOKEN_TYPE_STRING));
     }
     return true;
 }
 
-/* initialize graph from dot file */
-bool graphe::read_dot(const string &filename) {
-    ifstream dotfile;
-    dotfile.open(filename.c_str());
-    if (!dotfile.is_open())
+/* initialize graph from dot file, which is memory-mapped and read sequentially;
+ * if all_attributes is false, attributes other than weights (if weights is true)
+ * are skipped */
+bool graphe::read_dot(const string &filename,bool all_attributes,bool weights) {
+    mapped_file dotfile;
+    if (!dotfile.open(filename))
         return false;
+    dot_all_attributes=all_attributes;
+    dot_keep_weights=weights;
     dot_subgraph_level=0;
     dot_reading_attributes=false;
     dot_reading_value=false;
     dot_comment_type=0;
     dot_newline_count=0;
     map<int,attrib> delayed_attributes;
+    gen_map node_index;
+    gen_map::const_iterator nit;
+    gen label;
     string token;
     int res,gtype,subgraph_count=0,index;
     bool strict=false,error_raised=false,has_root_graph=false;
@@ -2005,7 +2960,14 @@ bool graphe::read_dot(const string &filename) {
             }
         case _GT_DOT_TOKEN_TYPE_NUMBER:
         case _GT_DOT_TOKEN_TYPE_STRING:
-            index=add_node(str2gen(token,dot_token_type!=_GT_DOT_TOKEN_TYPE_NUMBER));
+            /* vertices are looked up by their labels, so that e.g. 01 and 1 are the same vertex */
+            label=str2gen(token,dot_token_type!=_GT_DOT_TOKEN_TYPE_NUMBER);
+            if ((nit=node_index.find(label))!=node_index.end())
+                index=nit->second.val;
+            else {
+                index=append_node(label);
+                node_index[label]=index;
+            }
             if (subgraphs.empty()) { error_raised=true; break; }
             node(index).set_subgraph(subgraphs.back().index());
             subgraphs.back().set_index(index+1);
@@ -2214,6 +3176,9 @@ bool gmap_find(const gen_map &gmap,const gen &key,gen &val) {
 bool graphe::read_gen(const gen &g) {
     if (g.type!=_VECT || g.subtype!=_GRAPH__VECT)
         return false;
+    GT_PROFILE(profile,"read_gen");
+    if (read_compiled(g))
+        return true;
     this->clear();
     int n;
     const vecteur &gv=*g._VECTptr;
@@ -2259,15 +3224,285 @@ bool graphe::read_gen(const gen &g) {
         }
         start+=deg;
         nodes.push_back(vert);
+        invalidate_adjacency();
     }
+    if (supports_attributes())
+        register_compiled(g);
     return true;
 }
 
-/* read special graph from a list of adjacency lists of integers */
-void graphe::read_special(const int *special_graph) {
-    int state=1;
-    gen v,w;
-    for(const int *p=special_graph;*p!=-2;++p) {
+/* compiled graphs
+ *
+ * Graphs read by read_gen or produced by to_gen are kept in a small LRU cache,
+ * keyed by the address of the source vecteur. Since the entry holds a reference
+ * to the source, the address cannot be reused by another vecteur while the
+ * entry is alive, so that subsequent commands applied to the same gen may copy
+ * the already parsed graph instead of parsing it again. Only graphs with at
+ * least compiled_threshold elements are cached automatically, unless pinned by
+ * the compile_graph command. An automatically cached source is first only
+ * marked as seen, and the parsed graph is stored when it is read again, so
+ * that graphs which are read once are never copied into the cache.
+ *
+ * Every entry stores a fingerprint of the identities of the source elements,
+ * which is checked on each lookup in a single sequential pass without
+ * dereferencing them; a source in which some element has been replaced in
+ * place is therefore detected and parsed again.
+ *
+ * Commands which only query the graph read it through shared_graph, which
+ * refers to the cached graph itself instead of copying it; the cached graph
+ * is reference counted, so it stays alive while it is used even if the entry
+ * is evicted meanwhile. Commands which modify the graph they read use
+ * read_gen, which copies the cached graph. */
+
+graphe::compiled_map graphe::compiled_graphs;
+int graphe::compiled_cache_size=4;
+int graphe::compiled_threshold=4096;
+ulong graphe::compiled_clock=0;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t compiled_mutex=PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+class compiled_lock { // locks the compiled graph cache within the current scope
+public:
+#ifdef HAVE_LIBPTHREAD
+    compiled_lock() { pthread_mutex_lock(&compiled_mutex); }
+    ~compiled_lock() { pthread_mutex_unlock(&compiled_mutex); }
+#else
+    compiled_lock() { }
+#endif
+};
+
+/* return a word identifying the value of g, which changes when g is replaced */
+static ulong compiled_identity(const gen &g) {
+    unsigned long long w;
+    switch (g.type) {
+    case _INT_:
+        w=(unsigned long long)g.val;
+        break;
+    case _DOUBLE_: {
+        double d=g._DOUBLE_val;
+        w=0;
+        memcpy(&w,&d,std::min(sizeof(w),sizeof(d)));
+        break;
+    }
+    case _VECT:
+        w=(unsigned long long)(size_t)g._VECTptr;
+        break;
+    case _MAP:
+        w=(unsigned long long)(size_t)g._MAPptr;
+        break;
+    case _STRNG:
+        w=(unsigned long long)(size_t)g._STRNGptr;
+        break;
+    case _SYMB:
+        w=(unsigned long long)(size_t)g._SYMBptr;
+        break;
+    case _IDNT:
+        w=(unsigned long long)(size_t)g._IDNTptr;
+        break;
+    case _ZINT:
+        w=(unsigned long long)(size_t)g._ZINTptr;
+        break;
+    case _FRAC:
+        w=(unsigned long long)(size_t)g._FRACptr;
+        break;
+    case _CPLX:
+        w=(unsigned long long)(size_t)g._CPLXptr;
+        break;
+    default:
+        w=0;
+        break;
+    }
+    return (ulong)(w^((unsigned long long)g.type<<56)^((unsigned long long)g.subtype<<48));
+}
+
+/* return the fingerprint of the graph vecteur v; it changes when an element of v
+ * is replaced by another value */
+ulong graphe::compiled_fingerprint(const vecteur &v) {
+    unsigned long long h=0x9E3779B97F4A7C15ULL^(unsigned long long)v.size();
+    for (const_iterateur it=v.begin();it!=v.end();++it) {
+        h^=(unsigned long long)compiled_identity(*it)+0x9E3779B97F4A7C15ULL+(h<<6)+(h>>2);
+        h*=0xBF58476D1CE4E5B9ULL;
+    }
+    h^=h>>31;
+    return (ulong)h;
+}
+
+/* return the cache entry for g, or NULL if there is none or the source was
+ * modified in place since the entry was made (lock must be held) */
+graphe::compiled_entry *graphe::find_compiled_entry(const gen &g) {
+    compiled_map::iterator it=compiled_graphs.find(g._VECTptr);
+    if (it==compiled_graphs.end())
+        return NULL;
+    if (it->second.fingerprint!=compiled_fingerprint(*g._VECTptr)) {
+        /* the source was modified in place, discard the entry */
+        release_compiled(it->second.C);
+        compiled_graphs.erase(it);
+        return NULL;
+    }
+    it->second.stamp=++compiled_clock;
+    return &it->second;
+}
+
+/* return the cached graph parsed from g, or NULL if there is none (lock must be held) */
+const graphe *graphe::find_compiled(const gen &g) {
+    compiled_entry *e=find_compiled_entry(g);
+    return e==NULL || e->C==NULL?NULL:e->C->G;
+}
+
+/* drop a reference to the cached graph C, which is deleted with the last one (lock must be held) */
+void graphe::release_compiled(compiled_graph *C) {
+    if (C!=NULL && --C->refs==0) {
+        delete C->G;
+        delete C;
+    }
+}
+
+/* evict least recently used unpinned entries until at most keep entries remain (lock must be held) */
+void graphe::evict_compiled(int keep) {
+    while (int(compiled_graphs.size())>keep) {
+        compiled_map::iterator it,lru=compiled_graphs.end();
+        for (it=compiled_graphs.begin();it!=compiled_graphs.end();++it) {
+            if (it->second.pins==0 && (lru==compiled_graphs.end() || it->second.stamp<lru->second.stamp))
+                lru=it;
+        }
+        if (lru==compiled_graphs.end())
+            break;
+        release_compiled(lru->second.C);
+        compiled_graphs.erase(lru);
+    }
+}
+
+/* copy the cached graph parsed from g to this graph, return false if g is not cached */
+bool graphe::read_compiled(const gen &g) {
+    compiled_lock lock;
+    const graphe *C=find_compiled(g);
+    if (C==NULL) {
+        GT_COUNT("compiled_cache_misses",1);
+        return false;
+    }
+    GT_COUNT("compiled_cache_hits",1);
+    GT_PROFILE(profile,"copy_compiled");
+    if (supports_attributes())
+        C->copy(*this);
+    else C->copy_topology(*this);
+    return true;
+}
+
+/* store a copy of this graph in the cache, tied to g (which must be its gen representation);
+ * unless force=true, the copy is made only if g was already seen before */
+void graphe::register_compiled(const gen &g,bool force) const {
+    assert(supports_attributes() && g.type==_VECT);
+    if (!force && (compiled_cache_size<=0 || int(g._VECTptr->size())<compiled_threshold))
+        return;
+    compiled_lock lock;
+    compiled_entry *e=find_compiled_entry(g);
+    if (e!=NULL && e->C!=NULL)
+        return;
+    if (e==NULL) {
+        evict_compiled(std::max(compiled_cache_size-1,0));
+        e=&compiled_graphs[g._VECTptr];
+        e->src=g;
+        e->fingerprint=compiled_fingerprint(*g._VECTptr);
+        e->C=NULL;
+        e->pins=0;
+        e->stamp=++compiled_clock;
+        if (!force)
+            return;
+    }
+    GT_PROFILE(profile,"store_compiled");
+    e->C=new compiled_graph;
+    e->C->G=new graphe(*this);
+    e->C->G->adjacency(); // built now, so that shared readers never modify the graph
+    e->C->refs=1;
+}
+
+/* pin (if yes=true) or unpin the graph g in the cache, return false if g is not a graph */
+bool graphe::pin_compiled(const gen &g,bool yes,GIAC_CONTEXT) {
+    if (g.type!=_VECT || g.subtype!=_GRAPH__VECT)
+        return false;
+    if (yes) {
+        bool cached;
+        {
+            compiled_lock lock;
+            cached=find_compiled(g)!=NULL;
+        }
+        graphe G(contextptr);
+        if (!cached) {
+            if (!G.read_gen(g))
+                return false;
+            G.register_compiled(g,true);
+        }
+    }
+    compiled_lock lock;
+    compiled_map::iterator it=compiled_graphs.find(g._VECTptr);
+    if (it!=compiled_graphs.end()) {
+        if (yes)
+            ++it->second.pins;
+        else if (it->second.pins>0)
+            --it->second.pins;
+    }
+    evict_compiled(compiled_cache_size);
+    return true;
+}
+
+/* remove all entries from the cache, including pinned ones (graphs in use by
+ * shared readers are deleted when they are released) */
+void graphe::clear_compiled() {
+    compiled_lock lock;
+    for (compiled_map::iterator it=compiled_graphs.begin();it!=compiled_graphs.end();++it) {
+        release_compiled(it->second.C);
+    }
+    compiled_graphs.clear();
+}
+
+graphe::shared_graph::shared_graph(const context *contextptr,bool support_attributes) {
+    ctx=contextptr;
+    m_attributes=support_attributes;
+    m_own=NULL;
+    m_shared=NULL;
+    m_G=NULL;
+}
+
+graphe::shared_graph::~shared_graph() {
+    if (m_shared!=NULL) {
+        compiled_lock lock;
+        release_compiled(m_shared);
+    }
+    delete m_own;
+}
+
+/* refer to the cached graph parsed from g if it was made in the same context,
+ * otherwise read g into a private graph, return false if g is not a graph */
+bool graphe::shared_graph::read_gen(const gen &g) {
+    if (g.type!=_VECT || g.subtype!=_GRAPH__VECT)
+        return false;
+    {
+        compiled_lock lock;
+        compiled_entry *e=find_compiled_entry(g);
+        if (e!=NULL && e->C!=NULL && e->C->G->giac_context()==ctx) {
+            GT_COUNT("compiled_cache_hits",1);
+            release_compiled(m_shared);
+            m_shared=e->C;
+            ++m_shared->refs;
+            m_G=m_shared->G;
+            return true;
+        }
+    }
+    if (m_own==NULL)
+        m_own=new graphe(ctx,m_attributes);
+    if (!m_own->read_gen(g))
+        return false;
+    m_G=m_own;
+    return true;
+}
+
+/* read special graph from a list of adjacency lists of integers */
+void graphe::read_special(const int *special_graph) {
+    int state=1;
+    gen v,w;
+    for(const int *p=special_graph;*p!=-2;++p) {
         if (*p==-1) {
             state=1;
         } else if (state==1) {
@@ -2303,6 +3538,7 @@ void graphe::read_special(const char **special_graph) {
 
 graphe &graphe::operator =(const graphe &other) {
     nodes.clear();
+    invalidate_adjacency();
     m_supports_attributes=other.supports_attributes();
     other.copy(*this);
     return *this;
@@ -2319,8 +3555,28 @@ void graphe::copy(graphe &G) const {
     G.copy_marked_nodes(get_marked_nodes());
 }
 
+/* make a copy of this graph without vertex and edge attributes and store it in G */
+void graphe::copy_topology(graphe &G) const {
+    assert(!G.supports_attributes());
+    G.clear();
+    G.set_graph_attributes(attributes);
+    G.reserve_nodes(node_count());
+    for (node_iter it=nodes.begin();it!=nodes.end();++it) {
+        G.nodes.push_back(vertex(false));
+        G.invalidate_adjacency();
+        vertex &v=G.nodes.back();
+        const ivector &ngh=it->neighbors();
+        if (!ngh.empty())
+            v.add_neighbors(&ngh.front(),&ngh.front()+ngh.size());
+        if (it->has_multiedges())
+            v.copy_multiedges(*it);
+    }
+    G.copy_marked_nodes(get_marked_nodes());
+}
+
 void graphe::copy_nodes(const vector<vertex> &V) {
     nodes=V;
+    invalidate_adjacency();
     if (!supports_attributes()) {
         for (vector<vertex>::iterator it=nodes.begin();it!=nodes.end();++it) {
             it->unsupport_attributes();
@@ -2377,13 +3633,17 @@ void graphe::add_edge(int i,int j,const gen &w) {
     assert(i>=0 && i<node_count() && j>=0 && j<node_count());
     if (has_edge(i,j))
         return;
+    bool dyn=dynamic_synced();
     node(i).add_neighbor(j);
     if (!is_directed())
         node(j).add_neighbor(i);
+    invalidate_adjacency();
     if (is_weighted()) {
         assert(supports_attributes());
         set_edge_attribute(i,j,_GT_ATTRIB_WEIGHT,w);
     }
+    if (dyn)
+        m_dynamic.insert(*this,i,j,m_modifications);
 }
 
 /* add edge {i,j} or arc [i,j] with attributes */
@@ -2391,6 +3651,7 @@ void graphe::add_edge(int i,int j,const attrib &attr) {
     assert(i>=0 && i<node_count() && j>=0 && j<node_count() && supports_attributes());
     if (has_edge(i,j))
         return;
+    bool dyn=dynamic_synced();
     if (is_directed())
         node(i).add_neighbor(j,attr);
     else {
@@ -2398,6 +3659,134 @@ void graphe::add_edge(int i,int j,const attrib &attr) {
         node(v).add_neighbor(w,attr);
         node(w).add_neighbor(v);
     }
+    invalidate_adjacency();
+    if (dyn)
+        m_dynamic.insert(*this,i,j,m_modifications);
+}
+
+/* parallel sorting: the chunks are sorted independently and then merged pairwise */
+template<class T>
+struct parallel_sort_data {
+    std::vector<T> *v;
+    std::vector<size_t> bounds;
+    int width;
+};
+
+template<class T>
+static void parallel_sort_chunks(int first,int last,int thread,void *data) {
+    parallel_sort_data<T> *d=(parallel_sort_data<T>*)data;
+    for (int k=first;k<last;++k) {
+        std::sort(d->v->begin()+d->bounds[k],d->v->begin()+d->bounds[k+1]);
+    }
+}
+
+template<class T>
+static void parallel_sort_merges(int first,int last,int thread,void *data) {
+    parallel_sort_data<T> *d=(parallel_sort_data<T>*)data;
+    int nc=d->bounds.size()-1,w=d->width;
+    for (int k=first;k<last;++k) {
+        int a=2*k*w,b=std::min(a+w,nc),c=std::min(a+2*w,nc);
+        if (b<c)
+            std::inplace_merge(d->v->begin()+d->bounds[a],d->v->begin()+d->bounds[b],d->v->begin()+d->bounds[c]);
+    }
+}
+
+template<class T>
+static void parallel_sort(std::vector<T> &v) {
+    size_t n=v.size();
+    int nc=graphe::thread_count(int(std::min(n>>14,size_t(1<<20))));
+    if (nc<2) {
+        std::sort(v.begin(),v.end());
+        return;
+    }
+    parallel_sort_data<T> data;
+    data.v=&v;
+    data.bounds.resize(nc+1);
+    for (int k=0;k<=nc;++k) {
+        data.bounds[k]=(n*k)/nc;
+    }
+    graphe::parallel_for(nc,parallel_sort_chunks<T>,&data,nc,1);
+    for (data.width=1;data.width<nc;data.width*=2) {
+        int m=(nc+2*data.width-1)/(2*data.width);
+        graphe::parallel_for(m,parallel_sort_merges<T>,&data,m,1);
+    }
+}
+
+struct add_neighbors_data {
+    std::vector<graphe::vertex*> nodes;
+    const graphe::ivector *offsets;
+    const graphe::ivector *heads;
+};
+
+static void add_neighbors_range(int first,int last,int thread,void *data) {
+    add_neighbors_data *d=(add_neighbors_data*)data;
+    const graphe::ivector &ofs=*d->offsets;
+    const int *heads=d->heads->empty()?NULL:&d->heads->front();
+    for (int i=first;i<last;++i) {
+        d->nodes[i]->add_neighbors(heads+ofs[i],heads+ofs[i+1]);
+    }
+}
+
+/* add all edges (arcs) in E at once, loops and already present edges are ignored,
+ * on return E contains the inserted edges as sorted (normalized) pairs without duplicates */
+void graphe::add_edges(ipairs &E) {
+    int n=node_count();
+    bool isdir=is_directed(),isempty=true;
+    ipairs::iterator jt=E.begin();
+    for (ipairs::const_iterator it=E.begin();it!=E.end();++it) {
+        assert(it->first>=0 && it->first<n && it->second>=0 && it->second<n);
+        if (it->first==it->second)
+            continue;
+        *(jt++)=isdir || it->first<it->second?*it:make_pair(it->second,it->first);
+    }
+    E.erase(jt,E.end());
+    parallel_sort(E);
+    E.erase(std::unique(E.begin(),E.end()),E.end());
+    for (int i=0;isempty && i<n;++i) {
+        isempty=node(i).degree()==0;
+    }
+    if (!isempty) {
+        jt=E.begin();
+        for (ipairs::const_iterator it=E.begin();it!=E.end();++it) {
+            if (!has_edge(*it))
+                *(jt++)=*it;
+        }
+        E.erase(jt,E.end());
+    }
+    if (E.empty())
+        return;
+    /* distribute the arcs to their tails by counting sort, since E is sorted the heads
+     * of each vertex come out sorted as well */
+    ivector offsets(n+1,0),pos,heads(isdir?E.size():2*E.size());
+    for (ipairs_iter it=E.begin();it!=E.end();++it) {
+        ++offsets[it->first+1];
+        if (!isdir)
+            ++offsets[it->second+1];
+    }
+    for (int i=0;i<n;++i) {
+        offsets[i+1]+=offsets[i];
+    }
+    pos=offsets;
+    for (ipairs_iter it=E.begin();it!=E.end();++it) {
+        heads[pos[it->first]++]=it->second;
+        if (!isdir)
+            heads[pos[it->second]++]=it->first;
+    }
+    add_neighbors_data data;
+    data.nodes.resize(n);
+    for (int i=0;i<n;++i) {
+        data.nodes[i]=&node(i);
+    }
+    data.offsets=&offsets;
+    data.heads=&heads;
+    parallel_for(n,add_neighbors_range,&data,thread_count(heads.size()>>16),256);
+    invalidate_adjacency();
+    if (is_weighted()) {
+        assert(supports_attributes());
+        for (ipairs_iter it=E.begin();it!=E.end();++it) {
+            set_edge_attribute(it->first,it->second,_GT_ATTRIB_WEIGHT,gen(1));
+        }
+    }
 }
 
 /* add edge {v,w} or arc [v,w], adding vertices v and/or w if necessary */
@@ -2459,16 +3848,24 @@ void graphe::remove_temporary_edges() {
 bool graphe::remove_edge(int i,int j) {
     if (!has_edge(i,j))
         return false;
+    bool dyn=dynamic_synced();
     node(i).remove_neighbor(j);
     if (!is_directed())
         node(j).remove_neighbor(i);
+    invalidate_adjacency();
+    if (dyn)
+        m_dynamic.remove(*this,i,j,m_modifications);
     return true;
 }
 
 /* add new vertex to the graph */
 int graphe::add_node() {
     assert(!supports_attributes());
+    bool dyn=dynamic_synced();
     nodes.push_back(vertex(false));
+    invalidate_adjacency();
+    if (dyn)
+        m_dynamic.add_node(m_modifications);
     return node_count()-1;
 }
 
@@ -2479,7 +3876,22 @@ int graphe::add_node(const gen &v,const attrib &attr) {
         if (it->label()==v)
             return it-nodes.begin();
     }
+    bool dyn=dynamic_synced();
     nodes.push_back(vertex(v,attr));
+    invalidate_adjacency();
+    if (dyn)
+        m_dynamic.add_node(m_modifications);
+    return node_count()-1;
+}
+
+/* add vertex v to the graph without checking whether it is already there */
+int graphe::append_node(const gen &v) {
+    assert(supports_attributes());
+    bool dyn=dynamic_synced();
+    nodes.push_back(vertex(v,attrib()));
+    invalidate_adjacency();
+    if (dyn)
+        m_dynamic.add_node(m_modifications);
     return node_count()-1;
 }
 
@@ -2497,6 +3909,7 @@ void graphe::add_nodes(int n) {
     for (int i=0;i<n;++i) {
         nodes.push_back(vertex(false));
     }
+    invalidate_adjacency();
 }
 
 /* remove all nodes with indices from V */
@@ -2864,35 +4277,33 @@ void graphe::adjacent_nodes(int i,ivector &adj,bool include_temp_edges) const {
 /* return a maximal independent set of vertices in undirected graph */
 void graphe::maximal_independent_set(ivector &ind) const {
     int n=node_count(),i;
-    ivector V(n),gain(n);
+    ivector gain(n);
+    bvector avail(n,true);
+    /* candidates ordered by decreasing gain, ties broken by the smallest index */
+    std::set<ipair> Q;
     for (i=0;i<n;++i) {
-        V[i]=i;
         gain[i]=degree(i);
+        Q.insert(make_pair(-gain[i],i));
     }
-    ivector::iterator pos;
     ind.clear();
     ind.reserve(n);
-    while (!V.empty()) {
-        i=V.front();
-        pos=V.begin();
-        for (ivector::iterator it=V.begin();it!=V.end();++it) {
-            if (gain[i]<gain[*it]) {
-                i=*it;
-                pos=it;
-            }
-        }
-        V.erase(pos);
+    while (!Q.empty()) {
+        i=Q.begin()->second;
+        Q.erase(Q.begin());
+        avail[i]=false;
         ind.push_back(i);
         const vertex &v=node(i);
         for (ivector_iter it=v.neighbors().begin();it!=v.neighbors().end();++it) {
-            if ((pos=find(V.begin(),V.end(),*it))==V.end())
+            if (!avail[*it])
                 continue;
-            V.erase(pos);
+            avail[*it]=false;
+            Q.erase(make_pair(-gain[*it],*it));
             const vertex &w=node(*it);
             for (ivector_iter jt=w.neighbors().begin();jt!=w.neighbors().end();++jt) {
-                if (find(V.begin(),V.end(),*jt)==V.end())
+                if (!avail[*jt])
                     continue;
-                gain[*jt]++;
+                Q.erase(make_pair(-gain[*jt],*jt));
+                Q.insert(make_pair(-(++gain[*jt]),*jt));
             }
         }
     }
@@ -2932,12 +4343,14 @@ void graphe::find_maximal_matching(ipairs &matching,int sg) const {
     }
     if (sg>=0)
         for (ivector_iter it=V.begin();it!=V.end();++it) V_pos[*it]=it-V.begin();
+    int first=0;
     while (true) {
-        for (i=0;i<n;++i) {
+        /* vertices before first stay marked or matched */
+        for (i=first;i<n;++i) {
             if (!node_marked[i] && match[i]<0)
                 break;
         }
-        if (i==n)
+        if ((first=i)==n)
             break;
         node_marked[i]=true;
         const vertex &v=node(V[i]);
@@ -2951,14 +4364,11 @@ void graphe::find_maximal_matching(ipairs &matching,int sg) const {
             }
         }
     }
-    ivector skip;
     matching.clear();
     for (i=0;i<int(match.size());++i) {
-        j=match[i];
-        if (j<0 || find(skip.begin(),skip.end(),i)!=skip.end())
-            continue;
-        skip.push_back(j);
-        matching.push_back(make_pair(V[i],V[j]));
+        /* report each matched pair once, from its smaller end */
+        if ((j=match[i])>i)
+            matching.push_back(make_pair(V[i],V[j]));
     }
 }
 
@@ -3375,53 +4785,245 @@ void graphe::create_random_layout(layout &x,int dim) {
     }
 }
 
-/* lay out the graph using a force-directed algorithm with spring-electrical model */
+/* bhtree class implementation
+ *
+ * The tree is rebuilt at the start of each iteration of the force-directed
+ * algorithm. Cells are stored in a flat vector, the children of a cell being
+ * consecutive, so the tree is traversed without recursion. */
+
+void graphe::bhtree::init_cell(int c,const double *center,double half) {
+    cell &C=cells[c];
+    for (int k=0;k<3;++k) {
+        C.center[k]=k<dim?center[k]:0;
+        C.com[k]=0;
+    }
+    C.half=half;
+    C.mass=0;
+    C.body=-1;
+    C.child=-1;
+}
+
+/* return the index of the child of c which contains the point p */
+int graphe::bhtree::child_index(int c,const double *p) const {
+    const cell &C=cells[c];
+    int q=0;
+    for (int k=0;k<dim;++k) {
+        if (p[k]>=C.center[k])
+            q|=1<<k;
+    }
+    return C.child+q;
+}
+
+/* create 2^d children of the leaf c */
+void graphe::bhtree::split(int c) {
+    int first=cells.size();
+    cells.resize(first+nch);
+    double h=cells[c].half/2,center[3];
+    for (int q=0;q<nch;++q) {
+        for (int k=0;k<dim;++k) {
+            center[k]=cells[c].center[k]+((q>>k)&1?h:-h);
+        }
+        init_cell(first+q,center,h);
+    }
+    cells[c].child=first;
+}
+
+/* insert the i-th point into the tree */
+void graphe::bhtree::insert(int i) {
+    const double *p=X+i*dim;
+    int c=0,b,k;
+    for (int depth=0;;++depth) {
+        cell &C=cells[c];
+        if (C.mass==0) {
+            C.mass=1;
+            C.body=i;
+            for (k=0;k<dim;++k) C.com[k]=p[k];
+            leaf_of[i]=c;
+            return;
+        }
+        for (k=0;k<dim;++k) C.com[k]=(C.com[k]*C.mass+p[k])/(C.mass+1);
+        ++C.mass;
+        if (C.child<0) {
+            if (depth>=BH_MAX_DEPTH) {
+                /* (nearly) coincident points are merged */
+                leaf_of[i]=c;
+                return;
+            }
+            /* move the point stored in this leaf to a child */
+            b=C.body;
+            C.body=-1;
+            split(c);
+            int cb=child_index(c,X+b*dim);
+            cell &B=cells[cb];
+            B.mass=1;
+            B.body=b;
+            for (k=0;k<dim;++k) B.com[k]=X[b*dim+k];
+            leaf_of[b]=cb;
+        }
+        c=child_index(c,p);
+    }
+}
+
+/* build the tree for the points stored in coords as consecutive d-tuples */
+void graphe::bhtree::build(const dvector &coords) {
+    int n=coords.size()/dim,i,k;
+    X=&coords.front();
+    double lo[3],hi[3],center[3],half=0;
+    for (k=0;k<dim;++k) {
+        lo[k]=DBL_MAX;
+        hi[k]=-DBL_MAX;
+    }
+    for (i=0;i<n;++i) {
+        for (k=0;k<dim;++k) {
+            lo[k]=std::min(lo[k],X[i*dim+k]);
+            hi[k]=std::max(hi[k],X[i*dim+k]);
+        }
+    }
+    for (k=0;k<dim;++k) {
+        center[k]=(lo[k]+hi[k])/2;
+        half=std::max(half,(hi[k]-lo[k])/2);
+    }
+    half=half*(1+1e-9)+1e-12;
+    cells.clear();
+    cells.reserve(4*n);
+    cells.resize(1);
+    init_cell(0,center,half);
+    leaf_of.resize(n);
+    for (i=0;i<n;++i) {
+        insert(i);
+    }
+}
+
+/* add the approximate repulsive force D/|xi-xj| acting on the i-th point to f,
+ * cells which are seen at angle smaller than theta are treated as single points,
+ * return the number of other points coinciding with the i-th point */
+int graphe::bhtree::repulsive_force(int i,double theta,double D,double R,double *f) {
+    const double *p=X+i*dim;
+    double dx[3],com[3],norm,s;
+    int c,m,k,zeros=0;
+    stack.clear();
+    stack.push_back(0);
+    while (!stack.empty()) {
+        c=stack.back();
+        stack.pop_back();
+        const cell &C=cells[c];
+        if (C.mass==0)
+            continue;
+        m=C.mass;
+        for (k=0;k<dim;++k) com[k]=C.com[k];
+        if (C.child<0 && leaf_of[i]==c) {
+            /* exclude the i-th point from its own leaf */
+            if (--m==0)
+                continue;
+            for (k=0;k<dim;++k) com[k]=(com[k]*(m+1)-p[k])/m;
+        }
+        norm=0;
+        for (k=0;k<dim;++k) {
+            dx[k]=p[k]-com[k];
+            norm+=dx[k]*dx[k];
+        }
+        norm=std::sqrt(norm);
+        if (C.child>=0 && 2*C.half>=theta*norm) {
+            for (k=0;k<nch;++k) stack.push_back(C.child+k);
+            continue;
+        }
+        if (norm>R)
+            continue;
+        if (norm==0) {
+            zeros+=m;
+            continue;
+        }
+        s=D*m/(norm*norm);
+        for (k=0;k<dim;++k) f[k]+=s*dx[k];
+    }
+    return zeros;
+}
+
+/* lay out the graph using a force-directed algorithm with spring-electrical model,
+ * for larger graphs the repulsive forces are approximated by using Barnes-Hut tree
+ * with opening angle barnes_hut_theta (setting it to zero disables the approximation) */
 void graphe::force_directed_placement(layout &x,double K,double R,double tol,bool ac) {
+    GT_PROFILE(profile,"force_directed_placement");
     double step_length=K,shrinking_factor=0.9,eps=K*tol,C=0.01,D=C*K*K;
     double energy=DBL_MAX,energy0,norm,max_displacement;
-    int progress=0,n=x.size(),i,j;
+    int progress=0,n=x.size(),i,j,k,zeros;
     if (n==0)
         return;
     assert (n==node_count() && n>0);
     int d=x.front().size();
-    point force(d),p(d),f(d);
+    /* store the coordinates contiguously */
+    dvector X(n*d);
+    for (i=0;i<n;++i) {
+        for (k=0;k<d;++k) X[i*d+k]=x[i][k];
+    }
+    bool approx=barnes_hut_theta>0 && n>=BH_MIN_NODES && (d==2 || d==3);
+    bhtree T(approx?d:2);
+    dvector force(d),f(d);
+    point jitter(d);
+    double *xi,*xj;
     /* keep updating the positions until the system freezes */
     do {
         energy0=energy;
         energy=0;
         max_displacement=0;
+        if (approx)
+            T.build(X);
         for (node_iter nt=nodes.begin();nt!=nodes.end();++nt) {
             i=nt-nodes.begin();
-            point &xi=x[i];
-            clear_point_coords(force);
+            xi=&X[i*d];
+            std::fill(force.begin(),force.end(),0.0);
             /* compute the attractive forces between vertices adjacent to the i-th vertex */
             for (ivector_iter it=nt->neighbors().begin();it!=nt->neighbors().end();++it) {
-                j=*it;
-                scale_point(p,point_distance(xi,x[j],p)/K);
-                add_point(force,p);
+                xj=&X[(*it)*d];
+                norm=0;
+                for (k=0;k<d;++k) {
+                    f[k]=xj[k]-xi[k];
+                    norm+=f[k]*f[k];
+                }
+                norm=std::sqrt(norm)/K;
+                for (k=0;k<d;++k) force[k]+=norm*f[k];
             }
             /* compute the repulsive forces for all vertices j!=i which are not too far from the i-th vertex */
-            for (layout_iter it=x.begin();it!=x.end();++it) {
-                j=it-x.begin();
-                if (i!=j) {
-                    norm=point_distance(*it,xi,f);
+            if (approx)
+                zeros=T.repulsive_force(i,barnes_hut_theta,D,R,&force.front());
+            else {
+                zeros=0;
+                for (j=0;j<n;++j) {
+                    if (i==j)
+                        continue;
+                    xj=&X[j*d];
+                    norm=0;
+                    for (k=0;k<d;++k) {
+                        f[k]=xi[k]-xj[k];
+                        norm+=f[k]*f[k];
+                    }
+                    norm=std::sqrt(norm);
                     if (norm>R)
                         continue;
-                    if (norm==0)
-                        rand_point(f,norm=shrinking_factor*eps);
-                    scale_point(f,D/(norm*norm));
-                    add_point(force,f);
+                    if (norm==0) {
+                        ++zeros;
+                        continue;
+                    }
+                    norm=D/(norm*norm);
+                    for (k=0;k<d;++k) force[k]+=norm*f[k];
                 }
             }
+            /* push the i-th vertex away from the vertices which coincide with it */
+            for (;zeros>0;--zeros) {
+                rand_point(jitter,norm=shrinking_factor*eps);
+                for (k=0;k<d;++k) force[k]+=jitter[k]*D/(norm*norm);
+            }
             /* move the location of the i-th vertex in the direction of the force f */
-            norm=point_displacement(force);
+            norm=0;
+            for (k=0;k<d;++k) norm+=force[k]*force[k];
+            norm=std::sqrt(norm);
             if (norm==0)
                 continue;
             if (step_length<norm) {
-                scale_point(force,step_length/norm);
+                for (k=0;k<d;++k) force[k]*=step_length/norm;
                 norm=step_length;
             }
-            add_point(xi,force);
+            for (k=0;k<d;++k) xi[k]+=force[k];
             /* update the maximal displacement for this iteration */
             if (norm>max_displacement)
                 max_displacement=norm;
@@ -3442,6 +5044,9 @@ void graphe::force_directed_placement(layout &x,double K,double R,double tol,boo
             }
         } else step_length*=shrinking_factor; /* simple cooling scheme */
     } while (max_displacement>eps);
+    for (i=0;i<n;++i) {
+        for (k=0;k<d;++k) x[i][k]=X[i*d+k];
+    }
 }
 
 /* compute optimal positions of edge labels and store them as "position" attributes of the respective edges */
@@ -3576,95 +5181,229 @@ gen graphe::sparse_product_element(const sparsemat &A,const sparsemat &B, int i,
     return res;
 }
 
-/* store the transposition of A in T */
-void graphe::transpose_sparsemat(const sparsemat &A, sparsemat &T) {
-    for (sparsemat::const_iterator it=A.begin();it!=A.end();++it) {
-        for(map<int,ipair>::const_iterator jt=it->second.begin();jt!=it->second.end();++jt) {
-            T[jt->first][it->first]=jt->second;
+/* store the transpose of A in T */
+void graphe::dsparsemat_transpose(const dsparsemat &A,dsparsemat &T) {
+    int n=A.row_count(),m=A.ncols,i,j,k;
+    T.ncols=n;
+    T.offsets.assign(m+1,0);
+    T.columns.resize(A.nnz());
+    T.values.resize(A.nnz());
+    for (k=0;k<A.nnz();++k) {
+        ++T.offsets[A.columns[k]+1];
+    }
+    for (j=0;j<m;++j) {
+        T.offsets[j+1]+=T.offsets[j];
+    }
+    ivector pos(T.offsets.begin(),T.offsets.end()-1);
+    for (i=0;i<n;++i) {
+        for (k=A.offsets[i];k<A.offsets[i+1];++k) {
+            j=pos[A.columns[k]]++;
+            T.columns[j]=i;
+            T.values[j]=A.values[k];
         }
     }
 }
 
-/* return number of vertices in V which are incident to the i-th vertex */
-int graphe::mdeg(const ivector &V, int i) const {
-    int d=0;
-    for (ivector_iter it=V.begin();it!=V.end();++it) {
-        if (i==*it)
-            return 1;
-        if (has_edge(i,*it))
-            ++d;
+struct spgemm_data {
+    const graphe::dsparsemat *A;
+    const graphe::dsparsemat *B;
+    graphe::dsparsemat *C;
+    std::vector<graphe::ivector> mark; // per-thread last row in which each column was hit
+    std::vector<graphe::dvector> acc;  // per-thread dense row accumulators
+    bool symbolic;                     // count the row sizes of C instead of filling them
+};
+
+/* Gustavson's product of the rows first,..,last-1 of A with B */
+static void spgemm_rows(int first,int last,int thread,void *data) {
+    spgemm_data *d=(spgemm_data*)data;
+    const graphe::dsparsemat &A=*d->A,&B=*d->B;
+    graphe::dsparsemat &C=*d->C;
+    graphe::ivector &mark=d->mark[thread];
+    graphe::dvector &acc=d->acc[thread];
+    int i,j,k,l,pos;
+    double a;
+    for (i=first;i<last;++i) {
+        if (d->symbolic) {
+            int cnt=0;
+            for (k=A.offsets[i];k<A.offsets[i+1];++k) {
+                for (l=B.offsets[A.columns[k]];l<B.offsets[A.columns[k]+1];++l) {
+                    if (mark[j=B.columns[l]]!=i) {
+                        mark[j]=i;
+                        ++cnt;
+                    }
+                }
+            }
+            C.offsets[i+1]=cnt;
+            continue;
+        }
+        pos=C.offsets[i];
+        for (k=A.offsets[i];k<A.offsets[i+1];++k) {
+            a=A.values[k];
+            for (l=B.offsets[A.columns[k]];l<B.offsets[A.columns[k]+1];++l) {
+                if (mark[j=B.columns[l]]!=i) {
+                    mark[j]=i;
+                    acc[j]=0;
+                    C.columns[pos++]=j;
+                }
+                acc[j]+=a*B.values[l];
+            }
+        }
+        std::sort(C.columns.begin()+C.offsets[i],C.columns.begin()+pos);
+        for (k=C.offsets[i];k<pos;++k) {
+            C.values[k]=acc[C.columns[k]];
+        }
     }
-    return d;
 }
 
-/* coarsening of the graph with respect to the prolongation matrix P */
-void graphe::coarsening(graphe &G,const sparsemat &P,const ivector &V) const {
-    sparsemat Q,I,R,IG;
-    int n=node_count();
-    transpose_sparsemat(P,Q);
-    /* create sparse symmetric incidence matrix I of this graph */
-    for (node_iter it=nodes.begin();it!=nodes.end();++it) {
-        const ivector &ngh=it->neighbors();
-        if (ngh.empty())
-            continue;
-        map<int,ipair> &row=I[it-nodes.begin()];
-        for (ivector_iter jt=ngh.begin();jt!=ngh.end();++jt) {
-            row[*jt]=make_pair(1,1);
+/* compute the product C=A*B, rows of C are computed in parallel */
+void graphe::dsparsemat_multiply(const dsparsemat &A,const dsparsemat &B,dsparsemat &C) {
+    GT_PROFILE(profile,"spgemm");
+    int n=A.row_count(),nt=thread_count(A.nnz()/4096+1);
+    C.ncols=B.ncols;
+    C.offsets.assign(n+1,0);
+    spgemm_data data;
+    data.A=&A;
+    data.B=&B;
+    data.C=&C;
+    data.mark.assign(nt,ivector(B.ncols,-1));
+    data.symbolic=true;
+    parallel_for(n,spgemm_rows,&data,nt,256);
+    for (int i=0;i<n;++i) {
+        C.offsets[i+1]+=C.offsets[i];
+    }
+    C.columns.resize(C.offsets[n]);
+    C.values.resize(C.offsets[n]);
+    for (int t=0;t<nt;++t) {
+        data.mark[t].assign(B.ncols,-1);
+    }
+    data.acc.assign(nt,dvector(B.ncols));
+    data.symbolic=false;
+    parallel_for(n,spgemm_rows,&data,nt,256);
+}
+
+struct prolong_data {
+    const graphe::dsparsemat *P;
+    const graphe::layout *y;
+    graphe::layout *x;
+};
+
+static void prolong_rows(int first,int last,int thread,void *data) {
+    prolong_data *d=(prolong_data*)data;
+    const graphe::dsparsemat &P=*d->P;
+    const graphe::layout &y=*d->y;
+    for (int i=first;i<last;++i) {
+        graphe::point &xi=d->x->at(i);
+        std::fill(xi.begin(),xi.end(),0.0);
+        for (int k=P.offsets[i];k<P.offsets[i+1];++k) {
+            const graphe::point &yj=y[P.columns[k]];
+            for (int c=xi.size();c-->0;) {
+                xi[c]+=P.values[k]*yj[c];
+            }
         }
     }
-    /* use Galerkin product Q*I*P as the incidence matrix IG for graph G */
-    multiply_sparse_matrices(Q,I,R,n);
-    multiply_sparse_matrices(R,P,IG,n);
+}
+
+/* compute the prolongation x=P*y of the layout y, rows of P are processed in parallel */
+void graphe::dsparsemat_prolong(const dsparsemat &P,const layout &y,layout &x) {
+    int n=P.row_count();
+    size_t d=y.empty()?0:y.front().size();
+    x.resize(n);
+    for (layout::iterator it=x.begin();it!=x.end();++it) {
+        it->resize(d);
+    }
+    prolong_data data;
+    data.P=&P;
+    data.y=&y;
+    data.x=&x;
+    parallel_for(n,prolong_rows,&data,thread_count(P.nnz()/4096+1),256);
+}
+
+/* coarsening of the graph with respect to the prolongation matrix P */
+void graphe::coarsening(graphe &G,const dsparsemat &P,const ivector &V) const {
+    const csr &adj=adjacency();
+    dsparsemat A,Q,R,IG;
+    /* the incidence matrix A of this graph */
+    A.ncols=node_count();
+    A.offsets=adj.offsets;
+    A.columns=adj.columns;
+    A.values.assign(adj.arc_count(),1.0);
+    /* use Galerkin product Q*A*P as the incidence matrix IG for graph G */
+    dsparsemat_transpose(P,Q);
+    dsparsemat_multiply(Q,A,R);
+    dsparsemat_multiply(R,P,IG);
+    G.reserve_nodes(V.size());
     for (ivector_iter it=V.begin();it!=V.end();++it) {
         G.add_node(node_label(*it));
     }
-    int i=0,j;
-    for (sparsemat::const_iterator it=IG.begin();it!=IG.end();++it) {
-        i=it->first;
-        for (map<int,ipair>::const_iterator jt=it->second.begin();jt!=it->second.end();++jt) {
-            j=jt->first;
-            if (i<j && jt->second.first!=0)
-                G.add_edge(i,j);
+    ipairs E;
+    for (int i=0;i<IG.row_count();++i) {
+        for (int k=IG.offsets[i];k<IG.offsets[i+1];++k) {
+            if (i<IG.columns[k] && IG.values[k]!=0)
+                E.push_back(make_pair(i,IG.columns[k]));
         }
     }
+    G.add_edges(E);
 }
 
 /* make coarser graph G by restricting to maximal independent set */
-void graphe::coarsening_mis(const ivector &V,graphe &G,sparsemat &P) const {
-    int n=node_count(),m=V.size();
+void graphe::coarsening_mis(const ivector &V,graphe &G,dsparsemat &P) const {
+    int n=node_count(),m=V.size(),j,k;
+    const csr &A=adjacency();
+    ivector pos(n,-1);
+    for (j=0;j<m;++j) {
+        pos[V[j]]=j;
+    }
+    P.ncols=m;
+    P.offsets.resize(n+1);
+    P.offsets[0]=0;
+    P.columns.clear();
+    P.values.clear();
     for (int i=0;i<n;++i) {
-        int md=mdeg(V,i);
-        assert(md>0);
-        for (int j=0;j<m;++j) {
-            if (i==V[j])
-                P[i][j]=make_pair(1,1);
-            else if (has_edge(i,V[j]))
-                P[i][j]=make_pair(1,md);
+        if (pos[i]>=0) {
+            P.columns.push_back(pos[i]);
+            P.values.push_back(1.0);
+        } else {
+            /* distribute i equally among its neighbors in V */
+            size_t start=P.columns.size();
+            for (k=A.offsets[i];k<A.offsets[i+1];++k) {
+                if ((j=pos[A.columns[k]])>=0)
+                    P.columns.push_back(j);
+            }
+            int md=P.columns.size()-start;
+            assert(md>0);
+            std::sort(P.columns.begin()+start,P.columns.end());
+            P.values.resize(P.columns.size(),1.0/md);
         }
+        P.offsets[i+1]=P.columns.size();
     }
     coarsening(G,P,V);
 }
 
 /* make coarser graph by collapsing edges found in maximal matching */
-void graphe::coarsening_ec(const ipairs &M,graphe &G,sparsemat &P) const {
-    ivector removed_nodes,V;
+void graphe::coarsening_ec(const ipairs &M,graphe &G,dsparsemat &P) const {
+    int n=node_count();
+    ivector partner(n,-1),pos(n,-1),V;
     for (ipairs_iter it=M.begin();it!=M.end();++it) {
-        removed_nodes.push_back(it->second);
+        partner[it->second]=it->first;
     }
-    int n=node_count(),m=removed_nodes.size(),J;
-    ivector::iterator ivt;
     for (int i=0;i<n;++i) {
-        if ((ivt=find(removed_nodes.begin(),removed_nodes.end(),i))==removed_nodes.end())
+        if (partner[i]<0) {
+            pos[i]=V.size();
             V.push_back(i);
-        else
-            removed_nodes.erase(ivt);
+        }
     }
+    /* each removed vertex is mapped to the vertex it is collapsed into */
+    P.ncols=V.size();
+    P.offsets.resize(n+1);
+    P.offsets[0]=0;
+    P.columns.clear();
     for (int i=0;i<n;++i) {
-        for (int j=0;j<n-m;++j) {
-            if (i==(J=V[j]) || find(M.begin(),M.end(),make_pair(J,i))!=M.end())
-                P[i][j]=make_pair(1,1);
-        }
+        int j=pos[partner[i]<0?i:partner[i]];
+        assert(j>=0);
+        P.columns.push_back(j);
+        P.offsets[i+1]=i+1;
     }
+    P.values.assign(n,1.0);
     coarsening(G,P,V);
 }
 
@@ -3694,7 +5433,7 @@ void graphe::multilevel_recursion(layout &x,int d,double R,double K,double tol,i
     } else {
         /* create coarser graph H and lay it out */
         graphe G(ctx);
-        sparsemat P; // prolongation matrix
+        dsparsemat P; // prolongation matrix
         if (multilevel_mis)
             coarsening_mis(mis,G,P);
         else
@@ -3702,18 +5441,7 @@ void graphe::multilevel_recursion(layout &x,int d,double R,double K,double tol,i
         layout y;
         G.multilevel_recursion(y,d,R,K,tol,depth+1);
         /* compute x=P*y (layout lifting) */
-        ipair pij;
-        point yj(d);
-        for (int i=0;i<n;++i) {
-            x[i]=point(d,0);
-            for (int j=0;j<m;++j) {
-                if (sparse_matrix_element(P,i,j,pij)) {
-                    copy_point(y[j],yj);
-                    scale_point(yj,_evalf(ipair2rat(pij),ctx).DOUBLE_val());
-                    add_point(x[i],yj);
-                }
-            }
-        }
+        dsparsemat_prolong(P,y,x);
         /* make the natural spring length K shorter with respect to
      * the current depth level and subsequently refine x */
         double L=K*std::pow(PLASTIC_NUMBER,depth-multilevel_depth);
@@ -3879,107 +5607,534 @@ void graphe::make_tutte_layout(layout &x,const ivector &outer_face) {
     } while (!converged);
 }
 
-/* Tomita recursive algorithm (a variant of Bron-Kerbosch) for maximal cliques */
-void graphe::tomita(iset &R,iset &P,iset &X,map<int,int> &m,int mode) {
-    if (P.empty() && X.empty()) {
-        if (mode==1) { // store matching
-            if (R.size()==2)
-                m[*R.begin()]=*R.rbegin();
-        } else if (mode==2 || mode==3) { // store the clique
-            ivector cliq;
-            cliq.reserve(R.size());
-            for (iset_iter it=R.begin();it!=R.end();++it) cliq.push_back(*it);
-            maxcliques.push_back(cliq);
-        }
-        if (mode==0 || mode==3)
-            ++m[R.size()];
-    } else {
-        /* choose as the pivot element the node with the highest number of neighbors in P, say i-th */
-        iset PUX,PP,XX,S;
-        sets_union(P,X,PUX);
-        int i=*PUX.begin(),mn=0,n;
-        for (iset_iter it=PUX.begin();it!=PUX.end();++it) {
-            const vertex &w=node(*it);
-            sets_intersection(w.neighbors(),P,S);
-            if ((n=int(S.size()))>mn) {
-                mn=n;
-                i=*it;
-            }
-        }
-        sets_difference(P,node(i).neighbors(),S);
-        for (iset_iter it=S.begin();it!=S.end();++it) {
-            const ivector &ngh=node(*it).neighbors();
-            R.insert(*it);
-            sets_intersection(ngh,P,PP);
-            sets_intersection(ngh,X,XX);
-            tomita(R,PP,XX,m,mode);
-            R.erase(*it);
-            P.erase(*it);
-            X.insert(*it);
-        }
+/* compute the degeneracy ordering of vertices (Batagelj and Zaversnik, 2003), in which
+ * each vertex has at most d later neighbors, where d is the degeneracy which is returned;
+ * core numbers are stored to core if it's non-null */
+int graphe::degeneracy_ordering(ivector &order,ivector *core) const {
+    const csr &A=adjacency();
+    int n=A.node_count(),md=0,d,i,j,k,u,du,pu,pw,w,res=0;
+    ivector deg(n),pos(n),bin;
+    for (i=0;i<n;++i) {
+        deg[i]=A.offsets[i+1]-A.offsets[i];
+        md=std::max(md,deg[i]);
     }
+    bin.resize(md+1,0);
+    for (i=0;i<n;++i) ++bin[deg[i]];
+    for (d=0,k=0;d<=md;++d) {
+        j=bin[d];
+        bin[d]=k;
+        k+=j;
+    }
+    order.resize(n);
+    for (i=0;i<n;++i) {
+        pos[i]=bin[deg[i]]++;
+        order[pos[i]]=i;
+    }
+    for (d=md;d>0;--d) bin[d]=bin[d-1];
+    if (md>=0 && !bin.empty()) bin[0]=0;
+    for (i=0;i<n;++i) {
+        int v=order[i];
+        res=std::max(res,deg[v]);
+        for (k=A.offsets[v];k<A.offsets[v+1];++k) {
+            u=A.columns[k];
+            if ((du=deg[u])>deg[v]) {
+                pu=pos[u];
+                pw=bin[du];
+                w=order[pw];
+                if (u!=w) {
+                    pos[u]=pw;
+                    order[pu]=w;
+                    pos[w]=pu;
+                    order[pw]=u;
+                }
+                ++bin[du];
+                --deg[u];
+            }
+        }
+    }
+    if (core!=NULL)
+        core->swap(deg);
+    return res;
 }
 
-/* a modified version of the Bron-Kerbosch algorithm for listing all maximal cliques,
-* developed by Tomita et al. Number of k-cliques will be stored to m[k] for each k.
-* If store_matching is true, store 2-cliques (v,w) as m[v]=w. */
-void graphe::clique_stats(map<int,int> &m,int mode) {
-    iset R,X,P;
-    for (int i=0;i<node_count();++i) P.insert(i);
-    tomita(R,P,X,m,mode);
+/* bit-parallel clique algorithms
+ *
+ * Both the maximum clique solver and the enumeration of maximal cliques process the
+ * vertices in degeneracy order: the search rooted at v is restricted to the later
+ * neighbors of v, which are at most d (the degeneracy of the graph). The root searches
+ * are independent and run in parallel. Each of them works on a local adjacency
+ * matrix of the neighborhood stored as rows of 64-bit words.
+ *
+ * The maximum clique solver is the BBMC algorithm by San Segundo et al. (Computers &
+ * Operations Research 38 (2011) 571-581), which bounds the search by greedy coloring
+ * of candidate sets computed with bit operations. The incumbent size is shared by all
+ * threads. Maximal cliques are enumerated by the algorithm of Eppstein, Löffler and
+ * Strash (2010), i.e. Tomita's pivoting Bron-Kerbosch with degeneracy ordering. */
+
+typedef unsigned long long bitword;
+
+static inline int bit_count(bitword w) {
+#ifdef __GNUC__
+    return __builtin_popcountll(w);
+#else
+    w=w-((w>>1) & 0x5555555555555555ULL);
+    w=(w & 0x3333333333333333ULL)+((w>>2) & 0x3333333333333333ULL);
+    w=(w+(w>>4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return int((w*0x0101010101010101ULL)>>56);
+#endif
 }
 
-/* generate a clique vertex cover of this graph */
-void graphe::find_maximal_cliques() {
-    map<int,int> m;
-    iset R,X,P;
-    for (int i=0;i<node_count();++i) P.insert(i);
-    clear_maximal_cliques();
-    tomita(R,P,X,m,2);
-}
-
-/* CP recursive subroutine */
-void graphe::cp_recurse(ivector &C,ivector &P,ivector &incumbent) {
-    if (C.size()>incumbent.size())
-        incumbent=C;
-    if (C.size()+P.size()>incumbent.size()) {
-        int p,k;
-        ivector Q,Cup;
-        while (!P.empty()) {
-            p=P.back();
-            P.pop_back();
-            Cup=C;
-            if (find(Cup.begin(),Cup.end(),p)==Cup.end())
-                Cup.push_back(p);
-            const vertex &v=node(p);
-            Q.clear();
-            Q.resize(std::min(P.size(),v.neighbors().size()));
-            k=0;
-            for (ivector_iter it=P.begin();it!=P.end();++it) {
-                if (v.has_neighbor(*it))
-                    Q[k++]=*it;
+static inline int lowest_bit(bitword w) {
+#ifdef __GNUC__
+    return __builtin_ctzll(w);
+#else
+    int i=0;
+    while ((w & 1)==0) { w>>=1; ++i; }
+    return i;
+#endif
+}
+
+static inline void set_bit(bitword *s,int i) { s[i>>6]|=1ULL<<(i&63); }
+static inline void clear_bit(bitword *s,int i) { s[i>>6]&=~(1ULL<<(i&63)); }
+
+/* return the index of the first element of s, or -1 if s is empty */
+static inline int first_bit(const bitword *s,int nw) {
+    for (int k=0;k<nw;++k) {
+        if (s[k]!=0)
+            return (k<<6)+lowest_bit(s[k]);
+    }
+    return -1;
+}
+
+static inline int and_count(const bitword *a,const bitword *b,int nw) {
+    int c=0;
+    for (int k=0;k<nw;++k) c+=bit_count(a[k] & b[k]);
+    return c;
+}
+
+struct clique_local { // per-thread workspace for clique searches
+    graphe::ivector tag;        // local index of a vertex in the current neighborhood, or -1
+    graphe::ivector local;      // global indices of local vertices
+    graphe::ipairs edges;       // edges in the neighborhood (local indices)
+    graphe::ivector deg;
+    std::vector<bitword> rows;  // adjacency rows of the local vertices
+    std::vector<bitword> xrows; // for enumeration: rows of excluded vertices (restricted to candidates)
+    std::vector<bitword> sets;  // candidate (and excluded) sets for each search depth
+    graphe::ivector order,colors,R;
+    std::map<int,int> stats;
+    std::vector<std::pair<int,graphe::ivector> > cliques;
+};
+
+struct clique_search { // data shared by parallel clique searches
+    const graphe::csr *A;
+    graphe::csr F;              // later neighbors in degeneracy order
+    graphe::ivector order,pos;
+    std::vector<clique_local> work;
+    int mode;
+    volatile int best;          // incumbent size, read without locking by all threads
+    graphe::ivector best_clique;
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_t mutex;
+#endif
+};
+
+/* prepare the degeneracy ordering, the later-neighbor lists and thread workspaces */
+static void clique_search_init(clique_search &cs,const graphe &G,int nthreads) {
+    const graphe::csr &A=G.adjacency();
+    int n=A.node_count(),i,j,k;
+    cs.A=&A;
+    G.degeneracy_ordering(cs.order);
+    cs.pos.resize(n);
+    for (i=0;i<n;++i) cs.pos[cs.order[i]]=i;
+    graphe::csr &F=cs.F;
+    F.offsets.resize(n+1);
+    F.columns.clear();
+    F.columns.reserve(A.arc_count()/2+1);
+    for (i=0;i<n;++i) {
+        F.offsets[i]=F.columns.size();
+        for (k=A.offsets[i];k<A.offsets[i+1];++k) {
+            if (cs.pos[j=A.columns[k]]>cs.pos[i])
+                F.columns.push_back(j);
+        }
+    }
+    F.offsets[n]=F.columns.size();
+    cs.work.resize(nthreads);
+    for (int t=0;t<nthreads;++t) cs.work[t].tag.assign(n,-1);
+    cs.best=0;
+}
+
+/* BBMC recursive search at the given depth, rows are the local adjacency matrix */
+static void bbmc_expand(clique_search &cs,clique_local &w,int k,int nw,int depth) {
+    bitword *P=&w.sets[(3*depth)*nw],*Q=P+nw,*Qc=Q+nw;
+    int *ord=&w.order[depth*k],*col=&w.colors[depth*k];
+    int kmin=cs.best-depth+1,cnt=0,c=1,v,i,j;
+    /* greedy sequential coloring of P, only vertices with colors >= kmin are kept for branching */
+    for (j=0;j<nw;++j) Q[j]=P[j];
+    while ((v=first_bit(Q,nw))>=0) {
+        for (j=0;j<nw;++j) Qc[j]=Q[j];
+        while ((v=first_bit(Qc,nw))>=0) {
+            clear_bit(Q,v);
+            clear_bit(Qc,v);
+            const bitword *row=&w.rows[v*nw];
+            for (j=0;j<nw;++j) Qc[j]&=~row[j];
+            if (c>=kmin) {
+                ord[cnt]=v;
+                col[cnt++]=c;
+            }
+        }
+        ++c;
+    }
+    /* branch on vertices in the reverse order of coloring */
+    for (i=cnt;i-->0;) {
+        if (depth+col[i]<=cs.best)
+            return;
+        v=ord[i];
+        w.R[depth]=v;
+        bitword *NP=&w.sets[(3*depth+3)*nw];
+        const bitword *row=&w.rows[v*nw];
+        bool empty=true;
+        for (j=0;j<nw;++j) {
+            if ((NP[j]=P[j] & row[j])!=0)
+                empty=false;
+        }
+        if (empty) {
+            if (depth+1>cs.best) {
+#ifdef HAVE_LIBPTHREAD
+                pthread_mutex_lock(&cs.mutex);
+#endif
+                if (depth+1>cs.best) {
+                    /* R[0] is the root, which is stored as the global index */
+                    cs.best_clique.resize(depth+1);
+                    cs.best_clique[0]=w.R[0];
+                    for (j=1;j<=depth;++j) cs.best_clique[j]=w.local[w.R[j]];
+                    cs.best=depth+1;
+                }
+#ifdef HAVE_LIBPTHREAD
+                pthread_mutex_unlock(&cs.mutex);
+#endif
+            }
+        } else bbmc_expand(cs,w,k,nw,depth+1);
+        clear_bit(P,v);
+    }
+}
+
+/* collect the later neighbors of v into w.local and the edges among them into w.edges,
+ * local indices are sorted by local degrees in descending order */
+static int clique_neighborhood(clique_search &cs,clique_local &w,int v) {
+    const graphe::csr &F=cs.F;
+    int k=0,i,j,a,b;
+    w.local.clear();
+    for (j=F.offsets[v];j<F.offsets[v+1];++j) {
+        w.tag[F.columns[j]]=k++;
+        w.local.push_back(F.columns[j]);
+    }
+    w.deg.assign(k,0);
+    w.edges.clear();
+    for (i=0;i<k;++i) {
+        int u=w.local[i];
+        for (j=F.offsets[u];j<F.offsets[u+1];++j) {
+            if ((b=w.tag[F.columns[j]])>=0) {
+                w.edges.push_back(make_pair(i,b));
+                ++w.deg[i];
+                ++w.deg[b];
+            }
+        }
+    }
+    /* renumber by degrees */
+    w.order.resize(k);
+    for (i=0;i<k;++i) w.order[i]=i;
+    for (i=1;i<k;++i) { // insertion sort is fast enough since neighborhoods are small
+        a=w.order[i];
+        for (j=i;j>0 && w.deg[w.order[j-1]]<w.deg[a];--j) w.order[j]=w.order[j-1];
+        w.order[j]=a;
+    }
+    graphe::ivector perm(k);
+    for (i=0;i<k;++i) perm[w.order[i]]=i;
+    graphe::ivector loc(k);
+    for (i=0;i<k;++i) {
+        loc[perm[i]]=w.local[i];
+        w.tag[w.local[i]]=-1;
+    }
+    w.local.swap(loc);
+    for (graphe::ipairs::iterator it=w.edges.begin();it!=w.edges.end();++it) {
+        it->first=perm[it->first];
+        it->second=perm[it->second];
+    }
+    return k;
+}
+
+/* run BBMC for the roots with positions first,..,last-1 in degeneracy order */
+static void bbmc_roots(int first,int last,int thread,void *data) {
+    clique_search &cs=*(clique_search*)data;
+    clique_local &w=cs.work[thread];
+    for (int p=first;p<last;++p) {
+        int v=cs.order[p];
+        if (cs.F.offsets[v+1]-cs.F.offsets[v]+1<=cs.best)
+            continue;
+        int k=clique_neighborhood(cs,w,v),nw=(k+63)/64;
+        if (k==0) {
+            /* an isolated vertex or a vertex with no later neighbors */
+            if (cs.best==0) {
+#ifdef HAVE_LIBPTHREAD
+                pthread_mutex_lock(&cs.mutex);
+#endif
+                if (cs.best==0) {
+                    cs.best_clique.assign(1,v);
+                    cs.best=1;
+                }
+#ifdef HAVE_LIBPTHREAD
+                pthread_mutex_unlock(&cs.mutex);
+#endif
             }
-            Q.resize(k);
-            cp_recurse(Cup,Q,incumbent);
+            continue;
         }
+        w.rows.assign(k*nw,0);
+        for (graphe::ipairs_iter it=w.edges.begin();it!=w.edges.end();++it) {
+            set_bit(&w.rows[it->first*nw],it->second);
+            set_bit(&w.rows[it->second*nw],it->first);
+        }
+        w.sets.resize(3*(k+2)*nw);
+        w.order.resize((k+1)*k);
+        w.colors.resize((k+1)*k);
+        w.R.resize(k+2);
+        bitword *P=&w.sets[3*nw];
+        for (int j=0;j<nw;++j) P[j]=0;
+        for (int i=0;i<k;++i) set_bit(P,i);
+        w.R[0]=v;
+        bbmc_expand(cs,w,k,nw,1);
     }
 }
 
-/* Carraghan-Pardalos algorithm for finding maximum clique in a sparse graph */
-int graphe::cp_maxclique(ivector &clique) {
+/* find maximum clique in this graph and return its size */
+int graphe::maximum_clique(ivector &clique) {
+    assert(!is_directed());
+    GT_PROFILE(profile,"maximum_clique");
+    clique.clear();
     int n=node_count();
-    ivector P(n),C;
-    /* initialize P and sort all adjacency lists */
-    for (int i=0;i<n;++i)
-        P[i]=i;
-    /* sort vertices by degree in descending order */
-    degree_comparator comp(this);
-    sort(P.begin(),P.end(),comp);
-    std::reverse(P.begin(),P.end());
-    cp_recurse(C,P,clique);
+    if (n==0)
+        return 0;
+    clique_search cs;
+    int nthreads=thread_count(n/64+1);
+    clique_search_init(cs,*this,nthreads);
+    /* greedy initial incumbent from the vertex with the largest core number */
+    for (int p=n;p-->0;) {
+        int v=cs.order[p];
+        bool adj=true;
+        for (ivector_iter it=clique.begin();adj && it!=clique.end();++it) {
+            adj=node(v).has_neighbor(*it);
+        }
+        if (adj)
+            clique.push_back(v);
+    }
+    cs.best_clique=clique;
+    cs.best=clique.size();
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_init(&cs.mutex,NULL);
+#endif
+    parallel_for(n,bbmc_roots,&cs,nthreads,16);
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_destroy(&cs.mutex);
+#endif
+    clique=cs.best_clique;
     return clique.size();
 }
 
+/* report the maximal clique R[0..sz-1] (R[0] is global, others are local) */
+static void bk_report(clique_local &w,int sz,int root_pos,int mode) {
+    if (mode==0) {
+        ++w.stats[sz];
+        return;
+    }
+    graphe::ivector cl(sz);
+    cl[0]=w.R[0];
+    for (int j=1;j<sz;++j) cl[j]=w.local[w.R[j]];
+    std::sort(cl.begin(),cl.end());
+    if (mode==1) {
+        if (sz==2)
+            w.stats[cl.front()]=cl.back();
+        return;
+    }
+    if (mode==3)
+        ++w.stats[sz];
+    w.cliques.push_back(make_pair(root_pos,graphe::ivector(0)));
+    w.cliques.back().second.swap(cl);
+}
+
+/* Tomita's pivoting Bron-Kerbosch on the local universe of p candidates and x excluded
+ * vertices; sets at depth d are P,X (nw words each) and the branching set (pw words) */
+static void bk_expand(clique_local &w,int p,int nw,int pw,int depth,int root_pos,int mode) {
+    bitword *P=&w.sets[depth*(2*nw+pw)],*X=P+nw,*C=X+nw;
+    int u=-1,best=-1,c,v,j;
+    if (first_bit(P,pw)<0) {
+        if (first_bit(X,nw)<0)
+            bk_report(w,depth,root_pos,mode);
+        return;
+    }
+    /* choose the pivot with the largest number of neighbors in P */
+    for (int s=0;s<2;++s) {
+        const bitword *S=s==0?P:X;
+        for (j=0;j<(s==0?pw:nw);++j) {
+            bitword word=S[j];
+            while (word!=0) {
+                v=(j<<6)+lowest_bit(word);
+                word&=word-1;
+                c=and_count(P,v<p?&w.rows[v*nw]:&w.xrows[(v-p)*pw],pw);
+                if (c>best) {
+                    best=c;
+                    u=v;
+                }
+            }
+        }
+    }
+    const bitword *urow=u<p?&w.rows[u*nw]:&w.xrows[(u-p)*pw];
+    for (j=0;j<pw;++j) C[j]=P[j] & ~urow[j];
+    bitword *NP=P+(2*nw+pw),*NX=NP+nw;
+    while ((v=first_bit(C,pw))>=0) {
+        clear_bit(C,v);
+        const bitword *row=&w.rows[v*nw];
+        for (j=0;j<nw;++j) {
+            NP[j]=P[j] & row[j];
+            NX[j]=X[j] & row[j];
+        }
+        w.R[depth]=v;
+        bk_expand(w,p,nw,pw,depth+1,root_pos,mode);
+        clear_bit(P,v);
+        set_bit(X,v);
+    }
+}
+
+/* enumerate maximal cliques containing the roots with positions first,..,last-1 in
+ * degeneracy order, as their earliest vertices */
+static void bk_roots(int first,int last,int thread,void *data) {
+    clique_search &cs=*(clique_search*)data;
+    clique_local &w=cs.work[thread];
+    const graphe::csr &A=*cs.A,&F=cs.F;
+    int i,j,k,a,b,p,x,nw,pw;
+    for (int rp=first;rp<last;++rp) {
+        int v=cs.order[rp];
+        w.R.resize(1);
+        w.R[0]=v;
+        p=F.offsets[v+1]-F.offsets[v];
+        if (p==0) {
+            if (A.offsets[v+1]==A.offsets[v])
+                bk_report(w,1,rp,cs.mode);
+            continue;
+        }
+        /* candidates get local indices 0,..,p-1, earlier neighbors are tagged with -2 */
+        w.local.clear();
+        for (j=F.offsets[v];j<F.offsets[v+1];++j) {
+            w.tag[F.columns[j]]=w.local.size();
+            w.local.push_back(F.columns[j]);
+        }
+        for (k=A.offsets[v];k<A.offsets[v+1];++k) {
+            if (w.tag[a=A.columns[k]]<0)
+                w.tag[a]=-2;
+        }
+        /* find the edges within the neighborhood of v by scanning later neighbors,
+         * excluded vertices joining the search get indices p,p+1,.. */
+        w.edges.clear();
+        x=0;
+        for (k=A.offsets[v];k<A.offsets[v+1];++k) {
+            int s=A.columns[k];
+            for (j=F.offsets[s];j<F.offsets[s+1];++j) {
+                int t=F.columns[j];
+                if ((b=w.tag[t])==-1)
+                    continue;
+                a=w.tag[s];
+                bool ca=a>=0 && a<p,cb=b>=0 && b<p;
+                if (ca && cb)
+                    w.edges.push_back(make_pair(a,b));
+                else if (ca || cb) {
+                    /* one endpoint is a candidate, the other one is excluded */
+                    int e=ca?t:s,c=ca?a:b;
+                    if (w.tag[e]==-2) {
+                        w.tag[e]=p+x++;
+                        w.local.push_back(e);
+                    }
+                    w.edges.push_back(make_pair(c,w.tag[e]));
+                }
+            }
+        }
+        nw=(p+x+63)/64;
+        pw=(p+63)/64;
+        w.rows.assign(p*nw,0);
+        w.xrows.assign(x*pw,0);
+        for (graphe::ipairs_iter it=w.edges.begin();it!=w.edges.end();++it) {
+            a=it->first;
+            b=it->second;
+            set_bit(&w.rows[a*nw],b);
+            if (b<p)
+                set_bit(&w.rows[b*nw],a);
+            else set_bit(&w.xrows[(b-p)*pw],a);
+        }
+        for (k=A.offsets[v];k<A.offsets[v+1];++k) w.tag[A.columns[k]]=-1;
+        w.sets.assign((p+2)*(2*nw+pw),0);
+        w.R.resize(p+2);
+        bitword *P=&w.sets[2*nw+pw],*X=P+nw;
+        for (i=0;i<p;++i) set_bit(P,i);
+        for (i=p;i<p+x;++i) set_bit(X,i);
+        bk_expand(w,p,nw,pw,1,rp,cs.mode);
+    }
+}
+
+/* enumerate all maximal cliques, mode is interpreted as follows:
+ *  0: store the number of k-cliques to m[k] for each k,
+ *  1: store 2-cliques (v,w) with v<w as m[v]=w,
+ *  2: store the cliques to the list of maximal cliques,
+ *  3: combination of 0 and 2. */
+void graphe::enumerate_cliques(map<int,int> &m,int mode) {
+    int n=node_count();
+    if (n==0) {
+        if (mode==2 || mode==3)
+            maxcliques.push_back(ivector(0));
+        if (mode==0 || mode==3)
+            ++m[0];
+        return;
+    }
+    clique_search cs;
+    int nthreads=thread_count(n/64+1);
+    clique_search_init(cs,*this,nthreads);
+    cs.mode=mode;
+    parallel_for(n,bk_roots,&cs,nthreads,16);
+    std::vector<std::pair<int,ivector> > all;
+    for (std::vector<clique_local>::iterator it=cs.work.begin();it!=cs.work.end();++it) {
+        for (map<int,int>::const_iterator jt=it->stats.begin();jt!=it->stats.end();++jt) {
+            if (mode==1)
+                m[jt->first]=jt->second;
+            else m[jt->first]+=jt->second;
+        }
+        if (all.empty())
+            all.swap(it->cliques);
+        else all.insert(all.end(),it->cliques.begin(),it->cliques.end());
+    }
+    if (!all.empty()) {
+        /* output the cliques in the order of their roots */
+        ivector perm(all.size()),cnt(n+1,0);
+        for (size_t i=0;i<all.size();++i) ++cnt[all[i].first+1];
+        for (int i=0;i<n;++i) cnt[i+1]+=cnt[i];
+        for (size_t i=0;i<all.size();++i) perm[cnt[all[i].first]++]=i;
+        size_t k=maxcliques.size();
+        maxcliques.resize(k+all.size());
+        for (ivector_iter it=perm.begin();it!=perm.end();++it) {
+            maxcliques[k++].swap(all[*it].second);
+        }
+    }
+}
+
+/* list all maximal cliques with the Bron-Kerbosch algorithm (Tomita pivoting on
+* degeneracy-ordered roots, see enumerate_cliques). Number of k-cliques will be
+* stored to m[k] for each k. If mode==1, store 2-cliques (v,w) as m[v]=w. */
+void graphe::clique_stats(map<int,int> &m,int mode) {
+    enumerate_cliques(m,mode);
+}
+
+/* generate a clique vertex cover of this graph */
+void graphe::find_maximal_cliques() {
+    map<int,int> m;
+    clear_maximal_cliques();
+    enumerate_cliques(m,2);
+}
+
 /*
 * Östergård class for finding maximum clique
 *
@@ -4084,17 +6239,6 @@ int graphe::ostergard::maxclique(ivector &clique) {
 * End of ostergard class
 */
 
-/* find maximum clique in this graph and return its size */
-int graphe::maximum_clique(ivector &clique) {
-    assert(!is_directed());
-    clique.clear();
-    int n=node_count(),m=edge_count();
-    if (20*m<=n*(n-1)) // edge density smaller than or equal to 0.1
-        return cp_maxclique(clique);
-    ostergard ost(this);
-    return ost.maxclique(clique);
-}
-
 /* remove a maximal clique from vertex set V using a fast greedy algorithm
 * (Johnson, J. Comp. Syst. Sci. 1974) */
 void graphe::remove_maximal_clique(iset &V) const {
@@ -4623,8 +6767,364 @@ int graphe::painter::color_vertices(ivector &colors,const ivector &icol,int max_
 * end of painter class
 */
 
-/* find optimal vertex coloring using an exact algorithm, requires GLPK */
+/* DSATUR-based branch&bound for optimal vertex coloring
+ *
+ * The search colors the vertex with the largest saturation degree first (ties are broken
+ * by the degree in the uncolored subgraph) using any color already present or one new
+ * color, which avoids exploring symmetric colorings (Brelaz 1979). The vertices of a
+ * large clique are precolored, which also gives the lower bound. Each thread keeps the
+ * neighbor color counts of all vertices for O(deg) assignment and undo, and buckets the
+ * uncolored vertices by saturation degree so that the selection scans only the vertices
+ * of the highest nonempty bucket. Subproblems are
+ * paths of (vertex,color) assignments from the root: whenever a thread is idle, a busy
+ * thread splits off the shallowest untried branch of its search stack and puts it into
+ * the shared pool. The number of colors of the incumbent is shared by all threads; it is
+ * written under the lock and read atomically without it, as are the stop flag and the
+ * number of idle threads. */
+
+#define COLORING_BB_NODE_LIMIT 1000000
+#define COLORING_BB_COUNT_INTERVAL 4096
+
+struct coloring_bb_frame {
+    int v;       // the vertex to color
+    int next;    // the next color to try
+    int ncolors; // the number of colors used before coloring v
+};
+
+struct coloring_bb_local { // per-thread search state
+    graphe::ivector color,sat,udeg,cnt,where;
+    graphe::ivectors bucket;    // uncolored vertices by saturation degree, where[v] is the position of v
+    int uncolored;
+    std::vector<coloring_bb_frame> stack;
+    graphe::ipairs path,applied;
+    int ncolors;
+    long nodes;
+};
+
+struct coloring_bb_shared {
+    const graphe::csr *A;
+    int n,lb,nc;                // nc is the number of colors which may appear in the search
+    int ub;                     // incumbent number of colors
+    bool stop;
+    int waiting;                // number of idle threads
+    bool limit_reached;
+    int busy;
+    long nodes,node_limit;
+    graphe::ivector best;
+    std::vector<graphe::ipairs> pool;
+    std::vector<coloring_bb_local> work;
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#endif
+};
+
+static void coloring_bb_lock(coloring_bb_shared &sh) {
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_lock(&sh.mutex);
+#endif
+}
+
+static void coloring_bb_unlock(coloring_bb_shared &sh) {
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_unlock(&sh.mutex);
+#endif
+}
+
+static void coloring_bb_broadcast(coloring_bb_shared &sh) {
+#ifdef HAVE_LIBPTHREAD
+    pthread_cond_broadcast(&sh.cond);
+#endif
+}
+
+static void coloring_bb_insert(coloring_bb_local &w,int v) {
+    graphe::ivector &B=w.bucket[w.sat[v]];
+    w.where[v]=B.size();
+    B.push_back(v);
+}
+
+static void coloring_bb_remove(coloring_bb_local &w,int v) {
+    graphe::ivector &B=w.bucket[w.sat[v]];
+    int p=w.where[v],last=B.back();
+    B[p]=last;
+    w.where[last]=p;
+    B.pop_back();
+}
+
+static void coloring_bb_assign(const coloring_bb_shared &sh,coloring_bb_local &w,int v,int c) {
+    const graphe::csr &A=*sh.A;
+    coloring_bb_remove(w,v);
+    --w.uncolored;
+    w.color[v]=c;
+    for (int k=A.offsets[v];k<A.offsets[v+1];++k) {
+        int u=A.columns[k];
+        --w.udeg[u];
+        if (w.cnt[u*sh.nc+c-1]++==0) {
+            if (w.color[u]==0) {
+                coloring_bb_remove(w,u);
+                ++w.sat[u];
+                coloring_bb_insert(w,u);
+            } else ++w.sat[u];
+        }
+    }
+}
+
+/* undo the last assignment, which must be the assignment of v */
+static void coloring_bb_unassign(const coloring_bb_shared &sh,coloring_bb_local &w,int v) {
+    const graphe::csr &A=*sh.A;
+    int c=w.color[v];
+    w.color[v]=0;
+    for (int k=A.offsets[v];k<A.offsets[v+1];++k) {
+        int u=A.columns[k];
+        ++w.udeg[u];
+        if (--w.cnt[u*sh.nc+c-1]==0) {
+            if (w.color[u]==0) {
+                coloring_bb_remove(w,u);
+                --w.sat[u];
+                coloring_bb_insert(w,u);
+            } else --w.sat[u];
+        }
+    }
+    coloring_bb_insert(w,v);
+    ++w.uncolored;
+}
+
+/* return the uncolored vertex with the largest saturation degree */
+static int coloring_bb_select(const coloring_bb_local &w) {
+    int s=w.bucket.size()-1;
+    while (s>=0 && w.bucket[s].empty()) --s;
+    if (s<0)
+        return -1;
+    const graphe::ivector &B=w.bucket[s];
+    int v=-1,d=-1;
+    for (graphe::ivector_iter it=B.begin();it!=B.end();++it) {
+        if (w.udeg[*it]>d) {
+            v=*it;
+            d=w.udeg[v];
+        }
+    }
+    return v;
+}
+
+static void coloring_bb_improve(coloring_bb_shared &sh,coloring_bb_local &w) {
+    coloring_bb_lock(sh);
+    if (w.ncolors<sh.ub) {
+        gt_atomic_store(sh.ub,w.ncolors);
+        sh.best=w.color;
+        if (sh.ub<=sh.lb)
+            gt_atomic_store(sh.stop,true);
+        coloring_bb_broadcast(sh);
+    }
+    coloring_bb_unlock(sh);
+}
+
+/* add the nodes visited since the last call to the total and check the node limit */
+static void coloring_bb_count(coloring_bb_shared &sh,coloring_bb_local &w) {
+    coloring_bb_lock(sh);
+    sh.nodes+=w.nodes;
+    w.nodes=0;
+    if (sh.node_limit>0 && sh.nodes>=sh.node_limit && !sh.stop) {
+        gt_atomic_store(sh.stop,true);
+        sh.limit_reached=true;
+        coloring_bb_broadcast(sh);
+    }
+    coloring_bb_unlock(sh);
+}
+
+/* give the shallowest untried branch to an idle thread, the branch is removed from this
+ * search; only colors which are valid in the current state are considered since such
+ * colors are also valid at the shallower level */
+static void coloring_bb_donate(coloring_bb_shared &sh,coloring_bb_local &w) {
+    int d=w.stack.size(),ub=gt_atomic_load(sh.ub);
+    for (int i=0;i<d;++i) {
+        coloring_bb_frame &f=w.stack[i];
+        int lim=std::min(f.ncolors+1,ub-1);
+        if (f.next>lim || w.cnt[f.v*sh.nc+f.next-1]>0)
+            continue;
+        coloring_bb_lock(sh);
+        if (int(sh.pool.size())>=sh.waiting) {
+            coloring_bb_unlock(sh);
+            return;
+        }
+        graphe::ipairs sub(w.path);
+        for (int j=0;j<i;++j) {
+            sub.push_back(make_pair(w.stack[j].v,w.color[w.stack[j].v]));
+        }
+        sub.push_back(make_pair(f.v,f.next++));
+        sh.pool.push_back(graphe::ipairs());
+        sh.pool.back().swap(sub);
+        coloring_bb_broadcast(sh);
+        coloring_bb_unlock(sh);
+        return;
+    }
+}
+
+/* depth-first search from the state reached by applying the current path */
+static void coloring_bb_search(coloring_bb_shared &sh,coloring_bb_local &w) {
+    if (w.uncolored==0) {
+        coloring_bb_improve(sh,w);
+        return;
+    }
+    coloring_bb_frame root={coloring_bb_select(w),1,w.ncolors};
+    w.stack.push_back(root);
+    while (!w.stack.empty() && !gt_atomic_load(sh.stop)) {
+        coloring_bb_frame &f=w.stack.back();
+        if (w.color[f.v]>0) {
+            coloring_bb_unassign(sh,w,f.v);
+            w.ncolors=f.ncolors;
+        }
+        int lim=std::min(f.ncolors+1,gt_atomic_load(sh.ub)-1);
+        while (f.next<=lim && w.cnt[f.v*sh.nc+f.next-1]>0) ++f.next;
+        if (f.next>lim) {
+            w.stack.pop_back();
+            continue;
+        }
+        int c=f.next++;
+        coloring_bb_assign(sh,w,f.v,c);
+        w.ncolors=std::max(f.ncolors,c);
+        if (++w.nodes==COLORING_BB_COUNT_INTERVAL)
+            coloring_bb_count(sh,w);
+        if (w.uncolored==0) {
+            coloring_bb_improve(sh,w);
+            continue;
+        }
+        if (gt_atomic_load(sh.waiting)>0)
+            coloring_bb_donate(sh,w);
+        coloring_bb_frame next={coloring_bb_select(w),1,w.ncolors};
+        w.stack.push_back(next);
+    }
+    while (!w.stack.empty()) {
+        if (w.color[w.stack.back().v]>0)
+            coloring_bb_unassign(sh,w,w.stack.back().v);
+        w.stack.pop_back();
+    }
+}
+
+static void coloring_bb_worker(int first,int last,int thread,void *data) {
+    coloring_bb_shared &sh=*(coloring_bb_shared*)data;
+    coloring_bb_local &w=sh.work[thread];
+    const graphe::csr &A=*sh.A;
+    if (int(w.color.size())!=sh.n) {
+        w.color.assign(sh.n,0);
+        w.sat.assign(sh.n,0);
+        w.cnt.assign(sh.n*sh.nc,0);
+        w.udeg.resize(sh.n);
+        w.where.resize(sh.n);
+        w.bucket.assign(sh.nc+1,graphe::ivector());
+        w.bucket.front().resize(sh.n);
+        for (int i=0;i<sh.n;++i) {
+            w.udeg[i]=A.offsets[i+1]-A.offsets[i];
+            w.bucket.front()[i]=w.where[i]=i;
+        }
+        w.uncolored=sh.n;
+        w.stack.reserve(sh.n);
+        w.nodes=0;
+    }
+    coloring_bb_lock(sh);
+    while (true) {
+        while (!sh.stop && sh.pool.empty() && sh.busy>0) {
+            gt_atomic_store(sh.waiting,sh.waiting+1);
+#ifdef HAVE_LIBPTHREAD
+            pthread_cond_wait(&sh.cond,&sh.mutex);
+#endif
+            gt_atomic_store(sh.waiting,sh.waiting-1);
+        }
+        if (sh.stop || sh.pool.empty())
+            break;
+        w.path.swap(sh.pool.back());
+        sh.pool.pop_back();
+        ++sh.busy;
+        coloring_bb_unlock(sh);
+        /* replay the path, it may have become invalid by an improvement of the bound */
+        w.ncolors=0;
+        w.applied.clear();
+        bool valid=true;
+        for (graphe::ipairs_iter it=w.path.begin();valid && it!=w.path.end();++it) {
+            int v=it->first,c=it->second;
+            if ((valid=w.color[v]==0 && c<=w.ncolors+1 && c<gt_atomic_load(sh.ub) && w.cnt[v*sh.nc+c-1]==0)) {
+                coloring_bb_assign(sh,w,v,c);
+                w.applied.push_back(*it);
+                w.ncolors=std::max(w.ncolors,c);
+            }
+        }
+        if (valid)
+            coloring_bb_search(sh,w);
+        for (graphe::ipairs::const_reverse_iterator it=w.applied.rbegin();it!=w.applied.rend();++it) {
+            coloring_bb_unassign(sh,w,it->first);
+        }
+        coloring_bb_lock(sh);
+        --sh.busy;
+        coloring_bb_broadcast(sh);
+    }
+    coloring_bb_broadcast(sh);
+    coloring_bb_unlock(sh);
+    coloring_bb_count(sh,w);
+}
+
+/* find an optimal coloring of G with the vertices of the given clique precolored,
+ * return the number of colors, 0 if there is no coloring with at most max_colors
+ * colors (if max_colors>0) and -1 if the node limit is reached, in which case
+ * colors contains the best coloring found or is empty if none was found */
+static int dsatur_branch_and_bound(graphe &G,const graphe::ivector &clique,int max_colors,long node_limit,graphe::ivector &colors) {
+    GT_PROFILE(profile,"coloring_branch_and_bound");
+    int n=G.node_count(),lb=clique.size(),ub=0;
+    colors.clear();
+    if (max_colors>0 && lb>max_colors)
+        return 0;
+    /* initial upper bound by heuristic */
+    G.uncolor_all_nodes();
+    for (graphe::ivector_iter it=clique.begin();it!=clique.end();++it) {
+        G.set_node_color(*it,it-clique.begin()+1);
+    }
+    G.dsatur();
+    graphe::ivector init;
+    G.get_node_colors(init);
+    for (graphe::ivector_iter it=init.begin();it!=init.end();++it) {
+        ub=std::max(ub,*it);
+    }
+    if (ub<=std::max(lb,1) && (max_colors<=0 || ub<=max_colors)) {
+        colors=init;
+        return ub;
+    }
+    coloring_bb_shared sh;
+    sh.A=&G.adjacency();
+    sh.n=n;
+    sh.lb=std::max(lb,1);
+    sh.ub=max_colors>0 && ub>max_colors?max_colors+1:ub;
+    if (max_colors<=0 || ub<=max_colors)
+        sh.best=init;
+    sh.nc=sh.ub-1;
+    sh.stop=sh.limit_reached=false;
+    sh.waiting=sh.busy=0;
+    sh.nodes=0;
+    sh.node_limit=node_limit;
+    sh.pool.resize(1);
+    for (graphe::ivector_iter it=clique.begin();it!=clique.end();++it) {
+        sh.pool.front().push_back(make_pair(*it,int(it-clique.begin())+1));
+    }
+    /* each thread holds n*nc color counts */
+    int nthreads=graphe::thread_count(n);
+    while (nthreads>1 && double(n)*sh.nc*nthreads>double(1<<26)) --nthreads;
+    sh.work.resize(nthreads);
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_init(&sh.mutex,NULL);
+    pthread_cond_init(&sh.cond,NULL);
+#endif
+    graphe::parallel_for(nthreads,coloring_bb_worker,&sh,nthreads,1);
+#ifdef HAVE_LIBPTHREAD
+    pthread_cond_destroy(&sh.cond);
+    pthread_mutex_destroy(&sh.mutex);
+#endif
+    GT_COUNT("coloring_bb_nodes",sh.nodes);
+    colors=sh.best;
+    if (sh.limit_reached)
+        return -1;
+    return colors.empty()?0:sh.ub;
+}
+
+/* find optimal vertex coloring using an exact algorithm */
 int graphe::exact_vertex_coloring(int max_colors) {
+    GT_PROFILE(profile,"exact_vertex_coloring");
     int ncolors=0,n=node_count();
     if (is_clique()) {
         for (int i=0;i<n;++i) {
@@ -4679,19 +7179,33 @@ int graphe::exact_vertex_coloring(int max_colors) {
         }
         return ncolors;
     }
-#ifndef HAVE_LIBGLPK
-    message("Error: GLPK library is required for graph coloring");
-#else
-    painter pt(this);
     ivector colors,clique;
     ostergard ost(this,5.0);
     ost.maxclique(clique);
-    ncolors=pt.color_vertices(colors,clique,max_colors);
-    if (ncolors>0 && find(colors.begin(),colors.end(),0)!=colors.end()) {
-        uncolor_all_nodes();
-        ncolors=0;
+#ifdef HAVE_LIBGLPK
+    long node_limit=COLORING_BB_NODE_LIMIT;
+#else
+    long node_limit=0;
+#endif
+    ncolors=dsatur_branch_and_bound(*this,clique,max_colors,node_limit,colors);
+#ifdef HAVE_LIBGLPK
+    if (ncolors<0) { // the search tree is too large, use the LP-based painter
+        painter pt(this);
+        ncolors=pt.color_vertices(colors,clique,max_colors);
+        if (ncolors>0 && find(colors.begin(),colors.end(),0)!=colors.end()) {
+            uncolor_all_nodes();
+            ncolors=0;
+        }
+        return ncolors;
     }
 #endif
+    if (ncolors<=0) {
+        uncolor_all_nodes();
+        return 0;
+    }
+    for (int i=0;i<n;++i) {
+        set_node_color(i,colors[i]);
+    }
     return ncolors;
 }
 
@@ -4718,13 +7232,18 @@ int graphe::exact_edge_coloring(ivector &colors,int *numcol) {
             icol[k++]=j;
     }
     assert(k==maxdeg);
+    /* by Vizing's theorem there is a coloring with at most maxdeg+1 colors */
 #ifdef HAVE_LIBGLPK
-    painter pt(&L);
-    int ncolors=pt.color_vertices(colors,icol,maxdeg+1);
+    int ncolors=dsatur_branch_and_bound(L,icol,maxdeg+1,COLORING_BB_NODE_LIMIT,colors);
+    if (ncolors<0) {
+        painter pt(&L);
+        ncolors=pt.color_vertices(colors,icol,maxdeg+1);
+    }
 #else
-    message("Error: GLPK library is required for graph coloring");
-    int ncolors=0;
+    int ncolors=dsatur_branch_and_bound(L,icol,maxdeg+1,0,colors);
 #endif
+    if (ncolors<=0)
+        return 0;
     for (k=0;k<maxdeg;++k) {
         colors[icol[k]]=k+1;
     }
@@ -4799,14 +7318,122 @@ bool graphe::is_clique(int sg) const {
     return edge_count(sg)==ec_max;
 }
 
-/* find maximum independent set in this graph and return its size */
+#define MIS_KERNEL_MAX_DENSITY 0.1
+
+/* find maximum independent set in this graph and return its size,
+ * sparse graphs are handled as the complement of a minimum vertex cover */
 int graphe::maximum_independent_set(ivector &v) const {
+    int n=node_count();
+    if (!is_directed() && n>1 && 2.0*edge_count()<=MIS_KERNEL_MAX_DENSITY*n*(n-1.0)) {
+        ivector cover;
+        if (mvc_kernelized(cover)) {
+            v.clear();
+            for (int i=0,j=0;i<n;++i) {
+                if (j<int(cover.size()) && cover[j]==i)
+                    ++j;
+                else v.push_back(i);
+            }
+            return v.size();
+        }
+    }
     graphe C(ctx,false);
     complement(C);
     return C.maximum_clique(v);
 }
 
-/* return the number of (directed) triangles in (di)graph */
+/* orient each edge of this undirected graph towards the endpoint of larger degree (ties
+ * are broken by index) and store the result to F, in which the vertices are renumbered by
+ * their positions in that order: the i-th vertex of F is order[i]. Every vertex has at
+ * most sqrt(2m) out-neighbors in F and the out-neighbor lists are sorted. */
+void graphe::forward_adjacency(csr &F,ivector &order) const {
+    const csr &A=adjacency();
+    int n=node_count(),i,r,s,maxdeg=0;
+    for (i=0;i<n;++i) {
+        maxdeg=std::max(maxdeg,A.offsets[i+1]-A.offsets[i]);
+    }
+    /* counting sort by degree, stable with respect to indices */
+    ivector cnt(maxdeg+2,0),rank(n);
+    for (i=0;i<n;++i) {
+        ++cnt[A.offsets[i+1]-A.offsets[i]+1];
+    }
+    for (i=0;i<=maxdeg;++i) {
+        cnt[i+1]+=cnt[i];
+    }
+    order.resize(n);
+    for (i=0;i<n;++i) {
+        order[rank[i]=cnt[A.offsets[i+1]-A.offsets[i]]++]=i;
+    }
+    F.offsets.assign(n+1,0);
+    F.weights.clear();
+    for (r=0;r<n;++r) {
+        i=order[r];
+        for (int k=A.offsets[i];k<A.offsets[i+1];++k) {
+            if (rank[A.columns[k]]>r)
+                ++F.offsets[r+1];
+        }
+    }
+    for (r=0;r<n;++r) {
+        F.offsets[r+1]+=F.offsets[r];
+    }
+    F.columns.resize(F.offsets[n]);
+    ivector pos(F.offsets.begin(),F.offsets.end()-1);
+    /* heads are appended in increasing order, hence the lists come out sorted */
+    for (s=0;s<n;++s) {
+        i=order[s];
+        for (int k=A.offsets[i];k<A.offsets[i+1];++k) {
+            if ((r=rank[A.columns[k]])<s)
+                F.columns[pos[r]++]=s;
+        }
+    }
+}
+
+struct triangle_data {
+    const graphe::csr *F;
+    std::vector<longlong> count;                // triangles found by each thread
+    std::vector<std::vector<longlong> > local;  // per-thread triangle counts of vertices, if needed
+    std::vector<graphe::ivectors> lists;        // per-thread triangle lists, if needed
+};
+
+/* compact-forward triangle counting for the vertices first,..,last-1 of the oriented graph:
+ * each triangle r<s<t is found once, from its lowest vertex r, as t in F(r) and F(s) */
+static void forward_triangles(int first,int last,int thread,void *data) {
+    triangle_data *d=(triangle_data*)data;
+    const graphe::csr &F=*d->F;
+    const int *col=F.columns.empty()?NULL:&F.columns.front();
+    bool loc=!d->local.empty(),lst=!d->lists.empty();
+    longlong c=0;
+    graphe::ivector common,trg(3);
+    for (int r=first;r<last;++r) {
+        int beg=F.offsets[r],end=F.offsets[r+1];
+        for (int k=beg;k<end;++k) {
+            int s=col[k];
+            /* the out-neighbors of s are larger than s, so only the tail of F(r) matters */
+            const int *a=col+k+1,*b=col+F.offsets[s];
+            size_t na=end-k-1,nb=F.offsets[s+1]-F.offsets[s];
+            if (!loc && !lst) {
+                c+=graphe::intersect_sorted(a,na,b,nb);
+                continue;
+            }
+            common.resize(std::min(na,nb));
+            common.resize(std::set_intersection(a,a+na,b,b+nb,common.begin())-common.begin());
+            c+=common.size();
+            for (graphe::ivector_iter it=common.begin();it!=common.end();++it) {
+                if (loc) {
+                    std::vector<longlong> &t=d->local[thread];
+                    ++t[r]; ++t[s]; ++t[*it];
+                }
+                if (lst) {
+                    trg[0]=r; trg[1]=s; trg[2]=*it;
+                    d->lists[thread].push_back(trg);
+                }
+            }
+        }
+    }
+    d->count[thread]+=c;
+}
+
+/* return the number of (directed) triangles in (di)graph, list them to dest if it is not NULL,
+ * if ccoeff is true return the average clustering coefficient instead */
 gen graphe::triangle_count(ivectors *dest,bool ccoeff,bool exact) {
     if (is_directed()) {
         sparsemat M,M2;
@@ -4822,42 +7449,64 @@ gen graphe::triangle_count(ivectors *dest,bool ccoeff,bool exact) {
         }
         return _ratnormal(trace/gen(3),ctx);
     }
-    gen c(0);
-    int n=node_count(),i,j,sz1,sz2,sz3,isz,p1,p2,p3;
-    double sum=0.0;
-    ivector offset(n,0),intersection,trg(3);
-    ivector_iter iter;
-    sort_by_degrees();
-    for (node_iter it=nodes.begin();it!=nodes.end();++it) {
-        i=it-nodes.begin();
-        const ivector &vn=it->neighbors();
-        if (ccoeff) { sz1=vn.size(); p1=(sz1*(sz1-1))/2; }
-        for (ivector_iter jt=vn.begin();jt!=vn.end();++jt) {
-            if ((j=*jt)<i) continue;
-            const ivector &wn=node(j).neighbors();
-            if (ccoeff) { sz2=wn.size(); p2=(sz2*(sz2-1))/2; }
-            if (!ccoeff && dest==NULL)
-                c+=intersect_linear(vn.begin(),vn.begin()+offset[i],wn.begin(),wn.begin()+offset[j]);
-            else {
-                intersection.resize(std::min(offset[i],offset[j]));
-                iter=set_intersection(vn.begin(),vn.begin()+offset[i],wn.begin(),wn.begin()+offset[j],intersection.begin());
-                intersection.resize(isz=iter-intersection.begin());
-                for (ivector_iter kt=intersection.begin();kt!=intersection.end();++kt) {
-                    if (ccoeff) { sz3=node(*kt).neighbors().size(); p3=(sz3*(sz3-1))/2; }
-                    if (!ccoeff) {
-                        trg[0]=i; trg[1]=j; trg[2]=*kt;
-                        dest->push_back(trg);
-                        c+=1;
-                    } else if (exact) c+=gen(1)/harmonic_mean_exact(p1,p2,p3);
-                    else sum+=1.0/harmonic_mean(p1,p2,p3);
+    int n=node_count(),r,t;
+    csr F;
+    ivector order;
+    forward_adjacency(F,order);
+    int nt=thread_count(F.arc_count()/4096+1);
+    triangle_data data;
+    data.F=&F;
+    data.count.assign(nt,0);
+    if (ccoeff)
+        data.local.assign(nt,std::vector<longlong>(n,0));
+    if (dest!=NULL)
+        data.lists.resize(nt);
+    parallel_for(n,forward_triangles,&data,nt,256);
+    longlong total=0;
+    for (t=0;t<nt;++t) {
+        total+=data.count[t];
+    }
+    if (dest!=NULL) {
+        size_t k=dest->size();
+        for (t=0;t<nt;++t) {
+            for (ivectors_iter it=data.lists[t].begin();it!=data.lists[t].end();++it) {
+                dest->push_back(ivector(3));
+                ivector &trg=dest->back();
+                for (int j=0;j<3;++j) {
+                    trg[j]=order[(*it)[j]];
                 }
+                std::sort(trg.begin(),trg.end());
             }
-            ++offset[j];
+            data.lists[t].clear();
+        }
+        /* the order in which threads finish is arbitrary */
+        std::sort(dest->begin()+k,dest->end());
+    }
+    if (!ccoeff)
+        return gen(total);
+    /* the average of local coefficients t(v)/C(deg(v),2), summed up per degree */
+    const csr &A=adjacency();
+    std::map<longlong,longlong> tri;
+    for (r=0;r<n;++r) {
+        longlong tv=0,d=A.offsets[order[r]+1]-A.offsets[order[r]];
+        for (t=0;t<nt;++t) {
+            tv+=data.local[t][r];
+        }
+        if (tv>0)
+            tri[d*(d-1)/2]+=tv;
+    }
+    if (!exact) {
+        double sum=0.0;
+        for (std::map<longlong,longlong>::const_iterator it=tri.begin();it!=tri.end();++it) {
+            sum+=double(it->second)/double(it->first);
         }
+        return sum/double(n);
+    }
+    gen c(0);
+    for (std::map<longlong,longlong>::const_iterator it=tri.begin();it!=tri.end();++it) {
+        c+=fraction(gen(it->second),gen(it->first));
     }
-    if (!ccoeff) return c;
-    if (!exact) return 3.0*sum/double(n);
-    return _ratnormal(gen(3)*c/gen(n),ctx);
+    return _ratnormal(c/gen(n),ctx);
 }
 
 /* remove i-th node which is assumed to be isolated */
@@ -4873,6 +7522,7 @@ void graphe::remove_isolated_nodes(const iset &I,graphe &G) {
     }
     isomorphic_copy(G,sigma);
     for (int i=I.size();i-->0;) G.nodes.pop_back();
+    G.invalidate_adjacency();
 }
 
 /* return true iff this is a multigraph */
@@ -5028,8 +7678,9 @@ bool is_sierpinski_match(const graphe::ivector &u,const graphe::ivector &v,int n
 }
 
 /* create a graph from decreasing degree sequence L by using Havel-Hakimi algorithm,
-* return false iff L is not a graphic sequence */
-bool graphe::hakimi(const ivector &L) {
+* return false iff L is not a graphic sequence (if E is given, the edges are stored
+* there instead of being added to the graph) */
+bool graphe::hakimi(const ivector &L,ipairs *E) {
     assert(node_count()==int(L.size()));
     int n=L.size(),d,i,z;
     if (n==0)
@@ -5047,7 +7698,9 @@ bool graphe::hakimi(const ivector &L) {
             ipair &p=D[D.size()-1-k];
             if (--p.first<0)
                 return false;
-            add_edge(i,p.second);
+            if (E!=NULL)
+                E->push_back(make_pair(i,p.second));
+            else add_edge(i,p.second);
         }
         z=0;
         for (ipairs_iter it=D.begin();it!=D.end();++it) {
@@ -5484,15 +8137,27 @@ void graphe::make_complete_kary_tree(int k,int d) {
 
 /* find all connected components of an undirected graph and store them */
 void graphe::connected_components(ivectors &components,int sg,bool skip_embedded,int *count) {
-    unvisit_all_nodes(sg);
-    unset_all_ancestors(sg);
-    disc_time=0;
+    if (sg<0 && !skip_embedded && count==NULL && dynamic_sync()) {
+        m_dynamic.components(components);
+        return;
+    }
     if (count==NULL)
         components.resize(node_count());
     int c=0;
-    for (node_iter it=nodes.begin();it!=nodes.end();++it) {
-        if ((sg<0 || it->subgraph()==sg) && (!skip_embedded || !it->is_embedded()) && !it->is_visited())
-            dfs(it-nodes.begin(),true,false,&components[c++],sg,skip_embedded);
+    if (skip_embedded) {
+        unvisit_all_nodes(sg);
+        unset_all_ancestors(sg);
+        disc_time=0;
+        for (node_iter it=nodes.begin();it!=nodes.end();++it) {
+            if ((sg<0 || it->subgraph()==sg) && !it->is_embedded() && !it->is_visited())
+                dfs(it-nodes.begin(),true,false,&components[c++],sg,true);
+        }
+    } else {
+        start_traversal(sg);
+        for (int i=0;i<node_count();++i) {
+            if (m_traversal.allowed(i) && !m_traversal.visited(i))
+                component_dfs(i,&components[c++]);
+        }
     }
     if (count==NULL)
         components.resize(c);
@@ -5537,59 +8202,74 @@ void graphe::biconnected_components(ivectors &components,int sg) {
 
 /* return the number of connected components in this graph */
 int graphe::connected_component_count(int sg) {
-    unvisit_all_nodes(sg);
-    unset_all_ancestors(sg);
-    disc_time=0;
+    if (sg<0 && dynamic_sync())
+        return m_dynamic.component_count();
+    start_traversal(sg);
     int count=0;
-    for (node_iter it=nodes.begin();it!=nodes.end();++it) {
-        if ((sg<0 || it->subgraph()==sg) && !it->is_visited()) {
-            dfs(it-nodes.begin(),false,false,NULL,sg);
+    for (int i=0;i<node_count();++i) {
+        if (m_traversal.allowed(i) && !m_traversal.visited(i)) {
+            component_dfs(i,NULL);
             ++count;
         }
     }
     return count;
 }
 
-void graphe::strongconnect_dfs(ivectors &components,bvector &onstack,int i,int sg) {
-    vertex &v=node(i);
-    v.set_visited(true);
-    v.set_disc(disc_time++);
-    v.set_low(v.disc());
-    node_stack.push(i);
-    onstack[i]=true;
-    int j;
-    for (ivector_iter it=v.neighbors().begin();it!=v.neighbors().end();++it) {
-        vertex &w=node(j=*it);
-        if (sg>=0 && w.subgraph()!=sg)
+/* Tarjan's DFS from the i-th vertex, iterative, working on the adjacency snapshot */
+void graphe::strongconnect_dfs(ivectors &components,int i) {
+    const csr &A=m_adjacency;
+    traversal_state &T=m_traversal;
+    ivector &path=T.stack;
+    int v,j;
+    assert(path.empty());
+    T.visit(i);
+    T.disc[i]=T.low[i]=disc_time++;
+    T.pos[i]=A.offsets[i];
+    T.scc_stack.push_back(i);
+    T.onstack[i]=true;
+    path.push_back(i);
+    while (!path.empty()) {
+        v=path.back();
+        if (T.pos[v]<A.offsets[v+1]) {
+            j=A.columns[T.pos[v]++];
+            if (!T.allowed(j))
+                continue;
+            if (!T.visited(j)) {
+                T.visit(j);
+                T.disc[j]=T.low[j]=disc_time++;
+                T.pos[j]=A.offsets[j];
+                T.scc_stack.push_back(j);
+                T.onstack[j]=true;
+                path.push_back(j);
+            } else if (T.onstack[j])
+                T.low[v]=std::min(T.low[v],T.disc[j]);
             continue;
-        if (!w.is_visited()) {
-            strongconnect_dfs(components,onstack,j,sg);
-            v.set_low(std::min(v.low(),w.low()));
-        } else if (onstack[j])
-            v.set_low(std::min(v.low(),w.disc()));
-    }
-    if (v.low()==v.disc()) {
-        /* output a strongly connected component */
-        components.resize(components.size()+1);
-        ivector &component=components.back();
-        do {
-            j=node_stack.top();
-            node_stack.pop();
-            component.push_back(j);
-            onstack[j]=false;
-        } while (j!=i);
+        }
+        path.pop_back();
+        if (T.low[v]==T.disc[v]) {
+            /* output a strongly connected component */
+            components.resize(components.size()+1);
+            ivector &component=components.back();
+            do {
+                j=T.scc_stack.back();
+                T.scc_stack.pop_back();
+                component.push_back(j);
+                T.onstack[j]=false;
+            } while (j!=v);
+        }
+        if (!path.empty())
+            T.low[path.back()]=std::min(T.low[path.back()],T.low[v]);
     }
 }
 
 /* find all strongly connected components in directed graph using Tarjan's algorithm */
 void graphe::strongly_connected_components(ivectors &components,int sg) {
-    assert(node_stack.empty());
-    unvisit_all_nodes(sg);
-    bvector onstack(node_count(),false);
+    start_traversal(sg);
+    m_traversal.onstack.assign(node_count(),false);
     disc_time=0;
-    for (node_iter it=nodes.begin();it!=nodes.end();++it) {
-        if ((sg<0 || it->subgraph()==sg) && !it->is_visited())
-            strongconnect_dfs(components,onstack,it-nodes.begin(),sg);
+    for (int i=0;i<node_count();++i) {
+        if (m_traversal.allowed(i) && !m_traversal.visited(i))
+            strongconnect_dfs(components,i);
     }
 }
 
@@ -5818,38 +8498,53 @@ void graphe::find_ears(ivectors &ears,int sg) {
     }
 }
 
-void graphe::find_bridges_dfs(int i,ipairs &B,int sg) {
-    vertex &v=node(i);
-    v.set_visited(true);
-    ++disc_time;
-    v.set_disc(disc_time);
-    v.set_low(disc_time);
-    for (ivector_iter it=v.neighbors().begin();it!=v.neighbors().end();++it) {
-        int j=*it;
-        vertex &w=node(j);
-        if (sg>=0 && w.subgraph()!=sg)
+/* bridge-finding DFS from the i-th vertex, iterative, working on the adjacency snapshot */
+void graphe::find_bridges_dfs(int i,ipairs &B) {
+    const csr &A=m_adjacency;
+    traversal_state &T=m_traversal;
+    ivector &path=T.stack;
+    int v,j,u;
+    assert(path.empty());
+    T.visit(i);
+    T.disc[i]=T.low[i]=++disc_time;
+    T.parent[i]=-1;
+    T.pos[i]=A.offsets[i];
+    path.push_back(i);
+    while (!path.empty()) {
+        v=path.back();
+        if (T.pos[v]<A.offsets[v+1]) {
+            j=A.columns[T.pos[v]++];
+            if (!T.allowed(j))
+                continue;
+            if (!T.visited(j)) {
+                T.visit(j);
+                T.disc[j]=T.low[j]=++disc_time;
+                T.parent[j]=v;
+                T.pos[j]=A.offsets[j];
+                path.push_back(j);
+            } else if (j!=T.parent[v] && T.disc[j]<T.disc[v])
+                T.low[v]=std::min(T.low[v],T.disc[j]);
             continue;
-        if (!w.is_visited()) {
-            w.set_ancestor(i);
-            find_bridges_dfs(j,B,sg);
-            v.set_low(std::min(v.low(),w.low()));
-            if (w.low()>v.disc())
-                B.push_back(make_pair(i<j?i:j,i<j?j:i));
-        } else if (j!=v.ancestor() && w.disc()<v.disc())
-            v.set_low(std::min(v.low(),w.disc()));
+        }
+        path.pop_back();
+        if (!path.empty()) {
+            u=path.back();
+            T.low[u]=std::min(T.low[u],T.low[v]);
+            if (T.low[v]>T.disc[u])
+                B.push_back(make_pair(u<v?u:v,u<v?v:u));
+        }
     }
 }
 
 /* create list B of all bridges in an undirected graph */
 void graphe::find_bridges(ipairs &B,int sg) {
     assert(!is_directed());
-    unvisit_all_nodes(sg);
-    unset_all_ancestors(sg);
+    start_traversal(sg);
     disc_time=0;
     B.clear();
-    for (node_iter it=nodes.begin();it!=nodes.end();++it) {
-        if ((sg<0 || it->subgraph()==sg) && !it->is_visited())
-            find_bridges_dfs(it-nodes.begin(),B,sg);
+    for (int i=0;i<node_count();++i) {
+        if (m_traversal.allowed(i) && !m_traversal.visited(i))
+            find_bridges_dfs(i,B);
     }
 }
 
@@ -6048,6 +8743,7 @@ bool graphe::find_path(int i,int j,ivector &path,int sg,bool skip_embedded) {
 void graphe::clear() {
     unmark_all_nodes();
     nodes.clear();
+    invalidate_adjacency();
 }
 
 /* return true iff the given face contains the edge {i,j} */
@@ -6852,6 +9548,10 @@ void graphe::make_random_planar(double p,int connectivity) {
     ipairs E;
     get_edges_as_pairs(E);
     ivector indices=rand_permu(E.size());
+    /* connectivity checks after removing single edges are answered incrementally */
+    bool incr=connectivity==1 && !is_incremental();
+    if (incr)
+        set_incremental(true);
     /* try to remove each edge with probability 0<p<1 */
     for (ivector_iter it=indices.begin();it!=indices.end();++it) {
         ipair &e=E[*it];
@@ -6878,56 +9578,152 @@ void graphe::make_random_planar(double p,int connectivity) {
             assert(false); // unreachable
         }
     }
+    if (incr)
+        set_incremental(false);
+}
+
+/* return the pair of vertices with index r in the lexicographic order of n*(n-1) arcs
+ * or n*(n-1)/2 edges {i,j} with j<i */
+static graphe::ipair vertex_pair_from_index(unsigned long long r,int n,bool isdir) {
+    if (isdir) {
+        int i=r/(n-1),j=r%(n-1);
+        if (j>=i) ++j;
+        return make_pair(i,j);
+    }
+    unsigned long long i=std::floor((1.0+std::sqrt(1.0+8.0*double(r)))/2.0);
+    while (i*(i-1)/2>r) --i;
+    while (i*(i+1)/2<=r) ++i;
+    return make_pair(int(i),int(r-i*(i-1)/2));
+}
+
+struct erdos_renyi_data {
+    int n;
+    bool isdir;
+    double p;
+    unsigned long long seed,N,block;
+    std::vector<graphe::ipairs> blocks;
+    unsigned long long *samples;
+    size_t sample_count;
+};
+
+/* each pair of vertices is chosen with probability p, skipping over pairs with a geometric
+ * distribution; every block of pairs has its own random stream */
+static void erdos_renyi_blocks(int first,int last,int thread,void *data) {
+    erdos_renyi_data *d=(erdos_renyi_data*)data;
+    double lq=std::log(1.0-d->p),s;
+    for (int b=first;b<last;++b) {
+        graphe::rng rand(d->seed+b);
+        graphe::ipairs &E=d->blocks[b];
+        unsigned long long r=b*d->block,hi=std::min(r+d->block,d->N);
+        while (true) {
+            s=std::floor(std::log(1.0-rand.uniform())/lq);
+            if (s>=double(hi-r))
+                break;
+            r+=(unsigned long long)s;
+            E.push_back(vertex_pair_from_index(r++,d->n,d->isdir));
+        }
+    }
+}
+
+#define ERDOS_RENYI_SAMPLE_BLOCK 65536
+/* draw random pair indices, one random stream per block of samples */
+static void erdos_renyi_samples(int first,int last,int thread,void *data) {
+    erdos_renyi_data *d=(erdos_renyi_data*)data;
+    for (int b=first;b<last;++b) {
+        graphe::rng rand(d->seed+b);
+        size_t lo=size_t(b)*ERDOS_RENYI_SAMPLE_BLOCK,hi=std::min(lo+ERDOS_RENYI_SAMPLE_BLOCK,d->sample_count);
+        for (size_t k=lo;k<hi;++k) {
+            d->samples[k]=rand.next()%d->N;
+        }
+    }
 }
 
-/* generate random edges in this graph */
+/* generate random edges in this graph, the result depends only on the state of the
+ * random generator and not on the number of threads */
 void graphe::erdos_renyi(double p) {
-    int n=node_count(),m=std::floor(p),i,j;
-    bool isdir=is_directed();
+    int n=node_count(),m=std::floor(p);
+    erdos_renyi_data data;
+    data.n=n;
+    data.isdir=is_directed();
+    data.p=p;
+    data.N=((unsigned long long)n*(n-1))/(data.isdir?1:2);
+    if (data.N==0 || (m==0 && 1.0-p==1.0))
+        return;
+    rng rand(((unsigned long long)giac::giac_rand(ctx)<<32)^(unsigned long long)giac::giac_rand(ctx));
+    ipairs E;
     if (m==0) {
         /* each edge is chosen with probability p */
-        for (int k=0;k<(isdir?2:1);++k) {
-            i=1; j=-1;
-            while (i<n) {
-                double r=rand_uniform();
-                j+=1+std::floor(std::log(1-r)/std::log(1-p));
-                while (j>=i && i<n) {
-                    j-=i;
-                    ++i;
-                }
-                if (i<n) add_edge(k==0?i:j,k==0?j:i);
-            }
+        data.seed=rand.next();
+        data.block=std::max(1ULL<<20,data.N>>26);
+        int nb=(data.N+data.block-1)/data.block;
+        data.blocks.resize(nb);
+        parallel_for(nb,erdos_renyi_blocks,&data,0,1);
+        size_t sz=0;
+        for (vector<ipairs>::const_iterator it=data.blocks.begin();it!=data.blocks.end();++it) {
+            sz+=it->size();
+        }
+        E.reserve(sz);
+        for (vector<ipairs>::iterator it=data.blocks.begin();it!=data.blocks.end();++it) {
+            E.insert(E.end(),it->begin(),it->end());
+            ipairs().swap(*it);
         }
     } else {
-        int N=(n*(n-1))/(isdir?1:2),i,j,r;
-        bool islarge=m>N/2;
-        if (islarge) { // first generate a complete graph
-            for (i=0;i<n;++i)
-                for (j=isdir?0:i+1;j<n;++j)
-                    if (i!=j) add_edge(i,j);
-        }
-        for (int k=0;k<(islarge?N-m:m);++k) {
-            while (true) {
-                r=rand_integer(N);
-                if (isdir) {
-                    i=r/(n-1); j=r%(n-1);
-                    if (j>=i) ++j;
-                } else {
-                    i=std::floor((1.0+std::sqrt(1.0+8.0*r))/2.0);
-                    j=r-i*(i-1)/2;
-                }
-                if (i>=n || j>=n) continue;
-                if (islarge && has_edge(i,j)) {
-                    remove_edge(i,j);
-                    break;
-                }
-                if (!islarge && !has_edge(i,j)) {
-                    add_edge(i,j);
-                    break;
-                }
+        /* choose exactly m edges: draw distinct pair indices in bulk (the complement if
+         * more than a half of all pairs is needed) */
+        unsigned long long M=std::min((unsigned long long)m,data.N);
+        bool islarge=M>data.N/2;
+        size_t cnt=islarge?data.N-M:M,k,extra;
+        std::vector<unsigned long long> S;
+        while (S.size()<cnt) {
+            k=S.size();
+            extra=cnt-k;
+            extra+=extra/8+64;
+            S.resize(k+extra);
+            data.seed=rand.next();
+            data.samples=&S[k];
+            data.sample_count=extra;
+            parallel_for((extra+ERDOS_RENYI_SAMPLE_BLOCK-1)/ERDOS_RENYI_SAMPLE_BLOCK,erdos_renyi_samples,&data,0,1);
+            parallel_sort(S);
+            S.erase(std::unique(S.begin(),S.end()),S.end());
+        }
+        if (S.size()>cnt) { // keep a random subset of size cnt
+            for (k=0;k<cnt;++k) {
+                std::swap(S[k],S[k+rand.next()%(S.size()-k)]);
+            }
+            S.resize(cnt);
+            if (islarge)
+                parallel_sort(S);
+        }
+        E.reserve(M);
+        if (islarge) {
+            std::vector<unsigned long long>::const_iterator st=S.begin();
+            for (unsigned long long r=0;r<data.N;++r) {
+                if (st!=S.end() && *st==r)
+                    ++st;
+                else E.push_back(vertex_pair_from_index(r,n,data.isdir));
+            }
+        } else {
+            for (std::vector<unsigned long long>::const_iterator st=S.begin();st!=S.end();++st) {
+                E.push_back(vertex_pair_from_index(*st,n,data.isdir));
             }
         }
     }
+    add_edges(E);
+}
+
+/* sorted local adjacency lists used by the generators before inserting the edges in bulk */
+static bool local_has_edge(const graphe::ivectors &adj,int i,int j) {
+    return binary_search(adj[i].begin(),adj[i].end(),j);
+}
+
+static void local_add_edge(graphe::ivectors &adj,int i,int j) {
+    adj[i].insert(std::lower_bound(adj[i].begin(),adj[i].end(),j),j);
+    adj[j].insert(std::lower_bound(adj[j].begin(),adj[j].end(),i),i);
+}
+
+static void local_remove_edge(graphe::ivectors &adj,int i,int j) {
+    adj[i].erase(std::lower_bound(adj[i].begin(),adj[i].end(),j));
+    adj[j].erase(std::lower_bound(adj[j].begin(),adj[j].end(),i));
 }
 
 /* generate edges of this graph according to preferential attachment rule */
@@ -6935,32 +9731,38 @@ void graphe::preferential_attachment(int d,int o) {
     assert(!is_directed());
     int n=node_count();
     if (n<2) return;
-    add_edge(0,1);
+    ivectors adj(n);
+    ipairs E;
+    local_add_edge(adj,0,1);
+    E.push_back(make_pair(0,1));
     int j,k;
     bucketsampler sampler(ivector(2,1),ctx);
     for (int i=2;i<n;++i) {
         for (int count=std::min(i,d);count-->0;) {
             do {
                 j=sampler.generate();
-            } while (has_edge(i,j));
-            add_edge(i,j);
+            } while (local_has_edge(adj,i,j));
+            local_add_edge(adj,i,j);
+            E.push_back(make_pair(j,i));
             sampler.increment(j);
         }
         for (int count=0;count<o;++count) {
-            const ivector &ngh=node(i).neighbors();
+            const ivector &ngh=adj[i];
             if (ngh.size()<2) break;
             j=rand_integer(ngh.size());
             do k=rand_integer(ngh.size()); while (k==j);
             j=ngh[j];
             k=ngh[k];
-            if (!has_edge(j,k)) {
-                add_edge(j,k);
+            if (!local_has_edge(adj,j,k)) {
+                local_add_edge(adj,j,k);
+                E.push_back(make_pair(j,k));
                 sampler.increment(j);
                 sampler.increment(k);
             }
         }
         sampler.insert(std::min(i,d));
     }
+    add_edges(E);
 }
 
 /* return true iff s is a graphic sequence */
@@ -7001,11 +9803,18 @@ void graphe::molloy_reed(const vecteur &p) {
             } else break;
         }
     } while (!is_graphic_sequence(stubs));
-    assert(hakimi(stubs));
     ipairs E;
-    get_edges_as_pairs(E);
+    if (!hakimi(stubs,&E))
+        assert(false);
+    ivectors adj(n);
+    for (ipairs_iter it=E.begin();it!=E.end();++it) {
+        local_add_edge(adj,it->first,it->second);
+    }
     int m=E.size();
-    if (m<2) return;
+    if (m<2) {
+        add_edges(E);
+        return;
+    }
     int iters=1+std::floor(M_LN2/std::log(double(m)/double(m-1))),tmp,at1,at2;
     ipair *e,*f;
     for (k=0;k<iters;++k) {
@@ -7018,16 +9827,16 @@ void graphe::molloy_reed(const vecteur &p) {
                 ++at2;
                 f=&E[rand_integer(m)];
             } while (at2<10 && (e==f || edges_incident(*e,*f) ||
-                                (has_edge(e->first,f->first) && has_edge(e->first,f->second)) ||
-                                (has_edge(e->first,f->first) && has_edge(f->first,e->second)) ||
-                                (has_edge(f->first,e->second) && has_edge(e->second,f->second)) ||
-                                (has_edge(e->first,f->second) && has_edge(e->second,f->second))));
+                                (local_has_edge(adj,e->first,f->first) && local_has_edge(adj,e->first,f->second)) ||
+                                (local_has_edge(adj,e->first,f->first) && local_has_edge(adj,f->first,e->second)) ||
+                                (local_has_edge(adj,f->first,e->second) && local_has_edge(adj,e->second,f->second)) ||
+                                (local_has_edge(adj,e->first,f->second) && local_has_edge(adj,e->second,f->second))));
             if (at2<10) break;
         } while (at1<10);
         if (at1>=10) break;
-        remove_edge(*e);
-        remove_edge(*f);
-        if (!has_edge(e->first,f->second) && !has_edge(f->first,e->second)) {
+        local_remove_edge(adj,e->first,e->second);
+        local_remove_edge(adj,f->first,f->second);
+        if (!local_has_edge(adj,e->first,f->second) && !local_has_edge(adj,f->first,e->second)) {
             tmp=e->second;
             e->second=f->second;
             f->second=tmp;
@@ -7036,9 +9845,10 @@ void graphe::molloy_reed(const vecteur &p) {
             e->second=f->first;
             f->first=tmp;
         }
-        add_edge(*e);
-        add_edge(*f);
+        local_add_edge(adj,e->first,e->second);
+        local_add_edge(adj,f->first,f->second);
     }
+    add_edges(E);
 }
 
 /* create a random graph with the given degree sequence d */
@@ -7088,10 +9898,13 @@ void graphe::make_random_sequential(const ivector &d) {
             }
         }
     } while (cnt<m);
+    ipairs E;
+    E.reserve(m);
     for (map<ipair,bool>::const_iterator it=used.begin();it!=used.end();++it) {
         if (it->second)
-            add_edge(it->first);
+            E.push_back(it->first);
     }
+    add_edges(E);
 }
 
 /* create a random bipartite graph with partition A,B */
@@ -7131,7 +9944,7 @@ void graphe::make_random_bipartite(int a,int b,double p) {
 /* create a random d-regular graph with vertices fromm V */
 void graphe::make_random_regular(int d,bool connected) {
     assert(!is_directed());
-    ipairs E;
+    ipairs E,F;
     int n=node_count();
     ivector prob,degrees(n);
     int prob_total,k,dd;
@@ -7144,11 +9957,13 @@ void graphe::make_random_regular(int d,bool connected) {
             for (vector<vertex>::iterator it=nodes.begin();it!=nodes.end();++it) {
                 it->clear_neighbors();
             }
+            invalidate_adjacency();
         }
         for (int i=0;i<n;++i) {
             degrees[i]=degree(i);
         }
         E.clear();
+        F.clear();
         for (int i=0;i<n;++i) {
             if ((dd=degrees[i])<d) {
                 for (int j=i+1;j<n;++j) {
@@ -7177,13 +9992,14 @@ void graphe::make_random_regular(int d,bool connected) {
             E.erase(E.begin()+k);
             ++degrees[edge.first];
             ++degrees[edge.second];
-            add_edge(edge);
+            F.push_back(edge);
             for (k=E.size();k-->0;) {
                 ipair &e=E[k];
                 if (degrees[e.first]==d || degrees[e.second]==d)
                     E.erase(E.begin()+k);
             }
         }
+        add_edges(F);
     } while (is_regular(d)<0);
 }
 
@@ -7762,6 +10578,430 @@ void graphe::unionfind::select(int id) {
  * END OF DISJOINT_SET CLASS
  */
 
+/*
+ * IMPLEMENTATION OF THE DYNAMIC CONNECTIVITY CLASS
+ *
+ * A spanning forest of the graph is maintained together with component
+ * labels. Insertions merge labels in a disjoint-set structure. When a tree
+ * edge is deleted, the two halves of its tree are searched simultaneously, so
+ * that only the smaller half is explored completely, and its incident edges
+ * are scanned for a replacement. BFS distances from the registered sources
+ * are repaired only in the region affected by the change.
+ */
+
+const int graphe::dynamic_connectivity::inf=std::numeric_limits<int>::max();
+
+graphe::dynamic_connectivity::dynamic_connectivity() {
+    m_enabled=m_built=false;
+    m_stamp=0;
+    m_sets=NULL;
+    m_capacity=m_next_label=m_count=0;
+    m_epoch=0;
+}
+
+/* turn the structure on or off, it is (re)built by the next call to build */
+void graphe::dynamic_connectivity::enable(bool yes) {
+    m_enabled=yes;
+    m_built=false;
+    m_sources.clear();
+    if (!yes) {
+        m_forest.clear();
+        m_label.clear();
+        m_mark.clear();
+        delete m_sets;
+        m_sets=NULL;
+    }
+}
+
+/* return a fresh pair of marks (the epoch and its successor) */
+int graphe::dynamic_connectivity::next_epoch() {
+    if (m_epoch>=std::numeric_limits<int>::max()-4) {
+        std::fill(m_mark.begin(),m_mark.end(),0);
+        m_epoch=0;
+    }
+    m_epoch+=2;
+    return m_epoch;
+}
+
+/* allocate twice as many labels as there are vertices, so that relabeling
+ * happens only once per linear number of updates */
+void graphe::dynamic_connectivity::reset_labels() {
+    delete m_sets;
+    m_capacity=2*int(m_forest.size())+16;
+    m_sets=new unionfind(m_capacity);
+    m_next_label=0;
+}
+
+/* label the trees of the forest from scratch */
+void graphe::dynamic_connectivity::relabel() {
+    int n=m_forest.size(),l;
+    reset_labels();
+    std::fill(m_label.begin(),m_label.end(),-1);
+    ivector &queue=m_side[0];
+    for (int i=0;i<n;++i) {
+        if (m_label[i]>=0)
+            continue;
+        m_sets->make_set(l=m_next_label++);
+        m_label[i]=l;
+        queue.assign(1,i);
+        for (size_t head=0;head<queue.size();++head) {
+            const ivector &adj=m_forest[queue[head]];
+            for (ivector_iter it=adj.begin();it!=adj.end();++it) {
+                if (m_label[*it]<0) {
+                    m_label[*it]=l;
+                    queue.push_back(*it);
+                }
+            }
+        }
+    }
+    queue.clear();
+}
+
+/* compute a spanning forest and the distances from the registered sources */
+void graphe::dynamic_connectivity::build(const graphe &G,unsigned long stamp) {
+    GT_PROFILE(profile,"dynamic_connectivity_build");
+    int n=G.node_count(),k;
+    m_forest.assign(n,ivector());
+    m_label.assign(n,-1);
+    m_mark.assign(n,0);
+    m_epoch=0;
+    ivector &queue=m_side[0];
+    m_count=0;
+    for (int i=0;i<n;++i) {
+        if (m_label[i]>=0)
+            continue;
+        m_label[i]=0;
+        ++m_count;
+        queue.assign(1,i);
+        for (size_t head=0;head<queue.size();++head) {
+            k=queue[head];
+            const ivector &ngh=G.node(k).neighbors();
+            for (ivector_iter it=ngh.begin();it!=ngh.end();++it) {
+                if (m_label[*it]<0) {
+                    m_label[*it]=0;
+                    m_forest[k].push_back(*it);
+                    m_forest[*it].push_back(k);
+                    queue.push_back(*it);
+                }
+            }
+        }
+    }
+    queue.clear();
+    relabel();
+    std::vector<source>::iterator it=m_sources.begin();
+    while (it!=m_sources.end()) {
+        if (it->root>=n)
+            it=m_sources.erase(it);
+        else compute_source(G,*(it++));
+    }
+    m_built=true;
+    m_stamp=stamp;
+}
+
+/* a new isolated vertex has been appended to the graph */
+void graphe::dynamic_connectivity::add_node(unsigned long stamp) {
+    m_forest.push_back(ivector());
+    m_mark.push_back(0);
+    if (m_next_label<m_capacity) {
+        m_sets->make_set(m_next_label);
+        m_label.push_back(m_next_label++);
+    } else {
+        m_label.push_back(-1);
+        relabel();
+    }
+    ++m_count;
+    for (std::vector<source>::iterator it=m_sources.begin();it!=m_sources.end();++it) {
+        it->dist.push_back(inf);
+    }
+    m_stamp=stamp;
+}
+
+/* the edge {u,v} has been added to the graph */
+void graphe::dynamic_connectivity::insert(const graphe &G,int u,int v,unsigned long stamp) {
+    int cu=component(u),cv=component(v);
+    if (cu!=cv) {
+        m_forest[u].push_back(v);
+        m_forest[v].push_back(u);
+        m_sets->unite(cu,cv);
+        --m_count;
+    }
+    for (std::vector<source>::iterator it=m_sources.begin();it!=m_sources.end();++it) {
+        decrease_distances(G,*it,u,v);
+    }
+    m_stamp=stamp;
+}
+
+/* the edge {u,v} has been removed from the graph */
+void graphe::dynamic_connectivity::remove(const graphe &G,int u,int v,unsigned long stamp) {
+    if (remove_tree_edge(u,v))
+        split(G,u,v);
+    for (std::vector<source>::iterator it=m_sources.begin();it!=m_sources.end();++it) {
+        increase_distances(G,*it,u,v);
+    }
+    m_stamp=stamp;
+}
+
+/* remove {u,v} from the forest, return false if it is not a tree edge */
+bool graphe::dynamic_connectivity::remove_tree_edge(int u,int v) {
+    ivector &adj_u=m_forest[u],&adj_v=m_forest[v];
+    ivector::iterator it=std::find(adj_u.begin(),adj_u.end(),v);
+    if (it==adj_u.end())
+        return false;
+    *it=adj_u.back();
+    adj_u.pop_back();
+    it=std::find(adj_v.begin(),adj_v.end(),u);
+    assert(it!=adj_v.end());
+    *it=adj_v.back();
+    adj_v.pop_back();
+    return true;
+}
+
+/* the tree containing u and v has been cut between them, reconnect it with
+ * a replacement edge or split off the smaller half as a new component */
+void graphe::dynamic_connectivity::split(const graphe &G,int u,int v) {
+    int e=next_epoch(),side=-1,x;
+    size_t head[2]={0,0};
+    m_side[0].assign(1,u);
+    m_side[1].assign(1,v);
+    m_mark[u]=e;
+    m_mark[v]=e+1;
+    /* advance both searches in turn until one of them is exhausted */
+    while (side<0) {
+        for (int k=0;k<2 && side<0;++k) {
+            ivector &queue=m_side[k];
+            if (head[k]==queue.size()) {
+                side=k;
+                break;
+            }
+            x=queue[head[k]++];
+            for (ivector_iter it=m_forest[x].begin();it!=m_forest[x].end();++it) {
+                if (m_mark[*it]!=e+k) {
+                    m_mark[*it]=e+k;
+                    queue.push_back(*it);
+                }
+            }
+        }
+    }
+    const ivector &half=m_side[side];
+    for (ivector_iter it=half.begin();it!=half.end();++it) {
+        const ivector &ngh=G.node(*it).neighbors();
+        for (ivector_iter jt=ngh.begin();jt!=ngh.end();++jt) {
+            if (m_mark[*jt]!=e+side) {
+                m_forest[*it].push_back(*jt);
+                m_forest[*jt].push_back(*it);
+                return;
+            }
+        }
+    }
+    ++m_count;
+    if (m_next_label==m_capacity) {
+        relabel();
+        return;
+    }
+    m_sets->make_set(m_next_label);
+    for (ivector_iter it=half.begin();it!=half.end();++it) {
+        m_label[*it]=m_next_label;
+    }
+    ++m_next_label;
+}
+
+/* store the connected components, ordered by their least vertex */
+void graphe::dynamic_connectivity::components(ivectors &comp) {
+    int n=m_label.size();
+    ivector index(m_capacity,-1);
+    comp.clear();
+    for (int i=0;i<n;++i) {
+        int &k=index[component(i)];
+        if (k<0) {
+            k=comp.size();
+            comp.push_back(ivector());
+        }
+        comp[k].push_back(i);
+    }
+    assert(int(comp.size())==m_count);
+}
+
+/* register i as a source of maintained BFS distances */
+void graphe::dynamic_connectivity::add_source(const graphe &G,int i) {
+    for (std::vector<source>::const_iterator it=m_sources.begin();it!=m_sources.end();++it) {
+        if (it->root==i)
+            return;
+    }
+    m_sources.push_back(source());
+    m_sources.back().root=i;
+    compute_source(G,m_sources.back());
+}
+
+void graphe::dynamic_connectivity::remove_source(int i) {
+    for (std::vector<source>::iterator it=m_sources.begin();it!=m_sources.end();++it) {
+        if (it->root==i) {
+            m_sources.erase(it);
+            return;
+        }
+    }
+}
+
+/* store the distances from the source i to the vertices in J (-1 if a vertex
+ * is not reachable), return false if i is not a registered source */
+bool graphe::dynamic_connectivity::distances(int i,const ivector &J,ivector &dist) const {
+    for (std::vector<source>::const_iterator it=m_sources.begin();it!=m_sources.end();++it) {
+        if (it->root!=i)
+            continue;
+        dist.resize(J.size());
+        for (ivector_iter jt=J.begin();jt!=J.end();++jt) {
+            int d=it->dist[*jt];
+            dist[jt-J.begin()]=d==inf?-1:d;
+        }
+        return true;
+    }
+    return false;
+}
+
+/* BFS from the root of s */
+void graphe::dynamic_connectivity::compute_source(const graphe &G,source &s) {
+    int k;
+    s.dist.assign(G.node_count(),inf);
+    s.dist[s.root]=0;
+    ivector &queue=m_side[0];
+    queue.assign(1,s.root);
+    for (size_t head=0;head<queue.size();++head) {
+        k=queue[head];
+        const ivector &ngh=G.node(k).neighbors();
+        for (ivector_iter it=ngh.begin();it!=ngh.end();++it) {
+            if (s.dist[*it]==inf) {
+                s.dist[*it]=s.dist[k]+1;
+                queue.push_back(*it);
+            }
+        }
+    }
+    queue.clear();
+}
+
+/* the edge {u,v} has been added, propagate the shortened distances */
+void graphe::dynamic_connectivity::decrease_distances(const graphe &G,source &s,int u,int v) {
+    ivector &d=s.dist;
+    if (d[v]<d[u])
+        std::swap(u,v);
+    if (d[u]==inf || d[u]+1>=d[v])
+        return;
+    d[v]=d[u]+1;
+    ivector &queue=m_side[0];
+    queue.assign(1,v);
+    int k;
+    for (size_t head=0;head<queue.size();++head) {
+        k=queue[head];
+        const ivector &ngh=G.node(k).neighbors();
+        for (ivector_iter it=ngh.begin();it!=ngh.end();++it) {
+            if (d[k]+1<d[*it]) {
+                d[*it]=d[k]+1;
+                queue.push_back(*it);
+            }
+        }
+    }
+    queue.clear();
+}
+
+/* the edge {u,v} has been removed: find the vertices which lost all their
+ * shortest paths, level by level, and recompute their distances from the
+ * unaffected part using a priority queue */
+void graphe::dynamic_connectivity::increase_distances(const graphe &G,source &s,int u,int v) {
+    ivector &d=s.dist;
+    if (d[v]<d[u])
+        std::swap(u,v);
+    if (d[u]==inf || d[u]==d[v])
+        return;
+    const ivector &ngh_v=G.node(v).neighbors();
+    for (ivector_iter it=ngh_v.begin();it!=ngh_v.end();++it) {
+        if (d[*it]==d[v]-1)
+            return; // v has another parent
+    }
+    int e=next_epoch(),k;
+    bool has_parent;
+    /* m_mark is e for affected vertices and e+1 for checked unaffected ones */
+    ivector &affected=m_side[0];
+    affected.assign(1,v);
+    m_mark[v]=e;
+    for (size_t head=0;head<affected.size();++head) {
+        k=affected[head];
+        const ivector &ngh=G.node(k).neighbors();
+        for (ivector_iter it=ngh.begin();it!=ngh.end();++it) {
+            int w=*it;
+            if (d[w]!=d[k]+1 || m_mark[w]==e || m_mark[w]==e+1)
+                continue;
+            has_parent=false;
+            const ivector &ngh_w=G.node(w).neighbors();
+            for (ivector_iter jt=ngh_w.begin();jt!=ngh_w.end() && !has_parent;++jt) {
+                has_parent=d[*jt]==d[w]-1 && m_mark[*jt]!=e;
+            }
+            m_mark[w]=has_parent?e+1:e;
+            if (!has_parent)
+                affected.push_back(w);
+        }
+    }
+    std::priority_queue<ipair,std::vector<ipair>,std::greater<ipair> > pq;
+    for (ivector_iter it=affected.begin();it!=affected.end();++it) {
+        k=inf;
+        const ivector &ngh=G.node(*it).neighbors();
+        for (ivector_iter jt=ngh.begin();jt!=ngh.end();++jt) {
+            if (m_mark[*jt]!=e && d[*jt]!=inf && d[*jt]+1<k)
+                k=d[*jt]+1;
+        }
+        d[*it]=k;
+        if (k!=inf)
+            pq.push(make_pair(k,*it));
+    }
+    ipair p;
+    while (!pq.empty()) {
+        p=pq.top();
+        pq.pop();
+        if (p.first!=d[p.second])
+            continue;
+        const ivector &ngh=G.node(p.second).neighbors();
+        for (ivector_iter it=ngh.begin();it!=ngh.end();++it) {
+            if (m_mark[*it]==e && p.first+1<d[*it]) {
+                d[*it]=p.first+1;
+                pq.push(make_pair(d[*it],*it));
+            }
+        }
+    }
+    affected.clear();
+}
+
+/*
+ * END OF DYNAMIC CONNECTIVITY CLASS
+ */
+
+/* enable or disable the incremental mode, in which connectivity queries and
+ * distances from the registered sources (see add_distance_source) are answered
+ * from a structure updated by add_edge, remove_edge, add_node and
+ * contract_edge; other modifications of the graph trigger a full rebuild on
+ * the next query (only undirected graphs are supported) */
+void graphe::set_incremental(bool yes) {
+    m_dynamic.enable(yes);
+    if (yes)
+        dynamic_sync();
+}
+
+/* bring the incremental structure up to date, return false if it cannot be used */
+bool graphe::dynamic_sync() {
+    if (!m_dynamic.enabled() || is_directed())
+        return false;
+    if (!m_dynamic.is_synced(m_modifications))
+        m_dynamic.build(*this,m_modifications);
+    return true;
+}
+
+/* maintain BFS distances from the i-th vertex in incremental mode */
+void graphe::add_distance_source(int i) {
+    assert(i>=0 && i<node_count());
+    if (dynamic_sync())
+        m_dynamic.add_source(*this,i);
+}
+
+void graphe::remove_distance_source(int i) {
+    m_dynamic.remove_source(i);
+}
+
 /* make planar layout */
 bool graphe::make_planar_layout(layout &x) {
     int n=node_count(),of,m;
@@ -7786,6 +11026,7 @@ bool graphe::make_planar_layout(layout &x) {
     /* remove temporary vertices and edges */
     remove_temporary_edges();
     while (node_count()>n) nodes.pop_back();
+    invalidate_adjacency();
     x.resize(n);
     return true;
 }
@@ -8142,31 +11383,88 @@ void graphe::draw_labels(vecteur &drawing,const layout &x) const {
     }
 }
 
+/* DFS from the i-th vertex storing the traversal data in vertices, iterative,
+ * with adjacency lists read from the snapshot */
 void graphe::rdfs(int i,ivector &d,bool rec,int sg,bool skip_embedded) {
-    vertex &v=node(i);
-    v.set_visited(true);
-    v.set_disc(++disc_time);
-    v.set_low(v.disc());
+    const csr &A=adjacency();
+    ivector &path=m_traversal.stack,&pos=m_traversal.pos;
+    if (int(pos.size())<node_count())
+        pos.resize(node_count());
+    path.clear();
+    vertex &r=node(i);
+    r.set_visited(true);
+    r.set_disc(++disc_time);
+    r.set_low(r.disc());
     if (rec)
         d.push_back(i);
+    pos[i]=A.offsets[i];
+    path.push_back(i);
     int j;
-    for (ivector_iter it=v.neighbors().begin();it!=v.neighbors().end();++it) {
-        j=*it;
+    while (!path.empty()) {
+        int k=path.back();
+        vertex &v=node(k);
+        if (pos[k]==A.offsets[k+1]) {
+            path.pop_back();
+            if (!path.empty()) {
+                vertex &u=node(path.back());
+                u.set_low(std::min(u.low(),v.low()));
+            }
+            continue;
+        }
+        j=A.columns[pos[k]++];
         vertex &w=node(j);
         if ((sg>=0 && w.subgraph()!=sg) || (skip_embedded && w.is_embedded()))
             continue;
         if (!w.is_visited()) {
-            w.set_ancestor(i);
+            w.set_ancestor(k);
             v.set_leaf(false);
-            rdfs(j,d,rec,sg,skip_embedded);
-            v.set_low(std::min(v.low(),w.low()));
+            w.set_visited(true);
+            w.set_disc(++disc_time);
+            w.set_low(w.disc());
+            if (rec)
+                d.push_back(j);
+            pos[j]=A.offsets[j];
+            path.push_back(j);
         } else if (j!=v.ancestor())
             v.set_low(std::min(v.low(),w.disc()));
     }
 }
 
+/* DFS from root visiting vertices allowed by the current traversal state only,
+ * appending the visited vertices to comp (if non-null) in preorder */
+void graphe::component_dfs(int root,ivector *comp) {
+    const csr &A=m_adjacency;
+    traversal_state &T=m_traversal;
+    ivector &path=T.stack;
+    int v,j;
+    if (comp!=NULL)
+        comp->clear();
+    assert(path.empty());
+    T.visit(root);
+    if (comp!=NULL)
+        comp->push_back(root);
+    T.pos[root]=A.offsets[root];
+    path.push_back(root);
+    while (!path.empty()) {
+        v=path.back();
+        if (T.pos[v]==A.offsets[v+1]) {
+            path.pop_back();
+            continue;
+        }
+        j=A.columns[T.pos[v]++];
+        if (!T.allowed(j) || T.visited(j))
+            continue;
+        T.visit(j);
+        if (comp!=NULL)
+            comp->push_back(j);
+        T.pos[j]=A.offsets[j];
+        path.push_back(j);
+    }
+}
+
 /* depth-first graph traversal with O(n+m) time and O(m) space complexity */
 void graphe::dfs(int root,bool rec,bool clr,ivector *D,int sg,bool skip_embedded) {
+    GT_PROFILE(profile,"dfs");
     if (clr) {
         unvisit_all_nodes(sg);
         unset_all_ancestors(sg);
@@ -8187,6 +11485,7 @@ void graphe::dfs(int root,bool rec,bool clr,ivector *D,int sg,bool skip_embedded
 
 /* breadth-first graph traversal with O(n+m) time and O(m) space complexity */
 void graphe::bfs(int root,bool rec,bool clr,ivector *D,int sg,bool skip_embedded) {
+    GT_PROFILE(profile,"bfs");
     if (clr) {
         unvisit_all_nodes(sg);
         unset_all_ancestors(sg);
@@ -8197,30 +11496,32 @@ void graphe::bfs(int root,bool rec,bool clr,ivector *D,int sg,bool skip_embedded
         d.clear();
         d.reserve(node_count());
     }
-    assert(node_queue.empty());
-    node_queue.push(root);
+    const csr &A=adjacency();
+    ivector &queue=m_traversal.stack;
+    queue.clear();
+    queue.push_back(root);
     int i,j;
-    while (!node_queue.empty()) {
-        i=node_queue.front();
-        node_queue.pop();
+    for (size_t head=0;head<queue.size();++head) {
+        i=queue[head];
         vertex &v=node(i);
         if (!v.is_visited()) {
             v.set_disc(disc_time++);
             if (rec)
                 d.push_back(i);
             v.set_visited(true);
-            for (ivector_iter it=v.neighbors().begin();it!=v.neighbors().end();++it) {
-                vertex &w=node(j=*it);
+            for (int k=A.offsets[i];k<A.offsets[i+1];++k) {
+                vertex &w=node(j=A.columns[k]);
                 if ((sg>=0 && w.subgraph()!=sg) || (skip_embedded && w.is_embedded()))
                     continue;
                 if (!w.is_visited()) {
                     if (w.ancestor()<0)
                         w.set_ancestor(i);
-                    node_queue.push(j);
+                    queue.push_back(j);
                 }
             }
         }
     }
+    queue.clear();
 }
 
 /* return true iff the graph is connected */
@@ -8231,11 +11532,14 @@ bool graphe::is_connected(int sg) {
         underlying(G);
         return G.is_connected(sg);
     }
+    if (sg<0 && dynamic_sync())
+        return m_dynamic.component_count()<=1;
     int i=sg<0?0:first_vertex_from_subgraph(sg);
     assert(i>=0);
-    dfs(i,false,true,NULL,sg);
-    for (node_iter it=nodes.begin()+i;it!=nodes.end();++it) {
-        if ((sg<0 || it->subgraph()==sg) && !it->is_visited())
+    start_traversal(sg);
+    component_dfs(i,NULL);
+    for (int j=i+1;j<node_count();++j) {
+        if (m_traversal.allowed(j) && !m_traversal.visited(j))
             return false;
     }
     return true;
@@ -8430,6 +11734,8 @@ void graphe::tensor_product(const graphe &G,graphe &P) const {
 /* compute the distance between i-th and J nodes using BFS and store them to dist
 * (also output paths if shortest_paths!=NULL) */
 void graphe::distance(int i,const ivector &J,ivector &dist,ivectors *shortest_paths) {
+    if (shortest_paths==NULL && dynamic_sync() && m_dynamic.distances(i,J,dist))
+        return;
     bfs(i,false);
     int k,p,len;
     if (shortest_paths!=NULL) {
@@ -8461,9 +11767,519 @@ void graphe::distance(int i,const ivector &J,ivector &dist,ivectors *shortest_pa
     }
 }
 
+/* numeric shortest paths
+ *
+ * When all edge weights are machine integers or floating-point numbers, the
+ * adjacency structure and the weights are copied once to a CSR representation
+ * and shortest paths are computed with native arithmetic. Graphs with symbolic
+ * or exact rational weights are handled by the generic routines below. */
+
+/* fill A with the CSR representation of this graph (or its subgraph sg),
+ * return false if some weight is not an integer nor a floating-point number;
+ * if approx=true, other real weights (e.g. rationals) are approximated */
+bool graphe::make_csr(csr &A,int sg,bool approx) const {
+    GT_PROFILE(profile,"make_csr");
+    int n=node_count(),i,j;
+    bool isweighted=is_weighted(),isdir=is_directed();
+    A.offsets.resize(n+1);
+    A.columns.clear();
+    A.weights.clear();
+    A.integral=true;
+    A.min_weight=A.max_weight=1;
+    int m=0;
+    for (node_iter it=nodes.begin();it!=nodes.end();++it) {
+        m+=it->degree();
+    }
+    A.columns.reserve(m);
+    if (isweighted)
+        A.weights.reserve(m);
+    bool first=true;
+    double w;
+    gen wd;
+    for (i=0;i<n;++i) {
+        A.offsets[i]=A.columns.size();
+        const vertex &v=node(i);
+        if (sg>=0 && v.subgraph()!=sg)
+            continue;
+        for (ivector_iter it=v.neighbors().begin();it!=v.neighbors().end();++it) {
+            j=*it;
+            if (sg>=0 && node(j).subgraph()!=sg)
+                continue;
+            if (isweighted) {
+                const attrib &attr=(isdir || i<j)?v.neighbor_attributes(j):node(j).neighbor_attributes(i);
+                attrib_iter ait=attr.find(_GT_ATTRIB_WEIGHT);
+                if (ait==attr.end())
+                    return false;
+                const gen &wg=ait->second;
+                if (wg.type==_INT_)
+                    w=wg.val;
+                else if (wg.type==_DOUBLE_) {
+                    w=wg.DOUBLE_val();
+                    A.integral=false;
+                } else if (is_inf(wg) && is_positive(wg,ctx))
+                    continue; // arc with infinite weight is never used
+                else if (approx && (wd=evalf_double(wg,1,ctx)).type==_DOUBLE_) {
+                    w=wd.DOUBLE_val();
+                    A.integral=false;
+                } else return false;
+                if (first || w<A.min_weight) A.min_weight=w;
+                if (first || w>A.max_weight) A.max_weight=w;
+                first=false;
+                A.weights.push_back(w);
+            }
+            A.columns.push_back(j);
+        }
+    }
+    A.offsets[n]=A.columns.size();
+    GT_MEMORY("csr",sizeof(int)*(A.offsets.size()+A.columns.size())+sizeof(double)*A.weights.size());
+    return true;
+}
+
+/* return the adjacency snapshot of this graph (CSR without weights), which is built
+ * on first use and kept until the structure of the graph changes; not thread-safe,
+ * so it should be obtained by the calling thread before spawning workers */
+const graphe::csr &graphe::adjacency() const {
+    if (m_adjacency_valid)
+        return m_adjacency;
+    GT_PROFILE(profile,"adjacency");
+    csr &A=m_adjacency;
+    int n=node_count(),m=0,k=0;
+    for (node_iter it=nodes.begin();it!=nodes.end();++it) {
+        m+=it->degree();
+    }
+    A.offsets.resize(n+1);
+    A.columns.resize(m);
+    A.weights.clear();
+    A.integral=true;
+    A.min_weight=A.max_weight=1;
+    for (int i=0;i<n;++i) {
+        const ivector &ngh=node(i).neighbors();
+        A.offsets[i]=k;
+        std::copy(ngh.begin(),ngh.end(),A.columns.begin()+k);
+        k+=ngh.size();
+    }
+    A.offsets[n]=k;
+    m_adjacency_valid=true;
+    GT_MEMORY("adjacency",sizeof(int)*(A.offsets.size()+A.columns.size()));
+    return A;
+}
+
+/* prepare the state arrays for a new traversal of n vertices, visit marks are
+ * cleared in constant time by incrementing the stamp */
+void graphe::traversal_state::reset(int n,bool restricted) {
+    if (int(m_mark.size())!=n || m_stamp==std::numeric_limits<int>::max()) {
+        m_mark.assign(n,0);
+        m_stamp=0;
+    }
+    ++m_stamp;
+    disc.resize(n);
+    low.resize(n);
+    parent.resize(n);
+    pos.resize(n);
+    stack.clear();
+    scc_stack.clear();
+    if (restricted)
+        m_allowed.assign(n,false);
+    else m_allowed.clear();
+}
+
+/* start a traversal on the adjacency snapshot, restricted to the subgraph sg if sg>=0 */
+void graphe::start_traversal(int sg) {
+    adjacency();
+    m_traversal.reset(node_count(),sg>=0);
+    if (sg>=0) {
+        for (int i=0;i<node_count();++i) {
+            if (node(i).subgraph()==sg)
+                m_traversal.allow(i);
+        }
+    }
+}
+
+/* Dijkstra's algorithm with a binary heap on CSR adjacency with nonnegative weights */
+void graphe::csr_dijkstra(const csr &A,int src,dvector &dist,ivector &pred) {
+    int n=A.node_count(),u,v;
+    dist.assign(n,DBL_MAX);
+    pred.assign(n,-1);
+    priority_queue<pair<double,int>,vector<pair<double,int> >,greater<pair<double,int> > > Q;
+    dist[src]=0;
+    Q.push(make_pair(0.0,src));
+    double d,alt;
+    while (!Q.empty()) {
+        d=Q.top().first;
+        u=Q.top().second;
+        Q.pop();
+        if (d>dist[u])
+            continue; // stale entry
+        for (int k=A.offsets[u];k<A.offsets[u+1];++k) {
+            v=A.columns[k];
+            alt=d+A.weight(k);
+            if (alt<dist[v]) {
+                dist[v]=alt;
+                pred[v]=u;
+                Q.push(make_pair(alt,v));
+            }
+        }
+    }
+}
+
+/* Dial's bucket variant of Dijkstra's algorithm for small nonnegative integer weights */
+void graphe::csr_dial(const csr &A,int src,dvector &dist,ivector &pred) {
+    assert(A.integral && A.min_weight>=0 && A.max_weight<=DIAL_MAX_WEIGHT);
+    int n=A.node_count(),nb=int(A.max_weight)+1,pending=1,u,v;
+    dist.assign(n,DBL_MAX);
+    pred.assign(n,-1);
+    ivectors buckets(nb);
+    dist[src]=0;
+    buckets[0].push_back(src);
+    double alt;
+    for (long d=0;pending>0;++d) {
+        ivector &B=buckets[d%nb];
+        while (!B.empty()) {
+            u=B.back();
+            B.pop_back();
+            --pending;
+            if (dist[u]!=double(d))
+                continue; // stale entry
+            for (int k=A.offsets[u];k<A.offsets[u+1];++k) {
+                v=A.columns[k];
+                alt=d+A.weight(k);
+                if (alt<dist[v]) {
+                    dist[v]=alt;
+                    pred[v]=u;
+                    buckets[long(alt)%nb].push_back(v);
+                    ++pending;
+                }
+            }
+        }
+    }
+}
+
+/* queue-based Bellman-Ford algorithm on CSR adjacency,
+ * return false if a negative cycle reachable from src is found */
+bool graphe::csr_bellman_ford(const csr &A,int src,dvector &dist,ivector &pred) {
+    int n=A.node_count(),u,v;
+    dist.assign(n,DBL_MAX);
+    pred.assign(n,-1);
+    ivector len(n,0);
+    bvector queued(n,false);
+    queue<int> Q;
+    dist[src]=0;
+    Q.push(src);
+    queued[src]=true;
+    double alt;
+    while (!Q.empty()) {
+        u=Q.front();
+        Q.pop();
+        queued[u]=false;
+        for (int k=A.offsets[u];k<A.offsets[u+1];++k) {
+            v=A.columns[k];
+            alt=dist[u]+A.weight(k);
+            if (alt<dist[v]) {
+                dist[v]=alt;
+                pred[v]=u;
+                if ((len[v]=len[u]+1)>=n)
+                    return false; // a negative-weight cycle is found
+                if (!queued[v]) {
+                    Q.push(v);
+                    queued[v]=true;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/* relax the block (ib,jb) of the row-major n-by-n matrix D through the vertices of block kb */
+static void fw_relax_block(double *D,int n,int ib,int jb,int kb) {
+    int i0=ib*FW_BLOCK_SIZE,i1=std::min(n,i0+FW_BLOCK_SIZE);
+    int j0=jb*FW_BLOCK_SIZE,j1=std::min(n,j0+FW_BLOCK_SIZE);
+    int k0=kb*FW_BLOCK_SIZE,k1=std::min(n,k0+FW_BLOCK_SIZE);
+    double dik,s,*Di;
+    const double *Dk;
+    for (int k=k0;k<k1;++k) {
+        Dk=D+size_t(k)*n;
+        for (int i=i0;i<i1;++i) {
+            Di=D+size_t(i)*n;
+            dik=Di[k];
+            /* branch-free inner loop, vectorized by the compiler */
+            for (int j=j0;j<j1;++j) {
+                s=dik+Dk[j];
+                Di[j]=s<Di[j]?s:Di[j];
+            }
+        }
+    }
+}
+
+struct fw_data {
+    double *D;
+    int n,nb,kb;
+};
+
+/* phase 2 of blocked Floyd-Warshall: blocks in the row and the column of the pivot block */
+static void fw_phase2(int first,int last,int thread,void *data) {
+    fw_data *d=(fw_data*)data;
+    for (int t=first;t<last;++t) {
+        int b=t/2;
+        if (b>=d->kb) ++b;
+        if (t%2==0)
+            fw_relax_block(d->D,d->n,d->kb,b,d->kb);
+        else fw_relax_block(d->D,d->n,b,d->kb,d->kb);
+    }
+}
+
+/* phase 3 of blocked Floyd-Warshall: the remaining blocks */
+static void fw_phase3(int first,int last,int thread,void *data) {
+    fw_data *d=(fw_data*)data;
+    int m=d->nb-1;
+    for (int t=first;t<last;++t) {
+        int ib=t/m,jb=t%m;
+        if (ib>=d->kb) ++ib;
+        if (jb>=d->kb) ++jb;
+        fw_relax_block(d->D,d->n,ib,jb,d->kb);
+    }
+}
+
+/* fill D with the row-major adjacency matrix of A, absent arcs having infinite weight */
+static void csr_dense_matrix(const graphe::csr &A,graphe::dvector &D) {
+    int n=A.node_count(),i,j;
+    D.assign(size_t(n)*n,std::numeric_limits<double>::infinity());
+    for (i=0;i<n;++i) {
+        for (int k=A.offsets[i];k<A.offsets[i+1];++k) {
+            j=A.columns[k];
+            D[size_t(i)*n+j]=std::min(D[size_t(i)*n+j],A.weight(k));
+        }
+        D[size_t(i)*n+i]=0;
+    }
+}
+
+/* cache-blocked parallel Floyd-Warshall algorithm on a flat row-major double matrix D */
+void graphe::csr_floyd_warshall(const csr &A,dvector &D) {
+    int n=A.node_count();
+    csr_dense_matrix(A,D);
+    if (n==0)
+        return;
+    fw_data data;
+    data.D=&D.front();
+    data.n=n;
+    data.nb=(n+FW_BLOCK_SIZE-1)/FW_BLOCK_SIZE;
+    for (data.kb=0;data.kb<data.nb;++data.kb) {
+        fw_relax_block(data.D,n,data.kb,data.kb,data.kb);
+        if (data.nb==1)
+            break;
+        parallel_for(2*(data.nb-1),fw_phase2,&data,0,1);
+        parallel_for((data.nb-1)*(data.nb-1),fw_phase3,&data);
+    }
+}
+
+struct sssp_data {
+    const graphe::csr *A;
+    double *D;
+    bool dial;
+};
+
+/* compute rows first,..,last-1 of the distance matrix by running Dijkstra from each source */
+static void sssp_rows(int first,int last,int thread,void *data) {
+    sssp_data *d=(sssp_data*)data;
+    int n=d->A->node_count();
+    graphe::dvector dist;
+    graphe::ivector pred;
+    for (int i=first;i<last;++i) {
+        if (d->dial)
+            graphe::csr_dial(*d->A,i,dist,pred);
+        else graphe::csr_dijkstra(*d->A,i,dist,pred);
+        double *Di=d->D+size_t(i)*n;
+        for (int j=0;j<n;++j) {
+            Di[j]=dist[j]==DBL_MAX?std::numeric_limits<double>::infinity():dist[j];
+        }
+    }
+}
+
+/* compute all-pairs distances in A and store them to the row-major matrix D,
+ * run Dijkstra from every source in parallel if A is sparse with nonnegative
+ * weights, otherwise use blocked Floyd-Warshall */
+void graphe::csr_allpairs(const csr &A,dvector &D) {
+    GT_PROFILE(profile,"allpairs");
+    int n=A.node_count();
+    GT_MEMORY("allpairs_matrix",sizeof(double)*double(n)*double(n));
+    double lg=std::log(double(n+1))/M_LN2;
+    if (A.min_weight<0 || double(A.arc_count())*lg>=0.25*double(n)*double(n)) {
+        csr_floyd_warshall(A,D);
+        return;
+    }
+    D.resize(size_t(n)*n);
+    sssp_data data;
+    data.A=&A;
+    data.D=n>0?&D.front():NULL;
+    data.dial=A.integral && A.max_weight<=DIAL_MAX_WEIGHT;
+    parallel_for(n,sssp_rows,&data);
+}
+
+/* store the transpose (reverse) of A to T */
+void graphe::csr_transpose(const csr &A,csr &T) {
+    int n=A.node_count(),m=A.arc_count(),i,j,k;
+    T.integral=A.integral;
+    T.min_weight=A.min_weight;
+    T.max_weight=A.max_weight;
+    T.offsets.assign(n+1,0);
+    T.columns.resize(m);
+    T.weights.resize(A.weights.empty()?0:m);
+    for (k=0;k<m;++k) {
+        ++T.offsets[A.columns[k]+1];
+    }
+    for (i=0;i<n;++i) {
+        T.offsets[i+1]+=T.offsets[i];
+    }
+    ivector pos(T.offsets.begin(),T.offsets.end()-1);
+    for (i=0;i<n;++i) {
+        for (k=A.offsets[i];k<A.offsets[i+1];++k) {
+            j=pos[A.columns[k]]++;
+            T.columns[j]=i;
+            if (!A.weights.empty())
+                T.weights[j]=A.weights[k];
+        }
+    }
+}
+
+/* parallel loops
+ *
+ * parallel_for(n,task,data) splits the range 0,..,n-1 into chunks which are
+ * dynamically assigned to at most giac::threads worker threads. Tasks must not
+ * call Giac (i.e. operate on gens) since the context is not thread-safe. */
+
+struct parallel_for_shared {
+    graphe::parallel_task task;
+    void *data;
+    int n,chunk,next;
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_t mutex;
+#endif
+};
+
+struct parallel_for_worker_data {
+    parallel_for_shared *shared;
+    int thread;
+};
+
+#ifdef HAVE_LIBPTHREAD
+static void *parallel_for_worker(void *arg) {
+    parallel_for_worker_data *w=(parallel_for_worker_data*)arg;
+    parallel_for_shared *sh=w->shared;
+    int first,last;
+    while (true) {
+        pthread_mutex_lock(&sh->mutex);
+        first=sh->next;
+        last=sh->next=std::min(sh->n,first+sh->chunk);
+        pthread_mutex_unlock(&sh->mutex);
+        if (first>=last)
+            break;
+        sh->task(first,last,w->thread,sh->data);
+    }
+    return NULL;
+}
+#endif
+
+/* return the number of threads to use for n units of work */
+int graphe::thread_count(int work) {
+    return std::max(1,std::min(threads,work));
+}
+
+/* run task on chunks of the range 0,..,n-1 in parallel, each thread receives its index */
+void graphe::parallel_for(int n,parallel_task task,void *data,int nthreads,int chunk) {
+    if (n<=0)
+        return;
+    if (nthreads<=0)
+        nthreads=thread_count(n);
+#ifdef HAVE_LIBPTHREAD
+    if (nthreads>1) {
+        parallel_for_shared sh;
+        sh.task=task;
+        sh.data=data;
+        sh.n=n;
+        sh.chunk=chunk>0?chunk:std::max(1,n/(8*nthreads));
+        sh.next=0;
+        pthread_mutex_init(&sh.mutex,NULL);
+        vector<parallel_for_worker_data> wd(nthreads);
+        vector<pthread_t> tid(nthreads);
+        vector<bool> started(nthreads,false);
+        for (int t=0;t<nthreads;++t) {
+            wd[t].shared=&sh;
+            wd[t].thread=t;
+            if (t>0)
+                started[t]=pthread_create(&tid[t],NULL,parallel_for_worker,&wd[t])==0;
+        }
+        parallel_for_worker(&wd[0]);
+        for (int t=1;t<nthreads;++t) {
+            if (started[t])
+                pthread_join(tid[t],NULL);
+        }
+        pthread_mutex_destroy(&sh.mutex);
+        return;
+    }
+#endif
+    task(0,n,0,data);
+}
+
+/* convert numeric distance to gen */
+gen graphe::numeric2gen(double d,bool integral) {
+    if (d>=DBL_MAX)
+        return plusinf();
+    if (integral)
+        return gen((longlong)d);
+    return gen(d);
+}
+
+/* store numeric distances from src to dest to path_weights and the respective paths to paths */
+void graphe::numeric_paths(int src,const ivector &dest,const dvector &dist,const ivector &pred,bool integral,
+                           vecteur &path_weights,ivectors *paths) {
+    int n=node_count(),p;
+    for (int i=0;i<n;++i) {
+        node(i).set_ancestor(pred[i]);
+    }
+    path_weights.resize(dest.size());
+    for (ivector_iter it=dest.begin();it!=dest.end();++it) {
+        path_weights[it-dest.begin()]=numeric2gen(dist[*it],integral);
+    }
+    if (paths!=NULL) {
+        paths->resize(dest.size());
+        for (ivector_iter it=dest.begin();it!=dest.end();++it) {
+            ivector &path=paths->at(it-dest.begin());
+            path.clear();
+            if (dist[*it]==DBL_MAX) continue;
+            path.push_back(p=*it);
+            while (p!=src && (p=pred[p])>=0) path.push_back(p);
+            std::reverse(path.begin(),path.end());
+        }
+    }
+}
+
+/* compute the distances between all pairs of vertices with native arithmetic and store
+ * them to the row-major matrix D (infinite entries correspond to unreachable pairs),
+ * return false if some weights are symbolic */
+bool graphe::allpairs_distance(dvector &D,bool &integral) const {
+    csr A;
+    if (!make_csr(A))
+        return false;
+    csr_allpairs(A,D);
+    integral=A.integral;
+    return true;
+}
+
 /* compute the distances between all pairs of vertices using Floyd-Warshall algorithm */
 void graphe::allpairs_distance(matrice &m) const {
     int n=node_count(),i,j,k;
+    dvector D;
+    bool integral;
+    if (allpairs_distance(D,integral)) {
+        m.resize(n);
+        for (i=0;i<n;++i) {
+            vecteur row(n);
+            for (j=0;j<n;++j) {
+                row[j]=numeric2gen(D[size_t(i)*n+j],integral);
+            }
+            m[i]=row;
+        }
+        return;
+    }
     m.reserve(n);
     for (i=0;i<n;++i) {
         m.push_back(vecteur(n,plusinf()));
@@ -8494,6 +12310,7 @@ void graphe::allpairs_distance(matrice &m) const {
 /* return the length of the shortest path from src to dest in weighted
 * graph (Dijkstra's algorithm), also fill shortest_path with the respective vertices */
 void graphe::dijkstra(int src,const ivector &dest,vecteur &path_weights,ivectors *cheapest_paths,int sg) {
+    GT_PROFILE(profile,"dijkstra");
     int n=node_count();
     ivector Q;
     vecteur dist(n);
@@ -8504,6 +12321,16 @@ void graphe::dijkstra(int src,const ivector &dest,vecteur &path_weights,ivectors
             assert(node(*it).subgraph()==sg);
         }
     }
+    csr A;
+    if (make_csr(A,sg) && A.min_weight>=0) {
+        dvector ndist;
+        ivector pred;
+        if (A.integral && A.max_weight<=DIAL_MAX_WEIGHT)
+            csr_dial(A,src,ndist,pred);
+        else csr_dijkstra(A,src,ndist,pred);
+        numeric_paths(src,dest,ndist,pred,A.integral,path_weights,cheapest_paths);
+        return;
+    }
     unset_all_ancestors(sg);
     for (int i=0;i<n;++i) {
         vertex &v=node(i);
@@ -8561,6 +12388,15 @@ void graphe::dijkstra(int src,const ivector &dest,vecteur &path_weights,ivectors
 * graph (Bellman-Ford algorithm), also fill shortest_path with the respective vertices */
 bool graphe::bellman_ford(int src,const ivector &dest,vecteur &path_weights,ivectors *cheapest_paths) {
     int n=node_count(),u,v;
+    csr A;
+    if (make_csr(A)) {
+        dvector ndist;
+        ivector pred;
+        if (!csr_bellman_ford(A,src,ndist,pred))
+            return false;
+        numeric_paths(src,dest,ndist,pred,A.integral,path_weights,cheapest_paths);
+        return true;
+    }
     ivector prev(n);
     vecteur dist(n);
     bool isweighted=is_weighted();
@@ -8630,6 +12466,7 @@ bool graphe::topologic_sort(ivector &ordering) {
                 node_stack.push(*it);
         }
         vert.clear_neighbors();
+        G.invalidate_adjacency();
     }
     return G.edge_count()==0;
 }
@@ -8871,6 +12708,7 @@ void graphe::assign_edge_directions_from_st() {
                 v.remove_neighbor(*jt);
         }
     }
+    invalidate_adjacency();
     if (isweighted)
         make_weighted(W);
 }
@@ -8992,37 +12830,85 @@ void graphe::greedy_vertex_coloring_biggs(ivector &ordering) {
     }
 }
 
-/* classical greedy vertex coloring algorithm, time complexity O(n+m) */
+#define GREEDY_COLORING_PARALLEL_MIN 1024
+
+struct greedy_coloring_data {
+    graphe *G;
+    const graphe::csr *A;
+    const int *level_vertices;
+    std::vector<graphe::ivector> marks; // per-thread color marks, stamped with vertex index+1
+};
+
+/* color the given vertices, no two of which are adjacent, with the smallest colors not used by their neighbors */
+static void greedy_color_range(int first,int last,int thread,void *data) {
+    greedy_coloring_data &d=*(greedy_coloring_data*)data;
+    const graphe::csr &A=*d.A;
+    graphe::ivector &mark=d.marks[thread];
+    for (int i=first;i<last;++i) {
+        int v=d.level_vertices[i],c,k=1,deg=A.offsets[v+1]-A.offsets[v];
+        for (int j=A.offsets[v];j<A.offsets[v+1];++j) {
+            if ((c=d.G->node(A.columns[j]).color())>0 && c<=deg+1)
+                mark[c]=v+1;
+        }
+        while (mark[k]==v+1) ++k;
+        d.G->node(v).set_color(k);
+    }
+}
+
+/* classical greedy vertex coloring algorithm, time complexity O(n+m).
+ * Each vertex is assigned a level which is larger than the levels of its neighbors preceding
+ * it in p (Jones & Plassmann 1993). Vertices on the same level are independent and all their
+ * preceding neighbors are already colored, hence large levels are colored in parallel and the
+ * result is the same as if the vertices were colored sequentially */
 int graphe::greedy_vertex_coloring(const ivector &p) {
     if (is_directed()) {
         graphe G(ctx,false);
         underlying(G);
         return G.greedy_vertex_coloring(p);
     }
+    GT_PROFILE(profile,"greedy_vertex_coloring");
     uncolor_all_nodes();
-    int c=0,k;
-    std::set<int> used;
-    for (ivector_iter it=p.begin();it!=p.end();++it) {
-        vertex &v=node(*it);
-        if (c==0) {
-            v.set_color(++c);
-            continue;
-        }
-        used.clear();
-        for (ivector_iter jt=v.neighbors().begin();jt!=v.neighbors().end();++jt) {
-            vertex &v=node(*jt);
-            if (v.color()>0)
-                used.insert(v.color());
-        }
-        k=1;
-        for (std::set<int>::const_iterator jt=used.begin();jt!=used.end();++jt) {
-            if (*jt>k)
-                break;
-            ++k;
+    int n=node_count(),m=p.size(),maxdeg=0,nlevels=0;
+    const csr &A=adjacency();
+    ivector pos(n,-1),level(m,0),start;
+    for (int i=0;i<m;++i) {
+        int v=p[i],&l=level[i];
+        pos[v]=i;
+        for (int k=A.offsets[v];k<A.offsets[v+1];++k) {
+            int j=pos[A.columns[k]];
+            if (j>=0 && j<i && level[j]>=l)
+                l=level[j]+1;
         }
-        v.set_color(k);
-        if (k>c)
-            c=k;
+        nlevels=std::max(nlevels,l+1);
+        maxdeg=std::max(maxdeg,A.offsets[v+1]-A.offsets[v]);
+    }
+    /* sort the vertices by level, keeping the order within each level */
+    start.resize(nlevels+1,0);
+    for (ivector_iter it=level.begin();it!=level.end();++it) {
+        ++start[*it+1];
+    }
+    for (int l=0;l<nlevels;++l) {
+        start[l+1]+=start[l];
+    }
+    ivector sorted(m),fill(start.begin(),start.end()-1);
+    for (int i=0;i<m;++i) {
+        sorted[fill[level[i]]++]=p[i];
+    }
+    greedy_coloring_data data;
+    data.G=this;
+    data.A=&A;
+    int nthreads=thread_count(m/GREEDY_COLORING_PARALLEL_MIN);
+    data.marks.resize(nthreads,ivector(maxdeg+2,0));
+    for (int l=0;l<nlevels;++l) {
+        int sz=start[l+1]-start[l];
+        data.level_vertices=&sorted[start[l]];
+        if (nthreads>1 && sz>=GREEDY_COLORING_PARALLEL_MIN)
+            parallel_for(sz,greedy_color_range,&data,nthreads,GREEDY_COLORING_PARALLEL_MIN/4);
+        else greedy_color_range(0,sz,0,&data);
+    }
+    int c=0;
+    for (ivector_iter it=p.begin();it!=p.end();++it) {
+        c=std::max(c,node(*it).color());
     }
     return c;
 }
@@ -9159,29 +13045,6 @@ void graphe::make_plane_dual(const ivectors &faces) {
     }
 }
 
-/* return the number of different colors adjacent to the i-th vertex in a partially colored graph */
-int graphe::saturation_degree(const vertex &v,std::set<int> &colors) const {
-    int i,c;
-    colors.clear();
-    for (ivector_iter it=v.neighbors().begin();it!=v.neighbors().end();++it) {
-        i=*it;
-        const vertex &w=node(i);
-        if ((c=w.color())>0)
-            colors.insert(c);
-    }
-    return colors.size();
-}
-
-/* return the degree of v in the uncolored subgraph of this graph */
-int graphe::uncolored_degree(const vertex &v) const {
-    int deg=0;
-    for (ivector_iter it=v.neighbors().begin();it!=v.neighbors().end();++it) {
-        if (node(*it).color()==0)
-            ++deg;
-    }
-    return deg;
-}
-
 /* return true iff this graph has at least one uncolored (white) vertex */
 bool graphe::is_partially_colored() const {
     for (node_iter it=nodes.begin();it!=nodes.end();++it) {
@@ -9191,45 +13054,79 @@ bool graphe::is_partially_colored() const {
     return false;
 }
 
-/* a heuristic algorithm by D.Bre1az for nearly optimal vertex coloring (time complexity O(n*m)),
-* operates on a partially colored graph, returns the number of colors */
+/* mark the color c in the neighborhood of u, return true if it was not there before */
+static bool mark_neighbor_color(int u,int c,const graphe::ivector &offset,std::vector<bitword> &seen,std::set<graphe::ipair> &big) {
+    int w=offset[u]+(c-1)/64;
+    if (w<offset[u+1]) {
+        bitword b=1ULL<<((c-1)&63);
+        if (seen[w]&b)
+            return false;
+        seen[w]|=b;
+        return true;
+    }
+    return big.insert(make_pair(u,c)).second;
+}
+
+/* a heuristic algorithm by D.Brelaz for nearly optimal vertex coloring (time complexity O(m*log(n))),
+* operates on a partially colored graph. The colors in the neighborhood of each vertex are kept in
+* a bitset (larger colors in a set) and the uncolored vertices are kept in buckets by saturation,
+* ordered by the degree in the uncolored subgraph */
 void graphe::dsatur() {
-    int col,i,sat,maxsat,deg,maxdeg=0;
-    std::set<int> colors,maxcolors;
-    ivector indices;
-    for (node_iter it=nodes.begin();it!=nodes.end();++it) {
-        if (it->color()==0)
-            indices.push_back(it-nodes.begin());
+    GT_PROFILE(profile,"dsatur");
+    int n=node_count(),maxsat=0;
+    const csr &A=adjacency();
+    ivector sat(n,0),udeg(n,0),offset(n+1,0);
+    for (int i=0;i<n;++i) {
+        offset[i+1]=offset[i]+(A.offsets[i+1]-A.offsets[i])/64+1;
     }
-    if (indices.empty())
-        return;
-    ivector::iterator pos;
-    do {
-        maxsat=-1;
-        i=-1;
-        for (ivector::iterator it=indices.begin();it!=indices.end();++it) {
-            const vertex &v=node(*it);
-            if ((sat=saturation_degree(v,colors))>maxsat ||
-                    (sat==maxsat && (deg=uncolored_degree(v))>maxdeg)) {
-                if (sat==maxsat)
-                    maxdeg=deg;
-                maxsat=sat;
-                maxcolors=colors;
-                i=*it;
-                pos=it;
-            }
+    std::vector<bitword> seen(offset[n],0);
+    std::set<ipair> big;
+    for (int i=0;i<n;++i) {
+        int c=node(i).color();
+        for (int k=A.offsets[i];k<A.offsets[i+1];++k) {
+            int j=A.columns[k];
+            if (c>0 && mark_neighbor_color(j,c,offset,seen,big))
+                ++sat[j];
+            if (c==0)
+                ++udeg[j];
         }
-        if (i>=0) {
-            col=1;
-            for (std::set<int>::const_iterator it=maxcolors.begin();it!=maxcolors.end();++it) {
-                if (*it==col)
-                    ++col;
-                else break;
+    }
+    std::vector<std::set<ipair> > buckets(1);
+    for (int i=0;i<n;++i) {
+        if (node(i).color()!=0)
+            continue;
+        if (sat[i]>=int(buckets.size()))
+            buckets.resize(sat[i]+1);
+        buckets[sat[i]].insert(make_pair(-udeg[i],i));
+        maxsat=std::max(maxsat,sat[i]);
+    }
+    while (true) {
+        while (maxsat>0 && buckets[maxsat].empty()) --maxsat;
+        if (buckets[maxsat].empty())
+            break;
+        int i=buckets[maxsat].begin()->second,col=0;
+        buckets[maxsat].erase(buckets[maxsat].begin());
+        /* the smallest color not used by the neighbors */
+        for (int w=offset[i];w<offset[i+1];++w) {
+            if (~seen[w]) {
+                col=64*(w-offset[i])+lowest_bit(~seen[w])+1;
+                break;
             }
-            node(i).set_color(col);
-            indices.erase(pos);
         }
-    } while (i>=0);
+        assert(col>0);
+        node(i).set_color(col);
+        for (int k=A.offsets[i];k<A.offsets[i+1];++k) {
+            int j=A.columns[k];
+            if (node(j).color()!=0)
+                continue;
+            buckets[sat[j]].erase(make_pair(-udeg[j],j));
+            --udeg[j];
+            if (mark_neighbor_color(j,col,offset,seen,big) && ++sat[j]==int(buckets.size()))
+                buckets.resize(sat[j]+1);
+            buckets[sat[j]].insert(make_pair(-udeg[j],j));
+            maxsat=std::max(maxsat,sat[j]);
+        }
+    }
 }
 
 /* return the total number of different nonzero vertex colors in this graph */
@@ -9257,12 +13154,12 @@ bool graphe::is_vertex_colorable(int k) {
     ivector sigma=rand_permu(node_count());
     if (greedy_vertex_coloring(sigma)<=k)
         return true;
-    /* next try dsatur algorithm (quadratic time) */
+    /* next try dsatur algorithm (time O(m*log(n))) */
     uncolor_all_nodes();
     dsatur();
     if (color_count()<=k)
         return true;
-    /* finally resort to solving MIP problem */
+    /* finally resort to the exact DSATUR branch&bound */
     return exact_vertex_coloring(k)!=0;
 }
 
@@ -9496,7 +13393,7 @@ bool graphe::is_isomorphic(graphe &other,map<int,int> &isom) {
     delete[] sigma;
     return res;
 #else
-    /* use Ullmann's algorithm */
+    /* use the subgraph matcher, an isomorphism is an embedding of the same order */
     ivectors uv;
     subgraph_isomorphism(other,1,true,uv);
     if (uv.empty())
@@ -9510,71 +13407,48 @@ bool graphe::is_isomorphic(graphe &other,map<int,int> &isom) {
 #endif
 }
 
-/* convert a sequence of nd digits to nonnegative integer */
-int digits2int(char *digits,int nd) {
-    int n=1,res=0;
-    for (int i=nd;i-->0;) {
-        res+=*(digits+i)*n;
-        n*=10;
+#if defined HAVE_LIBNAUTY && defined HAVE_NAUTY_NAUTUTIL_H
+struct aut_output {
+    vecteur *gens;
+    int ofs;
+    graphe::bvector seen;
+};
+
+/* append the permutation perm as a list of disjoint cycles (fixed points omitted) */
+static void aut_collect(const int *perm,int n,void *data) {
+    aut_output *out=(aut_output*)data;
+    out->seen.assign(n,false);
+    vecteur p;
+    for (int i=0;i<n;++i) {
+        if (out->seen[i] || perm[i]==i)
+            continue;
+        vecteur cycle;
+        for (int j=i;!out->seen[j];j=perm[j]) {
+            out->seen[j]=true;
+            cycle.push_back(j+out->ofs);
+        }
+        p.push_back(cycle);
     }
-    return res;
+    out->gens->push_back(gen(p,_LIST__VECT));
 }
+#endif
 
 /* return the set of generators of the automorphism group of this graph */
 gen graphe::aut_generators() const {
 #if defined HAVE_LIBNAUTY && defined HAVE_NAUTY_NAUTUTIL_H
-    int n=node_count(),ofs=array_start(ctx),sz;
-    vecteur out(0);
+    int n=node_count(),sz;
+    vecteur res(0);
     if (n>0) {
         int *adj=to_array(sz);
-        char buf[L_tmpnam];
-        bool has_temp_file=(tmpnam(buf)!=NULL);
-        string tmpname(has_temp_file?buf:"nauty-autg");
-#ifdef _WIN32
-        string tmpdir=getenv("TEMP")?getenv("TEMP"):"c:\\Users\\Public";
-        tmpname=tmpdir+tmpname;
-#endif
-        FILE *f=fopen(tmpname.c_str(),"wb+");
-        if (f==NULL) {
-            message ("Error: failed to create temporary file");
-            return undef;
-        }
+        aut_output out;
+        out.gens=&res;
+        out.ofs=array_start(ctx);
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE,NULL);
-        nautywrapper_aut_generators(is_directed()?1:0,n,adj,f);
+        nautywrapper_aut_generators_cb(is_directed()?1:0,n,adj,aut_collect,&out);
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE,NULL);
-        /* parse the generators and output them as a sequence of
-     * permutations, each in form of a list of disjoint cycles */
-        int sz=ftell(f);
-        rewind(f);
-        int i=0,nd=0;
-        char c;
-        vecteur perm,cycle;
-        char digits[32];
-        for (int cnt=0;cnt<sz;++cnt) {
-            c=fgetc(f);
-            if (c=='(')
-                cycle.clear();
-            else if (c==')') {
-                cycle.push_back(ofs+digits2int(digits,nd));
-                perm.push_back(cycle);
-                nd=0;
-            } else if (c=='\n') {
-                out.push_back(gen(perm,_LIST__VECT));
-                perm.clear();
-            } else if (c>47 && c<58)
-                digits[nd++]=c-48;
-            else if (c==32) {
-                cycle.push_back(ofs+digits2int(digits,nd));
-                nd=0;
-            }
-            ++i;
-        }
-        fclose(f);
-        if (remove(tmpname.c_str())!=0)
-            message("Warning: failed to remove temporary file");
         delete[] adj;
     }
-    return gen(out,_LIST__VECT);
+    return gen(res,_LIST__VECT);
 #else
     return gensizeerr("nauty library is required for finding graph automorphisms");
 #endif
@@ -9603,6 +13477,89 @@ bool graphe::canonical_labeling(ivector &lab) const {
 #endif
 }
 
+struct canonical_hash_data {
+    int isdir;
+    const int *n;
+    int **adj;
+    unsigned long long *hashes;
+};
+
+static void canonical_hash_range(int first,int last,int thread,void *data) {
+    canonical_hash_data *d=(canonical_hash_data*)data;
+    nautywrapper_canonical_hashes(d->isdir,last-first,d->n+first,d->adj+first,d->hashes+first);
+}
+
+/* compute the canonical hashes of the graphs in the list g and store them to res as
+ * nonnegative integers; the graphs are read in blocks and the canonical forms of each
+ * block are computed in parallel if nauty is thread-safe; return false if an element
+ * of g is not a graph or nauty is not available */
+bool graphe::canonical_hashes(const vecteur &g,vecteur &res,GIAC_CONTEXT) {
+#if defined HAVE_LIBNAUTY && defined HAVE_NAUTY_NAUTUTIL_H
+    const int block=4096;
+    int k=g.size(),sz;
+    res.resize(k);
+    ivector n;
+    std::vector<int*> adj;
+    std::vector<unsigned long long> h;
+    bool ok=true;
+    for (int first=0;first<k && ok;first+=block) {
+        int last=std::min(k,first+block),cnt=last-first;
+        n.resize(2*cnt);
+        adj.assign(cnt,(int*)NULL);
+        h.resize(cnt);
+        /* directed and undirected graphs are hashed separately, with different markers */
+        for (int i=0;i<cnt;++i) {
+            graphe G(contextptr);
+            if (!G.read_gen(g[first+i])) {
+                ok=false;
+                break;
+            }
+            n[i]=G.node_count();
+            n[cnt+i]=G.is_directed()?1:0;
+            adj[i]=G.to_array(sz);
+        }
+        if (ok) {
+            int nt=nautywrapper_thread_safe()?thread_count(cnt/16+1):1;
+            for (int dir=0;dir<2;++dir) {
+                ivector sel_n;
+                std::vector<int*> sel_adj;
+                ivector idx;
+                for (int i=0;i<cnt;++i) {
+                    if (n[cnt+i]==dir) {
+                        idx.push_back(i);
+                        sel_n.push_back(n[i]);
+                        sel_adj.push_back(adj[i]);
+                    }
+                }
+                if (idx.empty())
+                    continue;
+                std::vector<unsigned long long> sel_h(idx.size());
+                canonical_hash_data data;
+                data.isdir=dir;
+                data.n=&sel_n.front();
+                data.adj=&sel_adj.front();
+                data.hashes=&sel_h.front();
+                pthread_setcancelstate(PTHREAD_CANCEL_DISABLE,NULL);
+                parallel_for(idx.size(),canonical_hash_range,&data,nt,16);
+                pthread_setcancelstate(PTHREAD_CANCEL_ENABLE,NULL);
+                for (size_t j=0;j<idx.size();++j) {
+                    h[idx[j]]=sel_h[j];
+                }
+            }
+            for (int i=0;i<cnt;++i) {
+                res[first+i]=gen((longlong)(h[i]>>1));
+            }
+        }
+        for (std::vector<int*>::iterator it=adj.begin();it!=adj.end();++it) {
+            delete[] *it;
+        }
+    }
+    return ok;
+#else
+    return false;
+#endif
+}
+
 /* construct the closure of this graph and store it to G, complexity O(n^3) */
 bool graphe::bondy_chvatal_closure(graphe &G,ivector &d) {
     underlying(G);
@@ -9976,6 +13933,7 @@ graphe::tsp::tsp(graphe *gr) {
         weight_map[a.tail][a.head]=_evalf(G->weight(*it),G->giac_context()).DOUBLE_val();
     }
     is_undir_weighted=!isdirected && isweighted;
+    heuristic=NULL;
 }
 
 /* TSP destructor */
@@ -9986,6 +13944,7 @@ graphe::tsp::~tsp() {
     delete[] arcs;
     delete[] sg_vertices;
     delete[] sg_edges;
+    delete heuristic;
 }
 
 /* create an edge or arc */
@@ -10164,9 +14123,10 @@ bool graphe::tsp::find_subgraph_subtours(ivectors &sv,solution_status &status) {
     bool retval=true;
     int iter_count=0,res,lres,stat;
     is_symmetric_tsp=is_undir_weighted && G->is_clique(sg);
-    heur_type=is_symmetric_tsp?_GT_TSP_CHRISTOFIDES_SA:
-                               (is_undir_weighted?_GT_TSP_FARTHEST_INSERTION_HEUR:
-                                                  _GT_TSP_NO_HEUR);
+    heur_type=is_undir_weighted && sg<0?_GT_TSP_LOCAL_SEARCH:
+                (is_symmetric_tsp?_GT_TSP_CHRISTOFIDES_SA:
+                                  (is_undir_weighted?_GT_TSP_FARTHEST_INSERTION_HEUR:
+                                                     _GT_TSP_NO_HEUR));
     do {
         ++iter_count;
         /* append subtour elimination constraints */
@@ -10535,7 +14495,21 @@ void graphe::tsp::heur(glp_tree *tree) {
     if (heur_type==_GT_TSP_NO_HEUR)
         return;
     int n=sg<0?nv:sg_nv,m=sg<0?ne:sg_ne,i,j,k;
-    if (heur_type==_GT_TSP_CHRISTOFIDES_SA) { // symmetric TSP
+    if (heur_type==_GT_TSP_LOCAL_SEARCH) {
+        /* run the local search once, its tour is the incumbent for every MIP solved */
+        if (heuristic==NULL) {
+            heuristic=new tsp_heuristic(G);
+            heuristic->solve(heuristic_tour);
+            for (i=0;i<n && G->has_edge(heuristic_tour[i],heuristic_tour[i+1]);++i);
+            if (i<n) // the tour is not in G
+                heuristic_tour.clear();
+        }
+        if (heuristic_tour.empty())
+            heur_type=is_symmetric_tsp?_GT_TSP_CHRISTOFIDES_SA:_GT_TSP_FARTHEST_INSERTION_HEUR;
+    }
+    if (heur_type==_GT_TSP_LOCAL_SEARCH)
+        tour=heuristic_tour;
+    else if (heur_type==_GT_TSP_CHRISTOFIDES_SA) { // symmetric TSP
         christofides(tour);
         heur_type=_GT_TSP_FARTHEST_INSERTION_RANDOM;
     } else { // weighted undirected TSP
@@ -10549,7 +14523,8 @@ void graphe::tsp::heur(glp_tree *tree) {
     }
     assert(int(tour.size())==n+1);
     /* optimize the tour */
-    lin_kernighan(tour);
+    if (heur_type!=_GT_TSP_LOCAL_SEARCH)
+        lin_kernighan(tour);
     /* construct the heuristic solution and pass it to the MIP solver */
     for (i=0;i<m;++i) coeff[i+1]=0.0;
     for (i=0;i<n;++i) {
@@ -11114,17 +15089,6 @@ void graphe::tsp::improve_tour(ivector &hc) {
     straighten(hc);
 }
 
-/* construct an approximate tour, G must be a complete graph */
-double graphe::tsp::approx(ivector &hc) {
-    assert(is_undir_weighted);
-    sg=-1;
-    christofides(hc);
-    double old_cost=tour_cost(hc),imp_cost;
-    improve_tour(hc);
-    imp_cost=tour_cost(hc);
-    return (1.5*imp_cost/old_cost);
-}
-
 /* compute the mean and the standard deviation of the given sample */
 void graphe::tsp::sample_mean_stddev(const dvector &sample,double &mean,double &stddev) {
     assert(!sample.empty());
@@ -11478,25 +15442,558 @@ void graphe::atsp::ksolve(int k,ivectors &hcv,dvector &costs) {
 
 #endif
 
-/* Try to find an optimal Hamiltonian cycle.
- * Return 0 if the graph is not Hamiltonian, else store the circuit in h
- * and return 1, if unable to solve return -1 */
-int graphe::traveling_salesman(ivector &h,double &cost,bool approximate) {
-#ifdef HAVE_LIBGLPK
-    tsp t(this);
-    if (approximate) {
-        double ratio=t.approx(h);
-        message("The tour cost is within %d%% of the optimal value",
-                std::floor((ratio-1.0)*100.0+.5));
-        cost=t.tour_cost(h);
-        return 1;
-    }
-    return t.solve(h,cost);
-#else
-    message("Error: GLPK library is required for solving traveling salesman problem");
-    return -1;
-#endif
-}
+/* local search heuristic for the symmetric TSP
+ *
+ * Distances are kept in a lower-triangular matrix for up to TSP_DENSE_LIMIT
+ * vertices or if the graph is dense enough, and looked up in sorted adjacency
+ * rows otherwise. Every vertex has
+ * a list of its nearest neighbors. Tours are improved by Lin-Kernighan chains
+ * of 2-opt moves and by Or-opt moves, processing a queue of the vertices whose
+ * don't-look bits are off, and then perturbed by local double-bridge kicks.
+ * Independent runs with separate random streams are spread across threads. */
+
+#define TSP_DENSE_LIMIT 4096
+#define TSP_LK_DEPTH 50
+#define TSP_KICK_WINDOW 50
+#define TSP_EPS 1e-9
+
+struct tsp_candidates_data {
+    const graphe::csr *A;
+    graphe::ivectors *cand;
+    int size;
+};
+
+static void tsp_candidate_lists(int first,int last,int thread,void *data) {
+    tsp_candidates_data *d=(tsp_candidates_data*)data;
+    const graphe::csr &A=*d->A;
+    vector<pair<double,int> > row;
+    for (int i=first;i<last;++i) {
+        row.clear();
+        for (int k=A.offsets[i];k<A.offsets[i+1];++k) {
+            if (A.columns[k]!=i)
+                row.push_back(make_pair(A.weight(k),A.columns[k]));
+        }
+        int sz=std::min(d->size,int(row.size()));
+        std::partial_sort(row.begin(),row.begin()+sz,row.end());
+        graphe::ivector &c=(*d->cand)[i];
+        c.resize(sz);
+        for (int k=0;k<sz;++k) {
+            c[k]=row[k].second;
+        }
+    }
+}
+
+/* prepare the distances of the undirected graph G and the candidate lists */
+graphe::tsp_heuristic::tsp_heuristic(const graphe *G,int cand_size) {
+    assert(!G->is_directed());
+    ctx=G->giac_context();
+    n=G->node_count();
+    if (!G->make_csr(adj)) {
+        /* evaluate symbolic weights numerically */
+        adj.offsets.resize(n+1);
+        adj.columns.clear();
+        adj.weights.clear();
+        adj.integral=false;
+        gen w;
+        for (int i=0;i<n;++i) {
+            adj.offsets[i]=adj.columns.size();
+            const ivector &ngh=G->node(i).neighbors();
+            for (ivector_iter it=ngh.begin();it!=ngh.end();++it) {
+                w=_evalf(G->weight(i,*it),ctx);
+                if (w.type!=_DOUBLE_ && w.type!=_INT_)
+                    continue;
+                adj.columns.push_back(*it);
+                adj.weights.push_back(w.type==_INT_?double(w.val):w.DOUBLE_val());
+            }
+        }
+        adj.offsets[n]=adj.columns.size();
+    }
+    double maxw=0;
+    for (int k=0;k<adj.arc_count();++k) {
+        maxw=std::max(maxw,std::abs(adj.weight(k)));
+    }
+    penalty=(n+1.0)*(maxw+1.0);
+    if (n<=TSP_DENSE_LIMIT || 3.0*adj.arc_count()>=double(n)*(n-1)) {
+        dense.assign((size_t(n)*(n-1))/2,penalty);
+        for (int i=0;i<n;++i) {
+            for (int k=adj.offsets[i];k<adj.offsets[i+1];++k) {
+                int j=adj.columns[k];
+                if (j<i)
+                    dense[(size_t(i)*(i-1))/2+j]=adj.weight(k);
+            }
+        }
+    }
+    cand.resize(n);
+    tsp_candidates_data data;
+    data.A=&adj;
+    data.cand=&cand;
+    data.size=cand_size;
+    parallel_for(n,tsp_candidate_lists,&data,thread_count(adj.arc_count()>>14),64);
+    if (!dense.empty()) { // the adjacency rows are no longer needed
+        ivector().swap(adj.columns);
+        dvector().swap(adj.weights);
+    }
+}
+
+/* return the distance between vertices i and j */
+double graphe::tsp_heuristic::distance(int i,int j) const {
+    if (i==j)
+        return 0;
+    if (!dense.empty())
+        return i>j?dense[(size_t(i)*(i-1))/2+j]:dense[(size_t(j)*(j-1))/2+i];
+    ivector::const_iterator first=adj.columns.begin()+adj.offsets[i],last=adj.columns.begin()+adj.offsets[i+1];
+    ivector::const_iterator it=std::lower_bound(first,last,j);
+    if (it==last || *it!=j)
+        return penalty;
+    return adj.weight(it-adj.columns.begin());
+}
+
+/* return the cost of the closed tour hc */
+double graphe::tsp_heuristic::tour_cost(const ivector &hc) const {
+    double cost=0;
+    for (ivector_iter it=hc.begin();it+1<hc.end();++it) {
+        cost+=distance(*it,*(it+1));
+    }
+    return cost;
+}
+
+/* one local search run with a tour stored as an array with a reversal flag */
+struct tsp_search {
+    const graphe::tsp_heuristic &H;
+    int n,qhead,qsize;
+    graphe::ivector tour,pos,queue,touched;
+    graphe::bvector queued;
+    graphe::ipairs journal,added;
+    bool rev,tentative;
+    double cost;
+    graphe::rng rand;
+    tsp_search(const graphe::tsp_heuristic &h,unsigned long long seed);
+    double d(int i,int j) const { return H.distance(i,j); }
+    int succ(int c) const { int p=pos[c]; return rev?tour[p==0?n-1:p-1]:tour[p==n-1?0:p+1]; }
+    int pred(int c) const { int p=pos[c]; return rev?tour[p==n-1?0:p+1]:tour[p==0?n-1:p-1]; }
+    void push(int c) { if (!queued[c]) { queued[c]=true; queue[(qhead+qsize++)%n]=c; } }
+    int pop() { int c=queue[qhead]; qhead=(qhead+1)%n; --qsize; queued[c]=false; return c; }
+    bool is_added(int a,int b) const;
+    void reverse_path(int a,int b);
+    void undo(size_t k);
+    void evaluate();
+    void construct();
+    bool lk_move(int t1);
+    bool or_move(int s1);
+    void optimize();
+    void kick();
+    void run(int kicks,double deadline);
+    void get_tour(graphe::ivector &hc) const;
+};
+
+tsp_search::tsp_search(const graphe::tsp_heuristic &h,unsigned long long seed) : H(h),rand(seed) {
+    n=H.node_count();
+    tour.resize(n);
+    pos.resize(n);
+    queue.resize(n);
+    queued.resize(n,false);
+    qhead=qsize=0;
+    rev=tentative=false;
+    cost=0;
+}
+
+bool tsp_search::is_added(int a,int b) const {
+    for (graphe::ipairs_iter it=added.begin();it!=added.end();++it) {
+        if ((it->first==a && it->second==b) || (it->first==b && it->second==a))
+            return true;
+    }
+    return false;
+}
+
+/* reverse the path from a to b, if the complementary path is shorter reverse
+ * that one and flip the orientation instead */
+void tsp_search::reverse_path(int a,int b) {
+    journal.push_back(make_pair(a,b));
+    int i=pos[a],j=pos[b],len,c;
+    if (rev)
+        std::swap(i,j);
+    len=(j-i+n)%n+1;
+    if (2*len>n) {
+        std::swap(i,j);
+        i=(i+1)%n;
+        j=(j-1+n)%n;
+        len=n-len;
+        rev=!rev;
+    }
+    for (int k=len/2;k-->0;) {
+        c=tour[i];
+        pos[tour[i]=tour[j]]=i;
+        pos[tour[j]=c]=j;
+        if (++i==n) i=0;
+        if (--j<0) j=n-1;
+    }
+}
+
+/* undo the reversals until k of them remain in the journal */
+void tsp_search::undo(size_t k) {
+    while (journal.size()>k) {
+        graphe::ipair e=journal.back();
+        journal.pop_back();
+        reverse_path(e.second,e.first);
+        journal.pop_back();
+    }
+}
+
+void tsp_search::evaluate() {
+    cost=0;
+    for (int k=0;k<n;++k) {
+        cost+=d(tour[k],tour[k+1<n?k+1:0]);
+    }
+}
+
+/* randomized nearest neighbor tour, all don't-look bits off */
+void tsp_search::construct() {
+    graphe::ivector rest(n);
+    graphe::bvector used(n,false);
+    for (int k=0;k<n;++k) rest[k]=k;
+    for (int k=n;k-->1;) std::swap(rest[k],rest[rand.integer(k+1)]);
+    int c=rest.front(),ptr=0;
+    for (int k=0;k<n;++k) {
+        tour[k]=c;
+        pos[c]=k;
+        used[c]=true;
+        const graphe::ivector &cd=H.candidates(c);
+        c=-1;
+        for (graphe::ivector_iter it=cd.begin();c<0 && it!=cd.end();++it) {
+            if (!used[*it]) c=*it;
+        }
+        if (c<0) {
+            while (ptr<n && used[rest[ptr]]) ++ptr;
+            if (ptr<n) c=rest[ptr];
+        }
+    }
+    rev=false;
+    evaluate();
+    for (graphe::ivector_iter it=rest.begin();it!=rest.end();++it) {
+        push(*it);
+    }
+}
+
+/* Lin-Kernighan move starting at t1: a chain of 2-opt moves, each replacing the
+ * edge [t1,t2] by [t2,t3] and closing the tour at t1, stopped when the gain
+ * criterion fails, the best prefix of the chain is kept */
+bool tsp_search::lk_move(int t1) {
+    size_t k0=journal.size(),kbest=k0,nbest=0;
+    int t2,t3,t4,c;
+    double g=0,gbest=TSP_EPS,go,w,v,vbest;
+    touched.clear();
+    added.clear();
+    for (int depth=0;depth<TSP_LK_DEPTH;++depth) {
+        t2=succ(t1);
+        go=g+d(t1,t2);
+        t3=-1;
+        vbest=-DBL_MAX;
+        const graphe::ivector &cd=H.candidates(t2);
+        for (graphe::ivector_iter it=cd.begin();it!=cd.end();++it) {
+            c=*it;
+            if (go-(w=d(t2,c))<=TSP_EPS)
+                break;
+            if (c==t1 || c==succ(t2) || is_added(t4=pred(c),c))
+                continue;
+            if ((v=d(t4,c)-w)>vbest) {
+                vbest=v;
+                t3=c;
+            }
+        }
+        if (t3<0)
+            break;
+        t4=pred(t3);
+        added.push_back(make_pair(t2,t3));
+        touched.push_back(t2);
+        touched.push_back(t3);
+        touched.push_back(t4);
+        reverse_path(t2,t4);
+        g=go-d(t2,t3)+d(t3,t4)-d(t4,t1);
+        if (g>gbest) {
+            gbest=g;
+            kbest=journal.size();
+            nbest=touched.size();
+        }
+    }
+    undo(kbest);
+    if (kbest==k0)
+        return false;
+    cost-=gbest;
+    push(t1);
+    for (size_t k=0;k<nbest;++k) {
+        push(touched[k]);
+    }
+    return true;
+}
+
+/* Or-opt move: move the segment of up to three vertices starting at s1 between
+ * two adjacent vertices near one of its ends, possibly reversed */
+bool tsp_search::or_move(int s1) {
+    int s2=s1,mid=s1,p,q,a,b,c,x,cc,dd,aa;
+    double g0,w,gain;
+    for (int len=1;len<=3 && len+3<=n;++len) {
+        if (len>1) {
+            s2=succ(s2);
+            if (len==3) mid=succ(s1);
+        }
+        p=pred(s1);
+        q=succ(s2);
+        if ((g0=d(p,s1)+d(s2,q)-d(p,q))<=TSP_EPS)
+            continue;
+        for (int e=0;e<2;++e) {
+            a=e==0?s1:s2;
+            b=e==0?s2:s1;
+            const graphe::ivector &cd=H.candidates(a);
+            for (graphe::ivector_iter it=cd.begin();it!=cd.end();++it) {
+                c=*it;
+                if ((w=d(a,c))>=g0)
+                    break;
+                if (c==s1 || c==s2 || c==mid)
+                    continue;
+                for (int side=0;side<2;++side) {
+                    x=side==0?succ(c):pred(c);
+                    if (x==s1 || x==s2 || x==mid)
+                        continue;
+                    if ((gain=g0+d(c,x)-w-d(b,x))<=TSP_EPS)
+                        continue;
+                    /* insert the segment between cc and dd=succ(cc), with aa next to cc */
+                    cc=side==0?c:x;
+                    dd=side==0?x:c;
+                    aa=side==0?a:b;
+                    reverse_path(s1,cc);
+                    reverse_path(cc,q);
+                    if (aa==s1)
+                        reverse_path(s2,s1);
+                    cost-=gain;
+                    push(p); push(q); push(s1); push(s2); push(cc); push(dd);
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+/* improve the tour until all don't-look bits are on */
+void tsp_search::optimize() {
+    while (qsize>0) {
+        int c=pop();
+        bool improved=false;
+        for (int dir=0;!improved && dir<2;++dir) {
+            rev=!rev;
+            improved=lk_move(c) || or_move(c);
+        }
+        if (!tentative)
+            journal.clear();
+    }
+}
+
+/* double-bridge kick on a random stretch of the tour: swap two consecutive paths */
+void tsp_search::kick() {
+    int L=std::min(TSP_KICK_WINDOW,n-2);
+    if (L<2)
+        return;
+    int a=rand.integer(n),o1=1+rand.integer(L-1),o2=o1+1+rand.integer(L-o1),b1,b2,c1,c2,e;
+    b1=succ(a);
+    b2=a;
+    for (int k=0;k<o1;++k) b2=succ(b2);
+    c1=succ(b2);
+    c2=b2;
+    for (int k=o1;k<o2;++k) c2=succ(c2);
+    e=succ(c2);
+    cost+=d(a,c1)+d(c2,b1)+d(b2,e)-d(a,b1)-d(b2,c1)-d(c2,e);
+    reverse_path(b1,c2);
+    reverse_path(c2,c1);
+    reverse_path(b2,b1);
+    push(a); push(b1); push(b2); push(c1); push(c2); push(e);
+}
+
+/* construct a tour, optimize it and then iterate kicks, keeping a kicked tour
+ * only if it is not worse after optimization */
+void tsp_search::run(int kicks,double deadline) {
+    construct();
+    optimize();
+    tentative=true;
+    double c0;
+    for (int k=0;k<kicks && (deadline<0 || gt_profiler::clock()<deadline);++k) {
+        journal.clear();
+        c0=cost;
+        kick();
+        optimize();
+        if (cost>c0+TSP_EPS) {
+            undo(0);
+            cost=c0;
+        }
+    }
+    tentative=false;
+    journal.clear();
+    evaluate();
+}
+
+void tsp_search::get_tour(graphe::ivector &hc) const {
+    hc.resize(n+1);
+    int c=tour.front();
+    for (int k=0;k<n;++k,c=succ(c)) {
+        hc[k]=c;
+    }
+    hc.back()=hc.front();
+}
+
+struct tsp_runs_data {
+    const graphe::tsp_heuristic *H;
+    unsigned long long seed;
+    int kicks;
+    double limit;
+    graphe::ivectors tours;
+    graphe::dvector costs;
+};
+
+static void tsp_runs(int first,int last,int thread,void *data) {
+    tsp_runs_data *d=(tsp_runs_data*)data;
+    for (int k=first;k<last;++k) {
+        tsp_search S(*d->H,d->seed+k);
+        S.run(d->kicks,d->limit<0?-1.0:gt_profiler::clock()+d->limit);
+        S.get_tour(d->tours[k]);
+        d->costs[k]=S.cost;
+    }
+}
+
+/* find a short tour by running the local search from several random starts,
+ * store it to hc as a closed vertex sequence and return its cost; the search
+ * stops after a fixed number of kicks or time_limit seconds if nonnegative */
+double graphe::tsp_heuristic::solve(ivector &hc,double time_limit,int starts) const {
+    hc.clear();
+    if (n<4) {
+        for (int i=0;i<n;++i) hc.push_back(i);
+        if (n>0) hc.push_back(0);
+        return tour_cost(hc);
+    }
+    tsp_runs_data data;
+    data.H=this;
+    data.seed=((unsigned long long)giac::giac_rand(ctx)<<32)^(unsigned long long)giac::giac_rand(ctx);
+    starts=std::max(starts,1);
+    data.kicks=time_limit<0?std::max(50,std::min(n,20000)/starts):RAND_MAX;
+    int nt=thread_count(starts);
+    data.limit=time_limit<0?-1.0:time_limit/((starts+nt-1)/nt);
+    data.tours.resize(starts);
+    data.costs.resize(starts);
+    parallel_for(starts,tsp_runs,&data,nt,1);
+    int best=std::min_element(data.costs.begin(),data.costs.end())-data.costs.begin();
+    hc=data.tours[best];
+    return data.costs[best];
+}
+
+/* return the Held-Karp lower bound for the tour cost obtained by subgradient
+ * optimization of 1-trees, ub is an upper bound (e.g. the cost of a tour);
+ * return DBL_MAX if there is no Hamiltonian cycle */
+double graphe::tsp_heuristic::lower_bound(double ub,int max_iter) const {
+    if (n<4)
+        return ub;
+    dvector pi(n,0.0),key(n);
+    ivector parent(n),deg(n);
+    bvector intree(n);
+    double best=-DBL_MAX,lambda=2.0,L,w,m1,m2,s,t;
+    int u,i1,i2,stall=0,j;
+    for (int iter=0;iter<max_iter && lambda>1e-6;++iter) {
+        /* minimum spanning tree on the vertices 1,..,n-1 by Prim's algorithm */
+        std::fill(key.begin(),key.end(),DBL_MAX);
+        std::fill(intree.begin(),intree.end(),false);
+        std::fill(deg.begin(),deg.end(),0);
+        key[1]=0;
+        parent[1]=-1;
+        L=0;
+        for (int k=1;k<n;++k) {
+            u=-1;
+            for (j=1;j<n;++j) {
+                if (!intree[j] && (u<0 || key[j]<key[u]))
+                    u=j;
+            }
+            if (key[u]==DBL_MAX)
+                return DBL_MAX;
+            intree[u]=true;
+            L+=key[u];
+            if (parent[u]>=0) {
+                ++deg[u];
+                ++deg[parent[u]];
+            }
+            if (dense.empty()) {
+                for (int a=adj.offsets[u];a<adj.offsets[u+1];++a) {
+                    j=adj.columns[a];
+                    if (j==0 || intree[j])
+                        continue;
+                    if ((w=adj.weight(a)+pi[u]+pi[j])<key[j]) {
+                        key[j]=w;
+                        parent[j]=u;
+                    }
+                }
+            } else for (j=1;j<n;++j) {
+                if (!intree[j] && (w=distance(u,j)+pi[u]+pi[j])<key[j]) {
+                    key[j]=w;
+                    parent[j]=u;
+                }
+            }
+        }
+        /* connect the vertex 0 by two cheapest edges */
+        m1=m2=DBL_MAX;
+        i1=i2=-1;
+        for (int a=dense.empty()?adj.offsets[0]:1;a<(dense.empty()?adj.offsets[1]:n);++a) {
+            j=dense.empty()?adj.columns[a]:a;
+            if (j==0)
+                continue;
+            w=(dense.empty()?adj.weight(a):distance(0,j))+pi[0]+pi[j];
+            if (w<m1) {
+                m2=m1; i2=i1;
+                m1=w; i1=j;
+            } else if (w<m2) {
+                m2=w; i2=j;
+            }
+        }
+        if (i2<0)
+            return DBL_MAX;
+        L+=m1+m2;
+        deg[0]=2;
+        ++deg[i1];
+        ++deg[i2];
+        for (j=0;j<n;++j) L-=2*pi[j];
+        if (L>best+TSP_EPS) {
+            best=L;
+            stall=0;
+        } else if (++stall>=5) {
+            lambda/=2;
+            stall=0;
+        }
+        s=0;
+        for (j=0;j<n;++j) s+=double(deg[j]-2)*double(deg[j]-2);
+        if (s==0 || best>=ub-TSP_EPS) // the 1-tree is a tour
+            break;
+        t=lambda*(ub-L)/s;
+        for (j=0;j<n;++j) pi[j]+=t*(deg[j]-2);
+    }
+    return std::min(best,ub);
+}
+
+/* Try to find an optimal Hamiltonian cycle.
+ * Return 0 if the graph is not Hamiltonian, else store the circuit in h
+ * and return 1, if unable to solve return -1. If approximate=true, find
+ * a near-optimal tour by local search within time_limit milliseconds
+ * (if nonnegative). */
+int graphe::traveling_salesman(ivector &h,double &cost,bool approximate,int time_limit) {
+    if (approximate) {
+        tsp_heuristic t(this);
+        cost=t.solve(h,time_limit<0?-1.0:time_limit*1e-3);
+        double lb=t.lower_bound(cost,std::max(3,std::min(100,int(2e8/(double(node_count())*node_count())))));
+        if (lb>0)
+            message("The tour cost is within %d%% of the optimal value",std::floor((cost/lb-1.0)*100.0+.5));
+        return 1;
+    }
+#ifdef HAVE_LIBGLPK
+    tsp t(this);
+    return t.solve(h,cost);
+#else
+    message("Error: GLPK library is required for solving traveling salesman problem");
+    return -1;
+#endif
+}
 
 /* find first k optimal tours in directed graph */
 bool graphe::find_directed_tours(int k,ivectors &hcv,dvector &costs,const ipairs &incl) {
@@ -11588,6 +16085,343 @@ gen graphe::maxflow_edmonds_karp(int s,int t,vector<map<int,gen> > &flow,const g
     return mf; // return the maximum flow
 }
 
+/* flow_network class implementation */
+
+/* build the residual network of A, in which each arc gets a reverse arc of zero
+ * capacity and the capacities are the weights of A (all ones if A is unweighted) */
+void graphe::flow_network::assign(const csr &A) {
+    int n=A.node_count(),m=A.arc_count(),i,j,k,a,b;
+    m_offsets.assign(n+1,0);
+    for (i=0;i<n;++i) {
+        for (k=A.offsets[i];k<A.offsets[i+1];++k) {
+            ++m_offsets[i+1];
+            ++m_offsets[A.columns[k]+1];
+        }
+    }
+    for (i=0;i<n;++i) {
+        m_offsets[i+1]+=m_offsets[i];
+    }
+    m_heads.resize(2*m);
+    m_mate.resize(2*m);
+    m_cap.assign(2*m,0.0);
+    m_arcs.resize(m);
+    ivector pos(m_offsets.begin(),m_offsets.end()-1);
+    double maxcap=0;
+    for (i=0;i<n;++i) {
+        for (k=A.offsets[i];k<A.offsets[i+1];++k) {
+            j=A.columns[k];
+            a=pos[i]++;
+            b=pos[j]++;
+            m_heads[a]=j;
+            m_heads[b]=i;
+            m_mate[a]=b;
+            m_mate[b]=a;
+            maxcap=std::max(maxcap,m_cap[a]=A.weight(k));
+            m_arcs[k]=a;
+        }
+    }
+    m_integral=A.integral;
+    m_eps=m_integral?0:1e-12*maxcap;
+    m_res=m_cap;
+    m_label.resize(n);
+    m_current.resize(n);
+    m_queue.resize(n);
+    m_next.resize(n);
+    m_prev.resize(n);
+    m_active.resize(n);
+    m_layer.resize(n);
+    m_excess.resize(n);
+    m_path.reserve(n);
+}
+
+void graphe::flow_network::layer_insert(int v) {
+    int h=m_label[v],u=m_layer[h];
+    m_next[v]=u;
+    m_prev[v]=-1;
+    if (u>=0)
+        m_prev[u]=v;
+    m_layer[h]=v;
+}
+
+void graphe::flow_network::layer_remove(int v) {
+    if (m_prev[v]>=0)
+        m_next[m_prev[v]]=m_next[v];
+    else m_layer[m_label[v]]=m_next[v];
+    if (m_next[v]>=0)
+        m_prev[m_next[v]]=m_prev[v];
+}
+
+/* set the labels to exact distances to t in the residual network and rebuild the
+ * layer and active lists, vertices which cannot reach t get label n and stay inactive */
+void graphe::flow_network::global_relabel(int s,int t) {
+    int n=node_count(),qh=0,qt=1,v,u,h;
+    std::fill(m_label.begin(),m_label.end(),n);
+    std::fill(m_layer.begin(),m_layer.end(),-1);
+    std::fill(m_active.begin(),m_active.end(),-1);
+    m_label[t]=0;
+    m_queue[0]=t;
+    while (qh<qt) {
+        v=m_queue[qh++];
+        for (int k=m_offsets[v];k<m_offsets[v+1];++k) {
+            u=m_heads[k];
+            if (u!=s && m_label[u]==n && m_res[m_mate[k]]>m_eps) {
+                m_label[u]=m_label[v]+1;
+                m_queue[qt++]=u;
+            }
+        }
+    }
+    for (u=0;u<n;++u) {
+        if (u==t || (h=m_label[u])==n)
+            continue;
+        layer_insert(u);
+        m_current[u]=m_offsets[u];
+        if (m_excess[u]>m_eps) {
+            m_queue[u]=m_active[h];
+            m_active[h]=u;
+        }
+    }
+}
+
+/* compute the value of a maximum s-t flow in the residual network by the highest-label
+ * push-relabel algorithm with global relabeling and gap heuristics (first phase only,
+ * so the result is a maximum preflow: residual capacities do not form a flow) */
+double graphe::flow_network::push_relabel(int s,int t) {
+    int n=node_count(),m=m_heads.size(),v,w,k,e,h,nh,hmax,lmax,work=0;
+    if (s==t)
+        return 0;
+    std::fill(m_excess.begin(),m_excess.end(),0.0);
+    for (k=m_offsets[s];k<m_offsets[s+1];++k) {
+        double d=m_res[k];
+        if (d>0) {
+            m_res[k]=0;
+            m_res[m_mate[k]]+=d;
+            m_excess[m_heads[k]]+=d;
+        }
+    }
+    m_excess[s]=0;
+    global_relabel(s,t);
+    hmax=lmax=0;
+    for (v=0;v<n;++v) {
+        if (m_label[v]<n)
+            lmax=std::max(lmax,m_label[v]);
+    }
+    hmax=lmax;
+    while (hmax>0) {
+        if ((v=m_active[hmax])<0) {
+            --hmax;
+            continue;
+        }
+        m_active[hmax]=m_queue[v];
+        /* discharge v */
+        h=m_label[v];
+        while (true) {
+            e=m_offsets[v+1];
+            for (k=m_current[v];k<e;++k) {
+                w=m_heads[k];
+                if (m_res[k]>m_eps && m_label[w]==h-1) {
+                    double d=std::min(m_excess[v],m_res[k]);
+                    m_res[k]-=d;
+                    m_res[m_mate[k]]+=d;
+                    if (w!=t && m_excess[w]<=m_eps) {
+                        m_queue[w]=m_active[h-1];
+                        m_active[h-1]=w;
+                        hmax=std::max(hmax,h-1);
+                    }
+                    m_excess[w]+=d;
+                    if ((m_excess[v]-=d)<=m_eps)
+                        break;
+                }
+            }
+            m_current[v]=k;
+            if (m_excess[v]<=m_eps)
+                break;
+            /* relabel */
+            nh=n;
+            for (k=m_offsets[v];k<e;++k) {
+                if (m_res[k]>m_eps && m_label[m_heads[k]]+1<nh) {
+                    nh=m_label[m_heads[k]]+1;
+                    m_current[v]=k;
+                }
+            }
+            work+=e-m_offsets[v]+12;
+            layer_remove(v);
+            if (m_layer[h]<0) {
+                /* gap: no vertex above h can reach t anymore */
+                for (int l=h+1;l<=lmax;++l) {
+                    for (w=m_layer[l];w>=0;w=m_next[w]) {
+                        m_label[w]=n;
+                    }
+                    m_layer[l]=-1;
+                }
+                lmax=h-1;
+                m_label[v]=n;
+                break;
+            }
+            if (nh>=n) {
+                m_label[v]=n;
+                break;
+            }
+            m_label[v]=h=nh;
+            layer_insert(v);
+            lmax=std::max(lmax,h);
+            if (work>6*n+m/2) {
+                global_relabel(s,t);
+                work=0;
+                lmax=-1;
+                for (w=0;w<n;++w) {
+                    if (m_label[w]<n)
+                        lmax=std::max(lmax,m_label[w]);
+                }
+                hmax=lmax;
+                break;
+            }
+        }
+    }
+    return m_excess[t];
+}
+
+/* augment the residual network along blocking flows (Dinic's algorithm) until there
+ * is no augmenting s-t path or the total flow reaches limit, return the total flow */
+double graphe::flow_network::dinic(int s,int t,double limit) {
+    int n=node_count(),qh,qt,v,w,k,e,i,j;
+    double total=0,df;
+    if (s==t)
+        return 0;
+    while (total<limit) {
+        /* compute BFS levels, vertices farther than t are not needed */
+        std::fill(m_label.begin(),m_label.end(),-1);
+        m_label[s]=0;
+        m_queue[0]=s;
+        qh=0; qt=1;
+        while (qh<qt && m_label[t]<0) {
+            v=m_queue[qh++];
+            for (k=m_offsets[v];k<m_offsets[v+1];++k) {
+                w=m_heads[k];
+                if (m_label[w]<0 && m_res[k]>m_eps) {
+                    m_label[w]=m_label[v]+1;
+                    m_queue[qt++]=w;
+                }
+            }
+        }
+        if (m_label[t]<0)
+            break;
+        std::copy(m_offsets.begin(),m_offsets.begin()+n,m_current.begin());
+        m_path.clear();
+        v=s;
+        while (true) {
+            if (v==t) {
+                /* augment along the path and retreat to the tail of its first saturated arc */
+                df=limit-total;
+                for (ivector_iter it=m_path.begin();it!=m_path.end();++it) {
+                    df=std::min(df,m_res[*it]);
+                }
+                i=-1;
+                for (j=0;j<int(m_path.size());++j) {
+                    k=m_path[j];
+                    m_res[k]-=df;
+                    m_res[m_mate[k]]+=df;
+                    if (i<0 && m_res[k]<=m_eps)
+                        i=j;
+                }
+                if ((total+=df)>=limit)
+                    break;
+                if (i<0)
+                    i=0;
+                m_path.resize(i);
+                v=i==0?s:m_heads[m_path.back()];
+                continue;
+            }
+            e=m_offsets[v+1];
+            for (k=m_current[v];k<e;++k) {
+                if (m_res[k]>m_eps && m_label[m_heads[k]]==m_label[v]+1)
+                    break;
+            }
+            m_current[v]=k;
+            if (k<e) {
+                m_path.push_back(k);
+                v=m_heads[k];
+                continue;
+            }
+            /* dead end */
+            if (v==s)
+                break;
+            m_label[v]=-1;
+            k=m_path.back();
+            m_path.pop_back();
+            v=m_heads[m_mate[k]];
+            ++m_current[v];
+        }
+    }
+    return total;
+}
+
+/* mark the vertices reachable from s in the residual network */
+void graphe::flow_network::source_side(int s,bvector &side) {
+    int n=node_count(),qh=0,qt=1,v,w;
+    side.assign(n,false);
+    side[s]=true;
+    m_queue[0]=s;
+    while (qh<qt) {
+        v=m_queue[qh++];
+        for (int k=m_offsets[v];k<m_offsets[v+1];++k) {
+            if (m_res[k]>m_eps && !side[w=m_heads[k]]) {
+                side[w]=true;
+                m_queue[qt++]=w;
+            }
+        }
+    }
+}
+
+/* build the residual network of this digraph, return false if some capacities are
+ * symbolic, infinite or negative */
+bool graphe::make_flow_network(flow_network &N) const {
+    csr A;
+    if (!make_csr(A))
+        return false;
+    int m=0;
+    for (node_iter it=nodes.begin();it!=nodes.end();++it) {
+        m+=it->degree();
+    }
+    if (A.arc_count()!=m || (A.arc_count()>0 && A.min_weight<0))
+        return false;
+    N.assign(A);
+    return true;
+}
+
+/* find the maximum flow from s to t, using native arithmetic when the capacities are
+ * numeric and the exact Edmonds-Karp algorithm otherwise; if flow is not NULL, store
+ * the flow to it in the same format as maxflow_edmonds_karp does */
+gen graphe::maxflow(int s,int t,vector<map<int,gen> > *flow) {
+    flow_network N;
+    if (!make_flow_network(N)) {
+        vector<map<int,gen> > f;
+        return maxflow_edmonds_karp(s,t,flow==NULL?f:*flow);
+    }
+    if (flow==NULL)
+        return numeric2gen(N.push_relabel(s,t),N.is_integral());
+    double mf=N.dinic(s,t);
+    int n=node_count(),i,j,k=0;
+    vector<map<int,double> > f(n);
+    double fk;
+    for (i=0;i<n;++i) {
+        const ivector &ngh=node(i).neighbors();
+        for (ivector_iter it=ngh.begin();it!=ngh.end();++it,++k) {
+            if ((fk=N.arc_flow(k))==0)
+                continue;
+            j=*it;
+            f[i][j]+=fk;
+            f[j][i]-=fk;
+        }
+    }
+    flow->assign(n,map<int,gen>());
+    for (i=0;i<n;++i) {
+        for (map<int,double>::const_iterator it=f[i].begin();it!=f[i].end();++it) {
+            (*flow)[i][it->first]=numeric2gen(it->second,N.is_integral());
+        }
+    }
+    return numeric2gen(mf,N.is_integral());
+}
+
 /* obtain a minimum cut from maximum flow */
 void graphe::minimum_cut(int s,const vector<map<int,gen> > &flow,ipairs &cut) {
     /* create the residual network */
@@ -11745,79 +16579,245 @@ void graphe::sharc_order() {
     G.isomorphic_copy(*this,order);
 }
 
-map<graphe::ivector,vector<graphe::cpol> > graphe::cache;
-
-/* implementation of cpol class */
+/* Tutte polynomial cache
+ *
+ * Polynomials of biconnected graphs met during deletion-contraction are stored
+ * in a hash table keyed by the canonical form of the graph (with nauty) or by
+ * the characteristic polynomial of the Laplacian and the adjacency structure
+ * (without nauty). The table holds at most tutte_cache_size entries; when it
+ * is full, the less frequently hit half is evicted and the hit counters of the
+ * survivors are halved. The cache is kept between calls and shared by worker
+ * threads. If the environment variable GIAC_TUTTE_CACHE holds a filename, the
+ * cache is loaded from that file on first use and saved to it after each
+ * computation that added new entries. */
+
+graphe::tutte_memo graphe::tutte_cache;
+int graphe::tutte_cache_size=65536;
+string graphe::tutte_cache_file;
+bool graphe::tutte_cache_loaded=false;
+
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t tutte_mutex=PTHREAD_MUTEX_INITIALIZER;
+#endif
 
-void graphe::cpol::assign(const cpol &other) {
-    nv=other.nv;
-#if defined HAVE_LIBNAUTY && defined HAVE_NAUTY_NAUTUTIL_H
-    cg=other.cg;
-    col=other.col;
+class tutte_lock { // locks the Tutte polynomial cache within the current scope
+public:
+#ifdef HAVE_LIBPTHREAD
+    tutte_lock() { pthread_mutex_lock(&tutte_mutex); }
+    ~tutte_lock() { pthread_mutex_unlock(&tutte_mutex); }
 #else
-    adj=other.adj;
+    tutte_lock() { }
 #endif
-    sz=other.sz;
-    frq=other.frq;
-    poly=other.poly;
+};
+
+/* tutte_memo class implementation (callers must hold the lock) */
+
+ulong graphe::tutte_memo::hash_key(int nv,const vector<ulong> &key) {
+    unsigned long long h=0x9E3779B97F4A7C15ULL^(unsigned long long)nv;
+    for (vector<ulong>::const_iterator it=key.begin();it!=key.end();++it) {
+        h^=(unsigned long long)*it+0x9E3779B97F4A7C15ULL+(h<<6)+(h>>2);
+        h*=0xBF58476D1CE4E5B9ULL;
+    }
+    h^=h>>31;
+    return (ulong)h;
 }
 
-graphe::cpol::cpol(const cpol &other) {
-    assign(other);
+void graphe::tutte_memo::rehash(int nb) {
+    m_buckets.assign(nb,-1);
+    m_next.resize(m_entries.size());
+    for (int i=0;i<int(m_entries.size());++i) {
+        int b=m_entries[i].hash&(nb-1);
+        m_next[i]=m_buckets[b];
+        m_buckets[b]=i;
+    }
 }
 
-#if defined HAVE_LIBNAUTY && defined HAVE_NAUTY_NAUTUTIL_H
-graphe::cpol::cpol(int n,ulong *g,int *c,size_t s,const intpoly &p) {
-    nv=n;
-    cg=g;
-    col=c;
-    sz=s;
-    frq=0;
-    poly=p;
+/* remove the less frequently hit half of the entries, older entries go first on ties */
+void graphe::tutte_memo::evict() {
+    int n=m_entries.size(),k=n/2;
+    ipairs order(n);
+    for (int i=0;i<n;++i) {
+        order[i]=make_pair(m_entries[i].frq,i);
+    }
+    std::nth_element(order.begin(),order.begin()+k,order.end());
+    vector<bool> keep(n,true);
+    for (int i=0;i<k;++i) {
+        keep[order[i].second]=false;
+    }
+    int j=0;
+    for (int i=0;i<n;++i) {
+        if (!keep[i])
+            continue;
+        if (i!=j)
+            std::swap(m_entries[j],m_entries[i]);
+        m_entries[j++].frq/=2;
+    }
+    m_entries.resize(j);
+    rehash(m_buckets.size());
 }
-#else
-graphe::cpol::cpol(int n,int *a,size_t s,const intpoly &p) {
-    nv=n;
-    adj=a;
-    sz=s;
-    frq=0;
-    poly=p;
+
+/* look up the polynomial of a graph with the given canonical key and its hash */
+bool graphe::tutte_memo::find(int nv,const vector<ulong> &key,ulong h,intpoly &p) {
+    if (m_buckets.empty())
+        return false;
+    for (int i=m_buckets[h&(m_buckets.size()-1)];i>=0;i=m_next[i]) {
+        cpol &cp=m_entries[i];
+        if (cp.match(nv,key,h)) {
+            ++cp.frq;
+            p=cp.poly;
+            return true;
+        }
+    }
+    return false;
 }
-#endif
 
-graphe::cpol &graphe::cpol::operator =(const cpol &other) {
-    assign(other);
-    return *this;
+void graphe::tutte_memo::insert(int nv,const vector<ulong> &key,ulong h,const intpoly &p) {
+    intpoly q;
+    if (tutte_cache_size<=0 || find(nv,key,h,q))
+        return; // another thread was faster
+    if (int(m_entries.size())>=tutte_cache_size)
+        evict();
+    m_entries.push_back(cpol());
+    cpol &cp=m_entries.back();
+    cp.nv=nv;
+    cp.key=key;
+    cp.hash=h;
+    cp.poly=p;
+    m_dirty=true;
+    int nb=std::max(int(m_buckets.size()),16);
+    while (nb<2*int(m_entries.size())) nb*=2;
+    if (nb!=int(m_buckets.size()))
+        rehash(nb);
+    else {
+        int b=h&(nb-1);
+        m_next.push_back(m_buckets[b]);
+        m_buckets[b]=m_entries.size()-1;
+    }
+}
+
+void graphe::tutte_memo::clear() {
+    m_entries.clear();
+    m_buckets.clear();
+    m_next.clear();
+    m_dirty=false;
+}
+
+void graphe::tutte_memo::swap(tutte_memo &other) {
+    m_entries.swap(other.m_entries);
+    m_buckets.swap(other.m_buckets);
+    m_next.swap(other.m_next);
+    std::swap(m_dirty,other.m_dirty);
+}
+
+/* the shared cache and its file are set aside until the destructor restores them */
+graphe::private_tutte_cache::private_tutte_cache() {
+    tutte_lock lock;
+    tutte_cache.swap(m_saved);
+    m_file=tutte_cache_file;
+    m_loaded=tutte_cache_loaded;
+    tutte_cache_file.clear();
+    tutte_cache_loaded=true;
+}
+
+graphe::private_tutte_cache::~private_tutte_cache() {
+    tutte_lock lock;
+    tutte_cache.swap(m_saved);
+    tutte_cache_file=m_file;
+    tutte_cache_loaded=m_loaded;
 }
 
+/* Cache file format, in native byte order: the header below followed by the entries,
+ * each of them consisting of three 32-bit integers nv, key size and number of terms,
+ * a 32-bit zero, the key words and the terms as triples of 32-bit integers (powers of
+ * x and y, coefficient). Files written with or without nauty are incompatible. */
+static const char tutte_magic[8]={'G','I','A','C','T','U','T','T'};
+
+struct tutte_header {
+    char magic[8];
+    unsigned int version;
+    unsigned int flags;     // 1 if keys are nauty canonical forms, word size in bits 8..15
+    longlong count;
+};
+
+static unsigned int tutte_flags() {
 #if defined HAVE_LIBNAUTY && defined HAVE_NAUTY_NAUTUTIL_H
-bool graphe::cpol::match(int n,ulong *g,int *c) const {
-    if (nv!=n)
+    return 1 | (sizeof(ulong)<<8);
+#else
+    return sizeof(ulong)<<8;
+#endif
+}
+
+/* merge the entries stored in the file into the cache */
+bool graphe::tutte_memo::load(const string &filename) {
+    mapped_file file;
+    if (!file.open(filename) || file.size()<sizeof(tutte_header))
         return false;
-    for (int i=0;i<n;++i) {
-        if (c[i]!=col[i])
+    tutte_header h;
+    memcpy(&h,file.data(),sizeof(h));
+    if (memcmp(h.magic,tutte_magic,8)!=0 || h.version!=1 || h.flags!=tutte_flags() || h.count<0)
+        return false;
+    size_t pos=sizeof(h);
+    int rec[4];
+    vector<ulong> key;
+    intpoly p;
+    bool dirty=m_dirty;
+    for (longlong c=0;c<h.count;++c) {
+        if (file.size()-pos<sizeof(rec))
             return false;
-    }
-    size_t cnt=0;
-    for (;cnt<sz;++cnt) {
-        if (g[cnt]!=cg[cnt])
+        memcpy(rec,file.data()+pos,sizeof(rec));
+        pos+=sizeof(rec);
+        if (rec[0]<0 || rec[1]<0 || rec[2]<0 ||
+                (file.size()-pos)/sizeof(ulong)<size_t(rec[1]) ||
+                (file.size()-pos-rec[1]*sizeof(ulong))/(3*sizeof(int))<size_t(rec[2]))
             return false;
-    }
+        key.resize(rec[1]);
+        if (rec[1]>0)
+            memcpy(&key.front(),file.data()+pos,rec[1]*sizeof(ulong));
+        pos+=rec[1]*sizeof(ulong);
+        p.clear();
+        for (int i=0;i<rec[2];++i) {
+            int t[3];
+            memcpy(t,file.data()+pos,sizeof(t));
+            pos+=sizeof(t);
+            p[make_pair(t[0],t[1])]=t[2];
+        }
+        insert(rec[0],key,hash_key(rec[0],key),p);
+    }
+    m_dirty=dirty;
     return true;
 }
-#else
-bool graphe::cpol::match(int n,int *a,int adj_sz) const {
-    if (nv!=n || sz!=adj_sz)
+
+/* write the cache to file (through a temporary file, so that readers never see a partial cache) */
+bool graphe::tutte_memo::save(const string &filename) {
+    if (!m_dirty)
+        return true;
+    string tmp=filename+".tmp";
+    buffered_writer out;
+    if (!out.open(tmp))
         return false;
-    for (int i=0;i<sz;++i) {
-        if (adj[i]!=a[i])
-            return false;
-    }
+    tutte_header h;
+    memcpy(h.magic,tutte_magic,8);
+    h.version=1;
+    h.flags=tutte_flags();
+    h.count=m_entries.size();
+    out.write((const char*)&h,sizeof(h));
+    for (vector<cpol>::const_iterator it=m_entries.begin();it!=m_entries.end();++it) {
+        int rec[4]={it->nv,int(it->key.size()),int(it->poly.size()),0};
+        out.write((const char*)rec,sizeof(rec));
+        if (!it->key.empty())
+            out.write((const char*)&it->key.front(),it->key.size()*sizeof(ulong));
+        for (intpoly_iter jt=it->poly.begin();jt!=it->poly.end();++jt) {
+            int t[3]={jt->first.first,jt->first.second,jt->second};
+            out.write((const char*)t,sizeof(t));
+        }
+    }
+    if (!out.close() || rename(tmp.c_str(),filename.c_str())!=0)
+        return false;
+    m_dirty=false;
     return true;
 }
-#endif
 
-/* end of cpol class implementation */
+/* end of tutte_memo class implementation */
 
 /* add the polynomial b to a (a is changed in place) */
 void graphe::poly_add(intpoly &a,const intpoly &b) {
@@ -11871,14 +16871,37 @@ gen graphe::intpoly2gen(const intpoly &v,const gen &x,const gen &y) {
     return p;
 }
 
-static int tutte_iter_count;
-static int tutte_hits;
-static clock_t tutte_time_start;
-static double tutte_matching_time;
+/* remove all graph attributes except the directed and weighted flags, whose values are
+ * immediate, so that copies of this graph can be made in worker threads */
+void graphe::strip_graph_attributes() {
+    bool isdir=is_directed(),isweighted=is_weighted();
+    attributes.clear();
+    set_directed(isdir);
+    set_weighted(isweighted);
+}
+
+#if defined HAVE_LIBPTHREAD && defined HAVE_LIBNAUTY && defined HAVE_NAUTY_NAUTUTIL_H
+#define GT_TUTTE_PARALLEL 1
+#endif
+
+#ifdef GT_TUTTE_PARALLEL
+static int tutte_workers=0; // number of running worker threads, guarded by tutte_mutex
+
+struct tutte_task {
+    graphe *G;
+    graphe::intpoly poly;
+};
+
+static void *tutte_worker(void *arg) {
+    tutte_task *task=(tutte_task*)arg;
+    task->poly=task->G->tutte_poly_recurse(1);
+    return NULL;
+}
+#endif
 
 /* compute the Tutte polynomial for this graph, using vorder-push heuristic */
 graphe::intpoly graphe::tutte_poly_recurse(int vc) {
-    ++tutte_iter_count;
+    GT_COUNT("tutte_iterations",1);
     intpoly p=poly_one(),fac;
     int n=node_count(),adj_sz,snv;
     bool isom;
@@ -11886,12 +16909,16 @@ graphe::intpoly graphe::tutte_poly_recurse(int vc) {
     vector<ipairs> blocks;
     ipairs E;
     graphe G(ctx,false),Gd(ctx,false),Gc(ctx,false);
-    matrice L;
-    ivector L_cp;
-    map<ivector,vector<cpol> >::iterator ct;
-    int *adj,*col;
-    ulong *cg;
+    vector<ulong> key;
+    ulong h;
+    int *adj;
+#if defined HAVE_LIBNAUTY && defined HAVE_NAUTY_NAUTUTIL_H
+    ivector col;
     size_t cg_sz;
+#else
+    matrice L;
+    ivector L_cp;
+#endif
     switch (vc) {
     case 2:
         assert(n>2);
@@ -11914,50 +16941,43 @@ graphe::intpoly graphe::tutte_poly_recurse(int vc) {
             }
             break;
         }
-        /* check for cached isomorphic graph, record the time */
-        isom=false;
-        tutte_time_start=clock();
-        simplify(G,true);
-        G.laplacian_matrix(L);
-        L_cp=vecteur_2_vector_int(*_eval(symbolic(at_charpoly,L),ctx)._VECTptr); // charpoly of the Laplacian
-        adj=G.to_array(adj_sz,true);
-        snv=G.node_count();
-#if defined HAVE_LIBNAUTY && defined HAVE_NAUTY_NAUTUTIL_H
-        cg_sz=nautywrapper_words_needed(snv)*(size_t)snv;
-        cg=new ulong[cg_sz];
-        col=new int[snv];
-        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE,NULL);
-        nautywrapper_canonical(0,snv,adj,NULL,cg,col);
-        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE,NULL);
-        delete[] adj;
-#endif
-        if ((ct=cache.find(L_cp))!=cache.end()) {
-            for (vector<cpol>::iterator it=ct->second.begin();it!=ct->second.end();++it) {
-                cpol &cp=*it;
+        /* check for cached isomorphic graph */
+        {
+            GT_PROFILE(matching,"tutte_matching");
+            simplify(G,true);
+            adj=G.to_array(adj_sz,true);
+            snv=G.node_count();
 #if defined HAVE_LIBNAUTY && defined HAVE_NAUTY_NAUTUTIL_H
-                if (cp.match(snv,cg,col)) {
-                    ++cp.frq;
-                    ++tutte_hits;
-                    delete[] cg;
-                    delete[] col;
-                    p=cp.poly;
-                    isom=true;
-                    break;
-                }
+            cg_sz=nautywrapper_words_needed(snv)*(size_t)snv;
+            key.resize(cg_sz+snv);
+            col.resize(snv);
+            {
+                tutte_lock lock; // nauty is not reentrant
+                pthread_setcancelstate(PTHREAD_CANCEL_DISABLE,NULL);
+                nautywrapper_canonical(0,snv,adj,NULL,&key.front(),&col.front());
+                pthread_setcancelstate(PTHREAD_CANCEL_ENABLE,NULL);
+            }
+            for (int i=0;i<snv;++i) {
+                key[cg_sz+i]=col[i];
+            }
 #else
-                if (cp.match(snv,adj,adj_sz)) {
-                    ++cp.frq;
-                    ++tutte_hits;
-                    delete[] adj;
-                    p=cp.poly;
-                    isom=true;
-                    break;
-                }
+            G.laplacian_matrix(L);
+            L_cp=vecteur_2_vector_int(*_eval(symbolic(at_charpoly,L),ctx)._VECTptr); // charpoly of the Laplacian
+            key.assign(L_cp.begin(),L_cp.end());
+            key.insert(key.end(),adj,adj+adj_sz);
 #endif
+            delete[] adj;
+            h=tutte_memo::hash_key(snv,key);
+            {
+                tutte_lock lock;
+                isom=tutte_cache.find(snv,key,h,p);
             }
         }
-        tutte_matching_time+=double(clock()-tutte_time_start)/CLOCKS_PER_SEC;
-        if (isom) break;
+        if (isom) {
+            GT_COUNT("tutte_cache_hits",1);
+            break;
+        }
+        GT_COUNT("tutte_cache_misses",1);
         /* no luck, perform the delete-contract step */
         get_edges_as_pairs(E);
         e=E.front();
@@ -11969,15 +16989,40 @@ graphe::intpoly graphe::tutte_poly_recurse(int vc) {
         copy(Gd); copy(Gc); // copies to perform deletion-contraction on
         Gd.remove_edge(e);
         Gc.contract_edge(e.second,e.first,false);
+#ifdef GT_TUTTE_PARALLEL
+        {
+            /* compute the deletion in a worker thread if one is available and the graph is not too small */
+            tutte_task task;
+            pthread_t worker;
+            bool spawned=false;
+            if (E.size()>=32) {
+                tutte_lock lock;
+                if (tutte_workers+1<threads) {
+                    task.G=&Gd;
+                    if ((spawned=pthread_create(&worker,NULL,tutte_worker,&task)==0))
+                        ++tutte_workers;
+                }
+            }
+            poly_mult(fac,Gc.tutte_poly_recurse(1));
+            if (spawned) {
+                pthread_join(worker,NULL);
+                {
+                    tutte_lock lock;
+                    --tutte_workers;
+                }
+                p=task.poly;
+            } else p=Gd.tutte_poly_recurse(1);
+        }
+#else
         p=Gd.tutte_poly_recurse(1);
         poly_mult(fac,Gc.tutte_poly_recurse(1));
+#endif
         poly_add(p,fac);
         /* cache the graph and its polynomial for future use */
-#if defined HAVE_LIBNAUTY && defined HAVE_NAUTY_NAUTUTIL_H
-        cache[L_cp].push_back(cpol(snv,cg,col,cg_sz,p));
-#else
-        cache[L_cp].push_back(cpol(snv,adj,adj_sz,p));
-#endif
+        {
+            tutte_lock lock;
+            tutte_cache.insert(snv,key,h,p);
+        }
         break;
     case 1:
         find_blocks(blocks);
@@ -12001,13 +17046,24 @@ graphe::intpoly graphe::tutte_poly_recurse(int vc) {
 
 /* return the Tutte polynomial of this graph */
 gen graphe::tutte_polynomial(const gen &x,const gen &y) {
-    assert(cache.empty() && !is_directed());
-    tutte_iter_count=tutte_hits=0;
-    tutte_matching_time=0;
+    assert(!is_directed());
+    GT_PROFILE(profile,"tutte_polynomial");
+    {
+        tutte_lock lock;
+        if (!tutte_cache_loaded) {
+            const char *fn=getenv("GIAC_TUTTE_CACHE");
+            if (fn!=NULL && *fn!='\0') {
+                tutte_cache_file=fn;
+                tutte_cache.load(tutte_cache_file);
+            }
+            tutte_cache_loaded=true;
+        }
+    }
     intpoly p;
     graphe G(ctx,false);
     if (is_connected()) {
         copy(G);
+        G.strip_graph_attributes();
         G.sort_by_degrees();
         G.sharc_order();
         p=G.tutte_poly_recurse(1);
@@ -12020,29 +17076,33 @@ gen graphe::tutte_polynomial(const gen &x,const gen &y) {
                 continue;
             sort(it->begin(),it->end());
             induce_subgraph(*it,G);
+            G.strip_graph_attributes();
             G.sort_by_degrees();
             G.sharc_order();
             poly_mult(p,G.tutte_poly_recurse(1));
         }
     }
-    /* clear the cache and return the Tutte polynomial p */
-    for (map<ivector,vector<cpol> >::iterator it=cache.begin();it!=cache.end();++it) {
-        for (vector<cpol>::const_iterator jt=it->second.begin();jt!=it->second.end();++jt) {
-#if defined HAVE_LIBNAUTY && defined HAVE_NAUTY_NAUTUTIL_H
-            delete[] jt->cg;
-            delete[] jt->col;
-#else
-            delete[] jt->adj;
-#endif
-        }
-        it->second.clear();
+    if (!tutte_cache_file.empty()) {
+        tutte_lock lock;
+        tutte_cache.save(tutte_cache_file);
     }
-    cache.clear();
     return intpoly2gen(p,x,y);
 }
 
+/* sink which appends the enumerated vertex sequences to an ivectors container */
+static bool collect_ivector(const graphe::ivector &v,void *data) {
+    ((graphe::ivectors*)data)->push_back(v);
+    return true;
+}
+
 /* find all fundamental cycles in this graph */
 void graphe::fundamental_cycles(ivectors &cycles,int sg,bool check) {
+    fundamental_cycles(collect_ivector,&cycles,sg,check);
+}
+
+/* pass the fundamental cycles of the graph (or its subgraph sg) to output one by one,
+ * return false if output stopped the enumeration */
+bool graphe::fundamental_cycles(ivector_sink output,void *data,int sg,bool check) {
     assert(!is_directed());
     ivectors comp;
     if (check) {
@@ -12051,9 +17111,10 @@ void graphe::fundamental_cycles(ivectors &cycles,int sg,bool check) {
             int nsg=max_subgraph_index();
             for (ivectors_iter it=comp.begin();it!=comp.end();++it) {
                 set_subgraph(*it,++nsg);
-                fundamental_cycles(cycles,nsg,false);
+                if (!fundamental_cycles(output,data,nsg,false))
+                    return false;
             }
-            return;
+            return true;
         }
     }
     ipairs E,nte;
@@ -12065,19 +17126,22 @@ void graphe::fundamental_cycles(ivectors &cycles,int sg,bool check) {
         if (node(i).ancestor()!=j && node(j).ancestor()!=i)
             nte.push_back(*it);
     }
+    ivector c;
     for (ipairs_iter it=nte.begin();it!=nte.end();++it) {
         const vertex &v=node(it->first),&w=node(it->second);
         i=v.disc()>w.disc()?it->first:it->second;
         j=v.disc()<w.disc()?it->first:it->second;
-        ivector c;
+        c.clear();
         while (i!=j) {
             c.push_back(i);
             i=node(i).ancestor();
             assert(i>=0);
         }
         c.push_back(j);
-        cycles.push_back(c);
+        if (!output(c,data))
+            return false;
     }
+    return true;
 }
 
 /* construct Mycielski graph with 2n+1 vertices and 3m+n edges */
@@ -12115,34 +17179,103 @@ gen graphe::local_clustering_coeff(int i) const {
     return _ratnormal(fraction(cnt,d*(d-1)),ctx);
 }
 
+#define WEDGE_SAMPLE_BLOCK 1024
+struct wedge_data {
+    const graphe::csr *A;
+    const std::vector<longlong> *cum;   // prefix sums of wedge counts, NULL for uniform vertices
+    unsigned long long seed;
+    int samples;
+    graphe::ivector closed;             // closed wedges found by each thread
+};
+
+/* sample the wedges in blocks first,..,last-1 and count the closed ones; every block
+ * has its own random stream, so that the result does not depend on the number of threads */
+static void wedge_samples(int first,int last,int thread,void *data) {
+    wedge_data *d=(wedge_data*)data;
+    const graphe::csr &A=*d->A;
+    int n=A.node_count(),v,deg,i,j,u,w,c=0;
+    for (int b=first;b<last;++b) {
+        graphe::rng rand(d->seed+b);
+        int lo=b*WEDGE_SAMPLE_BLOCK,hi=std::min(lo+WEDGE_SAMPLE_BLOCK,d->samples);
+        for (int k=lo;k<hi;++k) {
+            if (d->cum==NULL)
+                v=rand.integer(n);
+            else {
+                /* a vertex with probability proportional to the number of wedges centered at it */
+                longlong x=rand.next()%(unsigned long long)d->cum->back();
+                v=std::upper_bound(d->cum->begin(),d->cum->end(),x)-d->cum->begin();
+            }
+            if ((deg=A.offsets[v+1]-A.offsets[v])<2)
+                continue;
+            i=rand.integer(deg);
+            j=rand.integer(deg-1);
+            if (j>=i) ++j;
+            u=A.columns[A.offsets[v]+i];
+            w=A.columns[A.offsets[v]+j];
+            if (std::binary_search(A.columns.begin()+A.offsets[u],A.columns.begin()+A.offsets[u+1],w))
+                ++c;
+        }
+    }
+    d->closed[thread]+=c;
+}
+
+/* return the fraction of closed wedges among k random wedges of this undirected graph, if
+ * by_wedges is false then a random vertex is chosen first, which estimates the average
+ * clustering coefficient, otherwise the wedges are uniform, which estimates transitivity */
+double graphe::wedge_sampling(bool by_wedges,int k) const {
+    const csr &A=adjacency();
+    int n=node_count();
+    std::vector<longlong> cum;
+    if (by_wedges) {
+        cum.resize(n);
+        longlong sum=0,d;
+        for (int i=0;i<n;++i) {
+            d=A.offsets[i+1]-A.offsets[i];
+            cum[i]=(sum+=d*(d-1)/2);
+        }
+        if (sum==0)
+            return 0;
+    }
+    wedge_data data;
+    data.A=&A;
+    data.cum=by_wedges?&cum:NULL;
+    data.seed=((unsigned long long)giac::giac_rand(ctx)<<32)^(unsigned long long)giac::giac_rand(ctx);
+    data.samples=k;
+    int nb=(k+WEDGE_SAMPLE_BLOCK-1)/WEDGE_SAMPLE_BLOCK,nt=thread_count(k/4096+1),l=0;
+    data.closed.assign(nt,0);
+    parallel_for(nb,wedge_samples,&data,nt,1);
+    for (ivector_iter it=data.closed.begin();it!=data.closed.end();++it) {
+        l+=*it;
+    }
+    return double(l)/double(k);
+}
+
 /* return the clustering coefficient of this graph */
 gen graphe::clustering_coeff(bool approx,bool exact) {
     assert(!is_directed());
-    int i,j,n=node_count();
+    int n=node_count();
     if (n<3) return 0;
     if (approx) {
         /* approximate within +-1/2*1e-2 with probability 0.9999 */
-        int k=184207,l=0,u,v;
-        for (i=0;i<k;++i) {
-            j=rand_integer(n);
-            const ivector &ngh=node(j).neighbors();
-            u=ngh[rand_integer(ngh.size())];
-            while (u==(v=ngh[rand_integer(ngh.size())]));
-            if (has_edge(u,v)) ++l;
-        }
-        return _evalf(fraction(l,k),ctx);
+        return wedge_sampling(false,184207);
     }
     return triangle_count(NULL,true,exact);
 }
 
-/* return the triangle density (transitivity) of this graph */
-gen graphe::transitivity() {
+/* return the triangle density (transitivity) of this graph, if approx is true
+ * estimate it within +-1/2*1e-2 with probability 0.9999 by sampling wedges */
+gen graphe::transitivity(bool approx) {
     gen num_triangles(0),num_triplets(0);
     if (!is_directed()) {
-        num_triangles=gen(3)*triangle_count();
+        if (approx)
+            return wedge_sampling(true,184207);
+        longlong wedges=0,d;
         for (node_iter it=nodes.begin();it!=nodes.end();++it) {
-            num_triplets+=comb(it->neighbors().size(),2);
+            d=it->degree();
+            wedges+=d*(d-1)/2;
         }
+        num_triangles=gen(3)*triangle_count();
+        num_triplets=gen(wedges);
     } else {
         ipairs E;
         get_edges_as_pairs(E);
@@ -12165,7 +17298,6 @@ int graphe::edge_connectivity() {
     int n=node_count();
     assert(n>=2 && !is_directed());
     set<int> D,A;
-    vector<map<int,gen> > flow;
     int p,lambda=rand_max2,d,v,w,lambda_vw,maxdeg,i;
     /* set lambda to its upper bound */
     for (i=0;i<n;++i) {
@@ -12196,43 +17328,49 @@ int graphe::edge_connectivity() {
         if (A.empty()) break;
         v=*A.begin();
     }
-    /* find lambda(G) */
+    /* find lambda(G), the flows need not exceed the current bound */
     v=*D.begin();
     D.erase(D.begin());
-    set_directed(true);
-    for (set<int>::const_iterator it=D.begin();it!=D.end();++it) {
+    flow_network N;
+    N.assign(adjacency());
+    for (set<int>::const_iterator it=D.begin();it!=D.end() && lambda>0;++it) {
         w=*it;
-        lambda_vw=maxflow_edmonds_karp(v,w,flow).val;
+        N.reset();
+        lambda_vw=int(N.dinic(v,w,lambda));
         if (lambda_vw<lambda)
             lambda=lambda_vw;
     }
-    set_directed(false);
     return lambda;
 }
 
-int graphe::vertex_pair_connectivity(int v,int w) {
-    int n=node_count();
-    graphe D(ctx,false);
-    D.set_directed(true);
-    D.add_nodes(2*n);
-    int u1,u2;
-    for (int i=0;i<n;++i) {
-        u1=2*i; u2=2*i+1;
-        if (i!=v || i!=w)
-            D.add_edge(u1,u2);
-        const vertex &u=node(i);
-        for (ivector_iter it=u.neighbors().begin();it!=u.neighbors().end();++it) {
-            if (i!=v) D.add_edge(*it,u1);
-            if (i!=w) D.add_edge(u2,*it);
-        }
-    }
-    vector<map<int,gen> > flow;
-    return D.maxflow_edmonds_karp(2*v+1,2*w,flow).val;
+/* return the maximum number of internally disjoint v-w paths in the split network N,
+ * stop counting at limit */
+static int vertex_pair_connectivity(graphe::flow_network &N,int v,int w,int limit) {
+    N.reset();
+    return int(N.dinic(2*v+1,2*w,limit));
 }
 
 /* return the vertex connectivity of an undirected graph */
 int graphe::vertex_connectivity() {
     int n=node_count(),k=rand_max2,mindeg=rand_max2,deg,v;
+    /* split each vertex i into 2i and 2i+1, joined by an arc of unit capacity, and replace
+     * each edge ij by arcs from 2i+1 to 2j and from 2j+1 to 2i; the residual network of
+     * the result is shared by all vertex pairs */
+    const csr &A=adjacency();
+    csr S;
+    S.offsets.resize(2*n+1);
+    S.columns.reserve(2*n+A.arc_count());
+    for (int i=0;i<n;++i) {
+        S.offsets[2*i]=S.columns.size();
+        S.columns.push_back(2*i+1);
+        S.offsets[2*i+1]=S.columns.size();
+        for (int j=A.offsets[i];j<A.offsets[i+1];++j) {
+            S.columns.push_back(2*A.columns[j]);
+        }
+    }
+    S.offsets[2*n]=S.columns.size();
+    flow_network N;
+    N.assign(S);
     for (int i=0;i<n;++i) {
         if ((deg=degree(i))<mindeg) {
             v=i;
@@ -12242,14 +17380,14 @@ int graphe::vertex_connectivity() {
     for (int i=0;i<n;++i) {
         if (i==v || has_edge(i,v))
             continue;
-        k=std::min(k,vertex_pair_connectivity(v,i));
+        k=std::min(k,vertex_pair_connectivity(N,v,i,k));
     }
     ivector adj;
     adjacent_nodes(v,adj);
     for (ivector_iter it=adj.begin();it!=adj.end();++it) {
         for (ivector_iter jt=it+1;jt!=adj.end();++jt) {
             if (has_edge(*it,*jt)) continue;
-            k=std::min(k,vertex_pair_connectivity(*it,*jt));
+            k=std::min(k,vertex_pair_connectivity(N,*it,*jt,k));
         }
     }
     return k;
@@ -12307,6 +17445,9 @@ void graphe::truncate(graphe &dest,const ivectors &faces) {
 graphe::circ_enum::circ_enum(graphe *gr,int lo,int hi) {
     G=gr;
     lb=lo; ub=hi;
+    sink=NULL;
+    sink_data=NULL;
+    stopped=false;
     int n=G->node_count();
     A.resize(n);
     for (int i=0;i<n;++i) {
@@ -12324,13 +17465,13 @@ void graphe::circ_enum::backtrack(int v,bool &f) {
     mark[v]=true;
     marked_stack.push(v);
     int w,u,len;
-    for (int i=A[v].size();i-->0;) {
+    for (int i=A[v].size();!stopped && i-->0;) {
         w=A[v][i];
         if (w<s) A[v].erase(A[v].begin()+i);
         else if (w==s) {
             len=point_stack.size();
-            if ((lb<0 || len>=lb) && (ub<0 || len<=ub))
-                res.push_back(point_stack);
+            if ((lb<0 || len>=lb) && (ub<0 || len<=ub) && !sink(point_stack,sink_data))
+                stopped=true;
             f=true;
         } else if (!mark[w]) {
             backtrack(w,g);
@@ -12351,12 +17492,16 @@ void graphe::circ_enum::backtrack(int v,bool &f) {
     point_stack.pop_back();
 }
 
-/* return the list of all elementary cycles in the given digraph */
-graphe::ivectors graphe::circ_enum::find_cycles() {
+/* pass the elementary cycles in the given digraph to output one by one,
+ * until output returns false */
+void graphe::circ_enum::find_cycles(ivector_sink output,void *data) {
     int n=G->node_count(),u;
     bool flag;
+    sink=output;
+    sink_data=data;
+    stopped=false;
     mark.resize(n,false);
-    for (s=0;s<n;++s) {
+    for (s=0;s<n && !stopped;++s) {
         backtrack(s,flag);
         while (!marked_stack.empty()) {
             u=marked_stack.top();
@@ -12364,7 +17509,6 @@ graphe::ivectors graphe::circ_enum::find_cycles() {
             marked_stack.pop();
         }
     }
-    return res;
 }
 
 /*
@@ -12372,15 +17516,32 @@ graphe::ivectors graphe::circ_enum::find_cycles() {
  */
 
 void graphe::elementary_cycles(ivectors &cyc,int lo,int hi) {
+    cyc.clear();
+    elementary_cycles(collect_ivector,&cyc,lo,hi);
+}
+
+/* pass the elementary cycles of length between lo and hi (no bound if negative)
+ * to output one by one, the enumeration stops when output returns false */
+void graphe::elementary_cycles(ivector_sink output,void *data,int lo,int hi) {
     assert(is_directed());
     circ_enum ce(this,lo,hi);
-    cyc=ce.find_cycles();
+    ce.find_cycles(output,data);
 }
 
 /*
  * YEN CLASS IMPLEMENTATION
  */
 
+/* return the weight of the arc i->j in A */
+static double csr_arc_weight(const graphe::csr &A,int i,int j) {
+    for (int k=A.offsets[i];k<A.offsets[i+1];++k) {
+        if (A.columns[k]==j)
+            return A.weight(k);
+    }
+    assert(false);
+    return 0;
+}
+
 void graphe::yen::delete_children(tree_node *r) {
     for (vector<tree_node*>::const_iterator it=r->children.begin();it!=r->children.end();++it) {
         delete_children(*it);
@@ -12430,14 +17591,18 @@ graphe::yen::tree_node *graphe::yen::store_path(const ivector &path,tree_node *r
     return t;
 }
 
-void graphe::yen::select_path(tree_node *p) {
-    kspaths.push_back(p);
+/* mark the path ending in p as selected and pass it to the output,
+ * return false if the enumeration should stop */
+bool graphe::yen::select_path(tree_node *p) {
     tree_node *t=p;
     while (t!=NULL) {
         if (t->selected) break;
         t->selected=true;
         t=t->parent;
     }
+    ivector path;
+    restore_path(p,path);
+    return sink(path,sink_data) && (K<=0 || ++count<K);
 }
 
 void graphe::yen::restore_path(tree_node *p,ivector &path) {
@@ -12450,7 +17615,18 @@ void graphe::yen::restore_path(tree_node *p,ivector &path) {
     std::reverse(path.begin(),path.end());
 }
 
-void graphe::yen::find_kspaths(ivectors &paths) {
+void graphe::yen::find_kspaths(ivector_sink output,void *data) {
+    sink=output;
+    sink_data=data;
+    count=0;
+    csr A;
+    if (G->make_csr(A) && A.min_weight>=0)
+        find_numeric(A);
+    else find_symbolic();
+}
+
+/* Yen's algorithm with exact arithmetic, for arbitrary weights */
+void graphe::yen::find_symbolic() {
     assert(G->supports_attributes());
     ivectors cp;
     vecteur pw;
@@ -12460,12 +17636,10 @@ void graphe::yen::find_kspaths(ivectors &paths) {
         G->make_weighted(W);
     }
     G->weight_matrix(W);
-    paths.clear();
     G->dijkstra(src,ivector(1,dest),pw,&cp);
     if (cp.front().empty()) return;
-    kspaths.clear();
     tree_node *p=store_path(cp.front(),add_tree_node(NULL)),*t,*next;
-    select_path(p);
+    if (!select_path(p)) return;
     stack<ipair> removed_edges;
     gen wg;
     int i,j,spur_node,tail,head;
@@ -12475,7 +17649,7 @@ void graphe::yen::find_kspaths(ivectors &paths) {
     path.reserve(G->node_count());
     G->save_subgraphs();
     G->unset_subgraphs(1);
-    for (int k=1;k<K;++k) {
+    while (true) {
         restore_path(p,path);
         t=root;
         for (i=0;i+1<(int)path.size();++i) {
@@ -12508,13 +17682,132 @@ void graphe::yen::find_kspaths(ivectors &paths) {
         if (candidates.empty()) break;
         cit=candidates.begin();
         p=cit->second;
-        select_path(p);
         candidates.erase(cit);
+        if (!select_path(p)) break;
     }
     G->restore_subgraphs();
-    for (vector<tree_node*>::const_iterator it=kspaths.begin();it!=kspaths.end();++it) {
-        restore_path(*it,path);
-        paths.push_back(path);
+}
+
+/* find the spur paths for the spur vertices path[first],..,path[last-1], avoiding
+ * the root path vertices and the arcs used by the selected paths with the same root */
+void graphe::yen::spur_paths(int first,int last,int thread,void *data) {
+    spur_data *d=(spur_data*)data;
+    const csr &A=*d->A;
+    const ivector &path=*d->path;
+    spur_workspace &w=d->ws->at(thread);
+    std::greater<std::pair<double,int> > cmp;
+    int i,j,k,u,v,s;
+    double du,alt;
+    for (i=first;i<last;++i) {
+        ++w.stamp;
+        for (j=0;j<i;++j) {
+            w.blocked[path[j]]=w.stamp;
+        }
+        const ivector &banned=d->banned->at(i);
+        ivector &spur=d->spurs->at(i);
+        spur.clear();
+        s=path[i];
+        w.seen[s]=w.stamp;
+        w.dist[s]=0;
+        w.pred[s]=-1;
+        w.heap.assign(1,make_pair(0.0,s));
+        while (!w.heap.empty()) {
+            std::pop_heap(w.heap.begin(),w.heap.end(),cmp);
+            du=w.heap.back().first;
+            u=w.heap.back().second;
+            w.heap.pop_back();
+            if (du>w.dist[u])
+                continue; // stale entry
+            if (u==d->dest) {
+                for (v=u;v>=0;v=w.pred[v]) spur.push_back(v);
+                std::reverse(spur.begin(),spur.end());
+                d->costs->at(i)=du;
+                break;
+            }
+            for (k=A.offsets[u];k<A.offsets[u+1];++k) {
+                v=A.columns[k];
+                if (w.blocked[v]==w.stamp || (u==s && find(banned.begin(),banned.end(),v)!=banned.end()))
+                    continue;
+                alt=du+A.weight(k);
+                if (w.seen[v]!=w.stamp || alt<w.dist[v]) {
+                    w.seen[v]=w.stamp;
+                    w.dist[v]=alt;
+                    w.pred[v]=u;
+                    w.heap.push_back(make_pair(alt,v));
+                    std::push_heap(w.heap.begin(),w.heap.end(),cmp);
+                }
+            }
+        }
+    }
+}
+
+/* Yen's algorithm with native arithmetic, for numeric nonnegative weights,
+ * the spur paths of each iteration are computed in parallel */
+void graphe::yen::find_numeric(const csr &A) {
+    int n=A.node_count(),nt=thread_count(A.arc_count()/4096+1),i,L,seq=0;
+    dvector dist;
+    ivector pred,path;
+    csr_dijkstra(A,src,dist,pred);
+    if (dist[dest]==DBL_MAX) return;
+    for (i=dest;i>=0;i=pred[i]) path.push_back(i);
+    std::reverse(path.begin(),path.end());
+    tree_node *p=store_path(path,add_tree_node(NULL)),*t,*next;
+    if (!select_path(p)) return;
+    std::vector<spur_workspace> ws(nt);
+    for (std::vector<spur_workspace>::iterator it=ws.begin();it!=ws.end();++it) {
+        it->dist.resize(n);
+        it->pred.resize(n);
+        it->seen.assign(n,0);
+        it->blocked.assign(n,0);
+    }
+    ivectors banned,spurs;
+    dvector costs;
+    std::vector<tree_node*> roots;
+    /* candidates are ordered by cost, ties are broken by the order of discovery */
+    std::map<std::pair<double,int>,tree_node*> candidates;
+    std::set<tree_node*> pending;
+    spur_data data;
+    data.A=&A;
+    data.dest=dest;
+    data.path=&path;
+    data.banned=&banned;
+    data.spurs=&spurs;
+    data.costs=&costs;
+    data.ws=&ws;
+    while (true) {
+        restore_path(p,path);
+        L=path.size()-1;
+        banned.assign(L,ivector());
+        roots.resize(L);
+        t=root;
+        for (i=0;i<L;++i) {
+            roots[i]=t;
+            next=NULL;
+            for (vector<tree_node*>::const_iterator it=t->children.begin();it!=t->children.end();++it) {
+                if ((*it)->selected) {
+                    banned[i].push_back((*it)->i);
+                    if ((*it)->i==path[i+1]) next=*it;
+                }
+            }
+            t=next;
+        }
+        spurs.resize(L);
+        costs.resize(L);
+        parallel_for(L,spur_paths,&data,std::min(nt,L),1);
+        double root_cost=0;
+        for (i=0;i<L;++i) {
+            if (!spurs[i].empty()) {
+                t=store_path(spurs[i],roots[i]);
+                if (!t->selected && pending.insert(t).second)
+                    candidates[make_pair(root_cost+costs[i],seq++)]=t;
+            }
+            root_cost+=csr_arc_weight(A,path[i],path[i+1]);
+        }
+        if (candidates.empty()) break;
+        p=candidates.begin()->second;
+        pending.erase(p);
+        candidates.erase(candidates.begin());
+        if (!select_path(p)) break;
     }
 }
 
@@ -12523,8 +17816,15 @@ void graphe::yen::find_kspaths(ivectors &paths) {
  */
 
 void graphe::yen_ksp(int K,int src,int dest,ivectors &paths) {
+    paths.clear();
+    yen_ksp(K,src,dest,collect_ivector,&paths);
+}
+
+/* pass the K shortest paths from src to dest to output in order of increasing
+ * length (all simple paths if K is not positive), until output returns false */
+void graphe::yen_ksp(int K,int src,int dest,ivector_sink output,void *data) {
     yen Y(this,src,dest,K);
-    Y.find_kspaths(paths);
+    Y.find_kspaths(output,data);
 }
 
 /*
@@ -12710,6 +18010,16 @@ void graphe::mm::find_maximum_matching(ipairs &matching,int sg) {
 gen graphe::information_centrality(int k,bool approx) const {
     int n=node_count();
     assert(n>1 && !is_directed());
+    dvector icd;
+    if (approx && information_centrality(icd)) {
+        if (k>=0)
+            return icd[k];
+        vecteur ic(n);
+        for (int i=0;i<n;++i) {
+            ic[i]=icd[i];
+        }
+        return ic;
+    }
     matrice A;
     laplacian_matrix(A);
     for (int i=0;i<n;++i) {
@@ -12854,12 +18164,12 @@ gen graphe::betweenness_centrality(int k) const {
     vecteur cb(n,0);
     std::stack<int> S;
     std::queue<int> Q;
-    std::map<int,ivector> P;
-    ivector sigma(n),d(n);
-    vecteur delta(n);
+    ivectors P(n);
+    ivector d(n);
+    vecteur sigma(n),delta(n);
     for (int s=0;s<n;++s) {
-        P.clear();
         for (int i=0;i<n;++i) {
+            P[i].clear();
             sigma[i]=i==s?1:0;
             d[i]=i==s?0:-1;
             delta[i]=0;
@@ -12886,7 +18196,7 @@ gen graphe::betweenness_centrality(int k) const {
             S.pop();
             for (ivector_iter it=P[w].begin();it!=P[w].end();++it) {
                 int v=*it;
-                delta[v]+=gen(sigma[v])/gen(sigma[w])*(gen(1)+delta[w]);
+                delta[v]+=sigma[v]/sigma[w]*(gen(1)+delta[w]);
             }
             if (w!=s)
                 cb[w]+=delta[w];
@@ -12899,9 +18209,222 @@ gen graphe::betweenness_centrality(int k) const {
     return cb;
 }
 
-/* return the list of communicability betweenness centrality for all vertices */
-gen graphe::communicability_betweenness_centrality(int k) const {
+/* betweenness centrality with native arithmetic
+ *
+ * Brandes' algorithm is run from every source in parallel, each thread having
+ * its own accumulator. Like the exact version, it ignores edge weights. Shortest-path counts are stored as doubles, so they do
+ * not overflow. The dependencies are accumulated in the reverse order of
+ * discovery by scanning the out-arcs of each vertex and selecting those which
+ * lie on a shortest path, hence no predecessor lists are needed. For the
+ * approximation, the Riondato-Kornaropoulos scheme is used: r shortest paths
+ * are sampled uniformly at random, where r depends on the error bound eps, the
+ * failure probability and an upper bound on the vertex diameter. */
+
+struct brandes_workspace {
+    graphe::dvector sigma,dist,delta;
+    graphe::ivector order;
+    std::queue<int> Q;
+    void resize(int n) {
+        sigma.resize(n);
+        dist.resize(n);
+        delta.resize(n);
+        order.reserve(n);
+    }
+};
+
+/* compute shortest-path distances and counts from s, store vertices in order of discovery */
+static void brandes_forward(const graphe::csr &A,int s,brandes_workspace &ws) {
+    int v,w;
+    std::fill(ws.sigma.begin(),ws.sigma.end(),0.0);
+    std::fill(ws.dist.begin(),ws.dist.end(),-1.0);
+    ws.order.clear();
+    ws.sigma[s]=1;
+    ws.dist[s]=0;
+    ws.Q.push(s);
+    while (!ws.Q.empty()) {
+        v=ws.Q.front();
+        ws.Q.pop();
+        ws.order.push_back(v);
+        for (int k=A.offsets[v];k<A.offsets[v+1];++k) {
+            w=A.columns[k];
+            if (ws.dist[w]<0) {
+                ws.dist[w]=ws.dist[v]+1;
+                ws.Q.push(w);
+            }
+            if (ws.dist[w]==ws.dist[v]+1)
+                ws.sigma[w]+=ws.sigma[v];
+        }
+    }
+}
+
+/* return true iff the arc at position k of A, leaving v, lies on a shortest path */
+static inline bool brandes_is_tight(const graphe::csr &A,const graphe::dvector &dist,int v,int k) {
+    int w=A.columns[k];
+    return dist[w]>=0 && dist[w]==dist[v]+1;
+}
+
+#define BRANDES_SAMPLE_BLOCK 64
+struct brandes_data {
+    const graphe::csr *A;
+    const graphe::csr *T; // transpose of A, used for sampling paths in digraphs
+    int nsamples;
+    unsigned long long seed;
+    std::vector<graphe::dvector> acc;
+    std::vector<brandes_workspace> ws;
+};
+
+/* exact Brandes accumulation for sources first,..,last-1 */
+static void brandes_sources(int first,int last,int thread,void *data) {
+    brandes_data *d=(brandes_data*)data;
+    const graphe::csr &A=*d->A;
+    brandes_workspace &ws=d->ws[thread];
+    graphe::dvector &cb=d->acc[thread];
+    int v;
+    for (int s=first;s<last;++s) {
+        brandes_forward(A,s,ws);
+        for (graphe::ivector::const_reverse_iterator it=ws.order.rbegin();it!=ws.order.rend();++it) {
+            v=*it;
+            ws.delta[v]=0;
+            for (int k=A.offsets[v];k<A.offsets[v+1];++k) {
+                if (brandes_is_tight(A,ws.dist,v,k)) {
+                    int w=A.columns[k];
+                    ws.delta[v]+=ws.sigma[v]/ws.sigma[w]*(1.0+ws.delta[w]);
+                }
+            }
+            if (v!=s)
+                cb[v]+=ws.delta[v];
+        }
+    }
+}
+
+/* Riondato-Kornaropoulos sampling of shortest paths in blocks first,..,last-1; every block
+ * has its own random stream, so that the result does not depend on the number of threads */
+static void brandes_samples(int first,int last,int thread,void *data) {
+    brandes_data *d=(brandes_data*)data;
+    const graphe::csr &A=*d->A,&T=*d->T;
+    brandes_workspace &ws=d->ws[thread];
+    graphe::dvector &cb=d->acc[thread];
+    int n=A.node_count(),s,t,v,w;
+    double r;
+    for (int b=first;b<last;++b) {
+        graphe::rng rand(d->seed+b);
+        int lo=b*BRANDES_SAMPLE_BLOCK,hi=std::min(lo+BRANDES_SAMPLE_BLOCK,d->nsamples);
+        for (int i=lo;i<hi;++i) {
+            s=rand.integer(n);
+            t=rand.integer(n-1);
+            if (t>=s) ++t;
+            brandes_forward(A,s,ws);
+            if (ws.dist[t]<0)
+                continue;
+            /* walk back from t, choosing predecessors with probability proportional to path counts */
+            w=t;
+            while (true) {
+                r=rand.uniform()*ws.sigma[w];
+                v=-1;
+                for (int k=T.offsets[w];k<T.offsets[w+1];++k) {
+                    int u=T.columns[k];
+                    if (ws.dist[u]<0 || ws.dist[w]!=ws.dist[u]+1)
+                        continue;
+                    v=u;
+                    if ((r-=ws.sigma[u])<0)
+                        break;
+                }
+                assert(v>=0);
+                if (v==s)
+                    break;
+                cb[v]+=1.0;
+                w=v;
+            }
+        }
+    }
+}
+
+/* compute the betweenness centrality of all vertices with native arithmetic (ignoring
+ * edge weights) and store the results to cb, if eps>0 approximate within eps with
+ * probability at least 1-prob */
+void graphe::betweenness_centrality(dvector &cb,double eps,double prob) const {
+    GT_PROFILE(profile,"betweenness_centrality");
     int n=node_count();
+    assert(n>1);
+    brandes_data data;
+    csr T;
+    const csr &A=adjacency();
+    data.A=&A;
+    bool isdir=is_directed();
+    if (isdir)
+        csr_transpose(A,T);
+    data.T=isdir?&T:&A;
+    int nt=thread_count(n),i;
+    data.acc.assign(nt,dvector(n,0.0));
+    data.ws.resize(nt);
+    for (i=0;i<nt;++i) {
+        data.ws[i].resize(n);
+    }
+    double scale=isdir?1.0:0.5;
+    if (eps<=0) {
+        parallel_for(n,brandes_sources,&data,nt);
+    } else {
+        /* bound the vertex diameter: for an undirected graph, the largest 2*ecc(v)+1
+         * over one vertex v in each connected component, n otherwise */
+        double vd=n;
+        if (!isdir) {
+            ivector dist(n,-1);
+            std::queue<int> Q;
+            int ecc,maxvd=1,v,w;
+            for (int s=0;s<n;++s) {
+                if (dist[s]>=0)
+                    continue;
+                dist[s]=0;
+                Q.push(s);
+                ecc=0;
+                while (!Q.empty()) {
+                    v=Q.front();
+                    Q.pop();
+                    ecc=std::max(ecc,dist[v]);
+                    for (int k=A.offsets[v];k<A.offsets[v+1];++k) {
+                        if (dist[w=A.columns[k]]<0) {
+                            dist[w]=dist[v]+1;
+                            Q.push(w);
+                        }
+                    }
+                }
+                maxvd=std::max(maxvd,2*ecc+1);
+            }
+            vd=std::min(vd,double(maxvd));
+        }
+        double c=0.5,lg=vd>3?std::floor(std::log(vd-2)/M_LN2)+1:1;
+        data.nsamples=int(std::ceil(c/(eps*eps)*(lg+std::log(1.0/prob))));
+        data.seed=((unsigned long long)giac::giac_rand(ctx)<<32)^(unsigned long long)giac::giac_rand(ctx);
+        parallel_for((data.nsamples+BRANDES_SAMPLE_BLOCK-1)/BRANDES_SAMPLE_BLOCK,brandes_samples,&data,nt,1);
+        /* rescale the estimated fractions of shortest paths to the scale of exact values */
+        scale*=double(n)*double(n-1)/double(data.nsamples);
+    }
+    cb.assign(n,0.0);
+    for (int t=0;t<nt;++t) {
+        for (i=0;i<n;++i) {
+            cb[i]+=data.acc[t][i];
+        }
+    }
+    for (i=0;i<n;++i) {
+        cb[i]*=scale;
+    }
+}
+
+/* return the list of communicability betweenness centrality for all vertices,
+ * if approx=true compute them in floating-point arithmetic */
+gen graphe::communicability_betweenness_centrality(int k,bool approx) const {
+    int n=node_count();
+    if (approx && n>2) {
+        dvector cbc;
+        communicability_betweenness_centrality(k,cbc);
+        if (k>=0)
+            return cbc[k];
+        vecteur res(n);
+        for (int i=0;i<n;++i) {
+            res[i]=cbc[i];
+        }
+        return res;
+    }
     matrice A;
     vecteur row(n),col(n),res(n,0),nullvec(n,0);
     adjacency_matrix(A);
@@ -12918,21 +18441,934 @@ gen graphe::communicability_betweenness_centrality(int k) const {
                 res[r]+=1-eAk[p][q]/eA[p][q];
             }
         }
-        A[r]=row;
+        A[r]=row;
+    }
+    res=divvecteur(res,(n-1)*(n-2));
+    if (k>=0)
+        return res[k];
+    return res;
+}
+ 
+/* return the list of Katz centrality measures for all vertices,
+ * where att is attenuation factor */
+vecteur graphe::katz_centrality(const gen &att) const {
+    int n=node_count();
+    matrice A;
+    adjacency_matrix(A);
+    return *_sum(_tran(_inv(_idn(n,ctx)-att*_tran(A,ctx),ctx),ctx),ctx)._VECTptr;
+}
+
+/* numeric centrality engine
+ *
+ * Katz centrality and PageRank are obtained by fixed-point iteration, information
+ * centrality by solving Laplacian systems with the conjugate gradient method and
+ * communicability betweenness by Krylov approximation of the action of matrix
+ * exponentials. Only the CSR adjacency is used, no dense n x n matrix is formed. */
+
+struct csr_matvec_data {
+    const graphe::csr *A;
+    bool weighted;
+    const double *x;
+    double *y;
+};
+
+static void csr_matvec_rows(int first,int last,int thread,void *data) {
+    csr_matvec_data *d=(csr_matvec_data*)data;
+    const graphe::csr &A=*d->A;
+    double s;
+    for (int i=first;i<last;++i) {
+        s=0;
+        for (int k=A.offsets[i];k<A.offsets[i+1];++k) {
+            s+=(d->weighted?A.weights[k]:1.0)*d->x[A.columns[k]];
+        }
+        d->y[i]=s;
+    }
+}
+
+/* y=A*x, rows are processed in parallel only if the matrix is large enough */
+static void csr_matvec(const graphe::csr &A,bool weighted,const graphe::dvector &x,graphe::dvector &y) {
+    csr_matvec_data data;
+    data.A=&A;
+    data.weighted=weighted && !A.weights.empty();
+    data.x=&x.front();
+    data.y=&y.front();
+    graphe::parallel_for(A.node_count(),csr_matvec_rows,&data,graphe::thread_count(A.arc_count()>>16),1024);
+}
+
+/* compute the Katz centralities (the solution of x=1+alpha*A^T*x) by Jacobi iteration
+ * and store them to kc, return false if the iteration does not converge (i.e. if alpha
+ * is not smaller than the reciprocal of the spectral radius of A) */
+bool graphe::katz_centrality(double alpha,dvector &kc,double tol) const {
+    int n=node_count(),maxitr=10000,i;
+    const csr &A=adjacency();
+    csr T;
+    if (is_directed())
+        csr_transpose(A,T);
+    const csr &B=is_directed()?T:A;
+    dvector y(n);
+    kc.assign(n,1.0);
+    for (int itr=0;itr<maxitr;++itr) {
+        csr_matvec(B,false,kc,y);
+        double diff=0,nrm=0;
+        for (i=0;i<n;++i) {
+            y[i]=1.0+alpha*y[i];
+            diff=std::max(diff,std::abs(y[i]-kc[i]));
+            nrm=std::max(nrm,std::abs(y[i]));
+        }
+        kc.swap(y);
+        if (!(nrm<1e300)) // overflow or NaN
+            return false;
+        if (diff<=tol*nrm)
+            return true;
+    }
+    return false;
+}
+
+/* compute the PageRank of all vertices with damping factor d by power iteration and
+ * store them to pr; arcs are followed with probabilities proportional to their weights
+ * and dangling vertices link to all vertices, exact weights are approximated, return
+ * false if some weight is not a real number or is negative */
+bool graphe::pagerank(double d,dvector &pr,double tol) const {
+    int n=node_count(),maxitr=10000,i;
+    csr A,T;
+    if (!make_csr(A,-1,true))
+        return false;
+    bool weighted=is_weighted();
+    if (weighted && A.arc_count()>0 && A.min_weight<0)
+        return false;
+    if (is_directed())
+        csr_transpose(A,T);
+    const csr &B=is_directed()?T:A;
+    dvector W(n,0.0),u(n),y(n);
+    for (i=0;i<n;++i) {
+        for (int k=A.offsets[i];k<A.offsets[i+1];++k) {
+            W[i]+=A.weight(k);
+        }
+    }
+    pr.assign(n,1.0/n);
+    for (int itr=0;itr<maxitr;++itr) {
+        double dangling=0,diff=0;
+        for (i=0;i<n;++i) {
+            if (W[i]>0)
+                u[i]=pr[i]/W[i];
+            else {
+                u[i]=0;
+                dangling+=pr[i];
+            }
+        }
+        csr_matvec(B,weighted,u,y);
+        double c=(1.0-d+d*dangling)/n;
+        for (i=0;i<n;++i) {
+            y[i]=c+d*y[i];
+            diff+=std::abs(y[i]-pr[i]);
+        }
+        pr.swap(y);
+        if (diff<=tol)
+            break;
+    }
+    return true;
+}
+
+struct laplacian_cg_data {
+    const graphe::csr *A;
+    bool weighted;
+    double tol;
+    graphe::dvector D;      // diagonal of the Laplacian
+    graphe::dvector diag;   // diagonal of the pseudoinverse of the Laplacian
+    std::vector<graphe::dvector> ws;
+};
+
+/* q=L*p where L is the Laplacian with diagonal D */
+static void laplacian_apply(const laplacian_cg_data &d,const double *p,double *q) {
+    const graphe::csr &A=*d.A;
+    int n=A.node_count();
+    double s;
+    for (int i=0;i<n;++i) {
+        s=d.D[i]*p[i];
+        for (int k=A.offsets[i];k<A.offsets[i+1];++k) {
+            s-=(d.weighted?A.weights[k]:1.0)*p[A.columns[k]];
+        }
+        q[i]=s;
+    }
+}
+
+/* solve L*x=e_s-1/n for s=first,..,last-1 by the Jacobi-preconditioned
+ * conjugate gradient method and record x[s]-mean(x), i.e. the s-th
+ * diagonal element of the pseudoinverse of L */
+static void laplacian_cg_columns(int first,int last,int thread,void *data) {
+    laplacian_cg_data *d=(laplacian_cg_data*)data;
+    int n=d->A->node_count(),i;
+    graphe::dvector &w=d->ws[thread];
+    w.resize(5*n);
+    double *x=&w[0],*r=x+n,*z=r+n,*p=z+n,*q=p+n;
+    double rz,rz_new,a,bnorm=std::sqrt(1.0-1.0/n),rnorm,mean;
+    for (int s=first;s<last;++s) {
+        rz=0;
+        for (i=0;i<n;++i) {
+            x[i]=0;
+            r[i]=(i==s?1.0:0.0)-1.0/n;
+            p[i]=z[i]=r[i]/d->D[i];
+            rz+=r[i]*z[i];
+        }
+        for (int itr=0;itr<10*n+100;++itr) {
+            laplacian_apply(*d,p,q);
+            a=0;
+            for (i=0;i<n;++i) a+=p[i]*q[i];
+            a=rz/a;
+            rnorm=rz_new=0;
+            for (i=0;i<n;++i) {
+                x[i]+=a*p[i];
+                r[i]-=a*q[i];
+                z[i]=r[i]/d->D[i];
+                rz_new+=r[i]*z[i];
+                rnorm+=r[i]*r[i];
+            }
+            if (std::sqrt(rnorm)<=d->tol*bnorm)
+                break;
+            for (i=0;i<n;++i) {
+                p[i]=z[i]+rz_new/rz*p[i];
+            }
+            rz=rz_new;
+        }
+        mean=0;
+        for (i=0;i<n;++i) mean+=x[i];
+        d->diag[s]=x[s]-mean/n;
+    }
+}
+
+/* compute the information centralities of all vertices of this connected graph with
+ * native arithmetic and store them to ic, return false if the weights are symbolic or
+ * nonpositive; since (L+J)^(-1)=L^+ + J/n^2, only the diagonal of L^+ is needed */
+bool graphe::information_centrality(dvector &ic,double tol) const {
+    int n=node_count(),i;
+    assert(n>1 && !is_directed());
+    csr A;
+    if (!make_csr(A))
+        return false;
+    laplacian_cg_data data;
+    data.weighted=is_weighted();
+    if (data.weighted && A.arc_count()>0 && A.min_weight<=0)
+        return false;
+    data.A=&A;
+    data.tol=tol;
+    data.D.assign(n,0.0);
+    for (i=0;i<n;++i) {
+        for (int k=A.offsets[i];k<A.offsets[i+1];++k) {
+            data.D[i]+=A.weight(k);
+        }
+        if (data.D[i]==0)
+            return false;
+    }
+    data.diag.resize(n);
+    int nt=thread_count(n);
+    data.ws.resize(nt);
+    parallel_for(n,laplacian_cg_columns,&data,nt,1);
+    double tr=0;
+    for (i=0;i<n;++i) tr+=data.diag[i];
+    ic.resize(n);
+    for (i=0;i<n;++i) {
+        ic[i]=n/(tr+n*data.diag[i]);
+    }
+    return true;
+}
+
+/* workspace for approximating exp(A-shift*I)*w in Krylov subspaces of dimension m */
+struct expv_workspace {
+    graphe::dvector V,H,F,P,Q,y;
+    void resize(int n,int m) {
+        V.resize((m+1)*n);
+        H.resize((m+1)*m);
+        F.resize(m*m);
+        P.resize(m*m);
+        Q.resize(m*m);
+        y.resize(n);
+    }
+};
+
+/* F=exp(t*H) for the leading k x k block of the m x m matrix H (stored with m+1 rows),
+ * by scaling and squaring the truncated Taylor series */
+static void small_expm(const double *H,int m,int k,double t,expv_workspace &ws) {
+    double *F=&ws.F[0],*P=&ws.P[0],*Q=&ws.Q[0],nrm=0,rs,s;
+    int i,j,l,sq=0;
+    for (i=0;i<k;++i) {
+        rs=0;
+        for (j=0;j<k;++j) rs+=std::abs(H[i+j*(m+1)]);
+        nrm=std::max(nrm,rs*std::abs(t));
+    }
+    while (nrm>0.5) {
+        nrm/=2;
+        ++sq;
+    }
+    t=std::ldexp(t,-sq);
+    for (i=0;i<k;++i) {
+        for (j=0;j<k;++j) {
+            F[i+j*k]=P[i+j*k]=(i==j?1.0:0.0);
+        }
+    }
+    for (int deg=1;deg<=24;++deg) {
+        /* P=P*(t*H)/deg */
+        double pn=0;
+        for (j=0;j<k;++j) {
+            for (i=0;i<k;++i) {
+                s=0;
+                for (l=0;l<k;++l) s+=P[i+l*k]*H[l+j*(m+1)];
+                Q[i+j*k]=s*t/deg;
+                pn=std::max(pn,std::abs(Q[i+j*k]));
+            }
+        }
+        std::copy(Q,Q+k*k,P);
+        for (i=0;i<k*k;++i) F[i]+=P[i];
+        if (pn<1e-18)
+            break;
+    }
+    for (;sq>0;--sq) {
+        for (j=0;j<k;++j) {
+            for (i=0;i<k;++i) {
+                s=0;
+                for (l=0;l<k;++l) s+=F[i+l*k]*F[l+j*k];
+                Q[i+j*k]=s;
+            }
+        }
+        std::copy(Q,Q+k*k,F);
+    }
+}
+
+/* overwrite w with an approximation of exp(A-shift*I)*w, where the row of the vertex
+ * iso is zero (iso<0 means none) and w[iso]=0, using Krylov subspaces of dimension at most
+ * m with time stepping as in Expokit; for symmetric A the Lanczos recurrence is used */
+static void krylov_expv(const graphe::csr &A,int iso,double shift,double anorm,bool symmetric,
+                        int m,double tol,graphe::dvector &w,expv_workspace &ws) {
+    int n=A.node_count(),i,j,l,k;
+    double t=0,tau,beta=0,h,err;
+    double *V=&ws.V[0],*H=&ws.H[0];
+    for (i=0;i<n;++i) beta+=w[i]*w[i];
+    beta=std::sqrt(beta);
+    if (beta==0)
+        return;
+    tau=std::min(1.0,anorm>0?m/(2.0*anorm):1.0);
+    while (t<1) {
+        tau=std::min(tau,1-t);
+        for (i=0;i<n;++i) V[i]=w[i]/beta;
+        std::fill(ws.H.begin(),ws.H.end(),0.0);
+        bool happy=false;
+        for (k=0;k<m;++k) {
+            const double *v=V+k*n;
+            double *p=V+(k+1)*n;
+            for (i=0;i<n;++i) {
+                double s=-shift*v[i];
+                if (i!=iso) {
+                    for (l=A.offsets[i];l<A.offsets[i+1];++l) s+=v[A.columns[l]];
+                }
+                p[i]=s;
+            }
+            for (j=symmetric?std::max(0,k-1):0;j<=k;++j) {
+                const double *q=V+j*n;
+                h=0;
+                for (i=0;i<n;++i) h+=q[i]*p[i];
+                for (i=0;i<n;++i) p[i]-=h*q[i];
+                H[j+k*(m+1)]=h;
+            }
+            h=0;
+            for (i=0;i<n;++i) h+=p[i]*p[i];
+            h=std::sqrt(h);
+            H[k+1+k*(m+1)]=h;
+            if (h<=1e-12*std::max(1.0,anorm)) {
+                happy=true;
+                ++k;
+                break;
+            }
+            for (i=0;i<n;++i) p[i]/=h;
+        }
+        if (happy)
+            tau=1-t;
+        /* shrink the step until the local error is acceptable */
+        while (true) {
+            small_expm(H,m,k,tau,ws);
+            err=happy?0:beta*std::abs(tau*H[k+(k-1)*(m+1)]*ws.F[k-1]);
+            if (err<=tol*beta || tau<1e-12)
+                break;
+            tau/=2;
+        }
+        std::fill(ws.y.begin(),ws.y.end(),0.0);
+        for (j=0;j<k;++j) {
+            double c=beta*ws.F[j];
+            const double *q=V+j*n;
+            for (i=0;i<n;++i) ws.y[i]+=c*q[i];
+        }
+        if (iso>=0)
+            ws.y[iso]=0;
+        w.swap(ws.y);
+        ws.y.resize(n);
+        t+=tau;
+        beta=0;
+        for (i=0;i<n;++i) beta+=w[i]*w[i];
+        beta=std::sqrt(beta);
+        if (beta==0)
+            return;
+        if (err<tol*beta/4)
+            tau*=2;
+    }
+}
+
+struct communicability_data {
+    const graphe::csr *A;
+    int k;
+    double shift;
+    double anorm;
+    bool symmetric;
+    int dim;
+    double tol;
+    std::vector<graphe::dvector> acc;
+    std::vector<expv_workspace> ws;
+    std::vector<graphe::dvector> g,gr;
+};
+
+/* accumulate the contributions of columns first,..,last-1 of exp(A) */
+static void communicability_columns(int first,int last,int thread,void *data) {
+    communicability_data *d=(communicability_data*)data;
+    const graphe::csr &A=*d->A;
+    int n=A.node_count();
+    graphe::dvector &g=d->g[thread],&gr=d->gr[thread],&acc=d->acc[thread];
+    expv_workspace &ws=d->ws[thread];
+    for (int q=first;q<last;++q) {
+        g.assign(n,0.0);
+        g[q]=1.0;
+        krylov_expv(A,-1,d->shift,d->anorm,d->symmetric,d->dim,d->tol,g,ws);
+        for (int r=(d->k>=0?d->k:0);r<(d->k>=0?d->k+1:n);++r) {
+            if (r==q)
+                continue;
+            gr.assign(n,0.0);
+            gr[q]=1.0;
+            krylov_expv(A,r,d->shift,d->anorm,d->symmetric,d->dim,d->tol,gr,ws);
+            for (int p=0;p<n;++p) {
+                if (p!=q && p!=r && g[p]>0)
+                    acc[r]+=1.0-gr[p]/g[p];
+            }
+        }
+    }
+}
+
+/* compute the communicability betweenness centrality of k-th vertex (of all vertices if
+ * k<0) with native arithmetic and store the values to cbc; the columns of exp(A) and of
+ * exp(A_r), where A_r is A with r-th vertex isolated, are approximated in Krylov subspaces
+ * and the common factor exp(-maxdeg) keeps them in floating-point range */
+void graphe::communicability_betweenness_centrality(int k,dvector &cbc,double tol) const {
+    int n=node_count(),i;
+    assert(n>2);
+    const csr &A=adjacency();
+    communicability_data data;
+    data.A=&A;
+    data.k=k;
+    data.symmetric=!is_directed();
+    data.tol=tol;
+    data.dim=std::min(n,30);
+    data.shift=0;
+    for (i=0;i<n;++i) {
+        data.shift=std::max(data.shift,double(A.offsets[i+1]-A.offsets[i]));
+    }
+    data.anorm=2*data.shift;
+    int nt=thread_count(n);
+    data.acc.assign(nt,dvector(n,0.0));
+    data.ws.resize(nt);
+    data.g.resize(nt);
+    data.gr.resize(nt);
+    for (i=0;i<nt;++i) {
+        data.ws[i].resize(n,data.dim);
+    }
+    parallel_for(n,communicability_columns,&data,nt,1);
+    cbc.assign(n,0.0);
+    for (int t=0;t<nt;++t) {
+        for (i=0;i<n;++i) {
+            cbc[i]+=data.acc[t][i];
+        }
+    }
+    for (i=0;i<n;++i) {
+        cbc[i]/=double(n-1)*double(n-2);
+    }
+}
+
+/* symmetric eigenproblems
+ *
+ * Extreme eigenpairs of the adjacency, Laplacian or Seidel matrix of an undirected graph
+ * are computed by the thick-restart Lanczos method (mathematically equivalent to implicit
+ * restarting) with full reorthogonalization, the operator being applied on the CSR
+ * adjacency. A single Krylov sequence sees only one copy of a multiple eigenvalue, hence
+ * converged pairs are locked and the iteration is repeated from a fresh random vector
+ * until no missing eigenvalue shows up. Small problems are solved densely, provided that
+ * the order of the matrix does not exceed EIGEN_DENSE_MAX_ORDER. */
+
+#define EIGEN_DENSE_MAX_ORDER 2048
+
+/* compute all eigenpairs of the symmetric m x m matrix a (row-major, destroyed) by the
+ * cyclic Jacobi method, store the eigenvalues to w and the eigenvectors to columns of v */
+static void jacobi_eigen(int m,graphe::dvector &a,graphe::dvector &w,graphe::dvector &v) {
+    int i,j,p,q,r;
+    v.assign(m*m,0.0);
+    for (i=0;i<m;++i) {
+        v[i*m+i]=1.0;
+    }
+    for (int sweep=0;sweep<100;++sweep) {
+        double off=0,tot=0;
+        for (i=0;i<m;++i) {
+            for (j=0;j<m;++j) {
+                tot+=a[i*m+j]*a[i*m+j];
+                if (i!=j) off+=a[i*m+j]*a[i*m+j];
+            }
+        }
+        if (off<=1e-28*tot)
+            break;
+        double small=1e-18*std::sqrt(tot);
+        for (p=0;p<m;++p) {
+            for (q=p+1;q<m;++q) {
+                double apq=a[p*m+q];
+                if (std::abs(apq)<=small) {
+                    a[p*m+q]=a[q*m+p]=0;
+                    continue;
+                }
+                double theta=(a[q*m+q]-a[p*m+p])/(2*apq);
+                double t=(theta>=0?1.0:-1.0)/(std::abs(theta)+std::sqrt(theta*theta+1));
+                double c=1/std::sqrt(t*t+1),s=t*c,x,y;
+                for (r=0;r<m;++r) {
+                    x=a[r*m+p]; y=a[r*m+q];
+                    a[r*m+p]=c*x-s*y; a[r*m+q]=s*x+c*y;
+                }
+                for (r=0;r<m;++r) {
+                    x=a[p*m+r]; y=a[q*m+r];
+                    a[p*m+r]=c*x-s*y; a[q*m+r]=s*x+c*y;
+                }
+                for (r=0;r<m;++r) {
+                    x=v[r*m+p]; y=v[r*m+q];
+                    v[r*m+p]=c*x-s*y; v[r*m+q]=s*x+c*y;
+                }
+            }
+        }
+    }
+    w.resize(m);
+    for (i=0;i<m;++i) {
+        w[i]=a[i*m+i];
+    }
+}
+
+struct spectral_operator { // sign*M, where M is the adjacency, Laplacian or Seidel matrix
+    const graphe::csr *A;
+    int kind;
+    bool weighted;
+    double sign;
+    graphe::dvector D; // weighted degrees
+    double norm;       // upper bound for the spectral radius
+    void apply(const double *x,double *y,bool parallel) const;
+};
+
+void spectral_operator::apply(const double *x,double *y,bool parallel) const {
+    csr_matvec_data data;
+    data.A=A;
+    data.weighted=weighted && kind==_GT_SPECTRUM_LAPLACIAN;
+    data.x=x;
+    data.y=y;
+    int n=A->node_count(),i;
+    if (parallel)
+        graphe::parallel_for(n,csr_matvec_rows,&data,graphe::thread_count(A->arc_count()>>16),1024);
+    else csr_matvec_rows(0,n,0,&data);
+    switch (kind) {
+    case _GT_SPECTRUM_ADJACENCY:
+        for (i=0;i<n;++i) y[i]*=sign;
+        break;
+    case _GT_SPECTRUM_LAPLACIAN:
+        for (i=0;i<n;++i) y[i]=sign*(D[i]*x[i]-y[i]);
+        break;
+    case _GT_SPECTRUM_SEIDEL: {
+        double s=0;
+        for (i=0;i<n;++i) s+=x[i];
+        for (i=0;i<n;++i) y[i]=sign*(s-x[i]-2*y[i]);
+        break;
+    }
+    default:
+        assert(false);
+    }
+}
+
+static double dot_product(const graphe::dvector &x,const graphe::dvector &y) {
+    double s=0;
+    for (size_t i=0;i<x.size();++i) s+=x[i]*y[i];
+    return s;
+}
+
+/* subtract from v its projection onto the orthonormal vectors in Z and V[0],..,V[cnt-1]
+ * (twice, for numerical stability), accumulate the coefficients w.r.t. V to h if not NULL */
+static void orthogonalize(graphe::dvector &v,const std::vector<graphe::dvector> &Z,
+                          const std::vector<graphe::dvector> &V,int cnt,double *h) {
+    int n=v.size(),i;
+    double c;
+    for (int pass=0;pass<2;++pass) {
+        for (std::vector<graphe::dvector>::const_iterator it=Z.begin();it!=Z.end();++it) {
+            c=dot_product(*it,v);
+            for (i=0;i<n;++i) v[i]-=c*(*it)[i];
+        }
+        for (int j=0;j<cnt;++j) {
+            c=dot_product(V[j],v);
+            for (i=0;i<n;++i) v[i]-=c*V[j][i];
+            if (h!=NULL) h[j]+=c;
+        }
+    }
+}
+
+/* fill v with a random unit vector orthogonal to Z and V[0],..,V[cnt-1] */
+static void random_start(graphe::dvector &v,const std::vector<graphe::dvector> &Z,
+                         const std::vector<graphe::dvector> &V,int cnt,graphe::rng &rand) {
+    double nrm=0;
+    while (nrm==0) {
+        for (size_t i=0;i<v.size();++i) v[i]=rand.uniform()-0.5;
+        orthogonalize(v,Z,V,cnt,NULL);
+        nrm=std::sqrt(dot_product(v,v));
+    }
+    for (size_t i=0;i<v.size();++i) v[i]/=nrm;
+}
+
+/* find the want largest eigenpairs of op restricted to the orthogonal complement of the
+ * orthonormal vectors in Z by thick-restart Lanczos iteration, store the Ritz values to
+ * theta in decreasing order and the Ritz vectors to X, return the number of leading pairs
+ * which converged within the tolerance */
+static int lanczos_run(const spectral_operator &op,const std::vector<graphe::dvector> &Z,int want,
+                       double tol,graphe::rng &rand,graphe::dvector &theta,std::vector<graphe::dvector> &X) {
+    int n=op.A->node_count(),nz=Z.size(),i,j,r,l=0,nconv=0;
+    int m=std::min(n-nz,std::max(2*want+10,24));
+    assert(want<m);
+    std::vector<graphe::dvector> V(m+1,graphe::dvector(n)),W;
+    graphe::dvector T(m*m,0.0),a,w,S;
+    graphe::ivector idx(m);
+    double beta=0,eps=tol*std::max(op.norm,1e-300);
+    random_start(V[0],Z,V,0,rand);
+    for (int restart=0;restart<1000;++restart) {
+        for (j=l;j<m;++j) {
+            op.apply(&V[j][0],&V[j+1][0],true);
+            graphe::dvector h(j+1,0.0);
+            orthogonalize(V[j+1],Z,V,j+1,&h[0]);
+            for (i=0;i<=j;++i) T[i*m+j]=h[i];
+            beta=std::sqrt(dot_product(V[j+1],V[j+1]));
+            if (beta<=1e-12*op.norm) { // invariant subspace found, continue in a random direction
+                random_start(V[j+1],Z,V,j+1,rand);
+                beta=0;
+            } else {
+                for (i=0;i<n;++i) V[j+1][i]/=beta;
+            }
+        }
+        /* Rayleigh-Ritz projection */
+        a.resize(m*m);
+        for (i=0;i<m;++i) {
+            for (j=i;j<m;++j) {
+                a[i*m+j]=a[j*m+i]=T[i*m+j];
+            }
+        }
+        jacobi_eigen(m,a,w,S);
+        for (i=0;i<m;++i) idx[i]=i;
+        for (i=1;i<m;++i) { // sort by decreasing Ritz values
+            int t=idx[i];
+            for (j=i;j>0 && w[idx[j-1]]<w[t];--j) idx[j]=idx[j-1];
+            idx[j]=t;
+        }
+        for (nconv=0;nconv<want && std::abs(beta*S[(m-1)*m+idx[nconv]])<=eps;++nconv);
+        bool done=(nconv==want || restart==999);
+        l=done?want:std::min(m-1,want+(m-want)/2);
+        /* the new basis consists of the first l Ritz vectors and the last Lanczos vector */
+        W.assign(l,graphe::dvector(n,0.0));
+        for (i=0;i<l;++i) {
+            for (r=0;r<m;++r) {
+                double c=S[r*m+idx[i]];
+                if (c==0) continue;
+                for (j=0;j<n;++j) W[i][j]+=c*V[r][j];
+            }
+        }
+        if (done) {
+            theta.resize(want);
+            X.swap(W);
+            for (i=0;i<want;++i) theta[i]=w[idx[i]];
+            return nconv;
+        }
+        for (i=0;i<l;++i) V[i].swap(W[i]);
+        V[l].swap(V[m]);
+        std::fill(T.begin(),T.end(),0.0);
+        for (i=0;i<l;++i) T[i*m+i]=w[idx[i]];
+    }
+    return nconv;
+}
+
+/* compute the k largest (or smallest) eigenvalues of the matrix of the given kind with
+ * native arithmetic and store them to ev in order of decreasing (increasing) values, and
+ * the corresponding unit eigenvectors to evecs unless it is NULL; if deflate=true the
+ * constant vector is projected out (which skips the zero Laplacian eigenvalue of a
+ * connected graph), return the status (one of gt_eigenpairs_status); if the iteration
+ * did not converge, only the converged leading pairs are stored */
+int graphe::eigenpairs(int kind,int k,bool smallest,bool deflate,dvector &ev,std::vector<dvector> *evecs,double tol) const {
+    assert(!is_directed());
+    int n=node_count(),i,j,status=_GT_EIGEN_OK;
+    csr L;
+    if (kind==_GT_SPECTRUM_LAPLACIAN) {
+        if (!make_csr(L))
+            return _GT_EIGEN_INVALID_WEIGHTS;
+        if (is_weighted() && L.arc_count()>0 && L.min_weight<0)
+            return _GT_EIGEN_INVALID_WEIGHTS;
+    }
+    const csr &A=kind==_GT_SPECTRUM_LAPLACIAN?L:adjacency();
+    spectral_operator op;
+    op.A=&A;
+    op.kind=kind;
+    op.weighted=is_weighted();
+    op.sign=smallest?-1:1;
+    op.D.assign(n,0.0);
+    double maxdeg=0;
+    for (i=0;i<n;++i) {
+        for (int l=A.offsets[i];l<A.offsets[i+1];++l) {
+            op.D[i]+=(kind==_GT_SPECTRUM_LAPLACIAN?A.weight(l):1.0);
+        }
+        maxdeg=std::max(maxdeg,op.D[i]);
+    }
+    op.norm=kind==_GT_SPECTRUM_LAPLACIAN?2*maxdeg:(kind==_GT_SPECTRUM_SEIDEL?n+2*maxdeg:maxdeg);
+    op.norm=std::max(op.norm,1.0);
+    std::vector<dvector> Z;
+    if (deflate)
+        Z.push_back(dvector(n,1.0/std::sqrt(double(n))));
+    k=std::min(k,n-int(Z.size()));
+    ev.clear();
+    if (evecs!=NULL)
+        evecs->clear();
+    if (k<=0)
+        return _GT_EIGEN_OK;
+    std::vector<dvector> X,locked;
+    dvector theta,lv;
+    if (n<=256 || 2*k+10>=n-int(Z.size())) {
+        if (n>EIGEN_DENSE_MAX_ORDER)
+            return _GT_EIGEN_TOO_LARGE;
+        /* dense problem, the deflated directions are moved to the bottom of the spectrum */
+        dvector M(n*n),w,S,e(n,0.0),col(n);
+        for (j=0;j<n;++j) {
+            e[j]=1.0;
+            op.apply(&e[0],&col[0],false);
+            e[j]=0.0;
+            for (i=0;i<n;++i) M[i*n+j]=col[i];
+        }
+        for (std::vector<dvector>::const_iterator it=Z.begin();it!=Z.end();++it) {
+            for (i=0;i<n;++i) {
+                for (j=0;j<n;++j) M[i*n+j]-=(2*op.norm+1)*(*it)[i]*(*it)[j];
+            }
+        }
+        jacobi_eigen(n,M,w,S);
+        ivector idx(n);
+        for (i=0;i<n;++i) idx[i]=i;
+        for (i=1;i<n;++i) {
+            int t=idx[i];
+            for (j=i;j>0 && w[idx[j-1]]<w[t];--j) idx[j]=idx[j-1];
+            idx[j]=t;
+        }
+        for (i=0;i<k;++i) {
+            lv.push_back(w[idx[i]]);
+            locked.push_back(dvector(n));
+            for (j=0;j<n;++j) locked.back()[j]=S[j*n+idx[i]];
+        }
+    } else {
+        rng rand(((unsigned long long)giac::giac_rand(ctx)<<32)^(unsigned long long)giac::giac_rand(ctx));
+        int nconv=lanczos_run(op,Z,k,tol,rand,lv,locked);
+        if (nconv<k) {
+            /* keep the converged pairs only */
+            lv.resize(nconv);
+            locked.resize(nconv);
+            k=nconv;
+            status=_GT_EIGEN_NOT_CONVERGED;
+        }
+        /* look for the missing copies of multiple eigenvalues */
+        while (status==_GT_EIGEN_OK) {
+            std::vector<dvector> Y(Z);
+            Y.insert(Y.end(),locked.begin(),locked.end());
+            if (n-int(Y.size())<=25)
+                break;
+            if (lanczos_run(op,Y,1,tol,rand,theta,X)<1 || theta[0]<=lv.back()+tol*op.norm)
+                break;
+            for (j=k-1;j>0 && lv[j-1]<theta[0];--j);
+            lv.insert(lv.begin()+j,theta[0]);
+            locked.insert(locked.begin()+j,X[0]);
+            lv.pop_back();
+            locked.pop_back();
+        }
+    }
+    ev.resize(k);
+    for (i=0;i<k;++i) {
+        ev[i]=op.sign*lv[i];
+    }
+    if (evecs!=NULL)
+        evecs->swap(locked);
+    return status;
+}
+
+/* stochastic Lanczos quadrature, the estimates of z^T log(M) z for random sign vectors z */
+struct slq_data {
+    const graphe::csr *A;
+    bool weighted;
+    graphe::dvector D;
+    graphe::ivector comp;      // component indices
+    graphe::dvector compsize;
+    graphe::dvector S;         // diagonal scaling
+    int steps;
+    unsigned long long seed;
+    graphe::dvector est;
+};
+
+/* y=S*(L+P)*S*x, where P is the orthogonal projection onto the component indicator vectors
+ * and S is the diagonal scaling (if scale=true) which makes the diagonal of the product 1 */
+static void slq_apply(const slq_data &d,const double *x,double *y,graphe::dvector &s,bool scale) {
+    const graphe::csr &A=*d.A;
+    int n=A.node_count(),i;
+    s.assign(d.compsize.size(),0.0);
+    for (i=0;i<n;++i) {
+        double t=d.D[i]*x[i]*(scale?d.S[i]:1.0);
+        for (int k=A.offsets[i];k<A.offsets[i+1];++k) {
+            int j=A.columns[k];
+            t-=(d.weighted?A.weights[k]:1.0)*x[j]*(scale?d.S[j]:1.0);
+        }
+        y[i]=t;
+        s[d.comp[i]]+=x[i]*(scale?d.S[i]:1.0);
+    }
+    for (i=0;i<n;++i) {
+        y[i]+=s[d.comp[i]]/d.compsize[d.comp[i]];
+        if (scale) y[i]*=d.S[i];
+    }
+}
+
+static void slq_probes(int first,int last,int thread,void *data) {
+    slq_data *d=(slq_data*)data;
+    int n=d->A->node_count(),m=d->steps,i,j;
+    graphe::dvector q(n),qprev(n),u(n),s,alpha,beta,a,w,S;
+    for (int p=first;p<last;++p) {
+        graphe::rng rand(d->seed+p);
+        for (i=0;i<n;++i) {
+            q[i]=(rand.next()&1)?1.0/std::sqrt(double(n)):-1.0/std::sqrt(double(n));
+            qprev[i]=0;
+        }
+        alpha.clear();
+        beta.clear();
+        double b=0;
+        for (j=0;j<m;++j) {
+            slq_apply(*d,&q[0],&u[0],s,true);
+            double al=0;
+            for (i=0;i<n;++i) al+=q[i]*u[i];
+            alpha.push_back(al);
+            b=0;
+            for (i=0;i<n;++i) {
+                u[i]-=al*q[i]+(j>0?beta.back():0.0)*qprev[i];
+                b+=u[i]*u[i];
+            }
+            b=std::sqrt(b);
+            if (j+1==m || b<=1e-10*std::abs(al))
+                break;
+            beta.push_back(b);
+            for (i=0;i<n;++i) {
+                qprev[i]=q[i];
+                q[i]=u[i]/b;
+            }
+        }
+        int k=alpha.size();
+        a.assign(k*k,0.0);
+        for (i=0;i<k;++i) {
+            a[i*k+i]=alpha[i];
+            if (i+1<k) a[i*k+i+1]=a[(i+1)*k+i]=beta[i];
+        }
+        jacobi_eigen(k,a,w,S);
+        double e=0;
+        for (i=0;i<k;++i) {
+            e+=S[i]*S[i]*std::log(std::max(w[i],1e-300));
+        }
+        d->est[p]=n*e;
     }
-    res=divvecteur(res,(n-1)*(n-2));
-    if (k>=0)
-        return res[k];
-    return res;
 }
- 
-/* return the list of Katz centrality measures for all vertices,
- * where att is attenuation factor */
-vecteur graphe::katz_centrality(const gen &att) const {
-    int n=node_count();
-    matrice A;
-    adjacency_matrix(A);
-    return *_sum(_tran(_inv(_idn(n,ctx)-att*_tran(A,ctx),ctx),ctx),ctx)._VECTptr;
+
+/* compute the natural logarithm of the number of spanning forests of this undirected graph
+ * (of spanning trees if it is connected) with native arithmetic, which is log(det(L+P)) minus
+ * the sum of logarithms of the component sizes, where P is the orthogonal projection onto the
+ * component indicator vectors; the determinant is obtained by Cholesky factorization for
+ * small graphs and estimated by stochastic Lanczos quadrature (after scaling L+P to unit
+ * diagonal) otherwise, return false if
+ * the weights are symbolic or nonpositive */
+bool graphe::log_spanning_tree_count(double &lt) const {
+    assert(!is_directed());
+    int n=node_count(),i,j,k,nc=0;
+    csr A;
+    if (!make_csr(A))
+        return false;
+    slq_data data;
+    data.A=&A;
+    data.weighted=is_weighted();
+    if (data.weighted && A.arc_count()>0 && A.min_weight<=0)
+        return false;
+    data.D.assign(n,0.0);
+    data.comp.assign(n,-1);
+    for (i=0;i<n;++i) {
+        for (k=A.offsets[i];k<A.offsets[i+1];++k) {
+            data.D[i]+=A.weight(k);
+        }
+    }
+    ivector queue;
+    for (i=0;i<n;++i) {
+        if (data.comp[i]>=0)
+            continue;
+        queue.assign(1,i);
+        data.comp[i]=nc;
+        for (size_t pos=0;pos<queue.size();++pos) {
+            int v=queue[pos];
+            for (k=A.offsets[v];k<A.offsets[v+1];++k) {
+                j=A.columns[k];
+                if (data.comp[j]<0) {
+                    data.comp[j]=nc;
+                    queue.push_back(j);
+                }
+            }
+        }
+        data.compsize.push_back(queue.size());
+        ++nc;
+    }
+    lt=0;
+    for (i=0;i<nc;++i) {
+        lt-=std::log(data.compsize[i]);
+    }
+    if (n<=2000) {
+        dvector M(n*n),e(n,0.0),col(n),s;
+        for (j=0;j<n;++j) {
+            e[j]=1.0;
+            slq_apply(data,&e[0],&col[0],s,false);
+            e[j]=0.0;
+            for (i=0;i<n;++i) M[i*n+j]=col[i];
+        }
+        /* Cholesky factorization M=R^T*R, row-oriented */
+        for (i=0;i<n;++i) {
+            for (j=0;j<i;++j) {
+                double t=M[i*n+j];
+                for (k=0;k<j;++k) t-=M[i*n+k]*M[j*n+k];
+                M[i*n+j]=t/M[j*n+j];
+            }
+            double t=M[i*n+i];
+            for (k=0;k<i;++k) t-=M[i*n+k]*M[i*n+k];
+            if (t<=0)
+                return false;
+            M[i*n+i]=std::sqrt(t);
+            lt+=2*std::log(M[i*n+i]);
+        }
+        return true;
+    }
+    /* log(det(M))=log(det(S^-2))+log(det(S*M*S)), the latter is estimated with lower variance */
+    data.S.resize(n);
+    for (i=0;i<n;++i) {
+        double d=data.D[i]+1.0/data.compsize[data.comp[i]];
+        data.S[i]=1.0/std::sqrt(d);
+        lt+=std::log(d);
+    }
+    int nprobes=64;
+    data.steps=std::min(n,80);
+    data.est.resize(nprobes);
+    data.seed=((unsigned long long)giac::giac_rand(ctx)<<32)^(unsigned long long)giac::giac_rand(ctx);
+    parallel_for(nprobes,slq_probes,&data,thread_count(nprobes),1);
+    double sum=0;
+    for (i=0;i<nprobes;++i) {
+        sum+=data.est[i];
+    }
+    lt+=sum/nprobes;
+    return true;
 }
 
 /* returns the splittance of this graph */
@@ -13468,126 +19904,649 @@ void graphe::mvc_solver::preprocess(glp_tree *tree) {
             //if (cnt>0) std::cout << "Fixed " << cnt << " mirrors\n";
         }
     }
-    /* get already fixed vertices */
-    int n=sg<0?G->node_count():V.size(),cov_lbound=0;
-    if (sg<0)
-        G->unset_subgraphs(1);
-    bool in_cover;
-    for (int i=0;i<n;++i) {
-        int j=sg<0?i:V[i];
-        if (is_vertex_fixed(p,j,in_cover)) {
-            G->node(j).set_subgraph(0);
-            if (in_cover)
-                ++cov_lbound;
+    /* get already fixed vertices */
+    int n=sg<0?G->node_count():V.size(),cov_lbound=0;
+    if (sg<0)
+        G->unset_subgraphs(1);
+    bool in_cover;
+    for (int i=0;i<n;++i) {
+        int j=sg<0?i:V[i];
+        if (is_vertex_fixed(p,j,in_cover)) {
+            G->node(j).set_subgraph(0);
+            if (in_cover)
+                ++cov_lbound;
+        }
+    }
+    bool changed;
+    int s=sg<0?1:sg;
+    /* try to reduce the uncovered part of G */
+    do {
+        changed=false;
+        for (int k=0;k<n;++k) {
+            int i=sg<0?k:V[k];
+            vertex &v=G->node(i);
+            if (v.subgraph()==s) {
+                if (G->degree(i,s)==1) {
+                    make_vertex_fixed(p,i,false);
+                    int j=G->first_neighbor_from_subgraph(G->node(i),s);
+                    make_vertex_fixed(p,j,true);
+                    ++cov_lbound;
+                    G->node(i).set_subgraph(0);
+                    G->node(j).set_subgraph(0);
+                    changed=true;
+                    break;
+                } else if (G->mvc_is_dominant(i,s) || G->mvc_is_unconfined(i,s)) {
+                    make_vertex_fixed(p,i,true);
+                    ++cov_lbound;
+                    G->node(i).set_subgraph(0);
+                    changed=true;
+                    break;
+                }
+            }
+        }
+    } while (changed);
+    cov_lbound+=lower_bound(s);
+    if (cov_lbound>(int)glp_get_row_lb(p,last_row))
+        glp_set_row_bnds(p,last_row,GLP_LO,cov_lbound,0);
+    if (sg<0)
+        G->unset_subgraphs();
+    else G->set_subgraph(V,sg);
+}
+
+void graphe::mvc_solver::packing(glp_tree *tree) {
+    glp_prob *p=glp_ios_get_prob(tree);
+    int n=sg<0?G->node_count():V.size();
+    bool in_cover;
+    int *ind=new int[n+1];
+    double *val=new double[n+1];
+    int cnt=0;
+    for (int i=0;i<n;++i) {
+        int v=sg<0?i:V[i];
+        if (is_vertex_fixed(p,v,in_cover) && in_cover) {
+            ivector nv=G->node(v).neighbors();
+            for (int j=nv.size();j-->0;) {
+                if (sg>=0 && G->node(nv[j]).subgraph()!=sg)
+                    nv.erase(nv.begin()+j);
+            }
+            double sum=0;
+            for (ivector_iter it=nv.begin();it!=nv.end();++it) {
+                sum+=glp_get_col_prim(p,(sg<0?*it:V_pos[*it])+1);
+            }
+            if (sum>nv.size()-0.999) {
+                /* add packing constraint */
+                int r=glp_add_rows(p,1);
+                for (ivector_iter it=nv.begin();it!=nv.end();++it) {
+                    ind[it-nv.begin()+1]=(sg<0?*it:V_pos[*it])+1;
+                    val[it-nv.begin()+1]=1;
+                }
+                glp_set_mat_row(p,r,nv.size(),ind,val);
+                glp_set_row_bnds(p,r,GLP_UP,0,nv.size()-1);
+                ++cnt;
+            }
+        }
+    }
+    //if (cnt>0) std::cout << "Added " << cnt << " packing constraints\n";
+    delete[] ind;
+    delete[] val;
+}
+
+void graphe::mvc_solver::callback(glp_tree *tree,void *info) {
+    mvc_solver *mvcs=static_cast<mvc_solver*>(info);
+    switch (glp_ios_reason(tree)) {
+    case GLP_IBRANCH:
+        /* choose a variable to branch upon */
+        mvcs->branch(tree);
+        break;
+    case GLP_IHEUR:
+        /* obtain a heuristic solution */
+        if (mvcs->compute_heur) {
+            mvcs->heuristic(tree);
+            glp_ios_heur_sol(tree,mvcs->heur_sol);
+            //mvcs->compute_heur=false;
+        }
+        break;
+    case GLP_IROWGEN:
+        /* generate packing constraints */
+        mvcs->packing(tree);
+        break;
+    case GLP_IPREPRO:
+        /* preprocess subproblem */
+        if (!mvcs->is_k_vc)
+            mvcs->preprocess(tree);
+        break;
+    default:
+        /* ignore call for other reasons */
+        break;
+    }
+}
+#endif
+
+/*
+ * END OF MVC SOLVER CLASS IMPLEMENTATION
+ */
+
+/*
+ * VC_KERNEL CLASS IMPLEMENTATION
+ */
+
+/* The kernel keeps the degrees of the vertices in the remaining graph and a worklist of
+ * vertices whose neighborhoods have changed since they were last examined, so that each
+ * rule is tried only where it may have become applicable. The rules are: isolated vertices
+ * are not in the cover, the neighbor of a pendant vertex is in the cover, a vertex v is in
+ * the cover if N[u] is contained in N[v] for some neighbor u (dominance, which includes
+ * degree-2 vertices in triangles), and the crown reduction by Nemhauser & Trotter (1975)
+ * based on a half-integral optimal solution of the LP relaxation. */
+
+graphe::vc_kernel::vc_kernel(const csr &adj) : A(adj) {
+    n=A.node_count();
+    deg.resize(n);
+    state.assign(n,2);
+    mark.assign(n,0);
+    queued.assign(n,true);
+    work.resize(n);
+    for (int i=0;i<n;++i) {
+        deg[i]=A.offsets[i+1]-A.offsets[i];
+        work[i]=n-1-i;
+    }
+    stamp=0;
+}
+
+/* remove v from the remaining graph */
+void graphe::vc_kernel::remove(int v,bool in_cover) {
+    assert(state[v]==2);
+    state[v]=in_cover?1:0;
+    for (int k=A.offsets[v];k<A.offsets[v+1];++k) {
+        int u=A.columns[k];
+        if (state[u]!=2)
+            continue;
+        --deg[u];
+        if (!queued[u]) {
+            queued[u]=true;
+            work.push_back(u);
+        }
+    }
+}
+
+/* apply the local rules to v, which is remaining */
+void graphe::vc_kernel::reduce_vertex(int v) {
+    if (deg[v]==0) {
+        remove(v,false);
+        return;
+    }
+    if (deg[v]==1) {
+        for (int k=A.offsets[v];k<A.offsets[v+1];++k) {
+            if (state[A.columns[k]]==2) {
+                remove(A.columns[k],true);
+                break;
+            }
+        }
+        return;
+    }
+    /* mark N[v] and count |N(u) ∩ N[v]| for each remaining neighbor u, which includes v */
+    ++stamp;
+    mark[v]=stamp;
+    for (int k=A.offsets[v];k<A.offsets[v+1];++k) {
+        if (state[A.columns[k]]==2)
+            mark[A.columns[k]]=stamp;
+    }
+    for (int k=A.offsets[v];k<A.offsets[v+1];++k) {
+        int u=A.columns[k],c=0;
+        if (state[u]!=2)
+            continue;
+        for (int l=A.offsets[u];l<A.offsets[u+1];++l) {
+            int w=A.columns[l];
+            if (state[w]==2 && mark[w]==stamp)
+                ++c;
+        }
+        if (deg[u]<=deg[v] && c==deg[u]) { // N[u] is contained in N[v]
+            remove(v,true);
+            return;
+        }
+        if (deg[u]>=deg[v] && c==deg[v]) { // N[v] is contained in N[u]
+            remove(u,true);
+            if (!queued[v]) {
+                queued[v]=true;
+                work.push_back(v);
+            }
+            return;
+        }
+    }
+}
+
+/* compute a half-integral optimal solution x of the LP relaxation from a minimum vertex
+ * cover of the bipartite double cover, which is obtained by the Hopcroft-Karp algorithm
+ * and the theorem of Kőnig, and remove the vertices with x!=1/2 */
+bool graphe::vc_kernel::crown_reduction() {
+    ivector V,pos(n,-1);
+    for (int i=0;i<n;++i) {
+        if (state[i]==2) {
+            pos[i]=V.size();
+            V.push_back(i);
+        }
+    }
+    int r=V.size();
+    if (r==0)
+        return false;
+    /* left copy of the i-th vertex is i, the right copy is r+i */
+    ivector mate(2*r,-1),dist(r),queue,stack,it(r);
+    const int inf=std::numeric_limits<int>::max();
+    while (true) {
+        /* BFS from the free left vertices */
+        queue.clear();
+        bool found=false;
+        for (int i=0;i<r;++i) {
+            if (mate[i]<0) {
+                dist[i]=0;
+                queue.push_back(i);
+            } else dist[i]=inf;
+        }
+        for (size_t q=0;q<queue.size();++q) {
+            int i=queue[q],v=V[i];
+            for (int k=A.offsets[v];k<A.offsets[v+1];++k) {
+                int j=pos[A.columns[k]];
+                if (j<0)
+                    continue;
+                int l=mate[r+j];
+                if (l<0)
+                    found=true;
+                else if (dist[l]==inf) {
+                    dist[l]=dist[i]+1;
+                    queue.push_back(l);
+                }
+            }
+        }
+        if (!found)
+            break;
+        /* DFS along shortest augmenting paths, it[i] is the current edge of the i-th vertex */
+        for (int i=0;i<r;++i) {
+            it[i]=A.offsets[V[i]];
+        }
+        for (int s=0;s<r;++s) {
+            if (mate[s]>=0)
+                continue;
+            stack.assign(1,s);
+            while (!stack.empty()) {
+                int i=stack.back(),v=V[i],l=-1;
+                bool free_found=false;
+                for (;it[i]<A.offsets[v+1];++it[i]) {
+                    int j=pos[A.columns[it[i]]];
+                    if (j<0)
+                        continue;
+                    if ((l=mate[r+j])<0) {
+                        free_found=true;
+                        break;
+                    }
+                    if (dist[l]==dist[i]+1)
+                        break;
+                }
+                if (free_found) { // augment along the stack
+                    for (ivector_iter st=stack.begin();st!=stack.end();++st) {
+                        int j=pos[A.columns[it[*st]]];
+                        mate[*st]=r+j;
+                        mate[r+j]=*st;
+                        dist[*st]=inf;
+                    }
+                    break;
+                }
+                if (it[i]==A.offsets[v+1]) {
+                    dist[i]=inf;
+                    stack.pop_back();
+                } else stack.push_back(l);
+            }
+        }
+    }
+    /* alternating BFS from the free left vertices */
+    bvector zl(r,false),zr(r,false);
+    queue.clear();
+    for (int i=0;i<r;++i) {
+        if (mate[i]<0) {
+            zl[i]=true;
+            queue.push_back(i);
+        }
+    }
+    for (size_t q=0;q<queue.size();++q) {
+        int i=queue[q],v=V[i];
+        for (int k=A.offsets[v];k<A.offsets[v+1];++k) {
+            int j=pos[A.columns[k]];
+            if (j<0 || zr[j])
+                continue;
+            zr[j]=true;
+            int l=mate[r+j];
+            if (l>=0 && !zl[l]) {
+                zl[l]=true;
+                queue.push_back(l);
+            }
+        }
+    }
+    /* the cover is (L\Z) ∪ (R∩Z), x is the average of the two copies */
+    bool changed=false;
+    for (int i=0;i<r;++i) {
+        bool lc=!zl[i],rc=zr[i];
+        if (lc && rc) {
+            remove(V[i],true);
+            changed=true;
+        }
+    }
+    for (int i=0;i<r;++i) {
+        bool lc=!zl[i],rc=zr[i];
+        if (!lc && !rc) {
+            remove(V[i],false);
+            changed=true;
+        }
+    }
+    return changed;
+}
+
+/* apply the reduction rules until none of them applies */
+void graphe::vc_kernel::reduce() {
+    GT_PROFILE(profile,"vc_kernel_reduce");
+    do {
+        while (!work.empty()) {
+            int v=work.back();
+            work.pop_back();
+            queued[v]=false;
+            if (state[v]==2)
+                reduce_vertex(v);
+        }
+    } while (crown_reduction());
+}
+
+/* return the number of vertices in the kernel */
+int graphe::vc_kernel::remaining() const {
+    return std::count(state.begin(),state.end(),2);
+}
+
+/* get the vertices which are known to be in a minimum cover */
+void graphe::vc_kernel::get_cover(ivector &cover) const {
+    cover.clear();
+    for (int i=0;i<n;++i) {
+        if (state[i]==1)
+            cover.push_back(i);
+    }
+}
+
+/* get the connected components of the kernel, the biggest first */
+void graphe::vc_kernel::get_components(ivectors &components) const {
+    components.clear();
+    bvector seen(n,false);
+    ivectors comp;
+    ipairs order;
+    for (int s=0;s<n;++s) {
+        if (state[s]!=2 || seen[s])
+            continue;
+        comp.push_back(ivector(1,s));
+        ivector &C=comp.back();
+        seen[s]=true;
+        for (size_t q=0;q<C.size();++q) {
+            int v=C[q];
+            for (int k=A.offsets[v];k<A.offsets[v+1];++k) {
+                int u=A.columns[k];
+                if (state[u]==2 && !seen[u]) {
+                    seen[u]=true;
+                    C.push_back(u);
+                }
+            }
+        }
+        std::sort(C.begin(),C.end());
+        order.push_back(std::make_pair(-int(C.size()),int(comp.size())-1));
+    }
+    std::sort(order.begin(),order.end());
+    components.resize(comp.size());
+    for (ipairs_iter it=order.begin();it!=order.end();++it) {
+        components[it-order.begin()].swap(comp[it->second]);
+    }
+}
+
+/*
+ * END OF VC_KERNEL CLASS IMPLEMENTATION
+ */
+
+/* Branch&bound for minimum vertex cover of a connected kernel component. The vertex v of
+ * maximum degree is either in the cover or all its neighbors are, and in the latter case
+ * v is skipped if its degree is not smaller than the gap to the incumbent. In each node the
+ * isolated, pendant and triangle rules are applied to the vertices whose neighborhoods were
+ * changed by the branching, and the size of a greedy maximal matching is used as the lower
+ * bound. Removals are recorded on a trail and undone on backtracking. */
+
+#define VC_BB_WORK_LIMIT 200000000
+#define VC_BB_MIN_NODES 1000
+
+struct vc_bb_component {
+    graphe::ivector V;          // vertices of the component, in the original graph
+    graphe::csr A;              // adjacency of the component with local indices
+    graphe::ivector deg,state;  // degrees and states (see vc_kernel) in the remaining graph
+    graphe::ivector trail,pending,matched;
+    graphe::ivector cover;      // the best cover found, with local indices
+    int edges,size,best,stamp;
+    long nodes,node_limit;
+    bool aborted;
+};
+
+struct vc_bb_data {
+    const graphe::csr *A;
+    std::vector<vc_bb_component> *components;
+    bool limited;
+};
+
+static void vc_bb_remove(vc_bb_component &c,int v,bool in_cover) {
+    c.state[v]=in_cover?1:0;
+    c.trail.push_back(v);
+    c.edges-=c.deg[v];
+    if (in_cover)
+        ++c.size;
+    for (int k=c.A.offsets[v];k<c.A.offsets[v+1];++k) {
+        int u=c.A.columns[k];
+        if (c.state[u]==2) {
+            --c.deg[u];
+            c.pending.push_back(u);
+        }
+    }
+}
+
+static void vc_bb_undo(vc_bb_component &c,size_t mark) {
+    while (c.trail.size()>mark) {
+        int v=c.trail.back();
+        c.trail.pop_back();
+        if (c.state[v]==1)
+            --c.size;
+        c.state[v]=2;
+        for (int k=c.A.offsets[v];k<c.A.offsets[v+1];++k) {
+            int u=c.A.columns[k];
+            if (c.state[u]==2)
+                ++c.deg[u];
         }
+        c.edges+=c.deg[v];
     }
-    bool changed;
-    int s=sg<0?1:sg;
-    /* try to reduce the uncovered part of G */
-    do {
-        changed=false;
-        for (int k=0;k<n;++k) {
-            int i=sg<0?k:V[k];
-            vertex &v=G->node(i);
-            if (v.subgraph()==s) {
-                if (G->degree(i,s)==1) {
-                    make_vertex_fixed(p,i,false);
-                    int j=G->first_neighbor_from_subgraph(G->node(i),s);
-                    make_vertex_fixed(p,j,true);
-                    ++cov_lbound;
-                    G->node(i).set_subgraph(0);
-                    G->node(j).set_subgraph(0);
-                    changed=true;
-                    break;
-                } else if (G->mvc_is_dominant(i,s) || G->mvc_is_unconfined(i,s)) {
-                    make_vertex_fixed(p,i,true);
-                    ++cov_lbound;
-                    G->node(i).set_subgraph(0);
-                    changed=true;
-                    break;
-                }
+}
+
+/* apply the isolated, pendant and triangle rules to the pending vertices */
+static void vc_bb_reduce(vc_bb_component &c) {
+    while (!c.pending.empty()) {
+        int v=c.pending.back(),a=-1,b=-1;
+        c.pending.pop_back();
+        if (c.state[v]!=2 || c.deg[v]>2)
+            continue;
+        if (c.deg[v]==0) {
+            vc_bb_remove(c,v,false);
+            continue;
+        }
+        for (int k=c.A.offsets[v];k<c.A.offsets[v+1];++k) {
+            int u=c.A.columns[k];
+            if (c.state[u]==2) {
+                if (a<0) a=u; else b=u;
             }
         }
-    } while (changed);
-    cov_lbound+=lower_bound(s);
-    if (cov_lbound>(int)glp_get_row_lb(p,last_row))
-        glp_set_row_bnds(p,last_row,GLP_LO,cov_lbound,0);
-    if (sg<0)
-        G->unset_subgraphs();
-    else G->set_subgraph(V,sg);
+        if (b<0)
+            vc_bb_remove(c,a,true);
+        else {
+            int k=c.A.offsets[a];
+            for (;k<c.A.offsets[a+1] && c.A.columns[k]!=b;++k);
+            if (k==c.A.offsets[a+1])
+                continue;
+            vc_bb_remove(c,a,true);
+            vc_bb_remove(c,b,true);
+        }
+    }
 }
 
-void graphe::mvc_solver::packing(glp_tree *tree) {
-    glp_prob *p=glp_ios_get_prob(tree);
-    int n=sg<0?G->node_count():V.size();
-    bool in_cover;
-    int *ind=new int[n+1];
-    double *val=new double[n+1];
-    int cnt=0;
-    for (int i=0;i<n;++i) {
-        int v=sg<0?i:V[i];
-        if (is_vertex_fixed(p,v,in_cover) && in_cover) {
-            ivector nv=G->node(v).neighbors();
-            for (int j=nv.size();j-->0;) {
-                if (sg>=0 && G->node(nv[j]).subgraph()!=sg)
-                    nv.erase(nv.begin()+j);
-            }
-            double sum=0;
-            for (ivector_iter it=nv.begin();it!=nv.end();++it) {
-                sum+=glp_get_col_prim(p,(sg<0?*it:V_pos[*it])+1);
-            }
-            if (sum>nv.size()-0.999) {
-                /* add packing constraint */
-                int r=glp_add_rows(p,1);
-                for (ivector_iter it=nv.begin();it!=nv.end();++it) {
-                    ind[it-nv.begin()+1]=(sg<0?*it:V_pos[*it])+1;
-                    val[it-nv.begin()+1]=1;
-                }
-                glp_set_mat_row(p,r,nv.size(),ind,val);
-                glp_set_row_bnds(p,r,GLP_UP,0,nv.size()-1);
-                ++cnt;
+/* the size of a greedy maximal matching in the remaining graph */
+static int vc_bb_lower_bound(vc_bb_component &c) {
+    int n=c.V.size(),lb=0;
+    ++c.stamp;
+    for (int v=0;v<n;++v) {
+        if (c.state[v]!=2 || c.matched[v]==c.stamp)
+            continue;
+        for (int k=c.A.offsets[v];k<c.A.offsets[v+1];++k) {
+            int u=c.A.columns[k];
+            if (c.state[u]==2 && c.matched[u]!=c.stamp) {
+                c.matched[u]=c.matched[v]=c.stamp;
+                ++lb;
+                break;
             }
         }
     }
-    //if (cnt>0) std::cout << "Added " << cnt << " packing constraints\n";
-    delete[] ind;
-    delete[] val;
+    return lb;
 }
 
-void graphe::mvc_solver::callback(glp_tree *tree,void *info) {
-    mvc_solver *mvcs=static_cast<mvc_solver*>(info);
-    switch (glp_ios_reason(tree)) {
-    case GLP_IBRANCH:
-        /* choose a variable to branch upon */
-        mvcs->branch(tree);
-        break;
-    case GLP_IHEUR:
-        /* obtain a heuristic solution */
-        if (mvcs->compute_heur) {
-            mvcs->heuristic(tree);
-            glp_ios_heur_sol(tree,mvcs->heur_sol);
-            //mvcs->compute_heur=false;
+static void vc_bb_search(vc_bb_component &c) {
+    if (c.aborted)
+        return;
+    if (c.node_limit>0 && ++c.nodes>c.node_limit) {
+        c.aborted=true;
+        return;
+    }
+    size_t mark=c.trail.size();
+    vc_bb_reduce(c);
+    int n=c.V.size(),v=-1;
+    if (c.edges==0) {
+        if (c.size<c.best) {
+            c.best=c.size;
+            c.cover.clear();
+            for (int i=0;i<n;++i) {
+                if (c.state[i]==1)
+                    c.cover.push_back(i);
+            }
         }
-        break;
-    case GLP_IROWGEN:
-        /* generate packing constraints */
-        mvcs->packing(tree);
-        break;
-    case GLP_IPREPRO:
-        /* preprocess subproblem */
-        if (!mvcs->is_k_vc)
-            mvcs->preprocess(tree);
-        break;
-    default:
-        /* ignore call for other reasons */
-        break;
+        vc_bb_undo(c,mark);
+        return;
     }
-}
+    if (c.size+vc_bb_lower_bound(c)>=c.best) {
+        vc_bb_undo(c,mark);
+        return;
+    }
+    for (int i=0;i<n;++i) {
+        if (c.state[i]==2 && (v<0 || c.deg[i]>c.deg[v]))
+            v=i;
+    }
+    size_t branch=c.trail.size();
+    vc_bb_remove(c,v,true);
+    vc_bb_search(c);
+    vc_bb_undo(c,branch);
+    if (c.size+c.deg[v]<c.best) {
+        for (int k=c.A.offsets[v];k<c.A.offsets[v+1];++k) {
+            int u=c.A.columns[k];
+            if (c.state[u]==2)
+                vc_bb_remove(c,u,true);
+        }
+        vc_bb_remove(c,v,false);
+        vc_bb_search(c);
+    }
+    vc_bb_undo(c,mark);
+}
+
+/* solve the components first,..,last-1, which are sorted by size in decreasing order */
+static void vc_bb_worker(int first,int last,int thread,void *data) {
+    vc_bb_data &d=*(vc_bb_data*)data;
+    const graphe::csr &A=*d.A;
+    for (int i=first;i<last;++i) {
+        vc_bb_component &c=(*d.components)[i];
+        int n=c.V.size();
+        /* build the local adjacency */
+        std::map<int,int> pos;
+        for (int j=0;j<n;++j) {
+            pos[c.V[j]]=j;
+        }
+        c.A.offsets.resize(n+1);
+        c.A.offsets[0]=0;
+        for (int j=0;j<n;++j) {
+            int v=c.V[j];
+            for (int k=A.offsets[v];k<A.offsets[v+1];++k) {
+                std::map<int,int>::const_iterator it=pos.find(A.columns[k]);
+                if (it!=pos.end())
+                    c.A.columns.push_back(it->second);
+            }
+            c.A.offsets[j+1]=c.A.columns.size();
+        }
+        c.deg.resize(n);
+        for (int j=0;j<n;++j) {
+            c.deg[j]=c.A.offsets[j+1]-c.A.offsets[j];
+        }
+        c.state.assign(n,2);
+        c.matched.assign(n,0);
+        c.edges=c.A.columns.size()/2;
+        c.size=c.stamp=0;
+        c.best=n;
+        c.cover.resize(n);
+        for (int j=0;j<n;++j) {
+            c.cover[j]=j;
+        }
+        c.nodes=0;
+        c.node_limit=d.limited?std::max(long(VC_BB_MIN_NODES),long(VC_BB_WORK_LIMIT/(n+c.A.columns.size()))):0;
+        c.aborted=false;
+        vc_bb_search(c);
+        c.pending.clear();
+    }
+}
+
+/* find a minimum vertex cover of this undirected graph by reducing it to a kernel and solving
+ * the connected components of the kernel in parallel, the biggest first. With GLPK, the
+ * components on which the branch&bound exceeds its node limit are solved by mvc_solver.
+ * Return false if an error occurred. */
+bool graphe::mvc_kernelized(ivector &cover) const {
+    GT_PROFILE(profile,"mvc_kernelized");
+    const csr &A=adjacency();
+    vc_kernel K(A);
+    K.reduce();
+    K.get_cover(cover);
+    ivectors comps;
+    K.get_components(comps);
+    GT_COUNT("mvc_kernel_vertices",K.remaining());
+    std::vector<vc_bb_component> bb(comps.size());
+    for (size_t i=0;i<comps.size();++i) {
+        bb[i].V.swap(comps[i]);
+    }
+    vc_bb_data data;
+    data.A=&A;
+    data.components=&bb;
+#ifdef HAVE_LIBGLPK
+    data.limited=true;
+#else
+    data.limited=false;
 #endif
-
-/*
- * END OF MVC SOLVER CLASS IMPLEMENTATION
- */
+    parallel_for(bb.size(),vc_bb_worker,&data,thread_count(bb.size()),1);
+    for (std::vector<vc_bb_component>::const_iterator it=bb.begin();it!=bb.end();++it) {
+        if (it->aborted) {
+#ifdef HAVE_LIBGLPK
+            graphe G(ctx,false);
+            ivector cov;
+            induce_subgraph(it->V,G);
+            G.unset_subgraphs(1);
+            G.mvc(cov,_GT_VC_EXACT,1);
+            if (cov.empty())
+                return false;
+            for (ivector_iter jt=cov.begin();jt!=cov.end();++jt) {
+                cover.push_back(it->V[*jt]);
+            }
+#endif
+            continue;
+        }
+        for (ivector_iter jt=it->cover.begin();jt!=it->cover.end();++jt) {
+            cover.push_back(it->V[*jt]);
+        }
+    }
+    std::sort(cover.begin(),cover.end());
+    return true;
+}
 
 /* handle connected component indexed by sg if it is a tree, cycle or clique,
  * return false otherwise */
@@ -13802,6 +20761,11 @@ void graphe::mvc_half_integral(int sg,ivector &in_cover,ivector &out_cover) {
 /* find a (minimum) vertex cover (of subgraph sg) with respect to
  * the algorithm specification vc_alg */
 void graphe::mvc(ivector &cover,int vc_alg,int sg) {
+    if (sg==0 && vc_alg==_GT_VC_EXACT && !is_directed()) {
+        if (!mvc_kernelized(cover))
+            cover.clear();
+        return;
+    }
     if (sg==0) {
         int s=2,last_cov_size=0,cov_size;
         unset_subgraphs(s);
@@ -14110,6 +21074,15 @@ int graphe::k_vertex_cover(ivector &cover,int k) {
 
 /* return vertex cover number of this graph */
 int graphe::vertex_cover_number() {
+    ivector cover;
+    if (is_directed()) {
+        graphe G(ctx,false);
+        underlying(G);
+        return G.vertex_cover_number();
+    }
+    if (mvc_kernelized(cover))
+        return cover.size();
+    /* the kernel could not be solved, handle the components separately */
     ivector V1,V2;
     int sg=0,res=0;
     ivectors components;
@@ -14226,237 +21199,351 @@ void graphe::find_simplicial_vertices(ivector &res) {
     }
 }
 
-/* SIP CLASS IMPLEMENTATION */
+/* SUBGRAPH MATCHER CLASS IMPLEMENTATION
+ *
+ * The pattern P is matched against the target G vertex by vertex in a static
+ * order: the first vertex has the smallest domain and each next one has the
+ * most ordered neighbors (then the largest degree), as in VF2++ (Juttner and
+ * Madarasi, 2018). The candidates for a vertex are the neighbors of the image
+ * of an earlier neighbor, filtered by its domain. Domains are word-packed
+ * bitsets over the target vertices computed up front from the colors, the
+ * degrees and the neighborhood degree sequences, as in the Glasgow solver
+ * (McCreesh and Prosser, 2015). The subtrees rooted at the candidates for the
+ * first vertex are searched in parallel. Embeddings are either counted or
+ * collected, in both cases optionally up to a limit. A limited collection is
+ * searched sequentially, so that the embeddings found do not depend on the
+ * timing of threads. */
+
+struct graphe::subgraph_matcher::state {
+    ivector map;
+    bvector used;
+    longlong count;
+    shared *sh;
+};
 
-/* constructor */
-graphe::sip::sip(const graphe &G,const graphe &P,int max_sg_in) {
+struct graphe::subgraph_matcher::shared {
+    bool collect;
+    longlong limit,total;
+    volatile bool stop;
+    const subgraph_matcher *matcher;
+    ivectors found;
+    std::vector<state> states;
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_t mutex;
+#endif
+};
+
+struct subgraph_domains_data {
+    const graphe::csr *out,*in;
+    const graphe::ivector *gcol,*pcol,*pout,*pin;
+    const graphe::ivectors *pnds;
+    int n,maxd;
+    bool dir,isom;
+    std::vector<std::vector<bitword> > *domains;
+};
+
+/* compute the domain bits for the target vertices in the words first,..,last-1 */
+static void subgraph_domains(int first,int last,int thread,void *data) {
+    subgraph_domains_data *d=(subgraph_domains_data*)data;
+    const graphe::csr &out=*d->out,&in=*d->in;
+    int N=out.node_count(),od,id,k;
+    graphe::ivector nds;
+    for (int v=64*first;v<std::min(64*last,N);++v) {
+        od=out.offsets[v+1]-out.offsets[v];
+        id=in.offsets[v+1]-in.offsets[v];
+        if (!d->dir) { // the largest maxd degrees of the neighbors, in decreasing order
+            nds.clear();
+            for (int a=out.offsets[v];a<out.offsets[v+1];++a) {
+                int w=out.columns[a];
+                nds.push_back(out.offsets[w+1]-out.offsets[w]);
+            }
+            int sz=std::min(d->maxd,int(nds.size()));
+            std::partial_sort(nds.begin(),nds.begin()+sz,nds.end(),std::greater<int>());
+        }
+        for (int u=0;u<d->n;++u) {
+            if ((*d->pcol)[u]!=(*d->gcol)[v])
+                continue;
+            int po=(*d->pout)[u],pi=(*d->pin)[u];
+            if (d->isom?(po!=od || pi!=id):(po>od || pi>id))
+                continue;
+            if (!d->dir) {
+                const graphe::ivector &s=(*d->pnds)[u];
+                for (k=0;k<int(s.size()) && s[k]<=nds[k];++k);
+                if (k<int(s.size()))
+                    continue;
+            }
+            (*d->domains)[u][v/64]|=bitword(1)<<(v%64);
+        }
+    }
+}
+
+/* constructor, P is the pattern and G is the target graph */
+graphe::subgraph_matcher::subgraph_matcher(const graphe &G,const graphe &P,bool only_induced) {
     N=G.node_count();
     n=P.node_count();
-    isom=(n==N && G.edge_count()==P.edge_count());
     dir=G.is_directed();
     assert(P.is_directed()==dir);
-    max_sg=max_sg_in;
-    /* initialize adjacency matrices (A is transposed) */
-    matrice PA;
-    P.adjacency_matrix(PA);
-    B.resize(n);
+    induced=only_induced;
+    bool isom=n==N && G.edge_count()==P.edge_count();
+    out=&G.adjacency();
+    if (dir)
+        csr_transpose(*out,in);
+    /* pattern arcs: bit 0 of pm[i][j] is set iff i->j, bit 1 iff j->i */
+    edgemap pm(n);
     for (int i=0;i<n;++i) {
-        B[i].resize(n);
-        for (int j=0;j<n;++j) {
-            B[i][j]=is_one(PA[i][j]);
+        const ivector &ngh=P.node(i).neighbors();
+        for (ivector_iter it=ngh.begin();it!=ngh.end();++it) {
+            pm[i][*it]|=1;
+            pm[*it][i]|=2;
         }
     }
-    used_cols.resize(N,false);
-    A.resize(N); AT.resize(N);
-    nb=N/SIP_NBITS;
-    if (N%SIP_NBITS) ++nb;
-    for (int i=0;i<N;++i) {
-        A[i].resize(nb);
-        AT[i].resize(nb);
-    }
-    for (int i=0;i<N;++i) {
-        const vertex &v=G.node(i);
-        for (ivector_iter it=v.neighbors().begin();it!=v.neighbors().end();++it) {
-            set_ij(A,*it,i,true);
-            set_ij(AT,i,*it,true);
+    ivector pout(n,0),pin(n,0),pcol(n),gcol(N);
+    ivectors pnds(n);
+    int maxd=0;
+    for (int i=0;i<n;++i) {
+        for (map<int,int>::const_iterator it=pm[i].begin();it!=pm[i].end();++it) {
+            if (it->second & 1) ++pout[i];
+            if (it->second & 2) ++pin[i];
+            if (!dir)
+                pnds[i].push_back(pm[it->first].size());
+        }
+        std::sort(pnds[i].begin(),pnds[i].end(),std::greater<int>());
+        maxd=std::max(maxd,int(pm[i].size()));
+        pcol[i]=P.get_node_color(i);
+    }
+    for (int j=0;j<N;++j) {
+        gcol[j]=G.get_node_color(j);
+    }
+    /* compute the domains */
+    int nw=(N+63)/64;
+    domains.assign(n,std::vector<bitword>(nw,0));
+    subgraph_domains_data data;
+    data.out=out;
+    data.in=dir?&in:out;
+    data.gcol=&gcol;
+    data.pcol=&pcol;
+    data.pout=&pout;
+    data.pin=&pin;
+    data.pnds=&pnds;
+    data.n=n;
+    data.maxd=maxd;
+    data.dir=dir;
+    data.isom=isom;
+    data.domains=&domains;
+    parallel_for(nw,subgraph_domains,&data,thread_count(int(std::min(longlong(RAND_MAX),(longlong(n)*N+out->arc_count())>>16))),16);
+    /* order the pattern vertices */
+    ivector dsize(n,0),conn(n,0),rank(n,-1);
+    for (int u=0;u<n;++u) {
+        for (int w=0;w<nw;++w) dsize[u]+=bit_count(domains[u][w]);
+    }
+    order.clear();
+    for (int k=0;k<n;++k) {
+        int best=-1;
+        for (int u=0;u<n;++u) {
+            if (rank[u]>=0)
+                continue;
+            if (best<0 || conn[u]>conn[best])
+                best=u;
+            else if (conn[u]==conn[best]) {
+                int du=pm[u].size(),db=pm[best].size();
+                if (conn[u]==0?(dsize[u]<dsize[best] || (dsize[u]==dsize[best] && du>db)):
+                               (du>db || (du==db && dsize[u]<dsize[best])))
+                    best=u;
+            }
+        }
+        rank[best]=k;
+        order.push_back(best);
+        for (map<int,int>::const_iterator it=pm[best].begin();it!=pm[best].end();++it) {
+            ++conn[it->first];
         }
     }
-    /* initialize M */
-    M.resize(n);
-    bool cond;
-    for (int i=0;i<n;++i) {
-        M[i].resize(nb);
-        for (int j=0;j<N;++j) {
-            if (isom) {
-                if (dir)
-                    cond=P.in_degree(i)==G.in_degree(j) && P.out_degree(i)==G.out_degree(j);
-                else cond=P.degree(i)==G.degree(j);
-            } else {
-                if (dir)
-                    cond=P.in_degree(i)<=G.in_degree(j) && P.out_degree(i)<=G.out_degree(j);
-                else cond=P.degree(i)<=G.degree(j);
+    /* parents and adjacency checks */
+    parent.assign(n,-1);
+    parent_out.assign(n,true);
+    checks.assign(n,ipairs(0));
+    for (int k=0;k<n;++k) {
+        int u=order[k];
+        for (map<int,int>::const_iterator it=pm[u].begin();it!=pm[u].end();++it) {
+            if (rank[it->first]<k && (parent[k]<0 || rank[it->first]<rank[parent[k]]))
+                parent[k]=it->first;
+        }
+        if (parent[k]>=0)
+            parent_out[k]=(pm[u][parent[k]] & 2)!=0;
+        for (int l=0;l<k;++l) {
+            int w=order[l];
+            map<int,int>::const_iterator it=pm[u].find(w);
+            int mask=it==pm[u].end()?0:it->second;
+            if (mask!=0 || induced)
+                checks[k].push_back(make_pair(w,mask));
+        }
+    }
+    /* candidates for the first vertex */
+    roots.clear();
+    if (n>0) {
+        const std::vector<bitword> &D=domains[order.front()];
+        for (int w=0;w<nw;++w) {
+            for (bitword b=D[w];b!=0;b&=b-1) {
+                roots.push_back(64*w+lowest_bit(b));
             }
-            set_ij(M,i,j,cond && P.get_node_color(i)==G.get_node_color(j));
         }
     }
 }
 
-/* scalar product of r and c, it is assumed that r has exactly one 1 */
-bool graphe::sip::mult_bitrows(const bitrow &r,const bitrow &c) {
-    for (int i=0;i<N;++i) {
-        if (r[i].any())
-            return (r[i] & c[i]).any();
-    }
-    assert(false);
+/* return true iff there is an arc v->w in the target graph */
+bool graphe::subgraph_matcher::has_arc(int v,int w) const {
+    ivector::const_iterator first=out->columns.begin()+out->offsets[v],last=out->columns.begin()+out->offsets[v+1];
+    return std::binary_search(first,last,w);
 }
 
-/* fill row with zeros */
-void graphe::sip::clear_bitrow(bitrow &row) {
-    for (bitrow::iterator it=row.begin();it!=row.end();++it) {
-        it->reset();
+/* return true iff the k-th vertex in the order can be mapped to v */
+bool graphe::subgraph_matcher::feasible(int k,int v,const state &st) const {
+    if (st.used[v] || !in_domain(order[k],v))
+        return false;
+    int x,t;
+    for (ipairs_iter it=checks[k].begin();it!=checks[k].end();++it) {
+        x=st.map[it->first];
+        t=has_arc(v,x)?1:0;
+        if (dir?has_arc(x,v):t!=0)
+            t|=2;
+        if (induced?t!=it->second:(t & it->second)!=it->second)
+            return false;
     }
+    return true;
 }
 
-/* check if M defines an isomorphism */
-bool graphe::sip::is_isomorphism() {
-    bitmatrix prod(n);
-    for (int i=0;i<n;++i) {
-        prod[i].resize(nb);
-        const bitrow &r=M[i];
-        for (int j=0;j<N;++j) {
-            if (mult_bitrows(r,A[j]))
-                set_ij(prod,i,j,true);
-        }
-    }
-    for (int i=0;i<n;++i) {
-        const bitrow &r=M[i];
-        for (int j=0;j<n;++j) {
-            bool p=mult_bitrows(r,prod[j]),q=B[j][i];
-            if ((induced && p!=q) || (!induced && q && !p))
-                return false;
-        }
+/* count or store the embedding in st */
+void graphe::subgraph_matcher::report(state &st) const {
+    shared &sh=*st.sh;
+    if (!sh.collect && sh.limit<=0) {
+        ++st.count;
+        return;
     }
-    return true;
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_lock(&sh.mutex);
+#endif
+    if (sh.collect) {
+        if (sh.limit<=0 || longlong(sh.found.size())<sh.limit)
+            sh.found.push_back(st.map);
+        if (sh.limit>0 && longlong(sh.found.size())>=sh.limit)
+            sh.stop=true;
+    } else if (++sh.total>=sh.limit)
+        sh.stop=true;
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_unlock(&sh.mutex);
+#endif
 }
 
-/* prune matrix M */
-void graphe::sip::prune() {
-    bool changed=true;
-    while (changed) {
-        changed=false;
-        for (int i=0;i<n;++i) {
-            for (int j=0;j<N;++j) {
-                if (get_ij(M,i,j)) {
-                    for (int c=0;c<n;++c) {
-                        const bitrow &r=AT[j],&s=A[j],&m=M[c];
-                        int k=0,sz=r.size();
-                        if (B[i][c]) {
-                            for (k=0;k<sz;++k) {
-                                if ((r[k] & m[k]).any())
-                                    break;
-                            }
-                        }
-                        if (dir && k<sz && B[c][i]) {
-                            for (k=0;k<sz;++k) {
-                                if ((s[k] & m[k]).any())
-                                    break;
-                            }
-                        }
-                        if (k==sz) {
-                            edit(i,j);
-                            changed=true;
-                            break;
-                        }
-                    }
+/* map the k-th vertex in the order and recurse */
+void graphe::subgraph_matcher::extend(int k,state &st) const {
+    const shared &sh=*st.sh;
+    if (k==n) {
+        report(st);
+        return;
+    }
+    int u=order[k],p=parent[k],v;
+    if (p>=0) {
+        const csr &A=parent_out[k]?*out:in;
+        int pv=st.map[p];
+        for (int a=A.offsets[pv];a<A.offsets[pv+1] && !sh.stop;++a) {
+            if (feasible(k,v=A.columns[a],st)) {
+                st.map[u]=v;
+                st.used[v]=true;
+                extend(k+1,st);
+                st.used[v]=false;
+            }
+        }
+    } else {
+        const std::vector<bitword> &D=domains[u];
+        for (int w=0;w<int(D.size()) && !sh.stop;++w) {
+            for (bitword b=D[w];b!=0 && !sh.stop;b&=b-1) {
+                if (feasible(k,v=64*w+lowest_bit(b),st)) {
+                    st.map[u]=v;
+                    st.used[v]=true;
+                    extend(k+1,st);
+                    st.used[v]=false;
                 }
             }
         }
     }
 }
 
-/* undo the last set of changes to M */
-void graphe::sip::revert_changes() {
-    const ipairs &ch=snapshots.top();
-    for (ipairs_iter it=ch.begin();it!=ch.end();++it) {
-        set_ij(M,it->first,it->second,true);
+/* search the subtrees rooted at the candidates first,..,last-1 */
+void graphe::subgraph_matcher::root_task(int first,int last,int thread,void *data) {
+    shared &sh=*(shared*)data;
+    const subgraph_matcher &M=*sh.matcher;
+    state &st=sh.states[thread];
+    int u=M.order.front(),v;
+    for (int i=first;i<last && !sh.stop;++i) {
+        if (M.feasible(0,v=M.roots[i],st)) {
+            st.map[u]=v;
+            st.used[v]=true;
+            M.extend(1,st);
+            st.used[v]=false;
+        }
     }
-    snapshots.pop();
 }
 
-/* return true iff there is a zero-row in M */
-bool graphe::sip::M_has_empty_row() {
-    int k=0;
-    for (;k<n;++k) {
-        const bitrow &mr=M[k];
-        bitrow::const_iterator it=mr.begin();
-        for (;it!=mr.end();++it) {
-            if (it->any())
-                break;
-        }
-        if (it==mr.end())
-            break;
+void graphe::subgraph_matcher::run(shared &sh) const {
+    int nt=n==0 || (sh.collect && sh.limit>0)?1:thread_count(roots.size());
+    sh.matcher=this;
+    sh.total=0;
+    sh.stop=false;
+    sh.states.resize(nt);
+    for (std::vector<state>::iterator it=sh.states.begin();it!=sh.states.end();++it) {
+        it->map.assign(n,-1);
+        it->used.assign(N,false);
+        it->count=0;
+        it->sh=&sh;
     }
-    return k<n;
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_init(&sh.mutex,NULL);
+#endif
+    if (n==0)
+        report(sh.states.front()); // the empty pattern has one embedding
+    else parallel_for(roots.size(),root_task,&sh,nt,1);
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_destroy(&sh.mutex);
+#endif
 }
 
-/* main recursion procedure */
-bool graphe::sip::recurse(int i) {
-    if (i==n) {
-        if (is_isomorphism()) {
-            ivector sg(n);
-            for (int k=0;k<n;++k) {
-                int l=0;
-                for (;l<N;++l) {
-                    if (get_ij(M,k,l))
-                        break;
-                }
-                assert(l<N);
-                sg[k]=l;
-            }
-            found.push_back(sg);
-        }
-    } else {
-        prune();
-        push_changes();
-        if (!M_has_empty_row()) {
-            bitrow row=M[i];
-            clear_bitrow(M[i]);
-            int res;
-            for (int j=0;j<N;++j) {
-                if (!get_j(row,j) || used_cols[j])
-                    continue;
-                set_ij(M,i,j,true);
-                used_cols[j]=true;
-                res=recurse(i+1);
-                used_cols[j]=false;
-                set_ij(M,i,j,false);
-                if (max_sg>0 && res==max_sg)
-                    break;
-            }
-            M[i]=row;
-        }
-        revert_changes(); // revert pruning
+/* return the number of embeddings, stop counting at limit if positive */
+longlong graphe::subgraph_matcher::count(longlong limit) const {
+    shared sh;
+    sh.collect=false;
+    sh.limit=limit;
+    run(sh);
+    if (limit>0)
+        return std::min(sh.total,limit);
+    longlong res=0;
+    for (std::vector<state>::const_iterator it=sh.states.begin();it!=sh.states.end();++it) {
+        res+=it->count;
     }
-    return found.size();
+    return res;
 }
 
-int graphe::sip::find_subgraphs(bool only_induced) {
-    found.clear();
-    while (!snapshots.empty()) snapshots.pop();
-    induced=only_induced;
-    if (M_has_empty_row())
-        return 0;
-    int res=recurse();
-    assert(snapshots.empty());
-    return res;
+/* store at most k embeddings (all if k<=0) to res, sorted lexicographically, where
+ * res[i][j] is the image of the j-th pattern vertex, return their number; if k>0,
+ * these are the first k embeddings in the (sequential) search order */
+int graphe::subgraph_matcher::find(int k,ivectors &res) const {
+    shared sh;
+    sh.collect=true;
+    sh.limit=k;
+    run(sh);
+    std::sort(sh.found.begin(),sh.found.end());
+    res.swap(sh.found);
+    return res.size();
 }
 
-/* END OF SIP CLASS */
+/* END OF SUBGRAPH MATCHER CLASS */
 
-void graphe::subgraph_isomorphism(graphe &P,int max_sg,bool induced,ivectors &res) const {
-    graphe Q(ctx);
-    int m=P.node_count();
-    ipairs d(m);
-    for (int i=0;i<m;++i) {
-        d[i]=std::make_pair(P.node(i).degree(),i);
-    }
-    std::sort(d.begin(),d.end());
-    ivector sigma(m);
-    for (int i=0;i<m;++i) {
-        sigma[i]=d[i].second;
-    }
-    P.isomorphic_copy(Q,sigma); // high-degree vertices first
-    sip finder(*this,Q,max_sg);
-    int n=finder.find_subgraphs(induced);
-    res.resize(n);
-    ivector sg;
-    for (int i=0;i<n;++i) {
-        sg=finder.get_subgraph(i);
-        res[i].resize(m);
-        for (int j=0;j<m;++j) {
-            res[i][sigma[j]]=sg[j];
-        }
-    }
+/* find at most max_sg (all if max_sg<=0) embeddings of P into this graph */
+void graphe::subgraph_isomorphism(const graphe &P,int max_sg,bool induced,ivectors &res) const {
+    subgraph_matcher(*this,P,induced).find(max_sg,res);
+}
+
+/* return the number of embeddings of P into this graph, stop counting at limit if positive */
+longlong graphe::subgraph_isomorphism_count(const graphe &P,bool induced,longlong limit) const {
+    return subgraph_matcher(*this,P,induced).count(limit);
 }
 
 /* SPECIAL GRAPHS */
@@ -29,6 +29,7 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <cstdio>
 #include <queue>
 #include <stack>
 #include <set>
@@ -44,7 +45,11 @@
 #define PLASTIC_NUMBER_2 1.75487766625
 #define PLASTIC_NUMBER_3 2.32471795724
 #define MARGIN_FACTOR 0.139680581996 // pow(PLASTIC_NUMBER,-7)
-#define SIP_NBITS 64
+#define DIAL_MAX_WEIGHT 64
+#define FW_BLOCK_SIZE 64
+#define BH_MIN_NODES 128
+#define BH_MAX_DEPTH 32
+#define GT_BINARY_VERSION 1
 
 #ifndef NO_NAMESPACE_GIAC
 namespace giac {
@@ -92,6 +97,129 @@ enum gt_vertex_cover_algorithm {
     _GT_VC_EXACT
 };
 
+enum gt_spectrum_matrix {
+    _GT_SPECTRUM_ADJACENCY,
+    _GT_SPECTRUM_LAPLACIAN,
+    _GT_SPECTRUM_SEIDEL
+};
+
+enum gt_eigenpairs_status {
+    _GT_EIGEN_OK,
+    _GT_EIGEN_INVALID_WEIGHTS,
+    _GT_EIGEN_TOO_LARGE,
+    _GT_EIGEN_NOT_CONVERGED
+};
+
+/* relaxed atomic access to flags and counters shared between threads; without
+ * the GCC atomic builtins, a global lock is taken instead */
+#ifndef __GNUC__
+void gt_atomic_lock();
+void gt_atomic_unlock();
+#endif
+
+template<class T> inline T gt_atomic_load(const T &a) {
+#ifdef __GNUC__
+    return __atomic_load_n(&a,__ATOMIC_RELAXED);
+#else
+    gt_atomic_lock();
+    T v=a;
+    gt_atomic_unlock();
+    return v;
+#endif
+}
+
+template<class T> inline void gt_atomic_store(T &a,T v) {
+#ifdef __GNUC__
+    __atomic_store_n(&a,v,__ATOMIC_RELAXED);
+#else
+    gt_atomic_lock();
+    a=v;
+    gt_atomic_unlock();
+#endif
+}
+
+template<class T> inline void gt_atomic_add(T &a,T n) {
+#ifdef __GNUC__
+    __atomic_fetch_add(&a,n,__ATOMIC_RELAXED);
+#else
+    gt_atomic_lock();
+    a+=n;
+    gt_atomic_unlock();
+#endif
+}
+
+/* set a to v if v is larger */
+template<class T> inline void gt_atomic_raise(T &a,T v) {
+#ifdef __GNUC__
+    T cur=__atomic_load_n(&a,__ATOMIC_RELAXED);
+    while (v>cur && !__atomic_compare_exchange_n(&a,&cur,v,true,__ATOMIC_RELAXED,__ATOMIC_RELAXED));
+#else
+    gt_atomic_lock();
+    if (v>a)
+        a=v;
+    gt_atomic_unlock();
+#endif
+}
+
+enum gt_probe_kind {
+    _GT_PROBE_PHASE,
+    _GT_PROBE_COUNTER,
+    _GT_PROBE_MEMORY
+};
+
+/* lightweight instrumentation of the graph theory and LP engines
+ *
+ * While enabled (by the engine_profile command), each scope object adds its
+ * lifetime to the statistics of the named phase, counters are incremented and
+ * memory high-water marks are recorded. If tracing is on, the individual timed
+ * events are kept as well and can be dumped as a Chrome trace. Every probing
+ * site owns a static slot (see the GT_PROFILE, GT_COUNT and GT_MEMORY macros)
+ * which is updated atomically, without locking; report() merges the slots with
+ * equal names. Names must be string literals. When profiling is disabled each
+ * probe costs a flag test. */
+class gt_profiler {
+public:
+    class probe { // statistics collected at a single probing site
+        const char *m_name;
+        gt_probe_kind m_kind;
+        longlong m_calls;   // number of updates
+        longlong m_total;   // total time in microseconds or counter value
+        longlong m_max;     // maximal time in microseconds or memory peak in bytes
+        probe *m_next;
+        friend class gt_profiler;
+    public:
+        probe(const char *name,gt_probe_kind kind);
+        void count(longlong n=1) { if (is_enabled()) { gt_atomic_add<longlong>(m_calls,1); gt_atomic_add(m_total,n); } }
+        void memory(double bytes) { if (is_enabled()) { gt_atomic_add<longlong>(m_calls,1); gt_atomic_raise(m_max,longlong(bytes)); } }
+    };
+    class scope { // times the enclosing block as the phase of the given probe
+        probe &m_probe;
+        double m_start;
+    public:
+        scope(probe &p) : m_probe(p) { m_start=is_enabled()?clock():-1; }
+        ~scope() { if (m_start>=0) record(m_probe,m_start,clock()); }
+    };
+    static bool is_enabled() { return gt_atomic_load(enabled); }
+    static double clock();
+    static void start(bool trace);
+    static void stop();
+    static gen report();
+    static int write_trace(const std::string &filename);
+private:
+    static bool enabled;
+    static bool tracing;
+    static void record(probe &p,double start,double end);
+};
+
+/* define a probing site named by the string literal name */
+#define GT_PROBE(var,name,kind) static gt_profiler::probe var(name,kind)
+/* time the rest of the enclosing block as the named phase */
+#define GT_PROFILE(var,name) GT_PROBE(var##_probe,name,_GT_PROBE_PHASE); gt_profiler::scope var(var##_probe)
+/* add n to the named counter */
+#define GT_COUNT(name,n) do { GT_PROBE(gt_count_probe,name,_GT_PROBE_COUNTER); gt_count_probe.count(n); } while (0)
+/* record the named memory high-water mark */
+#define GT_MEMORY(name,bytes) do { GT_PROBE(gt_memory_probe,name,_GT_PROBE_MEMORY); gt_memory_probe.memory(bytes); } while (0)
+
 class graphe {
 public:
     typedef std::vector<int> ivector;
@@ -113,8 +241,8 @@ public:
     typedef std::set<int> iset;
     typedef std::vector<bool> bvector;
     typedef std::vector<bvector> bvectors;
-    typedef std::vector<std::bitset<SIP_NBITS> > bitrow;
-    typedef std::vector<bitrow> bitmatrix;
+    typedef void (*parallel_task)(int first,int last,int thread,void *data);
+    typedef bool (*ivector_sink)(const ivector &v,void *data); // consumer of enumerated cycles/paths, returns false to stop
 
     class vertex { // vertex class
         int m_subgraph;
@@ -172,6 +300,7 @@ public:
         const ivector &neighbors() const { return m_neighbors; }
         int degree() const { return m_neighbors.size(); }
         void add_neighbor(int i,const attrib &attr=attrib());
+        void add_neighbors(const int *first,const int *last);
         bool is_temporary(int i) const;
         attrib &neighbor_attributes(int i);
         const attrib &neighbor_attributes(int i) const;
@@ -187,6 +316,7 @@ public:
         int multiedges(int v) const;
         int multiedge_count() const;
         void clear_multiedges() { m_multiedges.clear(); }
+        void copy_multiedges(const vertex &other) { m_multiedges=other.m_multiedges; }
         bool has_multiedges() const { return !m_multiedges.empty(); }
     };
 
@@ -238,15 +368,20 @@ public:
         graphe *G;
         ivector point_stack;
         std::stack<int> marked_stack;
-        ivectors A,res;
+        ivectors A;
         bvector mark;
         int s,lb,ub;
+        ivector_sink sink;
+        void *sink_data;
+        bool stopped;
         void backtrack(int v,bool &f);
     public:
         circ_enum(graphe *gr,int lo=-1,int hi=-1);
-        ivectors find_cycles();
+        void find_cycles(ivector_sink output,void *data);
     };
 
+    class tsp_heuristic;
+
 #ifdef HAVE_LIBGLPK
     class painter { // vertex painter
         graphe *G;
@@ -291,7 +426,8 @@ public:
             _GT_TSP_NO_HEUR                     = 0,
             _GT_TSP_CHRISTOFIDES_SA             = 1,
             _GT_TSP_FARTHEST_INSERTION_HEUR     = 2,
-            _GT_TSP_FARTHEST_INSERTION_RANDOM   = 3
+            _GT_TSP_FARTHEST_INSERTION_RANDOM   = 3,
+            _GT_TSP_LOCAL_SEARCH                = 4
         };
         graphe *G;                              // the graph
         glp_prob *mip;                          // integer programming problem
@@ -322,6 +458,8 @@ public:
         dvector xev;
         dvector obj;
         bvector can_branch;
+        tsp_heuristic *heuristic;               // local search engine for MIP warm starts
+        ivector heuristic_tour;                 // the best tour found by the local search
         void formulate_mip();
         bool get_subtours();
         void add_subtours(const ivectors &sv);
@@ -369,7 +507,6 @@ public:
         tsp(graphe *gr);
         ~tsp();
         int solve(ivector &hc,double &cost);
-        double approx(ivector &hc);
         double tour_cost(const ivector &hc);
     };
     
@@ -414,6 +551,29 @@ public:
     };
 #endif
 
+    class bhtree { // Barnes-Hut quadtree/octree for approximating repulsive forces
+        struct cell {
+            double center[3];   // geometric center
+            double com[3];      // center of mass
+            double half;        // half of the side length
+            int mass;           // number of points in the cell
+            int body;           // index of the first point in a leaf, -1 otherwise
+            int child;          // index of the first of 2^d consecutive children, -1 for a leaf
+        };
+        int dim,nch;
+        const double *X;
+        std::vector<cell> cells;
+        ivector leaf_of,stack;
+        void init_cell(int c,const double *center,double half);
+        int child_index(int c,const double *p) const;
+        void split(int c);
+        void insert(int i);
+    public:
+        bhtree(int d) { assert(d==2 || d==3); dim=d; nch=1<<d; X=NULL; }
+        void build(const dvector &coords);
+        int repulsive_force(int i,double theta,double D,double R,double *f);
+    };
+
     class rectangle { // simple rectangle class
         double m_x,m_y,m_width,m_height;
         bool m_locked_above,m_locked_right;
@@ -444,37 +604,229 @@ public:
         layout *get_layout() const { return L; }
     };
 
-    class cpol {
-        void assign(const cpol &other);
-    public:
-        int nv;
-#if defined HAVE_LIBNAUTY && defined HAVE_NAUTY_NAUTUTIL_H
-        ulong *cg;
-        int *col;
-#else
-        int *adj;
-#endif
-        size_t sz;
-        int frq;
+    struct cpol { // Tutte polynomial of a biconnected graph, keyed by the canonical form of the graph
+        int nv;                 // number of vertices
+        std::vector<ulong> key; // canonical adjacency words followed by vertex colors
+        ulong hash;
+        int frq;                // number of cache hits, halved on each eviction round
         intpoly poly;
-#if defined HAVE_LIBNAUTY && defined HAVE_NAUTY_NAUTUTIL_H
-        cpol() { nv=0; cg=NULL; col=NULL; sz=0; frq=0; }
-#else
-        cpol() { nv=0; adj=NULL; sz=0; frq=0; }
-#endif
-#if defined HAVE_LIBNAUTY && defined HAVE_NAUTY_NAUTUTIL_H
-        cpol(int n,ulong *g,int *c,size_t s,const intpoly &p);
-#else
-        cpol(int n,int *a,size_t s,const intpoly &p);
-#endif
-        cpol(const cpol &other);
-        ~cpol() { }
-        cpol& operator =(const cpol &other);
-#if defined HAVE_LIBNAUTY && defined HAVE_NAUTY_NAUTUTIL_H
-        bool match(int n,ulong *g,int *c) const;
-#else
-        bool match(int n,int *a,int adj_sz) const;
-#endif
+        cpol() { nv=0; hash=0; frq=0; }
+        bool match(int n,const std::vector<ulong> &k,ulong h) const { return hash==h && nv==n && key==k; }
+    };
+
+    class tutte_memo { // bounded hash table of Tutte polynomials with frequency-aware eviction
+        std::vector<cpol> m_entries;
+        ivector m_buckets;  // index of the first entry in each bucket, -1 if the bucket is empty
+        ivector m_next;     // index of the next entry in the same bucket
+        bool m_dirty;       // true iff there are entries not saved to file yet
+        void rehash(int nb);
+        void evict();
+    public:
+        tutte_memo() { m_dirty=false; }
+        static ulong hash_key(int nv,const std::vector<ulong> &key);
+        bool find(int nv,const std::vector<ulong> &key,ulong h,intpoly &p);
+        void insert(int nv,const std::vector<ulong> &key,ulong h,const intpoly &p);
+        void clear();
+        void swap(tutte_memo &other);
+        int size() const { return m_entries.size(); }
+        bool load(const std::string &filename);
+        bool save(const std::string &filename);
+    };
+
+    class private_tutte_cache { // replaces the shared Tutte cache with an empty one, not backed by a file, in the current scope
+        tutte_memo m_saved;
+        std::string m_file;
+        bool m_loaded;
+    public:
+        private_tutte_cache();
+        ~private_tutte_cache();
+    };
+
+    struct compiled_graph { // parsed graph owned jointly by a cache entry and its shared readers
+        graphe *G;
+        int refs;
+    };
+
+    struct compiled_entry { // parsed copy of a graph, tied to the vecteur it was read from
+        gen src;        // holds a reference to the source so that its address stays unique
+        ulong fingerprint; // fingerprint of the source, for detecting in-place modifications
+        compiled_graph *C; // the parsed graph, NULL if the source was seen only once
+        int pins;       // number of compile_graph requests keeping this entry alive
+        ulong stamp;    // time of the last access, for LRU eviction
+    };
+    typedef std::map<const vecteur*,compiled_entry> compiled_map;
+
+    class shared_graph { // read-only graph read from a gen, shared with the compiled graph cache if possible
+        const context *ctx;
+        bool m_attributes;
+        graphe *m_own;
+        compiled_graph *m_shared;
+        const graphe *m_G;
+        shared_graph(const shared_graph &other);
+        shared_graph &operator =(const shared_graph &other);
+    public:
+        shared_graph(const context *contextptr=context0,bool support_attributes=true);
+        ~shared_graph();
+        bool read_gen(const gen &g);
+        const graphe &operator *() const { return *m_G; }
+        const graphe *operator ->() const { return m_G; }
+    };
+
+    struct csr { // compressed sparse row adjacency with numeric arc weights
+        ivector offsets;    // arcs leaving i-th vertex are at positions offsets[i],..,offsets[i+1]-1
+        ivector columns;    // arc heads
+        dvector weights;    // arc weights, empty if the graph is unweighted
+        bool integral;      // true iff all weights are integers
+        double min_weight;
+        double max_weight;
+        csr() { integral=true; min_weight=max_weight=1; }
+        int node_count() const { return offsets.empty()?0:int(offsets.size())-1; }
+        int arc_count() const { return columns.size(); }
+        double weight(int k) const { return weights.empty()?1.0:weights[k]; }
+    };
+
+    class vc_kernel { // reduction rules for minimum vertex cover, applied incrementally
+        const csr &A;
+        int n;
+        ivector deg;    // degrees in the remaining graph
+        ivector state;  // 0: not in cover, 1: in cover, 2: remaining
+        ivector mark;   // membership marks, stamped with the current value of stamp
+        ivector work;   // vertices whose neighborhoods have changed
+        bvector queued;
+        int stamp;
+        void remove(int v,bool in_cover);
+        void reduce_vertex(int v);
+        bool crown_reduction();
+    public:
+        vc_kernel(const csr &adj);
+        void reduce();
+        int vertex_state(int v) const { return state[v]; }
+        int remaining() const;
+        void get_cover(ivector &cover) const;
+        void get_components(ivectors &components) const;
+    };
+
+    struct dsparsemat { // compressed sparse row matrix with double entries
+        int ncols;          // number of columns
+        ivector offsets;    // entries in i-th row are at positions offsets[i],..,offsets[i+1]-1
+        ivector columns;    // column indices, increasing within each row
+        dvector values;     // entry values
+        dsparsemat() { ncols=0; }
+        int row_count() const { return offsets.empty()?0:int(offsets.size())-1; }
+        int nnz() const { return columns.size(); }
+    };
+
+    class traversal_state { // reusable per-vertex arrays for traversals on the adjacency snapshot
+        ivector m_mark;
+        int m_stamp;
+        bvector m_allowed;
+    public:
+        ivector disc;       // discovery times
+        ivector low;        // lowpoints
+        ivector parent;     // parents in the traversal tree
+        ivector pos;        // positions of the next arc to examine, for iterative DFS
+        ivector stack;      // DFS path or BFS queue
+        ivector scc_stack;  // Tarjan's component stack
+        bvector onstack;    // membership in Tarjan's component stack
+        traversal_state() { m_stamp=0; }
+        void reset(int n,bool restricted=false);
+        void allow(int i) { m_allowed[i]=true; }
+        bool allowed(int i) const { return m_allowed.empty() || m_allowed[i]; }
+        bool visited(int i) const { return m_mark[i]==m_stamp; }
+        void visit(int i) { m_mark[i]=m_stamp; }
+    };
+
+    class flow_network { // residual network with native capacities, reusable for many s-t queries
+        ivector m_offsets;  // residual arcs leaving i-th vertex are at m_offsets[i],..,m_offsets[i+1]-1
+        ivector m_heads;    // residual arc heads
+        ivector m_mate;     // index of the reverse residual arc
+        ivector m_arcs;     // residual arc of each arc of the source network
+        dvector m_cap;      // capacities, zero for reverse arcs
+        dvector m_res;      // residual capacities
+        double m_eps;       // residual capacities not above m_eps are considered zero
+        bool m_integral;
+        /* workspace */
+        ivector m_label,m_current,m_queue,m_path,m_next,m_prev,m_active,m_layer;
+        dvector m_excess;
+        void global_relabel(int s,int t);
+        void layer_insert(int v);
+        void layer_remove(int v);
+    public:
+        flow_network() { m_eps=0; m_integral=true; }
+        void assign(const csr &A);
+        void reset() { m_res=m_cap; }
+        int node_count() const { return m_offsets.empty()?0:int(m_offsets.size())-1; }
+        bool is_integral() const { return m_integral; }
+        double arc_flow(int k) const { return m_cap[m_arcs[k]]-m_res[m_arcs[k]]; }
+        double push_relabel(int s,int t);
+        double dinic(int s,int t,double limit=DBL_MAX);
+        void source_side(int s,bvector &side);
+    };
+
+    class tsp_heuristic { // multi-start local search for the symmetric TSP, runs in parallel
+        const context *ctx;
+        int n;
+        csr adj;            // numeric edge weights
+        dvector dense;      // lower triangle of the distance matrix, empty for large instances
+        ivectors cand;      // candidate lists: nearest neighbors sorted by distance
+        double penalty;     // distance between nonadjacent vertices
+    public:
+        tsp_heuristic(const graphe *G,int cand_size=10);
+        int node_count() const { return n; }
+        double distance(int i,int j) const;
+        const ivector &candidates(int i) const { return cand[i]; }
+        double tour_cost(const ivector &hc) const;
+        double solve(ivector &hc,double time_limit=-1,int starts=8) const;
+        double lower_bound(double ub,int max_iter) const;
+    };
+
+    class rng { // xorshift64* pseudorandom generator, for use in worker threads
+        unsigned long long state;
+    public:
+        rng(unsigned long long seed=0);
+        unsigned long long next();
+        int integer(int n) { assert(n>0); return int(next()%(unsigned long long)n); }
+        double uniform() { return double(next()>>11)*(1.0/9007199254740992.0); }
+    };
+
+    class mapped_file { // read-only view of a whole file, memory-mapped when supported
+        const char *m_data;
+        size_t m_size;
+        size_t m_pos;
+        bool m_mapped;
+        mapped_file(const mapped_file &other);
+        mapped_file &operator =(const mapped_file &other);
+    public:
+        mapped_file() { m_data=NULL; m_size=m_pos=0; m_mapped=false; }
+        ~mapped_file() { close(); }
+        bool open(const std::string &filename);
+        void close();
+        const char *data() const { return m_data; }
+        size_t size() const { return m_size; }
+        size_t position() const { return m_pos; }
+        void seek(size_t pos) { m_pos=std::min(pos,m_size); }
+        bool get(char &c) { if (m_pos>=m_size) return false; c=m_data[m_pos++]; return true; }
+        int peek() const { return m_pos<m_size?(unsigned char)m_data[m_pos]:EOF; }
+    };
+
+    class buffered_writer { // file output through a large buffer
+        FILE *m_file;
+        std::vector<char> m_buffer;
+        size_t m_len;
+        bool m_failed;
+        buffered_writer(const buffered_writer &other);
+        buffered_writer &operator =(const buffered_writer &other);
+    public:
+        buffered_writer(size_t bufsize=1<<20) : m_buffer(bufsize) { m_file=NULL; m_len=0; m_failed=false; }
+        ~buffered_writer() { close(); }
+        bool open(const std::string &filename);
+        bool close();
+        void flush();
+        void write(const char *str,size_t len);
+        void write(const std::string &str) { write(str.data(),str.size()); }
+        void put(char c) { if (m_len==m_buffer.size()) flush(); m_buffer[m_len++]=c; }
+        void write_int(longlong a);
+        void write_double(double d);
     };
 
     class ransampl { // random sampling from a given degree distribution
@@ -520,6 +872,52 @@ public:
         void clear();
     };
 
+    /* connectivity and BFS distances of an undirected graph, updated locally as
+     * vertices and edges are added or removed (see graphe::set_incremental) */
+    class dynamic_connectivity {
+        struct source {
+            int root;
+            ivector dist;
+        };
+        bool m_enabled,m_built;
+        unsigned long m_stamp;
+        ivectors m_forest; // spanning forest as adjacency lists
+        ivector m_label; // component labels, merged by m_sets on insertions
+        unionfind *m_sets;
+        int m_capacity,m_next_label,m_count;
+        ivector m_mark,m_side[2];
+        int m_epoch;
+        std::vector<source> m_sources;
+        int next_epoch();
+        void reset_labels();
+        void relabel();
+        int component(int i) { return m_sets->find(m_label[i]); }
+        bool remove_tree_edge(int u,int v);
+        void split(const graphe &G,int u,int v);
+        void compute_source(const graphe &G,source &s);
+        void decrease_distances(const graphe &G,source &s,int u,int v);
+        void increase_distances(const graphe &G,source &s,int u,int v);
+        dynamic_connectivity(const dynamic_connectivity &); // not copyable
+        dynamic_connectivity &operator =(const dynamic_connectivity &);
+    public:
+        static const int inf;
+        dynamic_connectivity();
+        ~dynamic_connectivity() { delete m_sets; }
+        void enable(bool yes);
+        bool enabled() const { return m_enabled; }
+        bool is_synced(unsigned long stamp) const { return m_enabled && m_built && m_stamp==stamp; }
+        void build(const graphe &G,unsigned long stamp);
+        void add_node(unsigned long stamp);
+        void insert(const graphe &G,int u,int v,unsigned long stamp);
+        void remove(const graphe &G,int u,int v,unsigned long stamp);
+        bool connected(int u,int v) { return component(u)==component(v); }
+        int component_count() const { return m_count; }
+        void components(ivectors &comp);
+        void add_source(const graphe &G,int i);
+        void remove_source(int i);
+        bool distances(int i,const ivector &J,ivector &dist) const;
+    };
+
     class ostergard { // clique maximizer
         graphe *G;
         int maxsize;
@@ -547,19 +945,41 @@ public:
                 return is_strictly_greater(b.first,a.first,context0);
             }
         };
+        struct spur_workspace { // per-thread arrays for the numeric spur path searches
+            dvector dist;
+            ivector pred;
+            ivector seen;       // dist and pred of v are valid iff seen[v] equals stamp
+            ivector blocked;    // v may not be used iff blocked[v] equals stamp
+            std::vector<std::pair<double,int> > heap;
+            int stamp;
+            spur_workspace() { stamp=0; }
+        };
+        struct spur_data {
+            const csr *A;
+            int dest;
+            const ivector *path;        // the last selected path
+            const ivectors *banned;     // heads of the removed arcs at each spur vertex
+            ivectors *spurs;            // spur paths, empty if dest is unreachable
+            dvector *costs;             // spur path costs
+            std::vector<spur_workspace> *ws;
+        };
         graphe *G;
         tree_node *root;
-        int src, dest, K;
-        std::vector<tree_node*> kspaths;
+        int src, dest, K, count;
+        ivector_sink sink;
+        void *sink_data;
         tree_node *add_tree_node(tree_node *p);
         tree_node *store_path(const ivector &path,tree_node *r);
-        void select_path(tree_node *p);
+        bool select_path(tree_node *p);
         void restore_path(tree_node *p,ivector &path);
         void delete_children(tree_node *r);
+        void find_symbolic();
+        void find_numeric(const csr &A);
+        static void spur_paths(int first,int last,int thread,void *data);
     public:
         yen(graphe *gr,int s,int d,int k) { G=gr; src=s; dest=d; K=k; root=NULL; }
         ~yen();
-        void find_kspaths(ivectors &paths);
+        void find_kspaths(ivector_sink output,void *data);
     };
 
     class mm { // An efficient implementation of Edmonds' blossom algorithm
@@ -585,31 +1005,30 @@ public:
         void find_maximum_matching(ipairs &matching,int sg=-1);
     };
 
-    class sip { // subgraph isomorphism via Ullmann's algorithm
-        int N,n,max_sg,nb;
-        bitmatrix A,AT,M;
-        bvectors B;
-        bvector used_cols;
-        ivectors found;
-        bool induced,dir,isom;
-        ipairs changes;
-        std::stack<ipairs> snapshots;
-        static void clear_bitrow(bitrow &row);
-        static bool get_j(const bitrow &row,int j) { return row[j/SIP_NBITS].test(j%SIP_NBITS); }
-        static bool get_ij(const bitmatrix &mat,int i,int j) { return get_j(mat[i],j); }
-        static void set_ij(bitmatrix &mat,int i,int j,bool val) { mat[i][j/SIP_NBITS].set(j%SIP_NBITS,val); }
-        bool mult_bitrows(const bitrow &r,const bitrow &c);
-        bool M_has_empty_row();
-        bool recurse(int i=0);
-        void prune();
-        void edit(int i,int j) { set_ij(M,i,j,false); changes.push_back(make_pair(i,j)); }
-        void push_changes() { snapshots.push(changes); changes.clear(); }
-        void revert_changes();
-        bool is_isomorphism();
+    class subgraph_matcher { // VF2++-style subgraph isomorphism with bitset domains, runs in parallel
+        struct state;
+        struct shared;
+        int N,n;
+        bool dir,induced;
+        const csr *out;             // adjacency of the target graph
+        csr in;                     // transposed adjacency of the target graph if it is directed
+        std::vector<std::vector<unsigned long long> > domains; // admissible images of pattern vertices
+        ivector order;              // pattern vertices in the search order
+        ivector parent;             // earlier vertex in the order adjacent to order[k] (-1 if none)
+        bvector parent_out;         // true iff candidates are out-neighbors of the image of parent[k]
+        std::vector<ipairs> checks; // earlier vertices to check at position k with the required arc masks
+        ivector roots;              // candidates for the first vertex in the order
+        bool has_arc(int v,int w) const;
+        bool in_domain(int u,int v) const { return (domains[u][v/64]>>(v%64)) & 1; }
+        bool feasible(int k,int v,const state &st) const;
+        void extend(int k,state &st) const;
+        void report(state &st) const;
+        static void root_task(int first,int last,int thread,void *data);
+        void run(shared &sh) const;
     public:
-        sip(const graphe &G,const graphe &P,int max_sg_in=1);
-        int find_subgraphs(bool only_induced=true);
-        const ivector &get_subgraph(int i) const { return found[i]; }
+        subgraph_matcher(const graphe &G,const graphe &P,bool only_induced);
+        longlong count(longlong limit=0) const;
+        int find(int k,ivectors &res) const;
     };
     
     struct edges_comparator { // for sorting edges by their weight
@@ -668,6 +1087,7 @@ public:
     static const gen FAUX;
     static const gen VRAI;
     static bool verbose;
+    static double barnes_hut_theta;
     static int default_vertex_color;
     static int default_edge_color;
     static int default_vertex_label_color;
@@ -675,7 +1095,14 @@ public:
     static int default_highlighted_vertex_color;
     static int default_edge_width;
     static int bold_edge_width;
-    static std::map<ivector,std::vector<cpol> > cache;
+    static tutte_memo tutte_cache;
+    static int tutte_cache_size;
+    static std::string tutte_cache_file;
+    static bool tutte_cache_loaded;
+    static compiled_map compiled_graphs;
+    static int compiled_cache_size;
+    static int compiled_threshold;
+    static ulong compiled_clock;
     // special graphs
     static const int clebsch_graph[];
     static const char* coxeter_graph[];
@@ -753,6 +1180,15 @@ private:
     ivectors maxcliques;
     std::stack<ivector> saved_subgraphs;
     bool m_supports_attributes;
+    mutable csr m_adjacency;
+    mutable bool m_adjacency_valid;
+    traversal_state m_traversal;
+    dynamic_connectivity m_dynamic;
+    unsigned long m_modifications;
+    void invalidate_adjacency() { m_adjacency_valid=false; ++m_modifications; }
+    bool dynamic_synced() const { return !is_directed() && m_dynamic.is_synced(m_modifications); }
+    bool dynamic_sync();
+    void start_traversal(int sg);
     void clear_node_stack();
     void clear_node_queue();
     void message(const char *str) const;
@@ -761,13 +1197,21 @@ private:
     void message(const char *format,int a,int b,int c) const;
     std::string giac_version() const;
     vertex &node(int i) { return nodes[i]; }
-    bool dot_parse_attributes(std::ifstream &dotfile,attrib &attr);
+    bool dot_parse_attributes(mapped_file &dotfile,attrib &attr);
+    int append_node(const gen &v);
+    static ulong compiled_fingerprint(const vecteur &v);
+    static compiled_entry *find_compiled_entry(const gen &g);
+    static const graphe *find_compiled(const gen &g);
+    static void release_compiled(compiled_graph *C);
+    static void evict_compiled(int keep);
+    bool read_compiled(const gen &g);
+    void register_compiled(const gen &g,bool force=false) const;
     static bool insert_attribute(attrib &attr,int key,const gen &val,bool overwrite=true);
     static bool remove_attribute(attrib &attr,int key);
     static bool genmap2attrib(const gen_map &m,attrib &attr);
     static void attrib2genmap(const attrib &attr,gen_map &m);
     static void copy_attributes(const attrib &src,attrib &dest);
-    void write_attrib(std::ofstream &dotfile,const attrib &attr) const;
+    void write_attrib(buffered_writer &dotfile,const attrib &attr) const;
     static ivector_iter binsearch(ivector_iter first,ivector_iter last,int a);
     static size_t sets_union(const iset &A,const iset &B,iset &U);
     static size_t sets_intersection(const iset &A,const iset &B,iset &I);
@@ -799,18 +1243,19 @@ private:
     static bool sparse_matrix_element(const sparsemat &A,int i,int j,ipair &val);
     static void multiply_sparse_matrices(const sparsemat &A,const sparsemat &B,sparsemat &P,int ncols,bool symmetric=false);
     static gen sparse_product_element(const sparsemat &A, const sparsemat &B,int i,int j);
-    static void transpose_sparsemat(const sparsemat &A,sparsemat &T);
+    static void dsparsemat_transpose(const dsparsemat &A,dsparsemat &T);
+    static void dsparsemat_multiply(const dsparsemat &A,const dsparsemat &B,dsparsemat &C);
+    static void dsparsemat_prolong(const dsparsemat &P,const layout &y,layout &x);
+    void numeric_paths(int src,const ivector &dest,const dvector &dist,const ivector &pred,bool integral,
+                       vecteur &path_weights,ivectors *paths);
     void multilevel_recursion(layout &x,int d,double R,double K,double tol,int depth=0);
-    int mdeg(const ivector &V,int i) const;
-    void coarsening(graphe &G,const sparsemat &P,const ivector &V) const;
-    void tomita(iset &R,iset &P,iset &X,std::map<int,int> &m,int mode=0);
-    int cp_maxclique(ivector &clique);
-    void cp_recurse(ivector &C,ivector &P,ivector &incumbent);
+    void coarsening(graphe &G,const dsparsemat &P,const ivector &V) const;
+    void enumerate_cliques(std::map<int,int> &m,int mode);
     int ost_maxclique(ivector &clique);
     void ost_recursive(ivector &U,int size,int &maxsize,ivector &incumbent,bool &found);
     void find_cut_vertices_dfs(int i,std::set<int> &ap,int sg);
     void find_blocks_dfs(int i,std::vector<ipairs> &blocks,int sg);
-    void find_bridges_dfs(int i,ipairs &B,int sg);
+    void find_bridges_dfs(int i,ipairs &B);
     int find_cycle_dfs(int i,int sg);
     bool find_path_dfs(int dest,int i,int sg,bool skip_embedded);
     static void sort_rectangles(std::vector<rectangle> &rectangles);
@@ -819,8 +1264,8 @@ private:
     static bool point2segment_projection(const point &p,const point &q,const point &r,point &proj);
     void force_directed_placement(layout &x,double K,double R=DBL_MAX,double tol=0.01,bool ac=true);
     static bool get_node_position(const attrib &attr,point &p);
-    void coarsening_mis(const ivector &V,graphe &G,sparsemat &P) const;
-    void coarsening_ec(const ipairs &M,graphe &G,sparsemat &P) const;
+    void coarsening_mis(const ivector &V,graphe &G,dsparsemat &P) const;
+    void coarsening_ec(const ipairs &M,graphe &G,dsparsemat &P) const;
     int best_quadrant(const point &p,const layout &x) const;
     void append_segment(vecteur &drawing, const point &p,const point &q,int color,int width,int style,bool arrow=false) const;
     void append_node(vecteur &drawing,const point &p,int color,int width,int shape) const;
@@ -844,11 +1289,12 @@ private:
     void make_product_nodes(const graphe &G,graphe &P) const;
     static void extract_path_from_cycle(const ivector &cycle,int i,int j,ivector &path);
     static void generate_nk_sets(int n,int k,std::vector<ulong> &v);
-    void strongconnect_dfs(ivectors &components,bvector &onstack,int i,int sg);
+    void strongconnect_dfs(ivectors &components,int i);
     bool degrees_equal(const ivector &v,int deg=0) const;
     void lca_recursion(int u,const ipairs &p,ivector &lca,unionfind &ds);
     void st_numbering_dfs(int i,ivector &preorder);
     void rdfs(int i,ivector &d,bool rec,int sg,bool skip_embedded);
+    void component_dfs(int root,ivector *comp);
     bool is_descendant(int v,int anc) const;
     static int pred(int i,int n);
     static int succ(int i,int n);
@@ -856,15 +1302,12 @@ private:
     void fold_face(const ivector &face,bool subdivide,int &label);
     void find_chords(const ivector &face,ipairs &chords);
     void augment(const ivectors &faces,int outer_face,bool subdivide=false);
-    int saturation_degree(const vertex &v,std::set<int> &colors) const;
-    int uncolored_degree(const vertex &v) const;
     bool is_partially_colored() const;
     void remove_maximal_clique(iset &V) const;
     bool bipartite_matching_bfs(ivector &dist);
     bool bipartite_matching_dfs(int u,ivector &dist);
     static gen make_colon_label(const ivector &v);
     void simplify(graphe &G,bool color_temp_vertices=false) const;
-    intpoly tutte_poly_recurse(int vc);
     static void poly_mult(intpoly &a,const intpoly &b);
     static void poly_add(intpoly &a,const intpoly &b);
     static intpoly poly_geom(int var,int k,bool leading_one,bool add_other_var=false);
@@ -879,7 +1322,6 @@ private:
     static gen ipair2rat(const ipair &p);
     void save_subgraphs();
     void restore_subgraphs();
-    int vertex_pair_connectivity(int v,int w);
     static gen harmonic_mean_exact(gen a,gen b,gen c) { return 3*a*b*c/(a*b+b*c+a*c); }
     static double harmonic_mean(double a,double b,double c) { return 3.0*a*b*c/(a*b+b*c+a*c); }
     void strec(int i,int t,int counter,int np,iset &Q,vecteur &timestamp,vecteur &l);
@@ -896,6 +1338,7 @@ private:
     void mvc_bipartite(const ivector &U,const ivector &V,ivector &cover,int sg=-1);
     ivector alom_candidates(const ivector &V,const vecteur &ds);
     int count_edges_in_Nv(int v,int sg=-1) const;
+    bool mvc_kernelized(ivector &cover) const;
     int count_edges(const ivector &V) const;
     bool is_simplicial(int i,const sparsemat &A,double D=0.0);
     void make_hoffman_singleton_graph();
@@ -935,6 +1378,9 @@ public:
     void read_special(const int *special_graph);
     void read_special(const char **special_graph);
     void copy(graphe &G) const;
+    void copy_topology(graphe &G) const;
+    static bool pin_compiled(const gen &g,bool yes,GIAC_CONTEXT);
+    static void clear_compiled();
     void copy_nodes(const std::vector<vertex> &V);
     bool supports_attributes() const { return m_supports_attributes; }
     void clear();
@@ -964,7 +1410,11 @@ public:
     int *to_array(int &sz,bool reduce=false) const;
     bool write_latex(const std::string &filename,const gen &drawing) const;
     bool write_dot(const std::string &filename) const;
-    bool read_dot(const std::string &filename);
+    bool read_dot(const std::string &filename,bool all_attributes=true,bool weights=true);
+    bool write_edge_list(const std::string &filename) const;
+    bool read_edge_list(const std::string &filename,bool weights=true);
+    bool write_binary(const std::string &filename) const;
+    bool read_binary(const std::string &filename,bool all_attributes=true,bool weights=true);
     bool is_null() const { return nodes.empty(); }
     bool is_empty() const;
     void weight_matrix(matrice &W) const;
@@ -982,6 +1432,10 @@ public:
     const ivector &get_discovered_nodes() const { return disc_nodes; }
     bool is_connected(int sg=-1);
     bool is_biconnected(int sg=-1);
+    void set_incremental(bool yes);
+    bool is_incremental() const { return m_dynamic.enabled(); }
+    void add_distance_source(int i);
+    void remove_distance_source(int i);
     bool is_triconnected(int sg=-1);
     bool is_cycle(ipairs &E,int sg=-1);
     void adjacent_nodes(int i,ivector &adj,bool include_temp_edges=true) const;
@@ -1021,6 +1475,7 @@ public:
     void add_edge(int i,int j,const attrib &attr);
     void add_edge(const ipair &edge) { add_edge(edge.first,edge.second); }
     void add_edge(const ipair &edge,const attrib &attr) { add_edge(edge.first,edge.second,attr); }
+    void add_edges(ipairs &E);
     ipair add_edge(const gen &v,const gen &w,const gen &weight=gen(1));
     ipair add_edge(const gen &v,const gen &w,const attrib &attr);
     void add_temporary_edge(int i,int j);
@@ -1107,11 +1562,12 @@ public:
     int tree_height(int root);
     void clique_stats(std::map<int,int> &m,int mode=0);
     int maximum_clique(ivector &clique);
+    int degeneracy_ordering(ivector &order,ivector *core=NULL) const;
     void greedy_neighborhood_clique_cover_numbers(ivector &cover_numbers);
     bool clique_cover(ivectors &cover,int k=0);
     int maximum_independent_set(ivector &v) const;
     int girth(bool odd=false,int sg=-1);
-    bool hakimi(const ivector &L);
+    bool hakimi(const ivector &L,ipairs *E=NULL);
     void erdos_renyi(double p);
     void preferential_attachment(int d,int o);
     void molloy_reed(const vecteur &p);
@@ -1172,7 +1628,17 @@ public:
     void draw_nodes(vecteur &drawing,const layout &x) const;
     void draw_labels(vecteur &drawing,const layout &x) const;
     void distance(int i,const ivector &J,ivector &dist,ivectors *shortest_paths=NULL);
+    bool make_csr(csr &A,int sg=-1,bool approx=false) const;
+    const csr &adjacency() const;
+    static void csr_dijkstra(const csr &A,int src,dvector &dist,ivector &pred);
+    static void csr_dial(const csr &A,int src,dvector &dist,ivector &pred);
+    static bool csr_bellman_ford(const csr &A,int src,dvector &dist,ivector &pred);
+    static void csr_floyd_warshall(const csr &A,dvector &D);
+    static void csr_allpairs(const csr &A,dvector &D);
+    static void csr_transpose(const csr &A,csr &T);
+    static gen numeric2gen(double d,bool integral);
     void allpairs_distance(matrice &m) const;
+    bool allpairs_distance(dvector &D,bool &integral) const;
     void dijkstra(int src,const ivector &dest,vecteur &path_weights,ivectors *cheapest_paths=NULL,int sg=-1);
     bool bellman_ford(int src,const ivector &dest,vecteur &path_weights,ivectors *cheapest_paths=NULL);
     bool topologic_sort(ivector &ordering);
@@ -1207,35 +1673,52 @@ public:
     bool is_isomorphic(graphe &other,std::map<int,int> &isom);
     gen aut_generators() const;
     bool canonical_labeling(ivector &lab) const;
+    static bool canonical_hashes(const vecteur &g,vecteur &res,GIAC_CONTEXT);
     bool bondy_chvatal_closure(graphe &G,ivector &d);
     int hamcond(bool make_closure=true);
     bool is_hamiltonian(ivector &hc);
     bool hamcycle(ivector &path);
-    int traveling_salesman(ivector &h,double &cost,bool approximate=false);
+    int traveling_salesman(ivector &h,double &cost,bool approximate=false,int time_limit=-1);
     bool find_directed_tours(int k,ivectors &hcv,dvector &costs,const ipairs &incl);
     bool make_euclidean_distances();
     gen maxflow_edmonds_karp(int s,int t,std::vector<std::map<int,gen> > &flow,const gen &limit=plusinf());
+    bool make_flow_network(flow_network &N) const;
+    gen maxflow(int s,int t,std::vector<std::map<int,gen> > *flow=NULL);
     void minimum_cut(int s,const std::vector<std::map<int,gen> > &flow,ipairs &cut);
     gen tutte_polynomial(const gen &x,const gen &y);
+    intpoly tutte_poly_recurse(int vc);
+    void strip_graph_attributes();
     void fundamental_cycles(ivectors &cycles,int sg=-1,bool check=true);
+    bool fundamental_cycles(ivector_sink output,void *data,int sg=-1,bool check=true);
     void mycielskian(graphe &G) const;
     gen local_clustering_coeff(int i) const;
     gen clustering_coeff(bool approx,bool exact);
-    gen transitivity();
+    gen transitivity(bool approx=false);
+    void forward_adjacency(csr &F,ivector &order) const;
+    double wedge_sampling(bool by_wedges,int k) const;
     int edge_connectivity();
     int vertex_connectivity();
     void truncate(graphe &dest,const ivectors &faces);
     void condensation(graphe &G);
     void elementary_cycles(ivectors &cyc,int lo,int hi);
+    void elementary_cycles(ivector_sink output,void *data,int lo,int hi);
     void yen_ksp(int K,int src,int dest,ivectors &paths);
+    void yen_ksp(int K,int src,int dest,ivector_sink output,void *data);
     void compute_in_out_degrees(ivector &ind,ivector &outd) const;
     vecteur distances_from(int k);
     gen betweenness_centrality(int k) const;
-    gen communicability_betweenness_centrality(int k) const;
+    void betweenness_centrality(dvector &cb,double eps=0,double prob=0.1) const;
+    gen communicability_betweenness_centrality(int k,bool approx=false) const;
+    void communicability_betweenness_centrality(int k,dvector &cbc,double tol=1e-10) const;
     gen closeness_centrality(int k,bool harmonic=false) const;
     gen degree_centrality(int k) const;
     vecteur katz_centrality(const gen &att) const;
+    bool katz_centrality(double alpha,dvector &kc,double tol=1e-12) const;
     gen information_centrality(int k,bool approx=false) const;
+    bool information_centrality(dvector &ic,double tol=1e-10) const;
+    bool pagerank(double d,dvector &pr,double tol=1e-12) const;
+    int eigenpairs(int kind,int k,bool smallest,bool deflate,dvector &ev,std::vector<dvector> *evecs=NULL,double tol=1e-10) const;
+    bool log_spanning_tree_count(double &lt) const;
     int splittance(int &m,ivector &vseq) const;
     bool is_split_graph(ivector &clq,ivector &indp) const;
     void contract_subgraph(graphe &G,const ivector &sg,const gen &lb) const;
@@ -1246,15 +1729,19 @@ public:
     bool is_reachable(int u,int v);
     void reachable(int u,ivector &r);
     void find_simplicial_vertices(ivector &res);
-    void subgraph_isomorphism(graphe &P,int max_sg,bool induced,ivectors &res) const;
+    void subgraph_isomorphism(const graphe &P,int max_sg,bool induced,ivectors &res) const;
+    longlong subgraph_isomorphism_count(const graphe &P,bool induced,longlong limit=0) const;
 
     // static methods
     static gen colon_label(int i,int j);
     static gen colon_label(int i,int j,int k);
     static size_t intersect_linear(ivector_iter min1,ivector_iter max1,ivector_iter min2,ivector_iter max2);
+    static size_t intersect_sorted(const int *a,size_t na,const int *b,size_t nb);
     static bool is_graphic_sequence(const ivector &s_orig);
     static ivector_iter insert_sorted(ivector &V,int val);
     static bool erase_sorted(ivector &V,int val);
+    static int thread_count(int work);
+    static void parallel_for(int n,parallel_task task,void *data,int nthreads=0,int chunk=0);
 };
 
 #ifndef NO_NAMESPACE_GIAC
@@ -103,6 +103,12 @@ bool has_suffix(const string &str,const string &suffix)
             str.compare(str.size()-suffix.size(),suffix.size(),suffix)==0;
 }
 
+/* return true iff the file name has a suffix of a plain edge list */
+bool is_edge_list_file(const string &filename) {
+    return has_suffix(filename,".txt") || has_suffix(filename,".el") ||
+            has_suffix(filename,".edges") || has_suffix(filename,".tsv") || has_suffix(filename,".csv");
+}
+
 string strip_string(const string &str) {
     string res(str);
     int i=0;
@@ -1018,7 +1024,10 @@ define_unary_function_ptr5(at_digraph,alias_at_digraph,&__digraph,0,true)
  * Writes the graph G to the file 'graphname.dot' in directory 'path/to' using
  * dot format or store the drawing of G in latex format if third argument is
  * given, where params is an option or a list of options to be passed to
- * the draw_graph command. Returns 1 on success and 0 on failure.
+ * the draw_graph command. If the filename ends with .txt, .el, .edges, .tsv
+ * or .csv, G is written as a plain list of edges (with weights in the third
+ * column). If it ends with .gbin, G is written in the binary graph format.
+ * Returns 1 on success and 0 on failure.
  */
 gen _export_graph(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
@@ -1057,6 +1066,10 @@ gen _export_graph(const gen &g,GIAC_CONTEXT) {
         gen drawing=_draw_graph(args.type==_VECT?change_subtype(args,_SEQ__VECT):gr,contextptr);
         return G.write_latex(filename,drawing);
     }
+    if (is_edge_list_file(filename))
+        return G.write_edge_list(filename)?1:0;
+    if (has_suffix(filename,".gbin"))
+        return G.write_binary(filename)?1:0;
     if (!has_suffix(filename,".dot") && !has_suffix(filename,".gv"))
         filename=filename+".dot";
     return G.write_dot(filename)?1:0;
@@ -1065,24 +1078,68 @@ static const char _export_graph_s[]="export_graph";
 static define_unary_function_eval(__export_graph,&_export_graph,_export_graph_s);
 define_unary_function_ptr5(at_export_graph,alias_at_export_graph,&__export_graph,0,true)
 
-/* USAGE:   import_graph("path/to/graphname[.dot or .gv]")
+/* USAGE:   import_graph("path/to/graphname[.dot or .gv]",[opts])
  *
  * Returns the graph constructed from instructions in the file
  * 'path/to/graphname.dot' (in dot format) or undef on failure.
+ * If the filename ends with .txt, .el, .edges, .tsv or .csv, the file is
+ * read as a plain list of edges, one per line, with optional weights in the
+ * third column. The file is memory-mapped and parsed in place. Files ending
+ * with .gbin are read in the binary graph format, which is memory-mapped and
+ * decoded from the mapping, the topology being copied into the graph.
+ * Supported options are:
+ *  - weighted=<bool>: load only the topology and (if true) the edge weights,
+ *    skipping all other attributes,
+ *  - directed=<bool>: read an edge list as a list of arcs.
  */
 gen _import_graph(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
-    if (g.type!=_STRNG)
+    bool isseq=g.type==_VECT && g.subtype==_SEQ__VECT && !g._VECTptr->empty();
+    const gen &fname=isseq?g._VECTptr->front():g;
+    if (fname.type!=_STRNG)
         return gentypeerr(contextptr);
     graphe G(contextptr);
-    string filename=graphe::genstring2str(g);
+    bool all_attributes=true,weights=true;
+    if (isseq) {
+        for (const_iterateur it=g._VECTptr->begin()+1;it!=g._VECTptr->end();++it) {
+            if (!it->is_symb_of_sommet(at_equal))
+                return generr("Invalid option");
+            const gen &lh=it->_SYMBptr->feuille._VECTptr->front();
+            const gen &rh=it->_SYMBptr->feuille._VECTptr->back();
+            if (!lh.is_integer() || !rh.is_integer())
+                return generr("Unrecognized option");
+            switch (lh.val) {
+            case _GT_WEIGHTED:
+                all_attributes=false;
+                weights=(bool)rh.val;
+                break;
+            case _GT_DIRECTED:
+                G.set_directed((bool)rh.val);
+                break;
+            default:
+                return generr("Unrecognized option");
+            }
+        }
+    }
+    string filename=graphe::genstring2str(fname);
     if (filename.empty())
         return undef;
-    if (!has_suffix(filename,".dot") && !has_suffix(filename,".gv"))
+    bool edgelist=is_edge_list_file(filename),binary=has_suffix(filename,".gbin");
+    if (!edgelist && !binary && !has_suffix(filename,".dot") && !has_suffix(filename,".gv"))
         filename=filename+".dot";
     filename=make_absolute_file_path(filename);
-    if (!G.read_dot(filename))
-        gt_err(_GT_ERR_READING_FAILED);
+    if (binary) {
+        if (!G.read_binary(filename,all_attributes,weights))
+            return gt_err(_GT_ERR_READING_FAILED);
+        return G.to_gen();
+    }
+    if (edgelist) {
+        if (!G.read_edge_list(filename,weights))
+            return gt_err(_GT_ERR_READING_FAILED);
+        return G.to_gen();
+    }
+    if (!G.read_dot(filename,all_attributes,weights))
+        return gt_err(_GT_ERR_READING_FAILED);
     gen_map m;
     gen l;
     for (int i=0;i<G.node_count();++i) {
@@ -1099,16 +1156,43 @@ static const char _import_graph_s[]="import_graph";
 static define_unary_function_eval(__import_graph,&_import_graph,_import_graph_s);
 define_unary_function_ptr5(at_import_graph,alias_at_import_graph,&__import_graph,0,true)
 
+/* USAGE:   compile_graph(G,[pin])
+ *
+ * Keeps the parsed representation of graph G alive between calls, so that
+ * subsequent commands applied to G do not parse it again. If pin is false,
+ * G is released and may be evicted from the cache of compiled graphs.
+ * Returns G.
+ */
+gen _compile_graph(const gen &g,GIAC_CONTEXT) {
+    if (g.type==_STRNG && g.subtype==-1) return g;
+    bool pin=true;
+    const gen &gr=g.type==_VECT && g.subtype==_SEQ__VECT?g._VECTptr->front():g;
+    if (g.type==_VECT && g.subtype==_SEQ__VECT) {
+        const vecteur &gv=*g._VECTptr;
+        if (gv.size()!=2)
+            return gt_err(_GT_ERR_WRONG_NUMBER_OF_ARGS);
+        if (!gv.back().is_integer())
+            return gentypeerr(contextptr);
+        pin=!is_zero(gv.back());
+    }
+    if (!graphe::pin_compiled(gr,pin,contextptr))
+        return gt_err(_GT_ERR_NOT_A_GRAPH);
+    return gr;
+}
+static const char _compile_graph_s[]="compile_graph";
+static define_unary_function_eval(__compile_graph,&_compile_graph,_compile_graph_s);
+define_unary_function_ptr5(at_compile_graph,alias_at_compile_graph,&__compile_graph,0,true)
+
 /* USAGE:   vertices(G)
  *
  * Return list of vertices of graph G.
  */
 gen _graph_vertices(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
-    graphe G(contextptr);
+    graphe::shared_graph G(contextptr);
     if (!G.read_gen(g))
         return gt_err(_GT_ERR_NOT_A_GRAPH);
-    return G.vertices();
+    return G->vertices();
 }
 static const char _graph_vertices_s[]="graph_vertices";
 static define_unary_function_eval(__graph_vertices,&_graph_vertices,_graph_vertices_s);
@@ -1124,7 +1208,7 @@ gen _edges(const gen &g,GIAC_CONTEXT) {
     if (g.type!=_VECT)
         return gentypeerr(contextptr);
     bool include_weights=false;
-    graphe G(contextptr);
+    graphe::shared_graph G(contextptr);
     if (g.subtype==_SEQ__VECT) {
         if (int(g._VECTptr->size())!=2)
             return gt_err(_GT_ERR_WRONG_NUMBER_OF_ARGS);
@@ -1133,9 +1217,9 @@ gen _edges(const gen &g,GIAC_CONTEXT) {
     }
     if (!G.read_gen(g.subtype==_SEQ__VECT?g._VECTptr->front():g))
         return gt_err(_GT_ERR_NOT_A_GRAPH);
-    if (include_weights && !G.is_weighted())
+    if (include_weights && !G->is_weighted())
         return gt_err(_GT_ERR_WEIGHTED_GRAPH_REQUIRED);
-    return change_subtype(G.edges(include_weights),_LIST__VECT);
+    return change_subtype(G->edges(include_weights),_LIST__VECT);
 }
 static const char _edges_s[]="edges";
 static define_unary_function_eval(__edges,&_edges,_edges_s);
@@ -1157,15 +1241,15 @@ gen _has_edge(const gen &g,GIAC_CONTEXT) {
     if (int(gv.back()._VECTptr->size())!=2)
         return gensizeerr(contextptr);
     const vecteur &e=*gv.back()._VECTptr;
-    graphe G(contextptr);
+    graphe::shared_graph G(contextptr);
     if (!G.read_gen(gv.front()))
         return gt_err(_GT_ERR_NOT_A_GRAPH);
-    if (G.is_directed())
+    if (G->is_directed())
         return gt_err(_GT_ERR_UNDIRECTED_GRAPH_REQUIRED);
-    int i=G.node_index(e.front()),j=G.node_index(e.back());
+    int i=G->node_index(e.front()),j=G->node_index(e.back());
     if (i<0 || j<0)
         return gt_err(i<0?e.front():e.back(),_GT_ERR_VERTEX_NOT_FOUND);
-    return graphe::boole(G.has_edge(i,j));
+    return graphe::boole(G->has_edge(i,j));
 }
 static const char _has_edge_s[]="has_edge";
 static define_unary_function_eval(__has_edge,&_has_edge,_has_edge_s);
@@ -1190,15 +1274,15 @@ gen _has_arc(const gen &g,GIAC_CONTEXT) {
         return gensizeerr(contextptr);
     const vecteur &e=*gv.back()._VECTptr;
     bool undirected=gv.back().subtype==_SET__VECT;
-    graphe G(contextptr);
+    graphe::shared_graph G(contextptr);
     if (!G.read_gen(gv.front()))
         return gt_err(_GT_ERR_NOT_A_GRAPH);
-    if (!G.is_directed())
+    if (!G->is_directed())
         return gt_err(_GT_ERR_DIRECTED_GRAPH_REQUIRED);
-    int i=G.node_index(e.front()),j=G.node_index(e.back());
+    int i=G->node_index(e.front()),j=G->node_index(e.back());
     if (i<0 || j<0)
         return gt_err(i<0?e.front():e.back(),_GT_ERR_VERTEX_NOT_FOUND);
-    return graphe::boole(G.has_edge(i,j) && (!undirected || G.has_edge(j,i)));
+    return graphe::boole(G->has_edge(i,j) && (!undirected || G->has_edge(j,i)));
 }
 static const char _has_arc_s[]="has_arc";
 static define_unary_function_eval(__has_arc,&_has_arc,_has_arc_s);
@@ -1320,13 +1404,13 @@ gen _vertex_degree(const gen &g,GIAC_CONTEXT) {
     const vecteur &gv=*g._VECTptr;
     if (gv.size()!=2)
         return gt_err(_GT_ERR_WRONG_NUMBER_OF_ARGS);
-    graphe G(contextptr);
+    graphe::shared_graph G(contextptr);
     if (!G.read_gen(gv.front()))
         return gt_err(_GT_ERR_NOT_A_GRAPH);
-    int i=G.node_index(gv[1]);
+    int i=G->node_index(gv[1]);
     if (i<0)
         return gt_err(gv[1],_GT_ERR_VERTEX_NOT_FOUND);
-    return G.degree(i);
+    return G->degree(i);
 }
 static const char _vertex_degree_s[]="vertex_degree";
 static define_unary_function_eval(__vertex_degree,&_vertex_degree,_vertex_degree_s);
@@ -3147,10 +3231,10 @@ define_unary_function_ptr5(at_list_edge_attributes,alias_at_list_edge_attributes
  */
 gen _number_of_edges(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
-    graphe G(contextptr,false);
+    graphe::shared_graph G(contextptr,false);
     if (!G.read_gen(g))
         return gt_err(_GT_ERR_NOT_A_GRAPH);
-    return G.edge_count();
+    return G->edge_count();
 }
 static const char _number_of_edges_s[]="number_of_edges";
 static define_unary_function_eval(__number_of_edges,&_number_of_edges,_number_of_edges_s);
@@ -3162,10 +3246,10 @@ define_unary_function_ptr5(at_number_of_edges,alias_at_number_of_edges,&__number
  */
 gen _number_of_vertices(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
-    graphe G(contextptr,false);
+    graphe::shared_graph G(contextptr,false);
     if (!G.read_gen(g))
         return gt_err(_GT_ERR_NOT_A_GRAPH);
-    return G.node_count();
+    return G->node_count();
 }
 static const char _number_of_vertices_s[]="number_of_vertices";
 static define_unary_function_eval(__number_of_vertices,&_number_of_vertices,_number_of_vertices_s);
@@ -3179,18 +3263,18 @@ gen _get_edge_weight(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
     if (g.type!=_VECT || g.subtype!=_SEQ__VECT || g._VECTptr->size()!=2)
         return gentypeerr(contextptr);
-    graphe G(contextptr);
+    graphe::shared_graph G(contextptr);
     if (!G.read_gen(g._VECTptr->front()))
         return gt_err(_GT_ERR_NOT_A_GRAPH);
-    if (!G.is_weighted())
+    if (!G->is_weighted())
         return gt_err(_GT_ERR_WEIGHTED_GRAPH_REQUIRED);
     if (g._VECTptr->back().type!=_VECT || g._VECTptr->back()._VECTptr->size()!=2)
         return gt_err(_GT_ERR_INVALID_EDGE);
     const vecteur &E=*g._VECTptr->back()._VECTptr;
-    int i=G.node_index(E.front()),j=G.node_index(E.back());
+    int i=G->node_index(E.front()),j=G->node_index(E.back());
     if (i<0 || j<0)
         return gt_err(i<0?E.front():E.back(),_GT_ERR_VERTEX_NOT_FOUND);
-    return G.weight(i,j);
+    return G->weight(i,j);
 }
 static const char _get_edge_weight_s[]="get_edge_weight";
 static define_unary_function_eval(__get_edge_weight,&_get_edge_weight,_get_edge_weight_s);
@@ -3229,10 +3313,10 @@ define_unary_function_ptr5(at_set_edge_weight,alias_at_set_edge_weight,&__set_ed
  */
 gen _is_directed(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
-    graphe G(contextptr);
+    graphe::shared_graph G(contextptr);
     if (!G.read_gen(g))
         return gt_err(_GT_ERR_NOT_A_GRAPH);
-    return graphe::boole(G.is_directed());
+    return graphe::boole(G->is_directed());
 }
 static const char _is_directed_s[]="is_directed";
 static define_unary_function_eval(__is_directed,&_is_directed,_is_directed_s);
@@ -3250,24 +3334,24 @@ gen _neighbors(const gen &g,GIAC_CONTEXT) {
     if (g.subtype==_SEQ__VECT && g._VECTptr->size()!=2) {
         return gt_err(_GT_ERR_WRONG_NUMBER_OF_ARGS);
     }
-    graphe G(contextptr);
+    graphe::shared_graph G(contextptr);
     if (!G.read_gen(g.subtype==_SEQ__VECT?g._VECTptr->front():g))
         return gt_err(_GT_ERR_NOT_A_GRAPH);
     if (g.subtype==_SEQ__VECT) {
         const gen &v=g._VECTptr->back();
-        int i=G.node_index(v);
+        int i=G->node_index(v);
         if (i<0)
             return gt_err(v,_GT_ERR_VERTEX_NOT_FOUND);
         graphe::ivector adj;
-        G.adjacent_nodes(i,adj);
-        return G.get_node_labels(adj);
+        G->adjacent_nodes(i,adj);
+        return G->get_node_labels(adj);
     } else {
         vecteur res;
-        int n=G.node_count();
+        int n=G->node_count();
         graphe::ivector adj;
         for (int i=0;i<n;++i) {
-            G.adjacent_nodes(i,adj,false);
-            res.push_back(_sort(G.get_node_labels(adj),contextptr));
+            G->adjacent_nodes(i,adj,false);
+            res.push_back(_sort(G->get_node_labels(adj),contextptr));
         }
         return change_subtype(res,_LIST__VECT);
     }
@@ -4654,7 +4738,9 @@ define_unary_function_ptr5(at_shortest_path,alias_at_shortest_path,&__shortest_p
  * computed by using Floyd-Warshall algorithm with complexity O(n^3). If For
  * some vertex pair no path exists, the corresponding entry in D is equal to
  * +infinity. Edges may have positive or negative weights but G shouldn't
- * contain negative cycles.
+ * contain negative cycles. For numeric weights, sparse graphs with nonnegative
+ * weights are handled by running Dijkstra's algorithm from each vertex in
+ * parallel, otherwise a cache-blocked parallel Floyd-Warshall is used.
  */
 gen _allpairs_distance(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
@@ -4693,9 +4779,19 @@ gen _graph_diameter(const gen &g,GIAC_CONTEXT) {
     }
     if (!isconn)
         return graphe::plusinf();
+    int n=G.node_count();
+    graphe::dvector ND;
+    bool integral;
+    if (G.allpairs_distance(ND,integral)) {
+        double md=0;
+        for (graphe::dvector_iter it=ND.begin();it!=ND.end();++it) {
+            if (*it>md && *it<DBL_MAX)
+                md=*it;
+        }
+        return graphe::numeric2gen(md,integral);
+    }
     matrice D;
     G.allpairs_distance(D);
-    int n=G.node_count();
     gen max_dist(symbolic(at_neg,_IDNT_infinity()));
     for (int i=0;i<n;++i) {
         for (int j=0;j<n;++j) {
@@ -5075,15 +5171,14 @@ define_unary_function_ptr5(at_chromatic_number,alias_at_chromatic_number,&__chro
  */
 gen _maximum_independent_set(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
-    graphe G(contextptr),C(contextptr);
+    graphe G(contextptr);
     if (!G.read_gen(g))
         return gt_err(_GT_ERR_NOT_A_GRAPH);
     if (G.is_directed())
         return gt_err(_GT_ERR_UNDIRECTED_GRAPH_REQUIRED);
-    G.complement(C);
-    graphe::ivector clique;
-    C.maximum_clique(clique);
-    vecteur res=C.get_node_labels(clique);
+    graphe::ivector indp;
+    G.maximum_independent_set(indp);
+    vecteur res=G.get_node_labels(indp);
     return _sort(res,contextptr);
 }
 static const char _maximum_independent_set_s[]="maximum_independent_set";
@@ -5097,12 +5192,11 @@ define_unary_function_ptr5(at_maximum_independent_set,alias_at_maximum_independe
  */
 gen _independence_number(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
-    graphe G(contextptr,false),C(contextptr,false);
+    graphe G(contextptr,false);
     if (!G.read_gen(g))
         return gt_err(_GT_ERR_NOT_A_GRAPH);
-    G.complement(C);
-    graphe::ivector clique;
-    return C.maximum_clique(clique);
+    graphe::ivector indp;
+    return G.maximum_independent_set(indp);
 }
 static const char _independence_number_s[]="independence_number";
 static define_unary_function_eval(__independence_number,&_independence_number,_independence_number_s);
@@ -5291,18 +5385,84 @@ static const char _is_arborescence_s[]="is_arborescence";
 static define_unary_function_eval(__is_arborescence,&_is_arborescence,_is_arborescence_s);
 define_unary_function_ptr5(at_is_arborescence,alias_at_is_arborescence,&__is_arborescence,0,true)
 
-/* USAGE:   graph_spectrum(G)
+/* parse the optional arguments k and laplacian of spectrum commands, return false on error */
+static bool parse_spectrum_args(const gen &g,gen &gr,int &k,bool &lap,bool allow_lap) {
+    k=0;
+    lap=false;
+    gr=g;
+    if (g.type!=_VECT || g.subtype!=_SEQ__VECT)
+        return true;
+    const vecteur &gv=*g._VECTptr;
+    if (gv.size()<2 || gv.size()>3)
+        return false;
+    gr=gv.front();
+    for (const_iterateur it=gv.begin()+1;it!=gv.end();++it) {
+        if (allow_lap && *it==at_laplacian && !lap)
+            lap=true;
+        else if (it->is_integer() && it->val!=0 && k==0)
+            k=it->val;
+        else return false;
+    }
+    return true;
+}
+
+/* return the error corresponding to the status returned by graphe::eigenpairs, or 0 */
+static gen eigenpairs_error(int status) {
+    switch (status) {
+    case _GT_EIGEN_INVALID_WEIGHTS:
+        return generr("Edge weights must be nonnegative numbers");
+    case _GT_EIGEN_TOO_LARGE:
+        return generr("Graph is too large for computing that many eigenvalues");
+    case _GT_EIGEN_NOT_CONVERGED:
+        return generr("Eigenvalue iteration did not converge");
+    default:
+        break;
+    }
+    return 0;
+}
+
+/* compute the |k| largest (smallest if k<0) eigenvalues of the given matrix numerically */
+static gen numeric_spectrum(const graphe &G,int kind,int k) {
+    if (G.is_directed())
+        return gt_err(_GT_ERR_UNDIRECTED_GRAPH_REQUIRED);
+    graphe::dvector ev;
+    gen err=eigenpairs_error(G.eigenpairs(kind,std::abs(k),k<0,false,ev));
+    if (!is_zero(err))
+        return err;
+    vecteur res(ev.size());
+    for (int i=0;i<int(ev.size());++i) {
+        res[i]=ev[i];
+    }
+    return res;
+}
+
+/* USAGE:   graph_spectrum(G,[k],[laplacian])
  *
  * Returns the graph spectrum of G. The return value is a list of lists with two
  * elements, each containing an eigenvalue and its multiplicity.
+ * If the option "laplacian" is given, the spectrum of the Laplacian matrix is
+ * returned instead.
+ * If a nonzero integer k is given, the |k| largest (for k>0) or smallest (for
+ * k<0) eigenvalues of an undirected graph G are computed numerically by
+ * Lanczos iteration and returned as a list, with repetitions according to
+ * multiplicities.
  */
 gen _graph_spectrum(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
     graphe G(contextptr,false);
-    if (!G.read_gen(g))
+    gen gr;
+    int k;
+    bool lap;
+    if (!parse_spectrum_args(g,gr,k,lap,true))
+        return gentypeerr(contextptr);
+    if (!G.read_gen(gr))
         return gt_err(_GT_ERR_NOT_A_GRAPH);
+    if (k!=0)
+        return numeric_spectrum(G,lap?_GT_SPECTRUM_LAPLACIAN:_GT_SPECTRUM_ADJACENCY,k);
     matrice A,res;
-    G.adjacency_matrix(A);
+    if (lap)
+        G.laplacian_matrix(A);
+    else G.adjacency_matrix(A);
     vecteur ev=*_eigenvals(A,contextptr)._VECTptr;
     gen_map ev_map;
     for (const_iterateur it=ev.begin();it!=ev.end();++it) {
@@ -5317,16 +5477,25 @@ static const char _graph_spectrum_s[]="graph_spectrum";
 static define_unary_function_eval(__graph_spectrum,&_graph_spectrum,_graph_spectrum_s);
 define_unary_function_ptr5(at_graph_spectrum,alias_at_graph_spectrum,&__graph_spectrum,0,true)
 
-/* USAGE:   seidel_spectrum(G)
+/* USAGE:   seidel_spectrum(G,[k])
  *
  * Returns the Seidel spectrum of G. The return value is a list of lists with two
  * elements, each containing an eigenvalue and its multiplicity.
+ * If a nonzero integer k is given, the |k| largest (for k>0) or smallest (for
+ * k<0) eigenvalues are computed numerically, as in graph_spectrum.
  */
 gen _seidel_spectrum(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
     graphe G(contextptr,false);
-    if (!G.read_gen(g))
+    gen gr;
+    int k;
+    bool lap;
+    if (!parse_spectrum_args(g,gr,k,lap,false))
+        return gentypeerr(contextptr);
+    if (!G.read_gen(gr))
         return gt_err(_GT_ERR_NOT_A_GRAPH);
+    if (k!=0)
+        return numeric_spectrum(G,_GT_SPECTRUM_SEIDEL,k);
     int n=G.node_count();
     matrice A,I,J,res;
     G.adjacency_matrix(A);
@@ -5425,20 +5594,41 @@ static const char _spanning_tree_s[]="spanning_tree";
 static define_unary_function_eval(__spanning_tree,&_spanning_tree,_spanning_tree_s);
 define_unary_function_ptr5(at_spanning_tree,alias_at_spanning_tree,&__spanning_tree,0,true)
 
-/* USAGE:   number_of_spanning_trees(G)
+/* USAGE:   number_of_spanning_trees(G,[approx])
  *
  * Returns the number of spanning trees in the undirected graph G if it is
  * connected, else return the number of spanning forests.
+ * If the option "approx" is given, the number is computed in floating-point
+ * arithmetic from the log-determinant of the Laplacian (which is estimated
+ * by stochastic Lanczos quadrature for large graphs). If it is too large to
+ * be represented as a float, the result is returned as exp(x).
  */
 gen _number_of_spanning_trees(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
     graphe G(contextptr,false);
-    if (!G.read_gen(g))
+    bool approx=false;
+    if (g.type==_VECT && g.subtype==_SEQ__VECT) {
+        const vecteur &gv=*g._VECTptr;
+        if (gv.size()!=2)
+            return gt_err(_GT_ERR_WRONG_NUMBER_OF_ARGS);
+        if (gv.back()!=at_approx)
+            return gentypeerr(contextptr);
+        approx=true;
+    }
+    if (!G.read_gen(approx?g._VECTptr->front():g))
         return gt_err(_GT_ERR_NOT_A_GRAPH);
     if (G.is_null())
         return gt_err(_GT_ERR_GRAPH_IS_NULL);
     if (G.is_directed())
         return gt_err(_GT_ERR_UNDIRECTED_GRAPH_REQUIRED);
+    if (approx) {
+        double lt;
+        if (!G.log_spanning_tree_count(lt))
+            return generr("Edge weights must be positive numbers");
+        if (lt<std::log(DBL_MAX))
+            return std::exp(lt);
+        return symbolic(at_exp,gen(lt));
+    }
     if (!G.is_connected()) {
         gen res(1);
         graphe C(contextptr,false);
@@ -5456,6 +5646,41 @@ static const char _number_of_spanning_trees_s[]="number_of_spanning_trees";
 static define_unary_function_eval(__number_of_spanning_trees,&_number_of_spanning_trees,_number_of_spanning_trees_s);
 define_unary_function_ptr5(at_number_of_spanning_trees,alias_at_number_of_spanning_trees,&__number_of_spanning_trees,0,true)
 
+/* USAGE:   fiedler_vector(G)
+ *
+ * Returns the unit eigenvector corresponding to the second smallest
+ * eigenvalue (the algebraic connectivity) of the Laplacian matrix of the
+ * connected undirected graph G, computed numerically. The signs of its
+ * entries give a spectral bisection of G. Edge weights are taken into
+ * account.
+ */
+gen _fiedler_vector(const gen &g,GIAC_CONTEXT) {
+    if (g.type==_STRNG && g.subtype==-1) return g;
+    graphe G(contextptr);
+    if (!G.read_gen(g))
+        return gt_err(_GT_ERR_NOT_A_GRAPH);
+    if (G.is_directed())
+        return gt_err(_GT_ERR_UNDIRECTED_GRAPH_REQUIRED);
+    if (G.node_count()<2)
+        return generr("Graph must have at least two vertices");
+    if (!G.is_connected())
+        return gt_err(_GT_ERR_CONNECTED_GRAPH_REQUIRED);
+    graphe::dvector ev;
+    std::vector<graphe::dvector> evecs;
+    gen err=eigenpairs_error(G.eigenpairs(_GT_SPECTRUM_LAPLACIAN,1,true,true,ev,&evecs));
+    if (!is_zero(err))
+        return err;
+    const graphe::dvector &v=evecs.front();
+    vecteur res(v.size());
+    for (int i=0;i<int(v.size());++i) {
+        res[i]=v[i];
+    }
+    return res;
+}
+static const char _fiedler_vector_s[]="fiedler_vector";
+static define_unary_function_eval(__fiedler_vector,&_fiedler_vector,_fiedler_vector_s);
+define_unary_function_ptr5(at_fiedler_vector,alias_at_fiedler_vector,&__fiedler_vector,0,true)
+
 /* USAGE:   minimal_spanning_tree(G)
  *
  * Returns the minimal spanning tree of the undirected graph G.
@@ -6019,17 +6244,20 @@ static const char _is_isomorphic_s[]="is_isomorphic";
 static define_unary_function_eval(__is_isomorphic,&_is_isomorphic,_is_isomorphic_s);
 define_unary_function_ptr5(at_is_isomorphic,alias_at_is_isomorphic,&__is_isomorphic,0,true)
 
-/* USAGE:   is_subgraph_isomorphic(G1,G2,[S])
+/* USAGE:   is_subgraph_isomorphic(G1,G2,[S],[opts])
  *
  * Returns true if graph G1 is isomorphic to some subgraph of G2, else returns
  * false. If an identifier 'S' is given, the found subgraph of G2 is stored there.
+ * If the option 'count' is given, the number of embeddings of G1 into G2 is
+ * returned instead. With count=k, counting stops at k.
  */
 gen _is_subgraph_isomorphic(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
     if (g.type!=_VECT || g.subtype!=_SEQ__VECT)
         return gentypeerr(contextptr);
     gen S=undef;
-    bool induced=false;
+    bool induced=false,count=false;
+    longlong limit=0;
     const vecteur &gv=*g._VECTptr;
     if (gv.size()<2)
         return gt_err(_GT_ERR_WRONG_NUMBER_OF_ARGS);
@@ -6043,9 +6271,20 @@ gen _is_subgraph_isomorphic(const gen &g,GIAC_CONTEXT) {
             S=*it;
         if (*it==at_induced_subgraph)
             induced=true;
+        else if (*it==at_count)
+            count=true;
+        else if (it->is_symb_of_sommet(at_equal) && it->_SYMBptr->feuille._VECTptr->front()==at_count) {
+            const gen &v=it->_SYMBptr->feuille._VECTptr->back();
+            if (!v.is_integer() || v.val<=0)
+                return gentypeerr(contextptr);
+            count=true;
+            limit=v.val;
+        }
     }
     if (G1.node_count()>G2.node_count() || G1.edge_count()>G2.edge_count())
-        return graphe::FAUX;
+        return count?gen(0):graphe::FAUX;
+    if (count)
+        return gen(G2.subgraph_isomorphism_count(G1,induced,limit));
     graphe::ivectors res;
     G2.subgraph_isomorphism(G1,1,induced,res);
     if (res.empty())
@@ -6108,6 +6347,31 @@ static const char _canonical_labeling_s[]="canonical_labeling";
 static define_unary_function_eval(__canonical_labeling,&_canonical_labeling,_canonical_labeling_s);
 define_unary_function_ptr5(at_canonical_labeling,alias_at_canonical_labeling,&__canonical_labeling,0,true)
 
+/* USAGE:   canonical_hash(G)
+ *          canonical_hash(L)
+ *
+ * Returns a nonnegative integer which depends only on the isomorphism class of
+ * the input graph G, or the list of such integers for the list L of graphs.
+ * Equal hashes indicate (with high probability) isomorphic graphs, which can
+ * be used to remove duplicates from large lists of graphs.
+ */
+gen _canonical_hash(const gen &g,GIAC_CONTEXT) {
+    if (g.type==_STRNG && g.subtype==-1) return g;
+#if !defined HAVE_LIBNAUTY || !defined HAVE_NAUTY_NAUTUTIL_H
+    return generr("nauty library is required for canonical hashing");
+#else
+    bool single=!(g.type==_VECT && g.subtype!=_GRAPH__VECT && !g._VECTptr->empty() &&
+                  g._VECTptr->front().type==_VECT && g._VECTptr->front().subtype==_GRAPH__VECT);
+    vecteur L=single?vecteur(1,g):*g._VECTptr,res;
+    if (!graphe::canonical_hashes(L,res,contextptr))
+        return gt_err(_GT_ERR_NOT_A_GRAPH);
+    return single?res.front():gen(res,_LIST__VECT);
+#endif
+}
+static const char _canonical_hash_s[]="canonical_hash";
+static define_unary_function_eval(__canonical_hash,&_canonical_hash,_canonical_hash_s);
+define_unary_function_ptr5(at_canonical_hash,alias_at_canonical_hash,&__canonical_hash,0,true)
+
 /* USAGE:   minimal_edge_coloring(G,[sto])
  *
  * Finds the minimal edge coloring of the input graph G and returns the
@@ -6328,7 +6592,7 @@ gen _traveling_salesman(const gen &g,GIAC_CONTEXT) {
             gt_err(_GT_ERR_WEIGHTED_GRAPH_REQUIRED);
         if (!G.is_clique())
             return generr("The input graph must be complete");
-        G.traveling_salesman(h,cost,true);
+        G.traveling_salesman(h,cost,true,time_limit<rand_max2?time_limit:-1);
     } else {
         res=U.is_biconnected()?G.traveling_salesman(h,cost):0;
         if (res==0)
@@ -6395,7 +6659,7 @@ gen _maxflow(const gen &g,GIAC_CONTEXT) {
     if (s<0 || t<0)
         return gt_err(s<0?S:T,_GT_ERR_VERTEX_NOT_FOUND);
     vector<map<int,gen> > flow;
-    gen mf=G.maxflow_edmonds_karp(s,t,flow);
+    gen mf=G.maxflow(s,t,is_undef(M)?NULL:&flow);
     int n=G.node_count();
     if (!is_undef(M)) {
         matrice m=*_matrix(makesequence(n,n,0),contextptr)._VECTptr;
@@ -6435,7 +6699,7 @@ gen _minimum_cut(const gen &g,GIAC_CONTEXT) {
     if (s<0 || t<0)
         return gt_err(s<0?S:T,_GT_ERR_VERTEX_NOT_FOUND);
     vector<map<int,gen> > flow;
-    G.maxflow_edmonds_karp(s,t,flow);
+    G.maxflow(s,t,&flow);
     graphe::ipairs cut;
     G.minimum_cut(s,flow,cut);
     vecteur res=G.ipairs2edges(cut);
@@ -6978,18 +7242,29 @@ static const char _clustering_coefficient_s[]="clustering_coefficient";
 static define_unary_function_eval(__clustering_coefficient,&_clustering_coefficient,_clustering_coefficient_s);
 define_unary_function_ptr5(at_clustering_coefficient,alias_at_clustering_coefficient,&__clustering_coefficient,0,true)
 
-/* USAGE:   network_transitivity(G)
+/* USAGE:   network_transitivity(G,[approx])
  *
- * Returns the transitivity (triangle density) of a graph G.
+ * Returns the transitivity (triangle density) of a graph G. If the option
+ * approx is given, the transitivity of an undirected graph is estimated by
+ * sampling wedges.
  */
 gen _network_transitivity(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
+    bool apprx=false;
+    if (g.type==_VECT && g.subtype==_SEQ__VECT) {
+        const vecteur &gv=*g._VECTptr;
+        if (gv.size()!=2)
+            return gt_err(_GT_ERR_WRONG_NUMBER_OF_ARGS);
+        if (gv.back()!=at_approx)
+            return gentypeerr(contextptr);
+        apprx=true;
+    }
     graphe G(contextptr,false);
-    if (!G.read_gen(g))
+    if (!G.read_gen(apprx?g._VECTptr->front():g))
         return gt_err(_GT_ERR_NOT_A_GRAPH);
     if (G.is_null())
         return gt_err(_GT_ERR_GRAPH_IS_NULL);
-    return G.transitivity();
+    return G.transitivity(apprx);
 }
 static const char _network_transitivity_s[]="network_transitivity";
 static define_unary_function_eval(__network_transitivity,&_network_transitivity,_network_transitivity_s);
@@ -7169,37 +7444,72 @@ static const char _truncate_graph_s[]="truncate_graph";
 static define_unary_function_eval(__truncate_graph,&_truncate_graph,_truncate_graph_s);
 define_unary_function_ptr5(at_truncate_graph,alias_at_truncate_graph,&__truncate_graph,0,true)
 
-/* USAGE:   find_cycles(G,[length=k||lb..ub])
+/* consumer of the vertex sequences enumerated by find_cycles and kspaths, it
+ * collects their labels or writes them to a file, one sequence per line */
+struct sequence_stream {
+    const graphe *G;
+    vecteur *res;
+    ofstream *out;
+    longlong limit,count;
+};
+
+static bool stream_sequence(const graphe::ivector &v,void *data) {
+    sequence_stream *s=(sequence_stream*)data;
+    gen seq=s->G->get_node_labels(v);
+    if (s->out!=NULL)
+        *s->out << seq.print(s->G->giac_context()) << "\n";
+    else s->res->push_back(seq);
+    return ++s->count<s->limit || s->limit<=0;
+}
+
+/* USAGE:   find_cycles(G,[length=k||lb..ub],[limit=n],[filename])
  *
  * Returns the list of elementary cycles of the digraph G. If length option is
  * specified, only cycles of length k resp. of length between lb and ub are
- * returned.
+ * returned. Cycles are enumerated one at a time, the enumeration stops after
+ * n cycles if limit=n is given. If filename is given, the cycles are written
+ * to that file (one per line) instead and their number is returned.
  */
 gen _find_cycles(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
     if (g.type!=_VECT)
         return gentypeerr(contextptr);
     int lb=-1,ub=-1;
+    longlong limit=0;
+    string filename;
     if (g.subtype==_SEQ__VECT) {
-        if (g._VECTptr->size()!=2)
+        const vecteur &gv=*g._VECTptr;
+        if (gv.size()<2 || gv.size()>4)
             return gt_err(_GT_ERR_WRONG_NUMBER_OF_ARGS);
-        if (!g._VECTptr->at(1).is_symb_of_sommet(at_equal))
-            return gensizeerr(contextptr);
-        const gen &opt=g._VECTptr->at(1);
-        if (opt._SYMBptr->feuille._VECTptr->front()!=at_length)
-            return gensizeerr(contextptr);
-        const gen &val=opt._SYMBptr->feuille._VECTptr->back();
-        if (val.is_integer() && val.val>0)
-            lb=ub=val.val;
-        else if (val.is_symb_of_sommet(at_interval)) {
-            const gen &lo=val._SYMBptr->feuille._VECTptr->front();
-            const gen &hi=val._SYMBptr->feuille._VECTptr->back();
-            if (!lo.is_integer() || !hi.is_integer())
+        for (const_iterateur it=gv.begin()+1;it!=gv.end();++it) {
+            if (it->type==_STRNG) {
+                filename=make_absolute_file_path(graphe::genstring2str(*it));
+                continue;
+            }
+            if (!it->is_symb_of_sommet(at_equal))
                 return gensizeerr(contextptr);
-            lb=lo.val;
-            ub=hi.val;
-            if (lb<0 || ub<0 || lb>ub)
+            const gen &opt=it->_SYMBptr->feuille._VECTptr->front();
+            const gen &val=it->_SYMBptr->feuille._VECTptr->back();
+            if (opt==at_limit) {
+                if (!val.is_integer() || val.val<=0)
+                    return gt_err(_GT_ERR_POSITIVE_INTEGER_REQUIRED);
+                limit=val.val;
+                continue;
+            }
+            if (opt!=at_length)
                 return gensizeerr(contextptr);
+            if (val.is_integer() && val.val>0)
+                lb=ub=val.val;
+            else if (val.is_symb_of_sommet(at_interval)) {
+                const gen &lo=val._SYMBptr->feuille._VECTptr->front();
+                const gen &hi=val._SYMBptr->feuille._VECTptr->back();
+                if (!lo.is_integer() || !hi.is_integer())
+                    return gensizeerr(contextptr);
+                lb=lo.val;
+                ub=hi.val;
+                if (lb<0 || ub<0 || lb>ub)
+                    return gensizeerr(contextptr);
+            }
         }
     }
     graphe G(contextptr);
@@ -7209,34 +7519,49 @@ gen _find_cycles(const gen &g,GIAC_CONTEXT) {
         return generr("Graph is empty");
     if (!G.is_directed())
         return gt_err(_GT_ERR_DIRECTED_GRAPH_REQUIRED);
-    graphe::ivectors cyc;
-    G.elementary_cycles(cyc,lb,ub);
     vecteur res;
-    G.ivectors2vecteur(cyc,res,false);
+    ofstream out;
+    sequence_stream data;
+    data.G=&G;
+    data.res=&res;
+    data.out=NULL;
+    data.limit=limit;
+    data.count=0;
+    if (!filename.empty()) {
+        out.open(filename.c_str());
+        if (!out.good())
+            return generr("Failed to open the output file");
+        data.out=&out;
+    }
+    G.elementary_cycles(stream_sequence,&data,lb,ub);
+    if (data.out!=NULL) {
+        out.close();
+        return gen(data.count);
+    }
     return change_subtype(res,_LIST__VECT);
 }
 static const char _find_cycles_s[]="find_cycles";
 static define_unary_function_eval(__find_cycles,&_find_cycles,_find_cycles_s);
 define_unary_function_ptr5(at_find_cycles,alias_at_find_cycles,&__find_cycles,0,true)
 
-/* USAGE:   kspaths(G,u,v,k)
+/* USAGE:   kspaths(G,u,v,k,[filename])
  *
  * Returns the list of k shortest paths between vertices u and v in the
- * (weighted) digraph G.
+ * (weighted) digraph G. If filename is given, the paths are written to that
+ * file (one per line) as they are found and their number is returned.
  */
 gen _kspaths(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
     if (g.type!=_VECT || g.subtype!=_SEQ__VECT)
         return gentypeerr(contextptr);
     const vecteur &gv=*g._VECTptr;
-    if (gv.size()!=4)
+    if (gv.size()<4 || gv.size()>5)
         return gt_err(_GT_ERR_WRONG_NUMBER_OF_ARGS);
     graphe G(contextptr);
     if (!G.read_gen(gv.front()))
         return gt_err(_GT_ERR_NOT_A_GRAPH);
     if (G.is_empty())
         return generr("Graph is empty");
-    graphe::ivectors paths;
     int k,src,dest;
     src=G.node_index(gv[1]);
     dest=G.node_index(gv[2]);
@@ -7244,11 +7569,29 @@ gen _kspaths(const gen &g,GIAC_CONTEXT) {
         return gt_err(src<0?gv[1]:gv[2],_GT_ERR_VERTEX_NOT_FOUND);
     if (src==dest)
         return generr("Source and destination vertices must be different");
-    if (!gv.back().is_integer() || (k=gv.back().val)<=0)
+    if (!gv[3].is_integer() || (k=gv[3].val)<=0)
         return gt_err(_GT_ERR_POSITIVE_INTEGER_REQUIRED);
-    G.yen_ksp(k,src,dest,paths);
     vecteur res;
-    G.ivectors2vecteur(paths,res);
+    ofstream out;
+    sequence_stream data;
+    data.G=&G;
+    data.res=&res;
+    data.out=NULL;
+    data.limit=0;
+    data.count=0;
+    if (gv.size()==5) {
+        if (gv.back().type!=_STRNG)
+            return gentypeerr(contextptr);
+        out.open(make_absolute_file_path(graphe::genstring2str(gv.back())).c_str());
+        if (!out.good())
+            return generr("Failed to open the output file");
+        data.out=&out;
+    }
+    G.yen_ksp(k,src,dest,stream_sequence,&data);
+    if (data.out!=NULL) {
+        out.close();
+        return gen(data.count);
+    }
     return change_subtype(res,_LIST__VECT);
 }
 static const char _kspaths_s[]="kspaths";
@@ -7331,7 +7674,7 @@ define_unary_function_ptr5(at_icomp,alias_at_icomp,&__icomp,0,true)
  * undirected graph G. If v is omitted, the list of IC measures
  * for all vertices is returned, in order as returned by vertices(G).
  * If option "approx" is given, the computation is done with
- * floating-point values.
+ * floating-point values by solving sparse Laplacian systems.
  */
 gen _information_centrality(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
@@ -7357,6 +7700,8 @@ gen _information_centrality(const gen &g,GIAC_CONTEXT) {
         return generr("Graph is empty");
     if (G.is_directed())
         return gt_err(_GT_ERR_UNDIRECTED_GRAPH_REQUIRED);
+    if (!G.is_connected())
+        return gt_err(_GT_ERR_CONNECTED_GRAPH_REQUIRED);
     return G.information_centrality(k,approx);
 }
 static const char _information_centrality_s[]="information_centrality";
@@ -7451,56 +7796,94 @@ static const char _closeness_centrality_s[]="closeness_centrality";
 static define_unary_function_eval(__closeness_centrality,&_closeness_centrality,_closeness_centrality_s);
 define_unary_function_ptr5(at_closeness_centrality,alias_at_closeness_centrality,&__closeness_centrality,0,true)
 
-/* USAGE:   betweenness_centrality(G,[v])
+/* USAGE:   betweenness_centrality(G,[v],[approx[=eps]])
  *
  * Returns the betweenness centrality measure of vertex v in G.
  * If v is omitted, the list of CC measures for all vertices
  * is returned, in order as returned by vertices(G).
- * Edge weights are ignored by this type of centrality.
+ * Edge weights are ignored by this type of centrality. If the option approx
+ * is given, the measures are computed in floating-point arithmetic in
+ * parallel. If approx=eps is given, the measures are estimated by sampling shortest
+ * paths such that the error of normalized values is at most eps with
+ * probability at least 0.9.
  */
 gen _betweenness_centrality(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
     int k=-1;
+    bool apprx=false;
+    double eps=0;
     graphe G(contextptr);
     if (g.type==_VECT && g.subtype==_SEQ__VECT) {
         const vecteur &gv=*g._VECTptr;
-        if (gv.size()!=2)
+        if (gv.size()<2 || gv.size()>3)
             return gt_err(_GT_ERR_WRONG_NUMBER_OF_ARGS);
         if (!G.read_gen(gv.front()))
             return gt_err(_GT_ERR_NOT_A_GRAPH);
-        k=G.node_index(gv.back());
-        if (k==-1)
-            return gt_err(gv.back(),_GT_ERR_VERTEX_NOT_FOUND);
+        for (const_iterateur it=gv.begin()+1;it!=gv.end();++it) {
+            if (*it==at_approx)
+                apprx=true;
+            else if (it->is_symb_of_sommet(at_equal) &&
+                     it->_SYMBptr->feuille._VECTptr->front()==at_approx) {
+                gen e=_evalf(it->_SYMBptr->feuille._VECTptr->back(),contextptr);
+                if (e.type!=_DOUBLE_ || e.DOUBLE_val()<=0 || e.DOUBLE_val()>=1)
+                    return generr("Expected a real number in (0,1)");
+                apprx=true;
+                eps=e.DOUBLE_val();
+            } else if (k<0 && it==gv.begin()+1) {
+                k=G.node_index(*it);
+                if (k==-1)
+                    return gt_err(*it,_GT_ERR_VERTEX_NOT_FOUND);
+            } else return gentypeerr(contextptr);
+        }
     } else if (!G.read_gen(g))
         return gt_err(_GT_ERR_NOT_A_GRAPH);
     if (G.is_empty())
         return generr("Graph is empty");
+    if (apprx) {
+        graphe::dvector cb;
+        G.betweenness_centrality(cb,eps);
+        if (k>=0)
+            return cb[k];
+        vecteur res(cb.size());
+        for (graphe::dvector_iter it=cb.begin();it!=cb.end();++it) {
+            res[it-cb.begin()]=*it;
+        }
+        return res;
+    }
     return G.betweenness_centrality(k);
 }
 static const char _betweenness_centrality_s[]="betweenness_centrality";
 static define_unary_function_eval(__betweenness_centrality,&_betweenness_centrality,_betweenness_centrality_s);
 define_unary_function_ptr5(at_betweenness_centrality,alias_at_betweenness_centrality,&__betweenness_centrality,0,true)
 
-/* USAGE:   communicability_betweenness_centrality(G,[v])
+/* USAGE:   communicability_betweenness_centrality(G,[v],[approx])
  *
  * Returns the communicability betweenness centrality measure of vertex v in G.
  * If v is omitted, the list of CBC measures for all vertices is returned,
  * in order as returned by vertices(G).
+ * If option "approx" is given, the matrix exponentials are approximated
+ * in floating-point arithmetic by Krylov subspace methods.
  * Edge weights are ignored by this type of centrality.
  */
 gen _communicability_betweenness_centrality(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
     int k=-1;
     graphe G(contextptr);
+    bool approx=false;
     if (g.type==_VECT && g.subtype==_SEQ__VECT) {
         const vecteur &gv=*g._VECTptr;
-        if (gv.size()!=2)
+        if (gv.size()<2 || gv.size()>3)
             return gt_err(_GT_ERR_WRONG_NUMBER_OF_ARGS);
+        if (gv.back()==at_approx)
+            approx=true;
         if (!G.read_gen(gv.front()))
             return gt_err(_GT_ERR_NOT_A_GRAPH);
-        k=G.node_index(gv.back());
-        if (k==-1)
-            return gt_err(gv.back(),_GT_ERR_VERTEX_NOT_FOUND);
+        if ((approx && gv.size()==3) || (!approx && gv.size()==2)) {
+            k=G.node_index(gv[1]);
+            if (k==-1)
+                return gt_err(gv[1],_GT_ERR_VERTEX_NOT_FOUND);
+        } else if (!approx)
+            return gt_err(_GT_ERR_WRONG_NUMBER_OF_ARGS);
     } else if (!G.read_gen(g))
         return gt_err(_GT_ERR_NOT_A_GRAPH);
     if (G.is_empty())
@@ -7512,7 +7895,7 @@ gen _communicability_betweenness_centrality(const gen &g,GIAC_CONTEXT) {
             return generr("Digraph must be strongly connected");
     } else if (!G.is_connected())
         return gt_err(_GT_ERR_CONNECTED_GRAPH_REQUIRED);
-    return G.communicability_betweenness_centrality(k);
+    return G.communicability_betweenness_centrality(k,approx);
 }
 static const char _communicability_betweenness_centrality_s[]="communicability_betweenness_centrality";
 static define_unary_function_eval(__communicability_betweenness_centrality,&_communicability_betweenness_centrality,_communicability_betweenness_centrality_s);
@@ -7525,8 +7908,8 @@ define_unary_function_ptr5(at_communicability_betweenness_centrality,alias_at_co
  * is returned, in order as returned by vertices(G).
  * The parameter alpha is attenuation factor which must lie between
  * 0 and 1. Setting it to a floating-point value will trigger
- * computation with floating-point values, which is faster for
- * larger networks.
+ * iterative computation with floating-point values, which is much
+ * faster for larger networks.
  * Edge weights are ignored by this type of centrality.
  */
 gen _katz_centrality(const gen &g,GIAC_CONTEXT) {
@@ -7550,6 +7933,18 @@ gen _katz_centrality(const gen &g,GIAC_CONTEXT) {
         if (k==-1)
             return gt_err(gv.back(),_GT_ERR_VERTEX_NOT_FOUND);
     }
+    if (alpha.type==_DOUBLE_) {
+        graphe::dvector kcd;
+        if (!G.katz_centrality(alpha.DOUBLE_val(),kcd))
+            return generr("Attenuation factor is too large, the iteration diverges");
+        if (k>=0)
+            return kcd[k];
+        vecteur kc(kcd.size());
+        for (int i=0;i<int(kcd.size());++i) {
+            kc[i]=kcd[i];
+        }
+        return kc;
+    }
     vecteur kc=G.katz_centrality(alpha);
     if (k>=0)
         return kc[k];
@@ -7559,6 +7954,61 @@ static const char _katz_centrality_s[]="katz_centrality";
 static define_unary_function_eval(__katz_centrality,&_katz_centrality,_katz_centrality_s);
 define_unary_function_ptr5(at_katz_centrality,alias_at_katz_centrality,&__katz_centrality,0,true)
 
+/* USAGE:   pagerank(G,[d],[v])
+ *
+ * Returns the PageRank of vertex v in G. If v is omitted, the list of
+ * PageRanks for all vertices is returned, in order as returned by
+ * vertices(G). The parameter d is the damping factor (by default 0.85),
+ * which must be a real number between 0 and 1. If only two arguments
+ * are given, the second one is the vertex v if G has such a vertex.
+ * In weighted graphs, arcs are followed with probabilities proportional
+ * to their weights, which must be nonnegative real numbers.
+ */
+gen _pagerank(const gen &g,GIAC_CONTEXT) {
+    if (g.type==_STRNG && g.subtype==-1) return g;
+    int k=-1;
+    double d=0.85;
+    graphe G(contextptr);
+    if (g.type==_VECT && g.subtype==_SEQ__VECT) {
+        const vecteur &gv=*g._VECTptr;
+        if (gv.size()<2 || gv.size()>3)
+            return gt_err(_GT_ERR_WRONG_NUMBER_OF_ARGS);
+        if (!G.read_gen(gv.front()))
+            return gt_err(_GT_ERR_NOT_A_GRAPH);
+        int vpos=1;
+        if (gv.size()==3 || G.node_index(gv[1])==-1) {
+            gen df=evalf_double(gv[1],1,contextptr);
+            if (df.type!=_DOUBLE_)
+                return gv.size()==3?gentypeerr(contextptr):gt_err(gv[1],_GT_ERR_VERTEX_NOT_FOUND);
+            d=df.DOUBLE_val();
+            if (d<0 || d>1)
+                return gensizeerr(contextptr);
+            vpos=2;
+        }
+        if (vpos<int(gv.size())) {
+            k=G.node_index(gv[vpos]);
+            if (k==-1)
+                return gt_err(gv[vpos],_GT_ERR_VERTEX_NOT_FOUND);
+        }
+    } else if (!G.read_gen(g))
+        return gt_err(_GT_ERR_NOT_A_GRAPH);
+    if (G.node_count()==0)
+        return gt_err(_GT_ERR_GRAPH_IS_NULL);
+    graphe::dvector pr;
+    if (!G.pagerank(d,pr))
+        return generr("Edge weights must be nonnegative real numbers");
+    if (k>=0)
+        return pr[k];
+    vecteur res(pr.size());
+    for (int i=0;i<int(pr.size());++i) {
+        res[i]=pr[i];
+    }
+    return res;
+}
+static const char _pagerank_s[]="pagerank";
+static define_unary_function_eval(__pagerank,&_pagerank,_pagerank_s);
+define_unary_function_ptr5(at_pagerank,alias_at_pagerank,&__pagerank,0,true)
+
 /* USAGE:   is_split_graph(G,[part])
  *
  * Returns TRUE iff G is a split graph. In that case, if
@@ -7891,6 +8341,261 @@ static const char _simplicial_vertices_s[]="simplicial_vertices";
 static define_unary_function_eval(__simplicial_vertices,&_simplicial_vertices,_simplicial_vertices_s);
 define_unary_function_ptr5(at_simplicial_vertices,alias_at_simplicial_vertices,&__simplicial_vertices,0,true)
 
+static void benchmark_conversion(graphe &G,GIAC_CONTEXT) {
+    gen g=G.to_gen();
+    graphe H(contextptr);
+    H.read_gen(g);
+}
+
+static void benchmark_dijkstra(graphe &G,GIAC_CONTEXT) {
+    graphe::ivector dest(G.node_count());
+    for (int i=G.node_count();i-->0;) dest[i]=i;
+    vecteur path_weights;
+    G.dijkstra(0,dest,path_weights);
+}
+
+static void benchmark_allpairs_distance(graphe &G,GIAC_CONTEXT) {
+    graphe::dvector D;
+    bool integral;
+    G.allpairs_distance(D,integral);
+}
+
+static void benchmark_betweenness_centrality(graphe &G,GIAC_CONTEXT) {
+    graphe::dvector cb;
+    G.betweenness_centrality(cb);
+}
+
+static void benchmark_maximum_clique(graphe &G,GIAC_CONTEXT) {
+    graphe::ivector clique;
+    G.maximum_clique(clique);
+}
+
+static void benchmark_triangle_count(graphe &G,GIAC_CONTEXT) {
+    G.triangle_count();
+}
+
+static void benchmark_spring_layout(graphe &G,GIAC_CONTEXT) {
+    graphe::layout x;
+    G.make_spring_layout(x,2);
+}
+
+static void benchmark_vertex_coloring(graphe &G,GIAC_CONTEXT) {
+    G.exact_vertex_coloring();
+}
+
+static void benchmark_tutte_polynomial(graphe &G,GIAC_CONTEXT) {
+    /* time the computation, not the lookup in the session cache, which is left intact */
+    graphe::private_tutte_cache memo;
+    G.tutte_polynomial(identificateur("x"),identificateur("y"));
+}
+
+struct graph_benchmark_task {
+    const char *name;
+    void (*run)(graphe &G,GIAC_CONTEXT);
+    int max_nodes; // skip workloads with more vertices (0 = no limit)
+    int max_edges; // skip workloads with more edges (0 = no limit)
+};
+
+static const graph_benchmark_task graph_benchmark_tasks[] = {
+    { "conversion",             benchmark_conversion,               0,      0  },
+    { "dijkstra",               benchmark_dijkstra,                 0,      0  },
+    { "allpairs_distance",      benchmark_allpairs_distance,        2000,   0  },
+    { "betweenness_centrality", benchmark_betweenness_centrality,   5000,   0  },
+    { "maximum_clique",         benchmark_maximum_clique,           0,      0  },
+    { "triangle_count",         benchmark_triangle_count,           0,      0  },
+    { "spring_layout",          benchmark_spring_layout,            2000,   0  },
+    { "vertex_coloring",        benchmark_vertex_coloring,          100,    0  },
+    { "tutte_polynomial",       benchmark_tutte_polynomial,         0,      30 },
+    { NULL,                     NULL,                               0,      0  }
+};
+
+static const char *graph_benchmark_special[] = {
+    "petersen", "heawood", "moebius-kantor", "pappus", "desargues", "dodecahedron",
+    "icosahedron", "clebsch", "coxeter", "tutte", "mcgee", "levi", "foster", "gray",
+    "hoffman-singleton", NULL
+};
+
+#define GRAPH_BENCHMARK_SEED 1234
+
+/* the benchmark reseeds the random generator with GRAPH_BENCHMARK_SEED; the
+ * session generator is reseeded afterwards with a value drawn from it beforehand,
+ * so that the session sequence stays determined by the user's own seed */
+class graph_benchmark_rng_guard {
+    int m_seed;
+    const context *m_ctx;
+public:
+    graph_benchmark_rng_guard(GIAC_CONTEXT) { m_ctx=contextptr; m_seed=giac_rand(contextptr); }
+    ~graph_benchmark_rng_guard() { _srand(m_seed,m_ctx); }
+};
+
+/* generate the random workload of the given kind with n vertices */
+static bool graph_benchmark_workload(graphe &G,int kind,int n,string &name,GIAC_CONTEXT) {
+    vecteur V;
+    if (kind==0) {
+        int k=std::max(2,(int)std::floor(std::sqrt((double)n)+0.5));
+        name="grid";
+        G.make_grid_graph(k,k);
+        return true;
+    }
+    if (kind==4)
+        n+=n%2; // random 4-regular graphs need an even number of vertices
+    G.make_default_labels(V,n);
+    G.reserve_nodes(n);
+    G.add_nodes(V);
+    switch (kind) {
+    case 1:
+        name="erdos_renyi";
+        G.erdos_renyi(std::min(0.5,8.0/n));
+        break;
+    case 2:
+        name="preferential_attachment";
+        G.preferential_attachment(3,0);
+        break;
+    case 3:
+        name="random_planar";
+        G.make_random_planar(0.5,1);
+        break;
+    case 4:
+        name="random_regular";
+        if (n<=5)
+            return false;
+        G.make_random_regular(4,false);
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+/* time all applicable tasks on G and append the results to os */
+static void graph_benchmark_run(graphe &G,const string &workload,int repeats,bool &first,
+                                stringstream &os,GIAC_CONTEXT) {
+    int n=G.node_count(),m=G.edge_count();
+    for (const graph_benchmark_task *t=graph_benchmark_tasks;t->name!=NULL;++t) {
+        if ((t->max_nodes>0 && n>t->max_nodes) || (t->max_edges>0 && m>t->max_edges))
+            continue;
+        double best=0,total=0,elapsed;
+        for (int r=0;r<repeats;++r) {
+            graphe H(G);
+            _srand(GRAPH_BENCHMARK_SEED,contextptr);
+            elapsed=gt_profiler::clock();
+            t->run(H,contextptr);
+            elapsed=gt_profiler::clock()-elapsed;
+            total+=elapsed;
+            if (r==0 || elapsed<best)
+                best=elapsed;
+        }
+        os << (first?"\n":",\n") << "    {\"workload\":\"" << workload << "\",\"n\":" << n
+           << ",\"m\":" << m << ",\"task\":\"" << t->name << "\",\"best\":" << best
+           << ",\"mean\":" << total/repeats << "}";
+        first=false;
+    }
+}
+
+/* USAGE:   graph_benchmark([sizes],[repeats],[filename])
+ *
+ * Times the main graph algorithms on fixed-seed workloads produced by the
+ * built-in random generators (grid, Erdos-Renyi, preferential attachment,
+ * random planar and random 4-regular graphs) for each number of vertices in
+ * the list sizes (by default [100,1000,10000]), and on a set of special
+ * graphs. Each task is run repeats times (by default 3). The results are
+ * returned as a JSON string, which is also written to filename if given.
+ */
+gen _graph_benchmark(const gen &g,GIAC_CONTEXT) {
+    if (g.type==_STRNG && g.subtype==-1) return g;
+    vecteur gv=g.type==_VECT && g.subtype==_SEQ__VECT?*g._VECTptr:vecteur(1,g);
+    graphe::ivector sizes;
+    int repeats=3;
+    string filename;
+    for (const_iterateur it=gv.begin();it!=gv.end();++it) {
+        if (it->type==_VECT) {
+            for (const_iterateur jt=it->_VECTptr->begin();jt!=it->_VECTptr->end();++jt) {
+                if (!jt->is_integer() || jt->val<2)
+                    return gt_err(_GT_ERR_POSITIVE_INTEGER_REQUIRED);
+                sizes.push_back(jt->val);
+            }
+        } else if (it->is_integer()) {
+            if (it->val<1)
+                return gt_err(_GT_ERR_POSITIVE_INTEGER_REQUIRED);
+            repeats=it->val;
+        } else if (it->type==_STRNG) {
+            filename=make_absolute_file_path(graphe::genstring2str(*it));
+        } else return gentypeerr(contextptr);
+    }
+    if (sizes.empty()) {
+        sizes.push_back(100);
+        sizes.push_back(1000);
+        sizes.push_back(10000);
+    }
+    stringstream os;
+    bool first=true;
+    string name;
+    graph_benchmark_rng_guard rng_guard(contextptr);
+    os << "{\n  \"threads\":" << threads << ",\n  \"seed\":" << GRAPH_BENCHMARK_SEED
+       << ",\n  \"repeats\":" << repeats << ",\n  \"results\":[";
+    for (graphe::ivector_iter it=sizes.begin();it!=sizes.end();++it) {
+        for (int kind=0;kind<5;++kind) {
+            graphe G(contextptr);
+            _srand(GRAPH_BENCHMARK_SEED,contextptr);
+            if (graph_benchmark_workload(G,kind,*it,name,contextptr))
+                graph_benchmark_run(G,name,repeats,first,os,contextptr);
+        }
+    }
+    for (const char **s=graph_benchmark_special;*s!=NULL;++s) {
+        graphe G(*s,contextptr);
+        if (!G.is_null())
+            graph_benchmark_run(G,*s,repeats,first,os,contextptr);
+    }
+    os << "\n  ]\n}\n";
+    if (!filename.empty()) {
+        ofstream out(filename.c_str());
+        if (!out.good())
+            return generr("Failed to write the benchmark results");
+        out << os.str();
+        out.close();
+    }
+    return string2gen(os.str(),false);
+}
+static const char _graph_benchmark_s[]="graph_benchmark";
+static define_unary_function_eval(__graph_benchmark,&_graph_benchmark,_graph_benchmark_s);
+define_unary_function_ptr5(at_graph_benchmark,alias_at_graph_benchmark,&__graph_benchmark,0,true)
+
+/* USAGE:   engine_profile([opt||filename])
+ *
+ * Controls the instrumentation of the graph theory and LP engines. Without
+ * arguments, returns the data collected so far as a map with entries
+ * "phases", "counters", "memory" and "elapsed". If opt is true resp. trace,
+ * the collected data is discarded and profiling (with all timed events kept
+ * if opt=trace) is started, if opt is false the profiling is stopped. If
+ * filename is given, the traced events are written to that file in Chrome
+ * trace format and their number is returned.
+ */
+gen _engine_profile(const gen &g,GIAC_CONTEXT) {
+    if (g.type==_STRNG && g.subtype==-1) return g;
+    if (g.type==_VECT && g.subtype==_SEQ__VECT && g._VECTptr->empty())
+        return gt_profiler::report();
+    if (g==at_trace) {
+        gt_profiler::start(true);
+        return 1;
+    }
+    if (g.is_integer()) {
+        if (is_zero(g))
+            gt_profiler::stop();
+        else gt_profiler::start(false);
+        return 1;
+    }
+    if (g.type==_STRNG) {
+        int cnt=gt_profiler::write_trace(make_absolute_file_path(graphe::genstring2str(g)));
+        if (cnt<0)
+            return generr("Failed to write the trace file");
+        return cnt;
+    }
+    return gentypeerr(contextptr);
+}
+static const char _engine_profile_s[]="engine_profile";
+static define_unary_function_eval(__engine_profile,&_engine_profile,_engine_profile_s);
+define_unary_function_ptr5(at_engine_profile,alias_at_engine_profile,&__engine_profile,0,true)
+
 #ifndef NO_NAMESPACE_GIAC
 }
 #endif // ndef NO_NAMESPACE_GIAC
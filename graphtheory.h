@@ -82,6 +82,7 @@ enum distribution_type {
 };
 
 bool is_graphe(const gen &g,std::string &disp_out,GIAC_CONTEXT);
+std::string make_absolute_file_path(const std::string &relative_path);
 
 // GRAPH THEORY GIAC COMMANDS
 
@@ -233,6 +234,7 @@ gen _seidel_spectrum(const gen &g,GIAC_CONTEXT);
 gen _is_integer_graph(const gen &g,GIAC_CONTEXT);
 gen _spanning_tree(const gen &g,GIAC_CONTEXT);
 gen _number_of_spanning_trees(const gen &g,GIAC_CONTEXT);
+gen _fiedler_vector(const gen &g,GIAC_CONTEXT);
 gen _minimal_spanning_tree(const gen &g,GIAC_CONTEXT);
 gen _graph_rank(const gen &g,GIAC_CONTEXT);
 gen _lowest_common_ancestor(const gen &g,GIAC_CONTEXT);
@@ -250,6 +252,7 @@ gen _is_isomorphic(const gen &g,GIAC_CONTEXT);
 gen _is_subgraph_isomorphic(const gen &g,GIAC_CONTEXT);
 gen _graph_automorphisms(const gen &g,GIAC_CONTEXT);
 gen _canonical_labeling(const gen &g,GIAC_CONTEXT);
+gen _canonical_hash(const gen &g,GIAC_CONTEXT);
 gen _minimal_edge_coloring(const gen &g,GIAC_CONTEXT);
 gen _chromatic_index(const gen &g,GIAC_CONTEXT);
 gen _is_hamiltonian(const gen &g,GIAC_CONTEXT);
@@ -282,6 +285,7 @@ gen _betweenness_centrality(const gen &g,GIAC_CONTEXT);
 gen _communicability_betweenness_centrality(const gen &g,GIAC_CONTEXT);
 gen _closeness_centrality(const gen &g,GIAC_CONTEXT);
 gen _katz_centrality(const gen &g,GIAC_CONTEXT);
+gen _pagerank(const gen &g,GIAC_CONTEXT);
 gen _information_centrality(const gen &g,GIAC_CONTEXT);
 gen _harmonic_centrality(const gen &g,GIAC_CONTEXT);
 gen _is_split_graph(const gen &g,GIAC_CONTEXT);
@@ -294,6 +298,9 @@ gen _vertex_cover_number(const gen &g,GIAC_CONTEXT);
 gen _is_reachable(const gen &g,GIAC_CONTEXT);
 gen _reachable(const gen &g,GIAC_CONTEXT);
 gen _simplicial_vertices(const gen &g,GIAC_CONTEXT);
+gen _compile_graph(const gen &g,GIAC_CONTEXT);
+gen _graph_benchmark(const gen &g,GIAC_CONTEXT);
+gen _engine_profile(const gen &g,GIAC_CONTEXT);
 
 // GENERAL GIAC COMMANDS
 
@@ -53,6 +53,7 @@ using namespace std;
 #include "derive.h"
 #include "intg.h"
 #include "tex.h"
+#include "markup.h"
 #include "lin.h"
 #include "solve.h"
 #include "modpoly.h"
@@ -359,8 +360,14 @@ void texmacs_output(const giac::gen & g,giac::gen & gg,bool reading_file,int no,
   putchar(TEXMACS_DATA_BEGIN);
   if (gg.type==giac::_STRNG)
     printf("verbatim:%s\n",gg._STRNGptr->c_str());
-  else 
-    printf("scheme:(document (equation* (math %s)))",giac::gen2scm(gg,giac::context0).c_str());
+  else {
+    // stream the markup to the pipe instead of building it in one string
+    printf("scheme:(document (equation* (math ");
+    giac::markup_file_writer out(stdout);
+    giac::export_scheme(gg,out,giac::context0);
+    out.flush();
+    printf(")))");
+  }
 #else
   if (reading_file){
     putchar(TEXMACS_DATA_BEGIN);
@@ -21,7 +21,11 @@
 #include "giac.h"
 #include "lpsolve.h"
 #include "optimization.h"
+#include "graphe.h"
 #include <ctime>
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef DBL_MAX
 #define DBL_MAX 1.79769313486e+308
@@ -239,6 +243,7 @@ lp_stats::lp_stats() {
     cuts_applied=0;
     max_active_nodes=0;
     mip_gap=-1; //negative means undefined
+    elapsed=0;
 }
 
 /*
@@ -997,6 +1002,7 @@ void lp_problem::report_status(const char *msg, int count) {
  * Solve the problem using the specified settings.
  */
 int lp_problem::solve() {
+    GT_PROFILE(profile,"lp_solve");
     stats=lp_stats();
     char buffer[1024];
     make_problem_exact();
@@ -1157,6 +1163,7 @@ int lp_problem::solve() {
                 else
                     range.tighten_ubound(ub,ctx);
                 ++stats.subproblems_examined;
+                GT_COUNT("lp_bb_nodes",1);
                 if (child_node.solve_relaxation()==_LP_SOLVED) {
                     double p=child_node.get_fractional_var(j);
                     variables[j].update_pseudocost(std::abs(child_node.get_opt_approx()-active_nodes[k].get_opt_approx()),
@@ -1233,6 +1240,1212 @@ int lp_problem::solve() {
     return _LP_SOLVED;
 }
 
+/*
+ * Factorize the basis matrix with columns cols. Each pivot is chosen in an
+ * active column with the fewest entries, in the shortest row among those
+ * whose entry is not smaller than a tenth of the largest one in magnitude.
+ * If the matrix is singular, false is returned and the slots and rows left
+ * without a pivot are stored to bad_slots and bad_rows, respectively.
+ */
+bool lp_basis_factor::factorize(const vector<lp_sparse_vector> &cols,ints &bad_slots,ints &bad_rows) {
+    m=cols.size();
+    lower.clear();
+    row_etas.clear();
+    urows.assign(m,lp_sparse_vector(0));
+    ucols.assign(m,ints(0));
+    diag.assign(m,0);
+    slot_of_row.assign(m,-1);
+    row_of_slot.assign(m,-1);
+    seq.clear();
+    work.assign(m,0);
+    bad_slots.clear();
+    bad_rows.clear();
+    //active submatrix, stored by rows with column patterns
+    vector<lp_sparse_vector> R(m);
+    vector<ints> C(m);
+    for (int j=0;j<m;++j) {
+        for (lp_sparse_vector::const_iterator it=cols[j].begin();it!=cols[j].end();++it) {
+            if (it->second==0)
+                continue;
+            R[it->first].push_back(make_pair(j,it->second));
+            C[j].push_back(it->first);
+        }
+    }
+    vector<bool> done(m,false);
+    ints mark(m,-1);
+    int c,r,k;
+    double amax,a,v=0,mult;
+    for (int step=0;step<m;++step) {
+        c=-1;
+        for (int j=0;j<m;++j) {
+            if (!done[j] && (c<0 || C[j].size()<C[c].size()))
+                c=j;
+        }
+        done[c]=true;
+        amax=0;
+        for (ints::const_iterator it=C[c].begin();it!=C[c].end();++it) {
+            const lp_sparse_vector &row=R[*it];
+            for (k=0;row[k].first!=c;++k);
+            amax=std::max(amax,std::abs(row[k].second));
+        }
+        if (amax<LP_PIVOT_TOL) { //no acceptable pivot in this column
+            for (ints::const_iterator it=C[c].begin();it!=C[c].end();++it) {
+                lp_sparse_vector &row=R[*it];
+                for (k=0;row[k].first!=c;++k);
+                row[k]=row.back();
+                row.pop_back();
+            }
+            C[c].clear();
+            bad_slots.push_back(c);
+            continue;
+        }
+        r=-1;
+        for (ints::const_iterator it=C[c].begin();it!=C[c].end();++it) {
+            const lp_sparse_vector &row=R[*it];
+            for (k=0;row[k].first!=c;++k);
+            a=row[k].second;
+            if (std::abs(a)>=0.1*amax && (r<0 || row.size()<R[r].size())) {
+                r=*it;
+                v=a;
+            }
+        }
+        //the rest of row r becomes a row of U
+        lp_sparse_vector &pr=R[r];
+        for (lp_sparse_vector::const_iterator it=pr.begin();it!=pr.end();++it) {
+            if (it->first==c)
+                continue;
+            urows[r].push_back(*it);
+            ucols[it->first].push_back(r);
+            ints &col=C[it->first];
+            for (k=0;col[k]!=r;++k);
+            col[k]=col.back();
+            col.pop_back();
+        }
+        diag[r]=v;
+        slot_of_row[r]=c;
+        row_of_slot[c]=r;
+        seq.push_back(r);
+        //eliminate the entries below the pivot
+        eta e;
+        e.pivot=r;
+        for (ints::const_iterator it=C[c].begin();it!=C[c].end();++it) {
+            if (*it==r)
+                continue;
+            lp_sparse_vector &row=R[*it];
+            for (k=0;row[k].first!=c;++k);
+            mult=row[k].second/v;
+            row[k]=row.back();
+            row.pop_back();
+            e.entries.push_back(make_pair(*it,mult));
+            for (k=0;k<int(row.size());++k) mark[row[k].first]=k;
+            for (lp_sparse_vector::const_iterator jt=pr.begin();jt!=pr.end();++jt) {
+                if (jt->first==c)
+                    continue;
+                if (mark[jt->first]>=0)
+                    row[mark[jt->first]].second-=mult*jt->second;
+                else {
+                    row.push_back(make_pair(jt->first,-mult*jt->second));
+                    C[jt->first].push_back(*it);
+                }
+            }
+            for (k=0;k<int(row.size());++k) mark[row[k].first]=-1;
+        }
+        if (!e.entries.empty())
+            lower.push_back(e);
+        C[c].clear();
+        pr.clear();
+    }
+    if (bad_slots.empty())
+        return true;
+    for (int i=0;i<m;++i) {
+        if (slot_of_row[i]<0)
+            bad_rows.push_back(i);
+    }
+    return false;
+}
+
+/*
+ * Solve B*x=a, where a is given in x and indexed by rows. The solution is
+ * indexed by slots. If spike is not NULL, the partially transformed vector
+ * needed by update is stored there.
+ */
+void lp_basis_factor::ftran(vector<double> &x,vector<double> *spike) {
+    double xr,s;
+    for (vector<eta>::const_iterator it=lower.begin();it!=lower.end();++it) {
+        if ((xr=x[it->pivot])==0)
+            continue;
+        for (lp_sparse_vector::const_iterator jt=it->entries.begin();jt!=it->entries.end();++jt) {
+            x[jt->first]-=jt->second*xr;
+        }
+    }
+    for (vector<eta>::const_iterator it=row_etas.begin();it!=row_etas.end();++it) {
+        s=0;
+        for (lp_sparse_vector::const_iterator jt=it->entries.begin();jt!=it->entries.end();++jt) {
+            s+=jt->second*x[jt->first];
+        }
+        x[it->pivot]-=s;
+    }
+    if (spike!=NULL)
+        *spike=x;
+    vector<double> &res=work;
+    for (int k=m-1;k>=0;--k) {
+        int r=seq[k];
+        s=x[r];
+        for (lp_sparse_vector::const_iterator it=urows[r].begin();it!=urows[r].end();++it) {
+            s-=it->second*res[it->first];
+        }
+        res[slot_of_row[r]]=s/diag[r];
+    }
+    x.swap(res);
+    res.assign(m,0);
+}
+
+/*
+ * Solve B^T*y=c, where c is given in y and indexed by slots. The solution is
+ * indexed by rows.
+ */
+void lp_basis_factor::btran(vector<double> &y) {
+    double zr,s;
+    vector<double> &z=work;
+    for (int k=0;k<m;++k) {
+        int r=seq[k];
+        z[r]=zr=y[slot_of_row[r]]/diag[r];
+        if (zr==0)
+            continue;
+        for (lp_sparse_vector::const_iterator it=urows[r].begin();it!=urows[r].end();++it) {
+            y[it->first]-=it->second*zr;
+        }
+    }
+    for (vector<eta>::const_reverse_iterator it=row_etas.rbegin();it!=row_etas.rend();++it) {
+        if ((zr=z[it->pivot])==0)
+            continue;
+        for (lp_sparse_vector::const_iterator jt=it->entries.begin();jt!=it->entries.end();++jt) {
+            z[jt->first]-=jt->second*zr;
+        }
+    }
+    for (vector<eta>::const_reverse_iterator it=lower.rbegin();it!=lower.rend();++it) {
+        s=0;
+        for (lp_sparse_vector::const_iterator jt=it->entries.begin();jt!=it->entries.end();++jt) {
+            s+=jt->second*z[jt->first];
+        }
+        z[it->pivot]-=s;
+    }
+    y.swap(z);
+    z.assign(m,0);
+}
+
+/*
+ * Replace the basis column in the given slot by the column whose partially
+ * transformed vector (obtained from ftran) is spike. The corresponding row of
+ * U is moved to the bottom and eliminated with a row eta (Forrest-Tomlin).
+ * Return false if the new pivot is too small, in which case the basis must be
+ * factorized again.
+ */
+bool lp_basis_factor::update(int slot,const vector<double> &spike) {
+    int rt=row_of_slot[slot],pos=0,r;
+    //remove the old column from U
+    for (ints::const_iterator it=ucols[slot].begin();it!=ucols[slot].end();++it) {
+        lp_sparse_vector &row=urows[*it];
+        for (lp_sparse_vector::iterator jt=row.begin();jt!=row.end();++jt) {
+            if (jt->first==slot) {
+                *jt=row.back();
+                row.pop_back();
+                break;
+            }
+        }
+    }
+    ucols[slot].clear();
+    //insert the spike
+    for (r=0;r<m;++r) {
+        if (r==rt || std::abs(spike[r])<=1e-14)
+            continue;
+        urows[r].push_back(make_pair(slot,spike[r]));
+        ucols[slot].push_back(r);
+    }
+    //eliminate row rt with the rows below it
+    for (lp_sparse_vector::const_iterator it=urows[rt].begin();it!=urows[rt].end();++it) {
+        work[it->first]=it->second;
+    }
+    urows[rt].clear();
+    work[slot]=spike[rt];
+    for (;seq[pos]!=rt;++pos);
+    eta e;
+    e.pivot=rt;
+    double mu;
+    for (int k=pos+1;k<m;++k) {
+        r=seq[k];
+        int c=slot_of_row[r];
+        if (work[c]==0)
+            continue;
+        mu=work[c]/diag[r];
+        work[c]=0;
+        for (lp_sparse_vector::const_iterator it=urows[r].begin();it!=urows[r].end();++it) {
+            work[it->first]-=mu*it->second;
+        }
+        e.entries.push_back(make_pair(r,mu));
+    }
+    double d=work[slot];
+    work[slot]=0;
+    seq.erase(seq.begin()+pos);
+    seq.push_back(rt);
+    diag[rt]=d;
+    if (!e.entries.empty())
+        row_etas.push_back(e);
+    return std::abs(d)>LP_PIVOT_TOL;
+}
+
+/*
+ * Simplex solver constructor, the initial basis consists of logicals.
+ */
+lp_simplex::lp_simplex(const lp_numeric_model &M) {
+    model=&M;
+    m=M.nrows;
+    ns=M.ncols();
+    n=ns+m;
+    iterations=0;
+    lb=M.lower;
+    lb.insert(lb.end(),M.row_lower.begin(),M.row_lower.end());
+    ub=M.upper;
+    ub.insert(ub.end(),M.row_upper.begin(),M.row_upper.end());
+    x.assign(n,0);
+    for (int j=0;j<ns;++j) {
+        x[j]=lb[j]>-DBL_MAX?lb[j]:(ub[j]<DBL_MAX?ub[j]:0);
+    }
+    basis.resize(m);
+    position.assign(n,-1);
+    for (int i=0;i<m;++i) {
+        basis[i]=ns+i;
+        position[ns+i]=i;
+    }
+    refactor();
+}
+
+/*
+ * Return the inner product of the jth column of [A,-I] with y.
+ */
+double lp_simplex::dot(int j,const vector<double> &y) const {
+    if (j>=ns)
+        return -y[j-ns];
+    double s=0;
+    const lp_sparse_vector &col=model->columns[j];
+    for (lp_sparse_vector::const_iterator it=col.begin();it!=col.end();++it) {
+        s+=it->second*y[it->first];
+    }
+    return s;
+}
+
+/*
+ * Store the jth column of [A,-I] to a as a dense vector.
+ */
+void lp_simplex::scatter(int j,vector<double> &a) const {
+    a.assign(m,0);
+    if (j>=ns) {
+        a[j-ns]=-1;
+        return;
+    }
+    const lp_sparse_vector &col=model->columns[j];
+    for (lp_sparse_vector::const_iterator it=col.begin();it!=col.end();++it) {
+        a[it->first]=it->second;
+    }
+}
+
+/*
+ * Compute the values of basic variables from the nonbasic ones.
+ */
+void lp_simplex::compute_primal() {
+    vector<double> r(m,0);
+    for (int j=0;j<n;++j) {
+        if (position[j]>=0 || x[j]==0)
+            continue;
+        if (j>=ns)
+            r[j-ns]+=x[j];
+        else {
+            const lp_sparse_vector &col=model->columns[j];
+            for (lp_sparse_vector::const_iterator it=col.begin();it!=col.end();++it) {
+                r[it->first]-=it->second*x[j];
+            }
+        }
+    }
+    lu.ftran(r);
+    for (int i=0;i<m;++i) {
+        x[basis[i]]=r[i];
+    }
+}
+
+/*
+ * Factorize the basis. Basic columns which make it singular are replaced by
+ * logicals of the rows left without a pivot.
+ */
+void lp_simplex::refactor() {
+    GT_PROFILE(profile,"lp_refactor");
+    vector<lp_sparse_vector> cols(m);
+    ints bad_slots,bad_rows;
+    for (int attempt=0;attempt<2;++attempt) {
+        for (int i=0;i<m;++i) {
+            int j=basis[i];
+            if (j<ns)
+                cols[i]=model->columns[j];
+            else cols[i]=lp_sparse_vector(1,make_pair(j-ns,-1.0));
+        }
+        if (lu.factorize(cols,bad_slots,bad_rows))
+            break;
+        for (int k=0;k<int(bad_slots.size());++k) {
+            int i=bad_slots[k],j=basis[i],l=ns+bad_rows[k];
+            position[j]=-1;
+            x[j]=lb[j]>-DBL_MAX && (ub[j]>=DBL_MAX || x[j]-lb[j]<=ub[j]-x[j])?lb[j]:(ub[j]<DBL_MAX?ub[j]:0);
+            basis[i]=l;
+            position[l]=i;
+        }
+    }
+    compute_primal();
+}
+
+/*
+ * Change the basis: variable q enters in slot r with its value changed by
+ * step, the leaving variable is set to leave_value.
+ */
+void lp_simplex::pivot(int r,int q,double step,const vector<double> &alpha,const vector<double> &spike,double leave_value) {
+    for (int i=0;i<m;++i) {
+        x[basis[i]]-=step*alpha[i];
+    }
+    x[q]+=step;
+    int p=basis[r];
+    x[p]=leave_value;
+    position[p]=-1;
+    basis[r]=q;
+    position[q]=r;
+    ++iterations;
+    if (lu.update_count()>=LP_REFACTOR_PERIOD || !lu.update(r,spike))
+        refactor();
+}
+
+/*
+ * Return true iff the reduced costs obtained with simplex multipliers y have
+ * correct signs with respect to the positions of the nonbasic variables.
+ */
+bool lp_simplex::is_dual_feasible(const vector<double> &y) const {
+    double d;
+    for (int j=0;j<n;++j) {
+        if (position[j]>=0 || lb[j]==ub[j])
+            continue;
+        d=(j<ns?model->cost[j]:0)-dot(j,y);
+        if ((d<-LP_DUAL_TOL && x[j]<ub[j]) || (d>LP_DUAL_TOL && x[j]>lb[j]))
+            return false;
+    }
+    return true;
+}
+
+/*
+ * Add the simplex iterations performed within the current scope to the
+ * profiler counter p.
+ */
+class lp_iteration_probe {
+    gt_profiler::probe &counter;
+    const int &iterations;
+    int start;
+public:
+    lp_iteration_probe(gt_profiler::probe &p,const int &it) : counter(p),iterations(it) { start=it; }
+    ~lp_iteration_probe() { counter.count(iterations-start); }
+};
+
+/*
+ * Primal simplex method with Dantzig pricing and Harris ratio test. While
+ * some basic variables are out of bounds, the sum of infeasibilities is
+ * minimized instead of the objective.
+ */
+int lp_simplex::primal(int limit) {
+    GT_PROFILE(profile,"lp_primal_simplex");
+    GT_PROBE(primal_iterations,"lp_primal_iterations",_GT_PROBE_COUNTER);
+    lp_iteration_probe probe(primal_iterations,iterations);
+    vector<double> c(m),y,alpha,spike;
+    int q,r,dir,j,start=iterations;
+    double d,best,a,t,theta,tr,amax,bnd,leave,range;
+    bool phase1;
+    while (true) {
+        phase1=false;
+        for (int i=0;i<m;++i) {
+            j=basis[i];
+            c[i]=x[j]<lb[j]-LP_PRIMAL_TOL?-1:(x[j]>ub[j]+LP_PRIMAL_TOL?1:0);
+            if (c[i]!=0)
+                phase1=true;
+        }
+        if (!phase1) for (int i=0;i<m;++i) {
+            j=basis[i];
+            c[i]=j<ns?model->cost[j]:0;
+        }
+        y=c;
+        lu.btran(y);
+        //pricing
+        q=-1;
+        dir=0;
+        best=LP_DUAL_TOL;
+        for (j=0;j<n;++j) {
+            if (position[j]>=0 || lb[j]==ub[j])
+                continue;
+            d=(phase1 || j>=ns?0:model->cost[j])-dot(j,y);
+            if (d<-best && x[j]<ub[j]) {
+                q=j;
+                dir=1;
+                best=-d;
+            } else if (d>best && x[j]>lb[j]) {
+                q=j;
+                dir=-1;
+                best=d;
+            }
+        }
+        if (q<0)
+            return phase1?_LP_INFEASIBLE:_LP_SOLVED;
+        if (iterations-start>=limit)
+            return _LP_ERROR;
+        scatter(q,alpha);
+        lu.ftran(alpha,&spike);
+        //Harris ratio test: the largest pivot among the rows which block within the relaxed bounds
+        range=dir>0?(ub[q]<DBL_MAX?ub[q]-x[q]:DBL_MAX):(lb[q]>-DBL_MAX?x[q]-lb[q]:DBL_MAX);
+        for (int pass=0;pass<2;++pass) {
+            if (pass==0)
+                theta=DBL_MAX;
+            r=-1;
+            amax=tr=leave=0;
+            for (int i=0;i<m;++i) {
+                a=-dir*alpha[i];
+                if (std::abs(a)<LP_PIVOT_TOL)
+                    continue;
+                j=basis[i];
+                if (a<0) {
+                    if (x[j]<lb[j]-LP_PRIMAL_TOL)
+                        continue;
+                    bnd=x[j]>ub[j]+LP_PRIMAL_TOL?ub[j]:lb[j];
+                    if (bnd<=-DBL_MAX)
+                        continue;
+                    t=(x[j]-bnd+(pass==0?LP_PRIMAL_TOL:0))/(-a);
+                } else {
+                    if (x[j]>ub[j]+LP_PRIMAL_TOL)
+                        continue;
+                    bnd=x[j]<lb[j]-LP_PRIMAL_TOL?lb[j]:ub[j];
+                    if (bnd>=DBL_MAX)
+                        continue;
+                    t=(bnd-x[j]+(pass==0?LP_PRIMAL_TOL:0))/a;
+                }
+                if (pass==0)
+                    theta=std::min(theta,t);
+                else if (t<=theta && std::abs(a)>amax) {
+                    r=i;
+                    amax=std::abs(a);
+                    tr=std::max(t,0.0);
+                    leave=bnd;
+                }
+            }
+        }
+        if (r<0 && range>=DBL_MAX)
+            return phase1?_LP_ERROR:_LP_UNBOUNDED;
+        if (r<0 || range<=tr) { //the entering variable moves to its opposite bound
+            for (int i=0;i<m;++i) {
+                x[basis[i]]-=dir*range*alpha[i];
+            }
+            x[q]=dir>0?ub[q]:lb[q];
+            ++iterations;
+            continue;
+        }
+        pivot(r,q,dir*tr,alpha,spike,leave);
+    }
+}
+
+/*
+ * Dual simplex method, assuming that the current basis is dual feasible. The
+ * leaving variable is the one with the largest bound violation and the
+ * entering variable is determined by Harris ratio test. The method stops as
+ * soon as the objective value reaches cutoff.
+ */
+int lp_simplex::dual(int limit,double cutoff) {
+    GT_PROFILE(profile,"lp_dual_simplex");
+    GT_PROBE(dual_iterations,"lp_dual_iterations",_GT_PROBE_COUNTER);
+    lp_iteration_probe probe(dual_iterations,iterations);
+    vector<double> c(m),y,rho,alpha,spike,ratios;
+    lp_sparse_vector cand;
+    int r,q,p,j,start=iterations;
+    double viol,target=0,arj,d,theta,amax,dz;
+    bool up,inc;
+    while (true) {
+        r=-1;
+        viol=LP_PRIMAL_TOL;
+        for (int i=0;i<m;++i) {
+            j=basis[i];
+            if (lb[j]-x[j]>viol) {
+                viol=lb[j]-x[j];
+                r=i;
+                target=lb[j];
+            } else if (x[j]-ub[j]>viol) {
+                viol=x[j]-ub[j];
+                r=i;
+                target=ub[j];
+            }
+        }
+        if (r<0)
+            return _LP_SOLVED;
+        if (objective()>=cutoff)
+            return _LP_INFEASIBLE;
+        if (iterations-start>=limit)
+            return _LP_ERROR;
+        p=basis[r];
+        up=x[p]<target;
+        for (int i=0;i<m;++i) {
+            j=basis[i];
+            c[i]=j<ns?model->cost[j]:0;
+        }
+        y=c;
+        lu.btran(y);
+        rho.assign(m,0);
+        rho[r]=1;
+        lu.btran(rho);
+        //collect the candidates which move x[p] towards target with their ratios |d_j/a_rj|
+        cand.clear();
+        ratios.clear();
+        theta=DBL_MAX;
+        for (j=0;j<n;++j) {
+            if (position[j]>=0 || lb[j]==ub[j])
+                continue;
+            arj=dot(j,rho);
+            if (std::abs(arj)<LP_PIVOT_TOL)
+                continue;
+            inc=up?arj<0:arj>0;
+            if (inc?x[j]>=ub[j]:x[j]<=lb[j])
+                continue;
+            d=(j<ns?model->cost[j]:0)-dot(j,y);
+            d=std::max(inc?d:-d,0.0);
+            cand.push_back(make_pair(j,arj));
+            ratios.push_back(d/std::abs(arj));
+            theta=std::min(theta,(d+LP_DUAL_TOL)/std::abs(arj));
+        }
+        q=-1;
+        amax=0;
+        for (int k=0;k<int(cand.size());++k) {
+            if (ratios[k]<=theta && std::abs(cand[k].second)>amax) {
+                q=cand[k].first;
+                amax=std::abs(cand[k].second);
+            }
+        }
+        if (q<0)
+            return _LP_INFEASIBLE; //the dual is unbounded
+        scatter(q,alpha);
+        lu.ftran(alpha,&spike);
+        if (std::abs(alpha[r])<LP_PIVOT_TOL)
+            return _LP_ERROR;
+        dz=(x[p]-target)/alpha[r];
+        pivot(r,q,dz,alpha,spike,target);
+    }
+}
+
+/*
+ * Set the bounds of the jth variable. A nonbasic variable is moved to the
+ * corresponding new bound.
+ */
+void lp_simplex::set_bounds(int j,double l,double u) {
+    bool at_upper=x[j]==ub[j] && x[j]!=lb[j];
+    lb[j]=l;
+    ub[j]=u;
+    if (position[j]>=0)
+        return;
+    double v=at_upper && u<DBL_MAX?u:(l>-DBL_MAX?l:(u<DBL_MAX?u:0));
+    if (v==x[j])
+        return;
+    vector<double> alpha;
+    scatter(j,alpha);
+    lu.ftran(alpha);
+    for (int i=0;i<m;++i) {
+        x[basis[i]]-=(v-x[j])*alpha[i];
+    }
+    x[j]=v;
+}
+
+/*
+ * Return the objective value at the current point.
+ */
+double lp_simplex::objective() const {
+    double s=0;
+    for (int j=0;j<ns;++j) {
+        s+=model->cost[j]*x[j];
+    }
+    return s;
+}
+
+/*
+ * Store the current basis to b and the nonbasic variables at upper bounds to
+ * at_upper.
+ */
+void lp_simplex::save_basis(ints &b,vector<bool> &at_upper) const {
+    b=basis;
+    at_upper.resize(n);
+    for (int j=0;j<n;++j) {
+        at_upper[j]=position[j]<0 && ub[j]<DBL_MAX && x[j]==ub[j];
+    }
+}
+
+/*
+ * Restore the basis saved by save_basis.
+ */
+void lp_simplex::load_basis(const ints &b,const vector<bool> &at_upper) {
+    basis=b;
+    position.assign(n,-1);
+    for (int i=0;i<m;++i) {
+        position[basis[i]]=i;
+    }
+    for (int j=0;j<n;++j) {
+        if (position[j]<0)
+            x[j]=at_upper[j] && ub[j]<DBL_MAX?ub[j]:(lb[j]>-DBL_MAX?lb[j]:(ub[j]<DBL_MAX?ub[j]:0));
+    }
+    refactor();
+}
+
+/*
+ * Solve the problem starting from the current basis. If it is not primal
+ * feasible, nonbasic variables are first moved to the bounds which make it
+ * dual feasible, where missing bounds are replaced by artificial ones, and
+ * the dual simplex method is applied. The primal simplex method then finishes
+ * the job with the original bounds. At most limit iterations are performed in
+ * each phase.
+ */
+int lp_simplex::solve(int limit) {
+    vector<double> y(m);
+    vector<pair<int,pair<double,double> > > boxed;
+    double d;
+    int i=0;
+    for (;i<m && x[basis[i]]>=lb[basis[i]]-LP_PRIMAL_TOL && x[basis[i]]<=ub[basis[i]]+LP_PRIMAL_TOL;++i);
+    if (i==m)
+        return primal(limit);
+    for (i=0;i<m;++i) {
+        y[i]=basis[i]<ns?model->cost[basis[i]]:0;
+    }
+    lu.btran(y);
+    for (int j=0;j<n;++j) {
+        if (position[j]>=0 || lb[j]==ub[j])
+            continue;
+        d=(j<ns?model->cost[j]:0)-dot(j,y);
+        if (d>=0) {
+            if (lb[j]<=-DBL_MAX) {
+                boxed.push_back(make_pair(j,make_pair(lb[j],ub[j])));
+                lb[j]=ub[j]<DBL_MAX?ub[j]-LP_ARTIFICIAL_BOUND:-LP_ARTIFICIAL_BOUND;
+            }
+            x[j]=lb[j];
+        } else {
+            if (ub[j]>=DBL_MAX) {
+                boxed.push_back(make_pair(j,make_pair(lb[j],ub[j])));
+                ub[j]=lb[j]>-DBL_MAX?lb[j]+LP_ARTIFICIAL_BOUND:LP_ARTIFICIAL_BOUND;
+            }
+            x[j]=ub[j];
+        }
+    }
+    compute_primal();
+    int res=dual(limit,DBL_MAX);
+    for (vector<pair<int,pair<double,double> > >::const_iterator it=boxed.begin();it!=boxed.end();++it) {
+        set_bounds(it->first,it->second.first,it->second.second);
+    }
+    if (res==_LP_ERROR)
+        return res;
+    return primal(limit);
+}
+
+/*
+ * Reoptimize after changing the bounds. Dual simplex is used if the current
+ * basis is dual feasible, with the primal simplex finishing the job. Return
+ * _LP_INFEASIBLE if the objective value reaches cutoff.
+ */
+int lp_simplex::resolve(int limit,double cutoff) {
+    vector<double> y(m);
+    for (int i=0;i<m;++i) {
+        y[i]=basis[i]<ns?model->cost[basis[i]]:0;
+    }
+    lu.btran(y);
+    if (!is_dual_feasible(y))
+        return primal(limit);
+    int res=dual(limit,cutoff);
+    if (res!=_LP_SOLVED)
+        return res;
+    return primal(limit);
+}
+
+/*
+ * Branch&bound node for the floating-point solver. Instead of the complete
+ * subproblem, it holds the bounds tightened on the path from the root and the
+ * optimal basis of the parent, from which the dual simplex method restarts.
+ */
+struct lp_bb_node {
+    int id,parent,depth;
+    double bound;  //optimal value of the parent relaxation
+    double infeas; //sum of integer infeasibilities of the parent solution
+    vector<pair<int,pair<double,double> > > bounds;
+    ints basis;
+    vector<bool> at_upper;
+    int branch_var,branch_dir;
+    double branch_frac;
+};
+
+/*
+ * State of the branch&bound shared by the threads. Only the thread with
+ * index 0, which is the calling thread, sends messages.
+ */
+struct lp_bb_shared {
+    lp_problem *prob;
+    const lp_simplex *root;
+    vector<lp_bb_node> pool;
+    int next_id,busy;
+    bool stop,depth_exceeded,iteration_limit_exceeded;
+    double incumbent,root_bound,root_infeas,start_time,last_report;
+    vector<double> solution;
+    vector<double> active_bound; //bound of the node processed by each thread
+    vector<pair<string,int> > messages;
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#endif
+};
+
+struct lp_bb_thread {
+    lp_bb_shared *sh;
+    int index;
+};
+
+static void lp_bb_lock(lp_bb_shared &sh) {
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_lock(&sh.mutex);
+#endif
+}
+
+static void lp_bb_unlock(lp_bb_shared &sh) {
+#ifdef HAVE_LIBPTHREAD
+    pthread_mutex_unlock(&sh.mutex);
+#endif
+}
+
+/*
+ * Nodes with bounds not smaller than this value are fathomed.
+ */
+static double lp_bb_cutoff(const lp_bb_shared &sh) {
+    if (sh.incumbent>=DBL_MAX)
+        return DBL_MAX;
+    return sh.incumbent-LP_PRIMAL_TOL*(1+std::abs(sh.incumbent));
+}
+
+/*
+ * Return the index of the next node in the pool according to the node
+ * selection strategy.
+ */
+static int lp_bb_select(const lp_bb_shared &sh) {
+    int ns=sh.prob->settings.nodeselect,k=-1;
+    bool has_incumbent=sh.incumbent<DBL_MAX;
+    double key,best=DBL_MAX,iopt=has_incumbent?sh.incumbent:0;
+    for (int i=0;i<int(sh.pool.size());++i) {
+        const lp_bb_node &node=sh.pool[i];
+        if (ns==_LP_DEPTHFIRST || (ns==_LP_HYBRID && !has_incumbent)) {
+            if (k>=0 && (node.depth<sh.pool[k].depth || (node.depth==sh.pool[k].depth && node.bound>=best)))
+                continue;
+            k=i;
+            best=node.bound;
+            continue;
+        }
+        key=node.bound;
+        if (ns==_LP_BEST_PROJECTION && sh.root_infeas>0)
+            key+=(iopt-sh.root_bound)*node.infeas/sh.root_infeas;
+        if (k<0 || key<best) {
+            k=i;
+            best=key;
+        }
+    }
+    return k;
+}
+
+/*
+ * Return the index of the branching variable among the fractional ones,
+ * according to the variable selection strategy.
+ */
+static int lp_bb_branching_variable(lp_bb_shared &sh,const ints &fractional,const vector<double> &frac) {
+    const lp_settings &settings=sh.prob->settings;
+    int j=-1;
+    double score,max_score=0;
+    if (settings.varselect==_LP_PSEUDOCOST || settings.varselect<0) {
+        for (int k=0;k<int(fractional.size());++k) {
+            score=sh.prob->variables[fractional[k]].score(frac[k]);
+            if (score==0) {
+                j=-1;
+                break;
+            }
+            if (score>max_score) {
+                j=k;
+                max_score=score;
+            }
+        }
+        if (j>=0)
+            return fractional[j];
+    }
+    switch (settings.varselect) {
+    case _LP_FIRSTFRACTIONAL:
+        return fractional.front();
+    case _LP_LASTFRACTIONAL:
+        return fractional.back();
+    default:
+        max_score=0;
+        for (int k=0;k<int(fractional.size());++k) {
+            if ((score=std::min(frac[k],1-frac[k]))>max_score) {
+                j=k;
+                max_score=score;
+            }
+        }
+        return fractional[j];
+    }
+}
+
+/*
+ * Send the pending messages and, if it is time, report the status.
+ */
+static void lp_bb_report(lp_bb_shared &sh) {
+    lp_problem &prob=*sh.prob;
+    char buffer[256];
+    for (vector<pair<string,int> >::const_iterator it=sh.messages.begin();it!=sh.messages.end();++it) {
+        if (it->second<0)
+            prob.message(it->first.c_str(),true);
+        else prob.report_status(it->first.c_str(),it->second);
+    }
+    sh.messages.clear();
+    double now=gt_profiler::clock();
+    if ((now-sh.last_report)*prob.settings.status_report_freq>=1) {
+        double lbound=DBL_MAX;
+        for (vector<lp_bb_node>::const_iterator it=sh.pool.begin();it!=sh.pool.end();++it) {
+            lbound=std::min(lbound,it->bound);
+        }
+        sprintf(buffer,"%d nodes active, lower bound: %g",int(sh.pool.size())+sh.busy,lbound);
+        string str(buffer);
+        if (prob.stats.mip_gap>=0) {
+            sprintf(buffer,", integrality gap: %g%%",prob.stats.mip_gap*100);
+            str+=string(buffer);
+        }
+        prob.report_status(str.c_str(),prob.stats.subproblems_examined);
+        sh.last_report=now;
+    }
+}
+
+/*
+ * Branch&bound worker. Each thread owns a copy of the root simplex solver.
+ * A node which is a child of the previously solved node is reoptimized from
+ * the basis already in the solver, else the parent basis is loaded first.
+ */
+static void *lp_bb_worker(void *arg) {
+    lp_bb_thread &td=*(lp_bb_thread*)arg;
+    lp_bb_shared &sh=*td.sh;
+    lp_problem &prob=*sh.prob;
+    const lp_settings &settings=prob.settings;
+    lp_simplex S(*sh.root);
+    vector<pair<int,pair<double,double> > > applied;
+    vector<pair<int,pair<double,double> > >::const_iterator bt;
+    vector<lp_bb_node> children;
+    ints fractional,basis;
+    vector<double> frac;
+    vector<bool> at_upper;
+    lp_bb_node node;
+    int last_id=-1,k,res;
+    double cutoff,obj=0,infeas,v,p,lbound;
+    lp_bb_lock(sh);
+    while (true) {
+        while (!sh.stop && sh.pool.empty() && sh.busy>0) {
+#ifdef HAVE_LIBPTHREAD
+            pthread_cond_wait(&sh.cond,&sh.mutex);
+#endif
+        }
+        if (sh.stop || sh.pool.empty())
+            break;
+        k=lp_bb_select(sh);
+        std::swap(node,sh.pool[k]);
+        std::swap(sh.pool[k],sh.pool.back());
+        sh.pool.pop_back();
+        cutoff=lp_bb_cutoff(sh);
+        if (node.bound>=cutoff)
+            continue;
+        ++sh.busy;
+        sh.active_bound[td.index]=node.bound;
+        lp_bb_unlock(sh);
+        //solve the relaxation
+        for (bt=applied.begin();bt!=applied.end();++bt) {
+            S.set_bounds(bt->first,sh.root->lower(bt->first),sh.root->upper(bt->first));
+        }
+        for (bt=node.bounds.begin();bt!=node.bounds.end();++bt) {
+            S.set_bounds(bt->first,bt->second.first,bt->second.second);
+        }
+        applied=node.bounds;
+        if (node.parent!=last_id)
+            S.load_basis(node.basis,node.at_upper);
+        res=S.resolve(settings.iteration_limit,cutoff);
+        last_id=node.id;
+        fractional.clear();
+        frac.clear();
+        infeas=0;
+        if (res==_LP_SOLVED) {
+            obj=S.objective();
+            for (int j=0;j<S.structural_count();++j) {
+                if (!prob.variables[j].is_integral())
+                    continue;
+                v=S.value(j);
+                p=v-std::floor(v);
+                if (p>LP_INTEGRALITY_TOL && p<1-LP_INTEGRALITY_TOL) {
+                    fractional.push_back(j);
+                    frac.push_back(p);
+                    infeas+=std::min(p,1-p);
+                }
+            }
+            if (!fractional.empty())
+                S.save_basis(basis,at_upper);
+        }
+        lp_bb_lock(sh);
+        --sh.busy;
+        sh.active_bound[td.index]=DBL_MAX;
+        ++prob.stats.subproblems_examined;
+        ++prob.stats.thread_nodes[td.index];
+        GT_COUNT("lp_bb_nodes",1);
+        if (res==_LP_ERROR && !sh.iteration_limit_exceeded) {
+            sh.messages.push_back(make_pair(string("Warning: iteration limit exceeded"),-1));
+            sh.iteration_limit_exceeded=true;
+        }
+        if (res==_LP_SOLVED) {
+            if (node.branch_var>=0)
+                prob.variables[node.branch_var].update_pseudocost(std::max(obj-node.bound,0.0),node.branch_frac,node.branch_dir);
+            if (node.parent<0) {
+                sh.root_bound=obj;
+                sh.root_infeas=infeas;
+            }
+            cutoff=lp_bb_cutoff(sh);
+            if (obj<cutoff && fractional.empty()) {
+                //new incumbent found
+                char buffer[256];
+                if (sh.incumbent>=DBL_MAX)
+                    sh.messages.push_back(make_pair(string("Incumbent solution found"),prob.stats.subproblems_examined));
+                else {
+                    sprintf(buffer,"Incumbent solution updated, objective value improvement: %g%%",
+                            (sh.incumbent-obj)/std::abs(sh.incumbent)*100.0);
+                    sh.messages.push_back(make_pair(string(buffer),prob.stats.subproblems_examined));
+                }
+                sh.incumbent=obj;
+                for (int j=0;j<S.structural_count();++j) {
+                    v=S.value(j);
+                    sh.solution[j]=prob.variables[j].is_integral()?std::floor(v+0.5):v;
+                }
+                cutoff=lp_bb_cutoff(sh);
+                for (int i=int(sh.pool.size())-1;i>=0;--i) {
+                    if (sh.pool[i].bound>=cutoff) {
+                        std::swap(sh.pool[i],sh.pool.back());
+                        sh.pool.pop_back();
+                    }
+                }
+            } else if (obj<cutoff) {
+                if (node.depth>=settings.depth_limit) {
+                    if (!sh.depth_exceeded) {
+                        sh.messages.push_back(make_pair(string("Warning: depth limit exceeded"),-1));
+                        sh.depth_exceeded=true;
+                    }
+                } else {
+                    //branch
+                    int j=lp_bb_branching_variable(sh,fractional,frac);
+                    v=std::floor(S.value(j));
+                    for (int dir=0;dir<2;++dir) {
+                        sh.pool.push_back(lp_bb_node());
+                        lp_bb_node &child=sh.pool.back();
+                        child.id=sh.next_id++;
+                        child.parent=node.id;
+                        child.depth=node.depth+1;
+                        child.bound=obj;
+                        child.infeas=infeas;
+                        child.bounds=node.bounds;
+                        child.bounds.push_back(make_pair(j,dir==0?make_pair(S.lower(j),v):make_pair(v+1,S.upper(j))));
+                        child.basis=basis;
+                        child.at_upper=at_upper;
+                        child.branch_var=j;
+                        child.branch_dir=dir;
+                        child.branch_frac=S.value(j)-v;
+                    }
+                }
+            }
+        }
+        //check the limits
+        int active=sh.pool.size()+sh.busy;
+        prob.stats.max_active_nodes=std::max(prob.stats.max_active_nodes,active);
+        GT_MEMORY("lp_bb_pool",double(active)*(sizeof(lp_bb_node)+sizeof(int)*prob.nc()));
+        if (sh.incumbent<DBL_MAX) {
+            lbound=sh.incumbent;
+            for (vector<lp_bb_node>::const_iterator it=sh.pool.begin();it!=sh.pool.end();++it) {
+                lbound=std::min(lbound,it->bound);
+            }
+            for (vector<double>::const_iterator it=sh.active_bound.begin();it!=sh.active_bound.end();++it) {
+                lbound=std::min(lbound,*it);
+            }
+            prob.stats.mip_gap=sh.incumbent==0?-lbound:(sh.incumbent-lbound)/std::abs(sh.incumbent);
+            if (settings.relative_gap_tolerance>0 && prob.stats.mip_gap<=settings.relative_gap_tolerance && active>0 && !sh.stop) {
+                sh.messages.push_back(make_pair(string("Warning: integrality gap threshold reached"),-1));
+                sh.stop=true;
+            }
+        }
+        if (!sh.stop && prob.stats.subproblems_examined>=settings.node_limit) {
+            sh.messages.push_back(make_pair(string("Warning: node limit exceeded"),-1));
+            sh.stop=true;
+        }
+        if (!sh.stop && 1e3*(gt_profiler::clock()-sh.start_time)>settings.time_limit) {
+            sh.messages.push_back(make_pair(string("Warning: time limit exceeded"),-1));
+            sh.stop=true;
+        }
+#ifdef HAVE_LIBPTHREAD
+        pthread_cond_broadcast(&sh.cond);
+#endif
+        if (td.index==0)
+            lp_bb_report(sh);
+    }
+#ifdef HAVE_LIBPTHREAD
+    pthread_cond_broadcast(&sh.cond);
+#endif
+    lp_bb_unlock(sh);
+    return NULL;
+}
+
+/*
+ * Run branch&bound from the root relaxation solved by root. Return true and
+ * store the best integer feasible solution to x if one is found.
+ */
+static bool lp_branch_and_bound(lp_problem &prob,const lp_simplex &root,vector<double> &x) {
+    GT_PROFILE(profile,"lp_branch_and_bound");
+    char buffer[1024];
+    lp_bb_shared sh;
+    sh.prob=&prob;
+    sh.root=&root;
+    sh.next_id=1;
+    sh.busy=0;
+    sh.stop=sh.depth_exceeded=sh.iteration_limit_exceeded=false;
+    sh.incumbent=DBL_MAX;
+    sh.root_bound=root.objective();
+    sh.root_infeas=0;
+    sh.start_time=sh.last_report=gt_profiler::clock();
+    sh.solution.resize(root.structural_count());
+    sh.pool.push_back(lp_bb_node());
+    lp_bb_node &rn=sh.pool.back();
+    rn.id=0;
+    rn.parent=-1;
+    rn.depth=0;
+    rn.bound=-DBL_MAX;
+    rn.infeas=0;
+    rn.branch_var=-1;
+    root.save_basis(rn.basis,rn.at_upper);
+    int nthreads=1;
+#ifdef HAVE_LIBPTHREAD
+    nthreads=std::max(1,threads);
+    pthread_mutex_init(&sh.mutex,NULL);
+    pthread_cond_init(&sh.cond,NULL);
+#endif
+    sh.active_bound.assign(nthreads,DBL_MAX);
+    prob.stats.thread_nodes.assign(nthreads,0);
+    vector<lp_bb_thread> td(nthreads);
+    for (int t=0;t<nthreads;++t) {
+        td[t].sh=&sh;
+        td[t].index=t;
+    }
+#ifdef HAVE_LIBPTHREAD
+    vector<pthread_t> tid(nthreads);
+    vector<bool> started(nthreads,false);
+    for (int t=1;t<nthreads;++t) {
+        started[t]=pthread_create(&tid[t],NULL,lp_bb_worker,&td[t])==0;
+    }
+#endif
+    lp_bb_worker(&td[0]);
+#ifdef HAVE_LIBPTHREAD
+    for (int t=1;t<nthreads;++t) {
+        if (started[t])
+            pthread_join(tid[t],NULL);
+    }
+    pthread_cond_destroy(&sh.cond);
+    pthread_mutex_destroy(&sh.mutex);
+#endif
+    lp_bb_report(sh);
+    prob.stats.elapsed=gt_profiler::clock()-sh.start_time;
+    //show branch&bound summary
+    sprintf(buffer,"Summary:\n * %d subproblem(s) examined\n * max. tree size: %d nodes",
+            prob.stats.subproblems_examined,prob.stats.max_active_nodes);
+    string str(buffer);
+    for (int t=0;t<nthreads;++t) {
+        sprintf(buffer,"\n * thread %d: %d node(s), %g nodes/s",t+1,prob.stats.thread_nodes[t],
+                prob.stats.elapsed>0?prob.stats.thread_nodes[t]/prob.stats.elapsed:0.0);
+        str+=string(buffer);
+    }
+    prob.message(str.c_str());
+    if (sh.incumbent>=DBL_MAX)
+        return false;
+    x=sh.solution;
+    return true;
+}
+
+/*
+ * Solve the problem in floating-point arithmetic by the bounded revised
+ * simplex method. Integer problems are solved by branch&bound in parallel,
+ * each thread taking nodes from a shared pool and reoptimizing them by the
+ * dual simplex method.
+ */
+int lp_problem::numeric_solve() {
+    GT_PROFILE(profile,"lp_numeric_solve");
+    stats=lp_stats();
+    if (settings.solver==_LP_INTERIOR_POINT)
+        message("Warning: interior point method requires GLPK library, using simplex method",true);
+    //create the floating-point model from the original problem
+    lp_numeric_model M;
+    M.nrows=nc();
+    M.columns.resize(nv());
+    M.cost.resize(nv());
+    M.lower.resize(nv());
+    M.upper.resize(nv());
+    M.integral.resize(nv());
+    const vecteur &obj=objective.first;
+    for (int j=0;j<nv();++j) {
+        lp_variable &var=variables[j];
+        M.cost[j]=j<int(obj.size())?gen2double(obj[j],ctx)*(settings.maximize?-1:1):0;
+        M.lower[j]=var.range().is_unrestricted_below()?-DBL_MAX:gen2double(var.range().lb(),ctx);
+        M.upper[j]=var.range().is_unrestricted_above()?DBL_MAX:gen2double(var.range().ub(),ctx);
+        M.integral[j]=var.is_integral();
+    }
+    M.row_lower.resize(nc());
+    M.row_upper.resize(nc());
+    gen a;
+    for (int i=0;i<nc();++i) {
+        for (int j=0;j<nv();++j) {
+            if (!is_zero(a=constr.lhs[i][j]))
+                M.columns[j].push_back(make_pair(i,gen2double(a,ctx)));
+        }
+        double rh=gen2double(constr.rhs[i],ctx);
+        M.row_lower[i]=constr.rv[i]==_LP_LEQ?-DBL_MAX:rh;
+        M.row_upper[i]=constr.rv[i]==_LP_GEQ?DBL_MAX:rh;
+    }
+    size_t nnz=0;
+    for (vector<lp_sparse_vector>::const_iterator it=M.columns.begin();it!=M.columns.end();++it) {
+        nnz+=it->size();
+    }
+    GT_MEMORY("lp_numeric_model",sizeof(pair<int,double>)*double(nnz));
+    message("Optimizing...");
+    lp_simplex root(M);
+    int result=root.solve(settings.iteration_limit);
+    if (result==_LP_ERROR)
+        message("Error: simplex method failed to converge",true);
+    if (result!=_LP_SOLVED)
+        return result;
+    vector<double> x(nv());
+    for (int j=0;j<nv();++j) {
+        x[j]=root.value(j);
+    }
+    if (has_integral_variables()) {
+        message("Applying branch&bound method to find integer feasible solutions...");
+        if (!lp_branch_and_bound(*this,root,x))
+            return _LP_INFEASIBLE;
+    }
+    solution=vecteur(nv());
+    double opt=0;
+    for (int j=0;j<nv();++j) {
+        opt+=M.cost[j]*x[j];
+        if (M.integral[j] && std::abs(x[j])<RAND_MAX)
+            solution[j]=gen(int(x[j]));
+        else solution[j]=gen(x[j]);
+    }
+    optimum=gen(settings.maximize?-opt:opt)+objective.second;
+    return _LP_SOLVED;
+}
+
 #ifdef HAVE_LIBGLPK
 
 /*
@@ -1372,12 +2585,12 @@ int lp_problem::glpk_branchcut(glp_prob *prob) {
 #endif
 
 /*
- * Solve the problem using the GLPK library.
+ * Solve the problem using the GLPK library, or by the native floating-point
+ * solver if GLPK is not available.
  */
 int lp_problem::glpk_solve() {
 #ifndef HAVE_LIBGLPK
-    message("Warning: solving in floating-point arithmetic requires GLPK library",true);
-    return solve();
+    return numeric_solve();
 #else
     glp_prob *prob=glpk_initialize();
     int result=0,solution_status;
@@ -17,6 +17,12 @@ namespace giac {
 #define LP_MIN_PARALLELISM 0.86
 #define LP_MAX_MAGNITUDE 1e6
 #define LP_CONSTR_MAXSIZE 1e5
+#define LP_PRIMAL_TOL 1e-7
+#define LP_DUAL_TOL 1e-7
+#define LP_PIVOT_TOL 1e-9
+#define LP_INTEGRALITY_TOL 1e-6
+#define LP_REFACTOR_PERIOD 100
+#define LP_ARTIFICIAL_BOUND 1e6
 
 typedef std::vector<int> ints;
 
@@ -80,6 +86,8 @@ struct lp_stats {
     int cuts_applied;
     int max_active_nodes;
     double mip_gap;
+    double elapsed; //wall time of branch&bound in seconds
+    ints thread_nodes; //subproblems examined by each branch&bound thread
     lp_stats();
 };
 
@@ -197,6 +205,8 @@ struct lp_problem {
 #endif
     int glpk_solve();
     bool glpk_load_from_file(const char *fname);
+    //native floating-point solver
+    int numeric_solve();
 };
 
 class lp_node {
@@ -238,6 +248,84 @@ public:
     int solve_relaxation();
 };
 
+typedef std::vector<std::pair<int,double> > lp_sparse_vector;
+
+/*
+ * Sparse LU factorization of the simplex basis B, computed with Markowitz
+ * pivoting and updated by the method of Forrest and Tomlin. Vectors indexed
+ * by rows are passed to ftran, which solves B*x=a, and vectors indexed by
+ * basis positions (slots) to btran, which solves B^T*y=c.
+ */
+class lp_basis_factor {
+    struct eta {
+        int pivot;
+        lp_sparse_vector entries;
+    };
+    int m;
+    std::vector<eta> lower;     //column etas from the elimination
+    std::vector<eta> row_etas;  //row etas from the updates
+    std::vector<lp_sparse_vector> urows; //off-diagonal entries of U in each row as (slot,value)
+    std::vector<ints> ucols;             //rows which may have a U entry in the given slot
+    std::vector<double> diag;   //pivot of each row
+    ints slot_of_row,row_of_slot;
+    ints seq;                   //rows in pivot order
+    std::vector<double> work;
+public:
+    lp_basis_factor() { m=0; }
+    bool factorize(const std::vector<lp_sparse_vector> &cols,ints &bad_slots,ints &bad_rows);
+    void ftran(std::vector<double> &x,std::vector<double> *spike=NULL);
+    void btran(std::vector<double> &y);
+    bool update(int slot,const std::vector<double> &spike);
+    int update_count() const { return row_etas.size(); }
+};
+
+/*
+ * Floating-point problem min c^T*x s.t. rl<=A*x<=ru and l<=x<=u, where
+ * infinite bounds are +-DBL_MAX.
+ */
+struct lp_numeric_model {
+    int nrows;
+    std::vector<lp_sparse_vector> columns;
+    std::vector<double> cost,lower,upper,row_lower,row_upper;
+    std::vector<bool> integral;
+    int ncols() const { return columns.size(); }
+};
+
+/*
+ * Bounded revised simplex method. Each row i has a logical variable equal to
+ * the activity of that row, so the basis initially consists of logicals.
+ * Primal simplex minimizes the sum of infeasibilities first and then the
+ * objective, dual simplex reoptimizes after tightening the bounds.
+ */
+class lp_simplex {
+    const lp_numeric_model *model;
+    int m,ns,n,iterations;
+    std::vector<double> lb,ub,x;
+    ints basis,position; //position[j] is the slot of basic variable j, -1 for nonbasic
+    lp_basis_factor lu;
+    double dot(int j,const std::vector<double> &y) const;
+    void scatter(int j,std::vector<double> &a) const;
+    void compute_primal();
+    void refactor();
+    void pivot(int r,int q,double step,const std::vector<double> &alpha,const std::vector<double> &spike,double leave_value);
+    bool is_dual_feasible(const std::vector<double> &y) const;
+    int primal(int limit);
+    int dual(int limit,double cutoff);
+public:
+    lp_simplex(const lp_numeric_model &M);
+    int structural_count() const { return ns; }
+    double lower(int j) const { return lb[j]; }
+    double upper(int j) const { return ub[j]; }
+    void set_bounds(int j,double l,double u);
+    double value(int j) const { return x[j]; }
+    double objective() const;
+    int iteration_count() const { return iterations; }
+    void save_basis(ints &b,std::vector<bool> &at_upper) const;
+    void load_basis(const ints &b,const std::vector<bool> &at_upper);
+    int solve(int limit);
+    int resolve(int limit,double cutoff);
+};
+
 gen _lpsolve(const gen &args,GIAC_CONTEXT);
 extern const unary_function_ptr * const  at_lpsolve;
 
@@ -246,23 +246,41 @@ string mml_tag(const string &tag,const string &str,int idc=0,
                const string &attr_key2="",const string &attr_val2="",
                const string &attr_key3="",const string &attr_val3="",
                const string &attr_key4="",const string &attr_val4="") {
-  string r,attr1,attr2,attr3,attr4;
+  const char *r=NULL;
   if (tag[0]=='c' || is_mathml_content_element(tag))
     r="id";
   else if (tag[0]=='m')
     r="xref";
-  assert(!r.empty());
-  if (!attr_key1.empty() && !attr_val1.empty())
-    attr1=" "+attr_key1+"='"+attr_val1+"'";
-  if (!attr_key2.empty() && !attr_val2.empty())
-    attr2=" "+attr_key2+"='"+attr_val2+"'";
-  if (!attr_key3.empty() && !attr_val3.empty())
-    attr3=" "+attr_key3+"='"+attr_val3+"'";
-  if (!attr_key4.empty() && !attr_val4.empty())
-    attr4=" "+attr_key4+"='"+attr_val4+"'";
-  if (idc==0)
-    return "<"+tag+attr1+attr2+attr3+attr4+">"+str+"</"+tag+">";
-  return "<"+tag+" "+r+"='id"+gen(idc).print(context0)+"'"+attr1+attr2+attr3+attr4+">"+str+"</"+tag+">";
+  assert(r!=NULL);
+  /* the result is assembled in place, it may be large */
+  string ret;
+  ret.reserve(str.size()+2*tag.size()+64);
+  ret+='<';
+  ret+=tag;
+  if (idc!=0) {
+    ret+=' ';
+    ret+=r;
+    ret+="='id";
+    ret+=print_INT_(idc);
+    ret+='\'';
+  }
+  const string *attr[8]={&attr_key1,&attr_val1,&attr_key2,&attr_val2,
+                         &attr_key3,&attr_val3,&attr_key4,&attr_val4};
+  for (int i=0;i<8;i+=2) {
+    if (attr[i]->empty() || attr[i+1]->empty())
+      continue;
+    ret+=' ';
+    ret+=*attr[i];
+    ret+="='";
+    ret+=*attr[i+1];
+    ret+='\'';
+  }
+  ret+='>';
+  ret+=str;
+  ret+="</";
+  ret+=tag;
+  ret+='>';
+  return ret;
 }
 
 string mml_csymbol(const string &s,const string &cd) {
@@ -282,7 +300,7 @@ string extract_id(MarkupBlock &ml,bool content) {
   assert(pos_id_end!=string::npos);
   string ret=str.substr(pos_id_start+attr.length(),
                           pos_id_end-pos_id_start-attr.length());
-  str=str.substr(0,pos_id_start)+str.substr(pos_id_end+1);
+  str.erase(pos_id_start,pos_id_end+1-pos_id_start);
   return ret;
 }
 
@@ -293,12 +311,12 @@ string insert_id(const string &str,int idc,bool content) {
   if (pos==string::npos || pos==0)
     return str;
   if (str[pos-1]=='/') pos--;
-  string r=(content?" id='id":" xref='id");
-  return str.substr(0,pos)+r+gen(idc).print(context0)+"'"+str.substr(pos);
+  string ret(str);
+  ret.insert(pos,(content?" id='id":" xref='id")+print_INT_(idc)+"'");
+  return ret;
 }
 
-string trim_string(const string &s_orig,int &indent) {
-  string s=s_orig;
+string trim_string(const string &s,int &indent) {
   size_t i,j;
   indent=0;
   for (i=0;i<s.length();++i) {
@@ -322,16 +340,19 @@ string str_to_tex(const string &s_orig,bool quote,bool ind) {
   for (string::const_iterator it=s.begin();it!=s.end();++it) {
     switch (*it) {
     case '\\': case '%': case '_': case '$': case '{': case '}': case '^':
-      ret+="\\";
-      ret+=string(1,*it);
+      ret+='\\';
+      ret+=*it;
       break;
     default:
-      ret+=string(1,*it);
+      ret+=*it;
       break;
     }
   }
-  if (ind && indent>0)
-    for (int i=0;i<indent;++i) ret="\\ "+ret;
+  if (ind && indent>0) {
+    string pre;
+    for (int i=0;i<indent;++i) pre+="\\ ";
+    ret.insert(0,pre);
+  }
   if (quote)
     return "\""+ret+"\"";
   return ret;
@@ -344,15 +365,15 @@ string str_to_scm(const string &s_orig,bool quote,bool ind) {
     switch (*it) {
     case '\\': case '"':
       ret+="\\\\\\";
-      ret+=string(1,*it);
+      ret+=*it;
       break;
     default:
-      ret+=string(1,*it);
+      ret+=*it;
       break;
     }
   }
   if (ind && indent>0)
-    for (int i=0;i<indent;++i) ret=" "+ret;
+    ret.insert(0,indent,' ');
   if (quote)
     return "``"+ret+"''";
   return ret;
@@ -373,7 +394,7 @@ string str_to_mml(const string &s_orig,bool ind,const string &tag="",int idc=0)
       ret+="&gt;";
       break;
     default:
-      ret+=string(1,*it);
+      ret+=*it;
       break;
     }
   }
@@ -896,35 +917,36 @@ string idnt2markup(const string &s_orig,int typ,bool unit,int idc,bool &isname)
   return ret;
 }
 
-vecteur flatten_operands(const gen &g) {
-  assert(g.type==_SYMB);
-  vecteur ops;
+/* append the operands of g to ops, operands with the same operator as g are expanded */
+void flatten_operands(const gen &g,const unary_function_ptr &op,vecteur &ops) {
   const gen &arg=g._SYMBptr->feuille;
-  if (arg.type!=_VECT)
+  if (arg.type!=_VECT) {
     ops.push_back(arg);
-  else {
-    const vecteur &args=*arg._VECTptr;
-    for (int i=0;i<int(args.size());++i) {
-      gen op=args[i];
-      const_iterateur it;
-      if (op.type==_SYMB && op._SYMBptr->sommet==g._SYMBptr->sommet) {
-        vecteur subops=flatten_operands(op);
-        for (it=subops.begin();it!=subops.end();++it)
-          ops.push_back(*it);
-      } else
-        ops.push_back(op);
-    }
+    return;
   }
+  const vecteur &args=*arg._VECTptr;
+  for (const_iterateur it=args.begin();it!=args.end();++it) {
+    if (it->type==_SYMB && it->_SYMBptr->sommet==op)
+      flatten_operands(*it,op,ops);
+    else
+      ops.push_back(*it);
+  }
+}
+
+vecteur flatten_operands(const gen &g) {
+  assert(g.type==_SYMB);
+  vecteur ops;
+  flatten_operands(g,g._SYMBptr->sommet,ops);
   return ops;
 }
 
 void parenthesize(MarkupBlock &ml,int flags) {
   if ((flags & _MARKUP_LATEX)!=0)
-    ml.latex="\\left("+ml.latex+"\\right)";
+    ml.latex.insert(0,"\\left(").append("\\right)");
   if ((flags & _MARKUP_MATHML_PRESENTATION)!=0)
-    ml.markup="<mfenced>"+ml.markup+"</mfenced>";
+    ml.markup.insert(0,"<mfenced>").append("</mfenced>");
   if ((flags & _MARKUP_SCHEME)!=0)
-    ml.scheme="(around* \"(\" "+ml.scheme+" \")\")";
+    ml.scheme.insert(0,"(around* \"(\" ").append(" \")\")");
   ml.priority=0;
 }
 
@@ -939,7 +961,7 @@ void prepend_minus(MarkupBlock &ml,int flags,bool circled=false,bool mrow=true)
   if (ml.priority>_PRIORITY_MUL)
     parenthesize(ml,flags);
   if ((flags & _MARKUP_LATEX)!=0)
-    ml.latex=(circled?"\\ominus ":"-")+ml.latex;
+    ml.latex.insert(0,circled?"\\ominus ":"-");
   if ((flags & _MARKUP_SCHEME)!=0)
     ml.scheme=scm_concat((circled?"\"<ominus>\" ":"\"-\" ")+ml.scheme);
   if ((flags & _MARKUP_MATHML_CONTENT)!=0) {
@@ -1788,7 +1810,9 @@ MarkupBlock gen2markup(const gen &g,int flags_orig,int &idc,GIAC_CONTEXT) {
     }
     if ((g.is_symb_of_sommet(at_prod) || g.is_symb_of_sommet(at_ampersand_times)) && vectarg) {
       int neg_count=0,num_count=0,den_count=0,nc=0,dc=0;
-      MarkupBlock pden,pnum,prev;
+      /* only the types of the previous factors are needed, blocks are not copied */
+      int pden_type=_MLBLOCK_GENERAL,pnum_type=_MLBLOCK_GENERAL,prev_type;
+      bool pden_appl=false,pnum_appl=false,prev_appl;
       string num,numc,numt,nums,den,denc,dent,dens,prod_sign,prod_sign_tex,prod_sign_scm;
       vecteur args=flatten_operands(g),ncnst,cnsts;
       for (int i=args.size();i-->0;) {
@@ -1808,12 +1832,6 @@ MarkupBlock gen2markup(const gen &g,int flags_orig,int &idc,GIAC_CONTEXT) {
       }
       args=mergevecteur(mergevecteur(ncnst,cnsts),args);
       ml.priority=_PRIORITY_MUL;
-      pden.type=_MLBLOCK_GENERAL;
-      pden.appl=false;
-      pden.priority=0;
-      pnum.type=_MLBLOCK_GENERAL;
-      pnum.appl=false;
-      pnum.priority=0;
       bool isinv,hasleadingfrac=true,is_cdot;
       int ni,di,np=-1,dp=-1;
       for (iterateur it=args.begin();it!=args.end();++it) {
@@ -1866,10 +1884,12 @@ MarkupBlock gen2markup(const gen &g,int flags_orig,int &idc,GIAC_CONTEXT) {
           neg_count++;
         if (isinv) {
           dc++;
-          prev=pden;
+          prev_type=pden_type;
+          prev_appl=pden_appl;
         } else {
           nc++;
-          prev=pnum;
+          prev_type=pnum_type;
+          prev_appl=pnum_appl;
         }
         if (((!isinv && num_count>1) || (isinv && den_count>1)) &&
             (tmp.priority>ml.priority || (tmp.priority==ml.priority && fc.type!=_CPLX)) &&
@@ -1880,14 +1900,15 @@ MarkupBlock gen2markup(const gen &g,int flags_orig,int &idc,GIAC_CONTEXT) {
         is_cdot=
             tmp.ctype(_MLBLOCK_LEADING_DIGIT) || tmp.ctype(_MLBLOCK_SUBTYPE_IDNT) ||
             tmp.ctype(_MLBLOCK_FACTORIAL) || tmp.ctype(_MLBLOCK_IDNT_NAME) ||
-            prev.ctype(_MLBLOCK_IDNT_NAME) || prev.ctype(_MLBLOCK_SUBTYPE_IDNT) ||
-            (tmp.ctype(_MLBLOCK_FRACTION) && prev.ctype(_MLBLOCK_FRACTION)) ||
-            (prev.ctype(_MLBLOCK_ELEMAPP) && prev.appl);
+            (prev_type & (_MLBLOCK_IDNT_NAME | _MLBLOCK_SUBTYPE_IDNT))!=0 ||
+            (tmp.ctype(_MLBLOCK_FRACTION) && (prev_type & _MLBLOCK_FRACTION)!=0) ||
+            ((prev_type & _MLBLOCK_ELEMAPP)!=0 && prev_appl);
         prod_sign=is_cdot?mml_cdot:mml_itimes;
         prod_sign_tex=is_cdot?"\\cdot ":tex_itimes;
         prod_sign_scm=is_cdot?" \"<cdot>\" ":" \"*\" ";
         if (isinv) {
-          pden=tmp;
+          pden_type=tmp.type;
+          pden_appl=tmp.appl;
           if (mml_content)
             denc+=tmp.content;
           if (mml_presentation)
@@ -1897,7 +1918,8 @@ MarkupBlock gen2markup(const gen &g,int flags_orig,int &idc,GIAC_CONTEXT) {
           if (scm)
             dens+=(dens.empty()?"":prod_sign_scm)+tmp.scheme;
         } else {
-          pnum=tmp;
+          pnum_type=tmp.type;
+          pnum_appl=tmp.appl;
           if (mml_content)
             numc+=tmp.content;
           if (mml_presentation)
@@ -3519,20 +3541,176 @@ MarkupBlock gen2markup(const gen &g,int flags_orig,int &idc,GIAC_CONTEXT) {
   return ml;
 }
 
+void markup_file_writer::write(const char *s,size_t len) {
+  if (_len+len>_buf.size()) {
+    flush();
+    if (len>=_buf.size()) {
+      if (fwrite(s,1,len,_fp)!=len)
+        _failed=true;
+      return;
+    }
+  }
+  memcpy(&_buf[_len],s,len);
+  _len+=len;
+}
+
+void markup_file_writer::flush() {
+  if (_len>0 && fwrite(&_buf[0],1,_len,_fp)!=_len)
+    _failed=true;
+  _len=0;
+  fflush(_fp);
+}
+
+/* Writes the LaTeX or Scheme markup for g to out. Top-level matrices, lists and
+ * sums are written element by element, so that their markup is never assembled
+ * in a single string. The output is the same as with gen2markup. */
+static void gen2markup_stream(const gen &g,int flags,int &idc,markup_writer &out,GIAC_CONTEXT) {
+  bool tex=(flags & _MARKUP_LATEX)!=0;
+  bool toplevel=(flags & _MARKUP_TOPLEVEL)!=0;
+  int cflags=flags & ~(_MARKUP_TOPLEVEL | _MARKUP_FACTOR);
+  MarkupBlock tmp;
+  string str;
+  if (g.type==_VECT && !g._VECTptr->empty() &&
+      !(g.subtype==_GRAPH__VECT && is_graphe(g,str,contextptr))) {
+    const vecteur &v=*g._VECTptr;
+    int st=g.subtype;
+    if (ckmatrix(v) && (st==0 || st==_MATRIX__VECT)) {
+      const char *ld=(st==0?"[":"("),*rd=(st==0?"]":")");
+      if (tex) {
+        out.write("\\left");
+        out.write(ld);
+        out.write("\\begin{array}{");
+        out.write(string(v.front()._VECTptr->size(),'c'));
+        out.write("}");
+      } else out.write("(matrix (tformat (table");
+      for (const_iterateur it=v.begin();it!=v.end();++it) {
+        if (!tex)
+          out.write(" (row");
+        else if (it!=v.begin())
+          out.write("\\\\");
+        for (const_iterateur jt=it->_VECTptr->begin();jt!=it->_VECTptr->end();++jt) {
+          tmp=gen2markup(*jt,cflags,idc,contextptr);
+          prepend_minus(tmp,cflags);
+          if (tex) {
+            if (jt!=it->_VECTptr->begin())
+              out.write("&");
+            out.write(tmp.latex);
+          } else {
+            out.write(" (cell ");
+            out.write(tmp.scheme);
+            out.write(")");
+          }
+        }
+        if (!tex)
+          out.write(")");
+      }
+      if (tex) {
+        out.write("\\end{array}\\right");
+        out.write(rd);
+      } else out.write(")))");
+      return;
+    }
+    const char *ld,*rd;
+    switch (st) {
+    case _SEQ__VECT:
+      ld=(toplevel?"":"(");
+      rd=(toplevel?"":")");
+      break;
+    case _SET__VECT:
+      ld=(tex?"\\{":"{");
+      rd=(tex?"\\}":"}");
+      break;
+    case _POLY1__VECT:
+      ld=(tex?"[":"<llbracket>");
+      rd=(tex?"]":"<rrbracket>");
+      break;
+    default:
+      ld="[";
+      rd="]";
+      break;
+    }
+    if (tex && *ld) {
+      out.write("\\left");
+      out.write(ld);
+    } else if (!tex) {
+      if (*ld) {
+        out.write("(around* \"");
+        out.write(ld);
+        out.write("\" ");
+      }
+      if (v.size()>1)
+        out.write("(concat ");
+    }
+    for (const_iterateur it=v.begin();it!=v.end();++it) {
+      tmp=gen2markup(*it,cflags,idc,contextptr);
+      prepend_minus(tmp,cflags);
+      if (it!=v.begin())
+        out.write(tex?",":" \",\" ");
+      out.write(tex?tmp.latex:tmp.scheme);
+    }
+    if (tex && *rd) {
+      out.write("\\right");
+      out.write(rd);
+    } else if (!tex) {
+      if (v.size()>1)
+        out.write(")");
+      if (*rd) {
+        out.write(" \"");
+        out.write(rd);
+        out.write("\")");
+      }
+    }
+    return;
+  }
+  if ((g.is_symb_of_sommet(at_plus) || g.is_symb_of_sommet(at_pointplus)) &&
+      g._SYMBptr->feuille.type==_VECT) {
+    bool circled=g.is_symb_of_sommet(at_pointplus);
+    vecteur args=flatten_operands(g);
+    if (!tex)
+      out.write("(concat ");
+    for (const_iterateur it=args.begin();it!=args.end();++it) {
+      tmp=gen2markup(*it,cflags,idc,contextptr);
+      if (!tmp.neg && it!=args.begin()) {
+        if (tex)
+          out.write(circled?"\\oplus ":"+");
+        else out.write(circled?" \"<oplus>\" ":" \"+\" ");
+      }
+      prepend_minus(tmp,cflags,circled,false);
+      if (tmp.priority>=_PRIORITY_ADD)
+        parenthesize(tmp,cflags);
+      out.write(tex?tmp.latex:tmp.scheme);
+    }
+    if (!tex)
+      out.write(")");
+    return;
+  }
+  tmp=gen2markup(g,flags,idc,contextptr);
+  prepend_minus(tmp,flags);
+  out.write(tex?tmp.latex:tmp.scheme);
+}
+
+void export_latex(const gen &g,markup_writer &out,GIAC_CONTEXT) {
+  int idc=0;
+  gen2markup_stream(g,_MARKUP_TOPLEVEL | _MARKUP_ELEMPOW | _MARKUP_LATEX,idc,out,contextptr);
+}
+
+void export_scheme(const gen &g,markup_writer &out,GIAC_CONTEXT) {
+  int idc=0;
+  gen2markup_stream(g,_MARKUP_TOPLEVEL | _MARKUP_ELEMPOW | _MARKUP_SCHEME,idc,out,contextptr);
+}
+
 string export_latex(const gen &g,GIAC_CONTEXT) {
-  MarkupBlock ml;
-  int idc=0,flags=_MARKUP_TOPLEVEL | _MARKUP_ELEMPOW | _MARKUP_LATEX;
-  ml=gen2markup(g,flags,idc,contextptr);
-  prepend_minus(ml,flags);
-  return ml.latex;
+  string ret;
+  markup_string_writer out(ret);
+  export_latex(g,out,contextptr);
+  return ret;
 }
 
 string gen2scm(const gen &g,GIAC_CONTEXT) {
-  MarkupBlock ml;
-  int idc=0,flags=_MARKUP_TOPLEVEL | _MARKUP_ELEMPOW | _MARKUP_SCHEME;
-  ml=gen2markup(g,flags,idc,contextptr);
-  prepend_minus(ml,flags);
-  return ml.scheme;
+  string ret;
+  markup_string_writer out(ret);
+  export_scheme(g,out,contextptr);
+  return ret;
 }
 
 // XML pretty printing
@@ -3633,31 +3811,67 @@ string xml_pretty_print(const string &xml,int level=0) {
 
 const string mathml_header_attributes="mode='display' xmlns='http://www.w3.org/1998/Math/MathML'";
 
-string export_mathml_content(const gen &g,GIAC_CONTEXT) {
+void export_mathml_content(const gen &g,markup_writer &out,GIAC_CONTEXT) {
   MarkupBlock ml;
   int idc=0,flags=_MARKUP_TOPLEVEL | _MARKUP_MATHML_CONTENT;
   ml=gen2markup(g,flags,idc,contextptr);
   prepend_minus(ml,flags);
-  return "<math "+mathml_header_attributes+">"+ml.content+"</math>";
+  out.write("<math ");
+  out.write(mathml_header_attributes);
+  out.write(">");
+  out.write(ml.content);
+  out.write("</math>");
 }
 
-string export_mathml_presentation(const gen &g,GIAC_CONTEXT) {
+void export_mathml_presentation(const gen &g,markup_writer &out,GIAC_CONTEXT) {
   MarkupBlock ml;
   int idc=0,flags=_MARKUP_TOPLEVEL | _MARKUP_ELEMPOW | _MARKUP_MATHML_PRESENTATION;
   ml=gen2markup(g,flags,idc,contextptr);
   prepend_minus(ml,flags);
-  return "<math "+mathml_header_attributes+">"+ml.markup+"</math>";
+  out.write("<math ");
+  out.write(mathml_header_attributes);
+  out.write(">");
+  out.write(ml.markup);
+  out.write("</math>");
 }
 
-string export_mathml(const gen &g,GIAC_CONTEXT) {
+void export_mathml(const gen &g,markup_writer &out,GIAC_CONTEXT) {
   MarkupBlock ml;
   int idc=0,flags=_MARKUP_TOPLEVEL | _MARKUP_MATHML_PRESENTATION | _MARKUP_MATHML_CONTENT;
   ml=gen2markup(g,flags,idc,contextptr);
   prepend_minus(ml,flags);
-  return "<math "+mathml_header_attributes+"><semantics>"+ml.markup+
-         "<annotation-xml encoding='MathML-Content'>"+ml.content+"</annotation-xml>"+
-         "<annotation encoding='Giac'>"+str_to_mml(g.print(contextptr),false)+
-         "</annotation></semantics></math>";
+  out.write("<math ");
+  out.write(mathml_header_attributes);
+  out.write("><semantics>");
+  out.write(ml.markup);
+  ml.markup.clear();
+  out.write("<annotation-xml encoding='MathML-Content'>");
+  out.write(ml.content);
+  ml.content.clear();
+  out.write("</annotation-xml><annotation encoding='Giac'>");
+  out.write(str_to_mml(g.print(contextptr),false));
+  out.write("</annotation></semantics></math>");
+}
+
+string export_mathml_content(const gen &g,GIAC_CONTEXT) {
+  string ret;
+  markup_string_writer out(ret);
+  export_mathml_content(g,out,contextptr);
+  return ret;
+}
+
+string export_mathml_presentation(const gen &g,GIAC_CONTEXT) {
+  string ret;
+  markup_string_writer out(ret);
+  export_mathml_presentation(g,out,contextptr);
+  return ret;
+}
+
+string export_mathml(const gen &g,GIAC_CONTEXT) {
+  string ret;
+  markup_string_writer out(ret);
+  export_mathml(g,out,contextptr);
+  return ret;
 }
 
   #ifndef KHICAS
@@ -3683,35 +3897,62 @@ bool has_improved_latex_export(const gen &g,string &s,bool override_texmacs,GIAC
 }
 #endif
   
-gen _export_mathml(const gen &g,GIAC_CONTEXT) {
-  if (g.type==_STRNG && g.subtype==-1) return g;
-  gen e;
-  int extype=0;
-  if (g.type==_VECT && g.subtype==_SEQ__VECT) {
-    const vecteur &args=*g._VECTptr;
-    if (args.size()!=2) return gensizeerr(contextptr);
-    e=args.front();
-    if (args.back()==at_display)
-      extype=1;
-    else if (args.back()==at_content)
-      extype=2;
-    else return gensizeerr(contextptr);   
-  } else e=g;
-  string ret;
+static void export_mathml_type(const gen &e,int extype,markup_writer &out,GIAC_CONTEXT) {
   switch (extype) {
   case 0:
-    ret=export_mathml(e,contextptr);
+    export_mathml(e,out,contextptr);
     break;
   case 1:
-    ret=export_mathml_presentation(e,contextptr);
+    export_mathml_presentation(e,out,contextptr);
     break;
   case 2:
-    ret=export_mathml_content(e,contextptr);
+    export_mathml_content(e,out,contextptr);
     break;
   default:
     assert(false); // unreachable
   }
-  return string2gen(ret,false);
+}
+
+gen _export_mathml(const gen &g,GIAC_CONTEXT) {
+  if (g.type==_STRNG && g.subtype==-1) return g;
+  gen e;
+  int extype=0;
+  string filename;
+  if (g.type==_VECT && g.subtype==_SEQ__VECT) {
+    vecteur args=*g._VECTptr;
+    if (args.size()>1 && args.back().type==_STRNG) {
+      filename=*args.back()._STRNGptr;
+      args.pop_back();
+    }
+    if (args.size()==2) {
+      if (args.back()==at_display)
+        extype=1;
+      else if (args.back()==at_content)
+        extype=2;
+      else return gensizeerr(contextptr);
+    } else if (args.size()!=1 || filename.empty())
+      return gensizeerr(contextptr);
+    e=args.front();
+  } else e=g;
+  if (filename.empty()) {
+    string ret;
+    markup_string_writer out(ret);
+    export_mathml_type(e,extype,out,contextptr);
+    return string2gen(ret,false);
+  }
+  FILE *fp=fopen(filename.c_str(),"w");
+  if (fp==NULL)
+    return gensizeerr("Failed to open the output file");
+  bool failed;
+  {
+    markup_file_writer out(fp);
+    export_mathml_type(e,extype,out,contextptr);
+    out.flush();
+    failed=out.failed();
+  }
+  if (fclose(fp)!=0 || failed)
+    return gensizeerr("Failed to write the output file");
+  return 1;
 }
 static const char _export_mathml_s[]="export_mathml";
 static define_unary_function_eval(__export_mathml,&_export_mathml,_export_mathml_s);
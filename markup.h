@@ -23,17 +23,59 @@
 #endif
 #include "first.h"
 #include "gen.h"
+#include <cstdio>
+#include <cstring>
 
 #ifndef NO_NAMESPACE_GIAC
 namespace giac {
 #endif // ndef NO_NAMESPACE_GIAC
 
+/* sink for exported markup, the exporters append to it piece by piece */
+class markup_writer {
+public:
+  virtual ~markup_writer() { }
+  virtual void write(const char *s,size_t len)=0;
+  virtual void flush() { }
+  void write(const string &s) { write(s.data(),s.size()); }
+  void write(const char *s) { write(s,strlen(s)); }
+};
+
+/* appends to a string, which grows geometrically */
+class markup_string_writer : public markup_writer {
+  string &_str;
+public:
+  markup_string_writer(string &s) : _str(s) { }
+  using markup_writer::write;
+  void write(const char *s,size_t len) { _str.append(s,len); }
+};
+
+/* buffered output to a C stream (a file or the TeXmacs pipe on stdout),
+ * the stream is not closed by the writer */
+class markup_file_writer : public markup_writer {
+  FILE *_fp;
+  vector<char> _buf;
+  size_t _len;
+  bool _failed;
+public:
+  markup_file_writer(FILE *fp,size_t bufsize=65536) : _fp(fp),_buf(bufsize),_len(0),_failed(false) { }
+  ~markup_file_writer() { flush(); }
+  using markup_writer::write;
+  void write(const char *s,size_t len);
+  void flush();
+  bool failed() const { return _failed; }
+};
+
 void enable_texmacs_compatible_latex_export(bool yes);
 string export_latex(const gen &g,GIAC_CONTEXT);
+void export_latex(const gen &g,markup_writer &out,GIAC_CONTEXT);
+void export_scheme(const gen &g,markup_writer &out,GIAC_CONTEXT);
 bool has_improved_latex_export(const gen &g,string &s,bool override_texmacs,GIAC_CONTEXT);
 string export_mathml(const gen &g,GIAC_CONTEXT);
 string export_mathml_presentation(const gen &g,GIAC_CONTEXT);
 string export_mathml_content(const gen &g,GIAC_CONTEXT);
+void export_mathml(const gen &g,markup_writer &out,GIAC_CONTEXT);
+void export_mathml_presentation(const gen &g,markup_writer &out,GIAC_CONTEXT);
+void export_mathml_content(const gen &g,markup_writer &out,GIAC_CONTEXT);
 gen _export_mathml(const gen &g,GIAC_CONTEXT);
 gen _xml_print(const gen &g,GIAC_CONTEXT);
 
@@ -221,6 +221,111 @@ void nautywrapper_canonical(int isdir,int n,int *adj,int *clab,unsigned long *cg
     DYNFREE(g,g_sz);
     DYNFREE(cg,cg_sz);
 }
+
+#ifndef TLS_ATTR
+#define TLS_ATTR
+#endif
+
+/* read the graph from the sequence adj of adjacency lists to g and its vertex colors to col */
+static void read_adjacency(int isdir,int n,int *adj,graph *g,int *col,int m) {
+    int i=0,j=0,k,read_col=1;
+    EMPTYGRAPH(g,m,n);
+    while (1) {
+        if ((k=adj[i++])==-1) { if ((++j)==n) break; read_col=1; }
+        else if (read_col==1) { col[j]=k; read_col=0; }
+        else if (j<k && isdir==0) { ADDONEEDGE(g,j,k,m); }
+        else if (isdir!=0) { ADDONEARC(g,j,k,m); }
+    }
+}
+
+static TLS_ATTR nautywrapper_perm_callback aut_callback;
+static TLS_ATTR void *aut_data;
+
+static void aut_hook(int count,int *perm,int *orbits,int numorbits,int stabvertex,int n) {
+    aut_callback(perm,n,aut_data);
+}
+
+void nautywrapper_aut_generators_cb(int isdir,int n,int *adj,nautywrapper_perm_callback cb,void *data) {
+    DYNALLSTAT(int,lab,lab_sz);
+    DYNALLSTAT(int,ptn,ptn_sz);
+    DYNALLSTAT(int,col,col_sz);
+    DYNALLSTAT(int,orbits,orbits_sz);
+    DYNALLSTAT(graph,g,g_sz);
+    optionblk options=isdir!=0?opts_dir:opts_undir;
+    statsblk stats;
+    int m=SETWORDSNEEDED(n);
+    nauty_check(WORDSIZE,m,n,NAUTYVERSIONID);
+    DYNALLOC1(int,lab,lab_sz,n,"malloc");
+    DYNALLOC1(int,ptn,ptn_sz,n,"malloc");
+    DYNALLOC1(int,col,col_sz,n,"malloc");
+    DYNALLOC1(int,orbits,orbits_sz,n,"malloc");
+    DYNALLOC2(graph,g,g_sz,n,m,"malloc");
+    options.getcanon=FALSE;
+    options.writeautoms=FALSE;
+    options.outfile=NULL;
+    options.defaultptn=FALSE;
+    options.userautomproc=aut_hook;
+    aut_callback=cb;
+    aut_data=data;
+    read_adjacency(isdir,n,adj,g,col,m);
+    color_graph(n,lab,ptn,col);
+    densenauty(g,lab,ptn,orbits,&options,&stats,m,n,NULL);
+}
+
+unsigned long long nautywrapper_canonical_hash(int isdir,int n,int *adj) {
+    DYNALLSTAT(int,lab,lab_sz);
+    DYNALLSTAT(int,ptn,ptn_sz);
+    DYNALLSTAT(int,col,col_sz);
+    DYNALLSTAT(int,orbits,orbits_sz);
+    DYNALLSTAT(graph,g,g_sz);
+    DYNALLSTAT(graph,cg,cg_sz);
+    optionblk options=isdir!=0?opts_dir:opts_undir;
+    statsblk stats;
+    unsigned long long h=0x9E3779B97F4A7C15ULL^((unsigned long long)n<<1)^(isdir!=0?1:0);
+    size_t cnt;
+    int i,m=SETWORDSNEEDED(n);
+    if (n==0)
+        return h;
+    nauty_check(WORDSIZE,m,n,NAUTYVERSIONID);
+    DYNALLOC1(int,lab,lab_sz,n,"malloc");
+    DYNALLOC1(int,ptn,ptn_sz,n,"malloc");
+    DYNALLOC1(int,col,col_sz,n,"malloc");
+    DYNALLOC1(int,orbits,orbits_sz,n,"malloc");
+    DYNALLOC2(graph,g,g_sz,n,m,"malloc");
+    DYNALLOC2(graph,cg,cg_sz,n,m,"malloc");
+    options.getcanon=TRUE;
+    options.writeautoms=FALSE;
+    options.outfile=NULL;
+    options.defaultptn=FALSE;
+    read_adjacency(isdir,n,adj,g,col,m);
+    color_graph(n,lab,ptn,col);
+    densenauty(g,lab,ptn,orbits,&options,&stats,m,n,cg);
+    /* the colors in canonical order, then the words of the canonical graph */
+    for (i=0;i<n;++i) {
+        h^=(unsigned long long)(unsigned int)col[lab[i]]+0x9E3779B97F4A7C15ULL+(h<<6)+(h>>2);
+        h*=0xBF58476D1CE4E5B9ULL;
+    }
+    for (cnt=0;cnt<m*(size_t)n;++cnt) {
+        h^=(unsigned long long)cg[cnt]+0x9E3779B97F4A7C15ULL+(h<<6)+(h>>2);
+        h*=0xBF58476D1CE4E5B9ULL;
+    }
+    return h^(h>>31);
+}
+
+void nautywrapper_canonical_hashes(int isdir,int count,const int *n,int **adj,unsigned long long *hashes) {
+    int i;
+    for (i=0;i<count;++i) {
+        hashes[i]=nautywrapper_canonical_hash(isdir,n[i],adj[i]);
+    }
+}
+
+int nautywrapper_thread_safe(void) {
+#ifdef USE_TLS
+    return 1;
+#else
+    return 0;
+#endif
+}
 #else // HAVE_LIBNAUTY
 #include <stdio.h>
 int nautywrapper_is_isomorphic(int isdir,int n,int *adj1,int *adj2,int *sigma){
@@ -230,4 +335,12 @@ void nautywrapper_aut_generators(int isdir,int n,int *adj,FILE *f){}
 void nautywrapper_canonical(int isdir,int n,int *adj,int *clab,unsigned long *cgrph,int *cols){
     *clab=*cgrph=*cols=16;
 }
+void nautywrapper_aut_generators_cb(int isdir,int n,int *adj,nautywrapper_perm_callback cb,void *data){}
+unsigned long long nautywrapper_canonical_hash(int isdir,int n,int *adj){
+    return 0;
+}
+void nautywrapper_canonical_hashes(int isdir,int count,const int *n,int **adj,unsigned long long *hashes){}
+int nautywrapper_thread_safe(void){
+    return 0;
+}
 #endif // HAVE_LIBNAUTY
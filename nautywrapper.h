@@ -23,6 +23,25 @@ void nautywrapper_canonical(int isdir, int n, int *adj,int *clab,unsigned long *
 /* return SETWORDSNEEDED(n) */
 int nautywrapper_words_needed(int n);
 
+/* callback receiving a permutation perm of 0,..,n-1 along with the user data */
+typedef void (*nautywrapper_perm_callback)(const int *perm,int n,void *data);
+
+/* pass the generators of Aut(G), where G is represented by the sequence adj of
+ * adjacency lists, to the callback cb one at a time (no files are used) */
+void nautywrapper_aut_generators_cb(int isdir,int n,int *adj,nautywrapper_perm_callback cb,void *data);
+
+/* return a 64-bit hash of the canonical form of the graph represented by the
+ * sequence adj of adjacency lists, isomorphic graphs have equal hashes */
+unsigned long long nautywrapper_canonical_hash(int isdir,int n,int *adj);
+
+/* compute the canonical hashes of count graphs at once, the i-th graph has n[i]
+ * vertices and is represented by the sequence adj[i] of adjacency lists */
+void nautywrapper_canonical_hashes(int isdir,int count,const int *n,int **adj,unsigned long long *hashes);
+
+/* return nonzero if nauty was built thread-safe, so that the functions above
+ * (except nautywrapper_aut_generators) may run in several threads at once */
+int nautywrapper_thread_safe(void);
+
 #if defined(__cplusplus)
 }
 #endif
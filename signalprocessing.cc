@@ -19,6 +19,8 @@
 #include "giacPCH.h"
 #include "giac.h"
 #include "signalprocessing.h"
+#include "graphe.h"
+#include "graphtheory.h"
 
 #ifdef HAVE_LIBSAMPLERATE
 #include "samplerate.h"
@@ -36,6 +38,216 @@ int nextpow2(int n) {
     return m;
 }
 
+/* precompute the twiddle factors and the bit-reversal permutation of the
+ * half-length complex transform which the real transform is built on */
+fft_plan::fft_plan(int len) {
+    assert(len>=2 && (len&(len-1))==0);
+    n=len;
+    int m=n/2,bits=0;
+    w.resize(m);
+    for (int k=0;k<m;++k) {
+        double a=-2.0*M_PI*k/n;
+        w[k]=std::complex<double>(std::cos(a),std::sin(a));
+    }
+    while ((1<<bits)<m) ++bits;
+    rev.resize(m);
+    for (int k=0;k<m;++k) {
+        int r=0;
+        for (int b=0;b<bits;++b) {
+            if (k&(1<<b)) r|=1<<(bits-1-b);
+        }
+        rev[k]=r;
+    }
+}
+
+/* iterative in-place complex FFT of length n/2, the inverse is not normalized */
+void fft_plan::transform(std::complex<double> *a,bool inverse) const {
+    int m=n/2;
+    for (int k=0;k<m;++k) {
+        if (k<rev[k]) std::swap(a[k],a[rev[k]]);
+    }
+    for (int len=2;len<=m;len*=2) {
+        int half=len/2,step=2*(m/len);
+        for (int i=0;i<m;i+=len) {
+            for (int j=0;j<half;++j) {
+                std::complex<double> t=inverse?std::conj(w[j*step]):w[j*step];
+                t*=a[i+j+half];
+                a[i+j+half]=a[i+j]-t;
+                a[i+j]+=t;
+            }
+        }
+    }
+}
+
+/* pack x into n/2 complex numbers, transform and split the result into the spectrum */
+void fft_plan::forward(const double *x,std::complex<double> *X) const {
+    int m=n/2;
+    for (int k=0;k<m;++k) {
+        X[k]=std::complex<double>(x[2*k],x[2*k+1]);
+    }
+    transform(X,false);
+    std::complex<double> z0=X[0],mi(0,-0.5);
+    X[0]=z0.real()+z0.imag();
+    X[m]=z0.real()-z0.imag();
+    for (int k=1;2*k<=m;++k) {
+        std::complex<double> zk=X[k],zmk=X[m-k];
+        std::complex<double> e=0.5*(zk+std::conj(zmk)),o=mi*(zk-std::conj(zmk));
+        X[k]=e+w[k]*o;
+        X[m-k]=std::conj(e-w[k]*o);
+    }
+}
+
+void fft_plan::inverse(std::complex<double> *X,double *x) const {
+    int m=n/2;
+    std::complex<double> i1(0,1);
+    std::complex<double> x0=X[0],xm=X[m];
+    X[0]=0.5*std::complex<double>(x0.real()+xm.real(),x0.real()-xm.real());
+    for (int k=1;2*k<=m;++k) {
+        std::complex<double> xk=X[k],xmk=X[m-k];
+        std::complex<double> e=0.5*(xk+std::conj(xmk)),o=0.5*(xk-std::conj(xmk))*std::conj(w[k]);
+        std::complex<double> e2=0.5*(xmk+std::conj(xk)),o2=0.5*(xmk-std::conj(xk))*std::conj(w[m-k]);
+        X[k]=e+i1*o;
+        X[m-k]=e2+i1*o2;
+    }
+    transform(X,true);
+    double s=1.0/m;
+    for (int k=0;k<m;++k) {
+        x[2*k]=s*X[k].real();
+        x[2*k+1]=s*X[k].imag();
+    }
+}
+
+#define CONVOLUTION_DIRECT_MAX 32
+#define CONVOLUTION_MIN_BLOCK 4096
+
+struct convolution_block {
+    int channel;
+    int start;
+};
+
+struct convolution_data {
+    const vector<vector<double> > *x;
+    const vector<vector<double> > *h;
+    vector<vector<double> > *y;
+    const fft_plan *plan;
+    const vector<vector<complex<double> > > *H;
+    vector<convolution_block> blocks;
+    int block_len;
+    vector<vector<double> > buf;
+    vector<vector<complex<double> > > spec;
+};
+
+static const vector<double> &convolution_filter(const vector<vector<double> > &h,int c) {
+    return h[c<int(h.size())?c:0];
+}
+
+/* direct convolution, used when the filter or the signal is very short */
+static void convolve_direct(int first,int last,int thread,void *data) {
+    convolution_data *d=(convolution_data*)data;
+    for (int c=first;c<last;++c) {
+        const vector<double> &x=d->x->at(c),&h=convolution_filter(*d->h,c);
+        vector<double> &y=d->y->at(c);
+        int lx=x.size(),lh=h.size();
+        for (int i=0;i<lx;++i) {
+            double xi=x[i];
+            double *yi=&y[i];
+            for (int j=0;j<lh;++j) yi[j]+=xi*h[j];
+        }
+    }
+}
+
+/* overlap-add: transform one block of the input, multiply it by the filter spectrum
+ * and add the inverse transform to the output */
+static void convolve_blocks(int first,int last,int thread,void *data) {
+    convolution_data *d=(convolution_data*)data;
+    int N=d->plan->size(),L=d->block_len;
+    double *buf=&d->buf[thread].front();
+    complex<double> *X=&d->spec[thread].front();
+    for (int b=first;b<last;++b) {
+        const convolution_block &blk=d->blocks[b];
+        int c=blk.channel;
+        const vector<double> &x=d->x->at(c);
+        const complex<double> *H=&d->H->at(c<int(d->H->size())?c:0).front();
+        vector<double> &y=d->y->at(c);
+        int cnt=std::min(L,int(x.size())-blk.start);
+        std::copy(x.begin()+blk.start,x.begin()+blk.start+cnt,buf);
+        std::fill(buf+cnt,buf+N,0.0);
+        d->plan->forward(buf,X);
+        for (int k=0;k<=N/2;++k) X[k]*=H[k];
+        d->plan->inverse(X,buf);
+        int ocnt=std::min(N,int(y.size())-blk.start);
+        double *yb=&y[blk.start];
+        for (int k=0;k<ocnt;++k) yb[k]+=buf[k];
+    }
+}
+
+/* convolve each buffer x[c] with the filter h[c] (or with h[0] if h has a single filter),
+ * long inputs are split into blocks which are processed by overlap-add, blocks of all
+ * channels are transformed in parallel */
+void convolve_buffers(const vector<vector<double> > &x,const vector<vector<double> > &h,vector<vector<double> > &y) {
+    int nc=x.size(),lh=0,lx=0,minlh=RAND_MAX;
+    assert(!h.empty() && (h.size()==1 || int(h.size())==nc));
+    for (vector<vector<double> >::const_iterator it=h.begin();it!=h.end();++it) {
+        lh=std::max(lh,int(it->size()));
+        minlh=std::min(minlh,int(it->size()));
+    }
+    y.resize(nc);
+    for (int c=0;c<nc;++c) {
+        int lxc=x[c].size(),lhc=convolution_filter(h,c).size();
+        lx=std::max(lx,lxc);
+        y[c].assign(lxc>0 && lhc>0?lxc+lhc-1:0,0.0);
+    }
+    if (lx==0 || minlh==0)
+        return;
+    GT_PROFILE(prof,"convolution");
+    convolution_data data;
+    data.x=&x;
+    data.h=&h;
+    data.y=&y;
+    if (lh<=CONVOLUTION_DIRECT_MAX || lx<=CONVOLUTION_DIRECT_MAX) {
+        graphe::parallel_for(nc,convolve_direct,&data,graphe::thread_count(nc),1);
+        return;
+    }
+    /* use blocks of length at least three times the filter length so that the tail
+     * of a block overlaps the next block only, unless a single transform suffices */
+    int N=nextpow2(std::max(4*lh,CONVOLUTION_MIN_BLOCK));
+    N=std::min(N,nextpow2(lx+lh-1));
+    fft_plan plan(N);
+    data.plan=&plan;
+    data.block_len=N-lh+1;
+    vector<vector<complex<double> > > H(h.size(),vector<complex<double> >(N/2+1));
+    vector<double> hbuf(N);
+    for (int f=0;f<int(h.size());++f) {
+        std::fill(hbuf.begin(),hbuf.end(),0.0);
+        std::copy(h[f].begin(),h[f].end(),hbuf.begin());
+        plan.forward(&hbuf.front(),&H[f].front());
+    }
+    data.H=&H;
+    /* even blocks first, then odd blocks, so that no two concurrent blocks write to
+     * the same part of the output */
+    for (int parity=0;parity<2;++parity) {
+        data.blocks.clear();
+        for (int c=0;c<nc;++c) {
+            int lxc=x[c].size();
+            for (int s=parity*data.block_len;s<lxc;s+=2*data.block_len) {
+                convolution_block blk;
+                blk.channel=c;
+                blk.start=s;
+                data.blocks.push_back(blk);
+            }
+        }
+        int nb=data.blocks.size();
+        if (nb==0)
+            continue;
+        int nthreads=graphe::thread_count(nb);
+        if (int(data.buf.size())<nthreads) {
+            data.buf.resize(nthreads,vector<double>(N));
+            data.spec.resize(nthreads,vector<complex<double> >(N/2+1));
+        }
+        graphe::parallel_for(nb,convolve_blocks,&data,nthreads,1);
+    }
+}
+
 bool is_sound_data(const gen &g,int &nc,int &bd,int &sr,int &len) {
     if (g.type!=_VECT)
         return false;
@@ -96,6 +308,274 @@ vecteur encode_chdata(const vecteur &data,int bd,double ratio,GIAC_CONTEXT) {
     return res;
 }
 
+/* decode channel data to doubles in [-1,1], return false if the data is invalid */
+bool decode_chdata_double(const vecteur &data,int bd,vector<double> &res) {
+    if (bd!=8 && bd!=16)
+        return false;
+    res.resize(data.size());
+    double denom=std::pow(2,bd-1);
+    vector<double>::iterator jt=res.begin();
+    for (const_iterateur it=data.begin();it!=data.end();++it,++jt) {
+        if (it->type!=_INT_)
+            return false;
+        int v=it->val;
+        if (bd==8) v-=127;
+        else if (v>=32768) v-=65536;
+        *jt=double(v)/denom;
+    }
+    return true;
+}
+
+vecteur encode_chdata_double(const vector<double> &data,int bd,double ratio) {
+    vecteur res;
+    if (bd!=8 && bd!=16)
+        return res;
+    res.reserve(data.size());
+    double fac=std::pow(2.0,bd-1)-1.0;
+    for (vector<double>::const_iterator it=data.begin();it!=data.end();++it) {
+        int k=std::floor(fac*std::max(-1.0,std::min(1.0,ratio*(*it))));
+        if (bd==8) k+=127;
+        res.push_back(k);
+    }
+    return res;
+}
+
+struct audio_buffer::source {
+    graphe::mapped_file file;
+};
+
+/* read an unsigned little-endian integer of the given byte length */
+static unsigned read_le(const unsigned char *p,int len) {
+    unsigned v=0;
+    for (int i=len;i-->0;) v=(v<<8)|p[i];
+    return v;
+}
+
+static double decode_sample(const unsigned char *p,audio_format fmt) {
+    switch (fmt) {
+    case _AUDIO_U8:
+        return (int(p[0])-127)/128.0;
+    case _AUDIO_S16:
+        return short(read_le(p,2))/32768.0;
+    case _AUDIO_S24: {
+        int v=read_le(p,3);
+        if (v>=8388608) v-=16777216;
+        return v/8388608.0;
+    }
+    case _AUDIO_F32: {
+        unsigned v=read_le(p,4);
+        float f;
+        memcpy(&f,&v,4);
+        return f;
+    }
+    default:
+        assert(false);
+    }
+    return 0;
+}
+
+/* copy the channel data from sound data g, return false if g is not sound data */
+bool audio_buffer::assign(const gen &g) {
+    close();
+    int nc,bd,sr,len;
+    if (!is_sound_data(g,nc,bd,sr,len))
+        return false;
+    m_format=bd==8?_AUDIO_U8:(bd==16?_AUDIO_S16:_AUDIO_S24);
+    m_channels=nc;
+    m_rate=sr;
+    m_frames=len;
+    int ss=sample_size();
+    m_raw.resize((size_t)len*nc*ss);
+    for (int c=0;c<nc;++c) {
+        const vecteur &chan=*g._VECTptr->at(c+1)._VECTptr;
+        unsigned char *q=m_raw.empty()?NULL:&m_raw[c*ss];
+        for (const_iterateur it=chan.begin();it!=chan.end();++it,q+=nc*ss) {
+            if (it->type!=_INT_) {
+                close();
+                return false;
+            }
+            unsigned v=it->val;
+            for (int i=0;i<ss;++i,v>>=8) q[i]=v&255;
+        }
+    }
+    m_data=m_raw.empty()?NULL:&m_raw.front();
+    return true;
+}
+
+/* map a PCM or IEEE float WAV file, return false if the file cannot be read
+ * or has an unsupported format */
+bool audio_buffer::open(const string &filename) {
+    close();
+    m_source=new source;
+    if (!m_source->file.open(filename)) {
+        close();
+        return false;
+    }
+    const unsigned char *p=(const unsigned char*)m_source->file.data();
+    size_t size=m_source->file.size(),pos=12;
+    if (size<12 || memcmp(p,"RIFF",4)!=0 || memcmp(p+8,"WAVE",4)!=0) {
+        close();
+        return false;
+    }
+    int tag=-1,bits=0;
+    while (pos+8<=size) {
+        const unsigned char *chunk=p+pos;
+        size_t len=read_le(chunk+4,4);
+        pos+=8;
+        if (memcmp(chunk,"fmt ",4)==0 && len>=16 && pos+16<=size) {
+            tag=read_le(p+pos,2);
+            m_channels=read_le(p+pos+2,2);
+            m_rate=read_le(p+pos+4,4);
+            bits=read_le(p+pos+14,2);
+            if (tag==0xFFFE && len>=26 && pos+26<=size) // WAVE_FORMAT_EXTENSIBLE
+                tag=read_le(p+pos+24,2);
+        } else if (memcmp(chunk,"data",4)==0) {
+            if (tag==1 && bits==8) m_format=_AUDIO_U8;
+            else if (tag==1 && bits==16) m_format=_AUDIO_S16;
+            else if (tag==1 && bits==24) m_format=_AUDIO_S24;
+            else if (tag==3 && bits==32) m_format=_AUDIO_F32;
+            else break;
+            if (m_channels<1 || m_rate<1)
+                break;
+            len=std::min(len,size-pos);
+            m_frames=len/((size_t)m_channels*sample_size());
+            m_data=p+pos;
+            return true;
+        }
+        pos+=len+(len&1);
+    }
+    close();
+    return false;
+}
+
+void audio_buffer::close() {
+    delete m_source;
+    m_source=NULL;
+    m_data=NULL;
+    vector<unsigned char>().swap(m_raw);
+    vector<float>().swap(m_samples);
+    m_channels=m_rate=m_frames=0;
+}
+
+double audio_buffer::sample(int frame,int chan) const {
+    size_t i=(size_t)frame*m_channels+chan;
+    if (!m_samples.empty())
+        return m_samples[i];
+    return decode_sample(m_data+i*sample_size(),m_format);
+}
+
+/* decode len samples of the channel chan starting at the given frame */
+void audio_buffer::read_channel(int chan,int start,int len,vector<double> &res) const {
+    res.resize(len);
+    size_t i=(size_t)start*m_channels+chan;
+    if (!m_samples.empty()) {
+        for (int k=0;k<len;++k,i+=m_channels) res[k]=m_samples[i];
+        return;
+    }
+    int ss=sample_size();
+    const unsigned char *p=m_data+i*ss;
+    for (int k=0;k<len;++k,p+=m_channels*ss) res[k]=decode_sample(p,m_format);
+}
+
+/* convert the samples to floats (once) and return them for in-place processing,
+ * the raw samples and the file mapping are released */
+float *audio_buffer::samples() {
+    size_t n=(size_t)m_frames*m_channels;
+    if (n==0)
+        return NULL;
+    if (m_samples.empty()) {
+        m_samples.resize(n);
+        int ss=sample_size();
+        const unsigned char *p=m_data;
+        for (size_t i=0;i<n;++i,p+=ss) m_samples[i]=decode_sample(p,m_format);
+        vector<unsigned char>().swap(m_raw);
+        delete m_source;
+        m_source=NULL;
+        m_data=NULL;
+    }
+    return &m_samples.front();
+}
+
+/* keep only the first len frames */
+void audio_buffer::truncate(int len) {
+    if (len>=m_frames)
+        return;
+    m_frames=std::max(0,len);
+    if (!m_samples.empty())
+        m_samples.resize((size_t)m_frames*m_channels);
+}
+
+/* return the largest absolute sample value */
+double audio_buffer::peak() const {
+    double ret=0;
+    for (int c=0;c<m_channels;++c) {
+        for (int i=0;i<m_frames;++i) ret=std::max(ret,std::abs(sample(i,c)));
+    }
+    return ret;
+}
+
+/* return the samples as sound data with bit depth 8 or 16, scaled by ratio */
+gen audio_buffer::to_gen(double ratio) const {
+    int bd=bit_depth();
+    vecteur header(4),res;
+    header[0]=m_channels;
+    header[1]=bd;
+    header[2]=m_rate;
+    header[3]=gen(((longlong)bd*m_frames*m_channels)/8);
+    res.reserve(m_channels+1);
+    res.push_back(header);
+    vector<double> chan;
+    for (int c=0;c<m_channels;++c) {
+        read_channel(c,0,m_frames,chan);
+        res.push_back(encode_chdata_double(chan,bd,ratio));
+    }
+    return res;
+}
+
+/* load sound data or the WAV file with the given name, relative to the working directory */
+static bool load_audio(const gen &g,audio_buffer &snd) {
+    if (g.type==_STRNG)
+        return snd.open(make_absolute_file_path(graphe::genstring2str(g)));
+    return snd.assign(g);
+}
+
+/* convert a list of real numbers to doubles, return false if some element is not a real number */
+static bool vecteur2doubles(const vecteur &v,vector<double> &res,GIAC_CONTEXT) {
+    res.resize(v.size());
+    vector<double>::iterator jt=res.begin();
+    for (const_iterateur it=v.begin();it!=v.end();++it,++jt) {
+        if (it->type==_DOUBLE_)
+            *jt=it->DOUBLE_val();
+        else if (it->type==_INT_)
+            *jt=it->val;
+        else if (it->type==_ZINT || it->type==_FRAC || it->type==_REAL) {
+            gen e=_evalf(*it,contextptr);
+            if (e.type!=_DOUBLE_)
+                return false;
+            *jt=e.DOUBLE_val();
+        } else return false;
+    }
+    return true;
+}
+
+/* return true if some element of v is a floating-point number */
+static bool has_approx_entry(const vecteur &v) {
+    for (const_iterateur it=v.begin();it!=v.end();++it) {
+        if (it->type==_DOUBLE_)
+            return true;
+    }
+    return false;
+}
+
+static vecteur doubles2vecteur(const vector<double> &v) {
+    vecteur res;
+    res.reserve(v.size());
+    for (vector<double>::const_iterator it=v.begin();it!=v.end();++it) {
+        res.push_back(*it);
+    }
+    return res;
+}
+
 int read_channel_data(const gen &g,int &nc,vector<vecteur*> &data) {
     int ret;
     if (ckmatrix(g)) {
@@ -281,21 +761,24 @@ define_unary_function_ptr5(at_plotwav,alias_at_plotwav,&__plotwav,0,true)
 
 gen _stereo2mono(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
-    int nc,bd,sr,len;
-    if (!is_sound_data(g,nc,bd,sr,len))
+    audio_buffer snd;
+    if (!load_audio(g,snd))
         return gentypeerr(contextptr);
-    if (nc==1)
+    int nc=snd.channels(),bd=snd.bit_depth(),len=snd.frames();
+    if (nc==1 && g.type==_VECT)
         return g;
-    vecteur data(len,0);
-    for (int i=1;i<=nc;++i) {
-        const vecteur &chan=*g._VECTptr->at(i)._VECTptr;
-        data=addvecteur(data,decode_chdata(chan,bd));
+    vector<double> data(len,0.0),chan;
+    for (int c=0;c<nc;++c) {
+        snd.read_channel(c,0,len,chan);
+        for (int i=0;i<len;++i) data[i]+=chan[i];
     }
-    data=multvecteur(fraction(1,nc),data);
-    vecteur header=*g._VECTptr->front()._VECTptr,edata=encode_chdata(data,bd,1.0,contextptr);
+    for (int i=0;i<len;++i) data[i]/=nc;
+    vecteur header(4);
     header[0]=1;
-    header[3]=header[3]/gen(nc);
-    return makevecteur(header,edata);
+    header[1]=bd;
+    header[2]=snd.samplerate();
+    header[3]=gen(((longlong)bd*len)/8);
+    return makevecteur(header,encode_chdata_double(data,bd,1.0));
 }
 static const char _stereo2mono_s []="stereo2mono";
 static define_unary_function_eval (__stereo2mono,&_stereo2mono,_stereo2mono_s);
@@ -313,11 +796,15 @@ gen _plotspectrum(const gen &g,GIAC_CONTEXT) {
         const vecteur &gv=*g._VECTptr;
         if (gv.size()!=2 || !is_sound_data(gv.front(),nc,bd,sr,len))
             return gensizeerr(contextptr);
-        vecteur data;
-        if (nc>1)
-            data=decode_chdata(*_stereo2mono(gv.front(),contextptr)._VECTptr->at(1)._VECTptr,bd);
-        else data=decode_chdata(*gv.front()._VECTptr->at(1)._VECTptr,bd);
-        len=data.size();
+        const vecteur &snd=*gv.front()._VECTptr;
+        vector<double> data(len,0.0),chan;
+        for (int c=1;c<=nc;++c) {
+            if (!decode_chdata_double(*snd[c]._VECTptr,bd,chan))
+                return gensizeerr(contextptr);
+            for (int i=0;i<len;++i) data[i]+=chan[i]/nc;
+        }
+        lfreq=0;
+        ufreq=sr/2;
         if (!gv.back().is_symb_of_sommet(at_equal))
             return gensizeerr(contextptr);
         const gen &lh=gv.back()._SYMBptr->feuille._VECTptr->front();
@@ -340,18 +827,19 @@ gen _plotspectrum(const gen &g,GIAC_CONTEXT) {
             if (lfreq>=ufreq)
                 return gensizeerr(contextptr);
         }
-        int n=nextpow2(len);
-        data.resize(n,0);
-        vecteur spec=*_fft(data,contextptr)._VECTptr;
+        int n=std::max(2,nextpow2(len));
+        data.resize(n,0.0);
+        vector<complex<double> > spec(n/2+1);
+        fft_plan(n).forward(&data.front(),&spec.front());
         vecteur nodes;
         int dfreq=ufreq-lfreq,n1=((long)n*(long)lfreq)/(long)sr,n2=((long)n*(long)ufreq)/(long)sr;
         int width=std::min(dfreq,std::max(1500,dfreq/5));
         nodes.reserve(std::floor(width));
         int step=(n2-n1)/(2*width);
         if (step==0) step=1;
-        double f;
+        double f=0;
         for (int i=n1;i<n2;++i) {
-            f=std::max(f,_evalf(pow(_abs(spec[i],contextptr),2)/gen(n),contextptr).DOUBLE_val());
+            f=std::max(f,std::norm(spec[i])/n);
             if (i%step==0) {
                 nodes.push_back(makecomplex(((long)i*(long)sr)/(long)n,f));
                 f=0;
@@ -413,18 +901,20 @@ define_unary_function_ptr5(at_duration,alias_at_duration,&__duration,0,true)
 
 gen _channel_data(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
-    if (g.type!=_VECT)
+    if (g.type!=_VECT && g.type!=_STRNG)
         return gentypeerr(contextptr);
     vecteur opts;
-    if (g.subtype==_SEQ__VECT) {
-        if (g._VECTptr->front().type!=_VECT)
+    bool isseq=g.type==_VECT && g.subtype==_SEQ__VECT;
+    if (isseq) {
+        if (g._VECTptr->front().type!=_VECT && g._VECTptr->front().type!=_STRNG)
             return gentypeerr(contextptr);
         opts=vecteur(g._VECTptr->begin()+1,g._VECTptr->end());
     }
-    const gen &data=g.subtype==_SEQ__VECT?g._VECTptr->front():g;
-    int nc,bd,sr,len;
-    if (!is_sound_data(data,nc,bd,sr,len))
+    const gen &data=isseq?g._VECTptr->front():g;
+    audio_buffer snd;
+    if (!load_audio(data,snd))
         return gentypeerr(contextptr);
+    int nc=snd.channels(),sr=snd.samplerate(),len=snd.frames();
     int chan=0,slice_start=0,slice_len=len;
     bool asmatrix=false;
     for (const_iterateur it=opts.begin();it!=opts.end();++it) {
@@ -463,16 +953,19 @@ gen _channel_data(const gen &g,GIAC_CONTEXT) {
     }
     if (slice_start<0 || slice_start>=len || slice_len<0 || slice_len>len || slice_start+slice_len>len)
         return gensizeerr(contextptr);
+    vector<double> samples;
     if (chan==0) {
         vecteur ret;
-        for (const_iterateur it=data._VECTptr->begin()+1;it!=data._VECTptr->end();++it) {
-            ret.push_back(decode_chdata(*it->_VECTptr,bd,slice_start,slice_len));
+        for (int c=0;c<nc;++c) {
+            snd.read_channel(c,slice_start,slice_len,samples);
+            ret.push_back(doubles2vecteur(samples));
         }
         if (ret.size()==1)
             return ret.front();
         return asmatrix?ret:change_subtype(ret,_SEQ__VECT);
     }
-    return decode_chdata(*data._VECTptr->at(chan)._VECTptr,bd,slice_start,slice_len);
+    snd.read_channel(chan-1,slice_start,slice_len,samples);
+    return doubles2vecteur(samples);
 }
 static const char _channel_data_s []="channel_data";
 static define_unary_function_eval (__channel_data,&_channel_data,_channel_data_s);
@@ -485,6 +978,14 @@ gen _cross_correlation(const gen &g,GIAC_CONTEXT) {
     vecteur &args=*g._VECTptr;
     if (args.size()!=2 || args.front().type!=_VECT || args.back().type!=_VECT)
         return gensizeerr(contextptr);
+    vector<vector<double> > x(1),h(1),y;
+    if (vecteur2doubles(*args.front()._VECTptr,x.front(),contextptr) &&
+            vecteur2doubles(*args.back()._VECTptr,h.front(),contextptr)) {
+        // real signals: the cross-correlation is the convolution of reversed u with v
+        std::reverse(x.front().begin(),x.front().end());
+        convolve_buffers(x,h,y);
+        return doubles2vecteur(y.front());
+    }
     vecteur A=*args.front()._VECTptr,B=*args.back()._VECTptr;
     int m=A.size(),n=B.size(),N=nextpow2(std::max(n,m));
     A.resize(2*N,0);
@@ -532,33 +1033,75 @@ void highpass(vecteur &data,double cutoff,int sr) {
     }
 }
 
+/* first-order RC filters on nc interleaved channels, applied in place */
+template<class T>
+static void lowpass_interleaved(T *s,int frames,int nc,double cutoff,int sr) {
+    double rc=0.15915494309/cutoff,dt=1.0/sr,alpha=dt/(rc+dt);
+    if (frames==0)
+        return;
+    vector<double> state(s,s+nc);
+    for (int i=0;i<frames;++i,s+=nc) {
+        for (int c=0;c<nc;++c) {
+            state[c]+=alpha*(s[c]-state[c]);
+            s[c]=state[c];
+        }
+    }
+}
+
+template<class T>
+static void highpass_interleaved(T *s,int frames,int nc,double cutoff,int sr) {
+    double rc=0.15915494309/cutoff,dt=1.0/sr,alpha=rc/(rc+dt);
+    if (frames==0)
+        return;
+    vector<double> prev(s,s+nc);
+    for (int i=1;i<frames;++i) {
+        T *cur=s+(size_t)i*nc;
+        for (int c=0;c<nc;++c) {
+            double x=cur[c];
+            cur[c]=alpha*(cur[c-nc]+x-prev[c]);
+            prev[c]=x;
+        }
+    }
+}
+
 gen filter(const vecteur &args,filter_type typ,GIAC_CONTEXT) {
     double cutoff=_evalf(args.at(1),contextptr).DOUBLE_val();
-    int nc,bd,sr,len;
-    if (is_sound_data(*args.front()._VECTptr,nc,bd,sr,len)) {
+    int sr;
+    audio_buffer snd;
+    if (load_audio(args.front(),snd)) {
+        sr=snd.samplerate();
         if (cutoff<=0 || cutoff>=sr/2)
             return gensizeerr(contextptr);
-        gen opt(undef);
+        double ratio=1.0,level=0;
+        bool normalize=false;
         if (args.size()>2) {
             if (!args[2].is_symb_of_sommet(at_equal))
                 return gensizeerr(contextptr);
-            if (args[2]._SYMBptr->feuille._VECTptr->front()==at_normalize)
-                opt=args[2];
+            const gen &lh=args[2]._SYMBptr->feuille._VECTptr->front();
+            const gen &rh=args[2]._SYMBptr->feuille._VECTptr->back();
+            if (lh==at_normalize) {
+                if (!is_real(rh,contextptr))
+                    return gensizeerr(contextptr);
+                level=_evalf(rh,contextptr).DOUBLE_val();
+                normalize=true;
+            }
         }
-        matrice data;
-        for (int i=1;i<=nc;++i) {
-            vecteur chdata=decode_chdata(*args.front()._VECTptr->at(i)._VECTptr,bd);
+        float *s=snd.samples();
+        if (s!=NULL) {
             switch(typ) {
-            case _LOWPASS_FILTER: lowpass(chdata,cutoff,sr); break;
-            case _HIGHPASS_FILTER: highpass(chdata,cutoff,sr); break;
+            case _LOWPASS_FILTER: lowpass_interleaved(s,snd.frames(),snd.channels(),cutoff,sr); break;
+            case _HIGHPASS_FILTER: highpass_interleaved(s,snd.frames(),snd.channels(),cutoff,sr); break;
             }
-            data.push_back(chdata);
         }
-        gen argv=makesequence(symbolic(at_equal,makesequence(at_samplerate,sr)),
-                              symbolic(at_equal,makesequence(at_bit_depth,bd)),data);
-        if (!is_undef(opt)) argv._VECTptr->push_back(opt);
-        return _createwav(argv,contextptr);
-    } else {
+        if (normalize && level<=0) { // positive levels are ignored, as in createwav
+            double peak=snd.peak();
+            if (peak>0)
+                ratio=std::pow(10.0,level/20.0)/peak;
+        }
+        return snd.to_gen(ratio);
+    } else if (args.front().type!=_VECT)
+        return gensizeerr("Failed to read the WAV file");
+    else {
         vecteur data=*args.front()._VECTptr;
         sr=44100;
         if (args.size()>2) {
@@ -567,6 +1110,15 @@ gen filter(const vecteur &args,filter_type typ,GIAC_CONTEXT) {
         }
         if (cutoff<=0 || cutoff>=sr/2)
             return gensizeerr(contextptr);
+        vector<double> x;
+        if (vecteur2doubles(data,x,contextptr)) {
+            double *xp=x.empty()?NULL:&x.front();
+            switch(typ) {
+            case _LOWPASS_FILTER: lowpass_interleaved(xp,x.size(),1,cutoff,sr); break;
+            case _HIGHPASS_FILTER: highpass_interleaved(xp,x.size(),1,cutoff,sr); break;
+            }
+            return doubles2vecteur(x);
+        }
         switch(typ) {
         case _LOWPASS_FILTER: lowpass(data,cutoff,sr); break;
         case _HIGHPASS_FILTER: highpass(data,cutoff,sr); break;
@@ -578,7 +1130,7 @@ gen filter(const vecteur &args,filter_type typ,GIAC_CONTEXT) {
 gen _lowpass(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
     if (g.type!=_VECT || g.subtype!=_SEQ__VECT || g._VECTptr->size()<2 ||
-            g._VECTptr->front().type!=_VECT || !is_real(g._VECTptr->at(1),contextptr))
+            (g._VECTptr->front().type!=_VECT && g._VECTptr->front().type!=_STRNG) || !is_real(g._VECTptr->at(1),contextptr))
         return gentypeerr(contextptr);
     return filter(*g._VECTptr,_LOWPASS_FILTER,contextptr);
 }
@@ -589,7 +1141,7 @@ define_unary_function_ptr5(at_lowpass,alias_at_lowpass,&__lowpass,0,true)
 gen _highpass(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
     if (g.type!=_VECT || g.subtype!=_SEQ__VECT || g._VECTptr->size()<2 ||
-            g._VECTptr->front().type!=_VECT || !is_real(g._VECTptr->at(1),contextptr))
+            (g._VECTptr->front().type!=_VECT && g._VECTptr->front().type!=_STRNG) || !is_real(g._VECTptr->at(1),contextptr))
         return gentypeerr(contextptr);
     return filter(*g._VECTptr,_HIGHPASS_FILTER,contextptr);
 }
@@ -604,14 +1156,52 @@ gen _moving_average(const gen &g,GIAC_CONTEXT) {
     const vecteur &gv=*g._VECTptr;
     if (gv.size()!=2)
         return gensizeerr("Wrong number of input arguments");
-    if (gv.front().type!=_VECT)
+    if (gv.front().type!=_VECT && gv.front().type!=_STRNG)
         return gensizeerr("First argument must be an array");
     if (!gv.back().is_integer() || gv.back().val<=0)
         return gensizeerr("Second argument must be a positive integer");
+    int n=gv.back().val;
+    audio_buffer snd;
+    if (load_audio(gv.front(),snd)) {
+        // running mean over each channel, computed in place
+        int nc=snd.channels(),len=snd.frames();
+        if (n>len)
+            return gensizeerr("Filter length exceeds array size");
+        float *s=snd.samples();
+        vector<double> acc(nc,0.0);
+        for (int i=0;i<n-1;++i) {
+            for (int c=0;c<nc;++c) acc[c]+=s[(size_t)i*nc+c];
+        }
+        for (int i=0;i<=len-n;++i) {
+            float *out=s+(size_t)i*nc;
+            const float *in=s+(size_t)(i+n-1)*nc;
+            for (int c=0;c<nc;++c) {
+                acc[c]+=in[c];
+                double first=out[c];
+                out[c]=acc[c]/n;
+                acc[c]-=first;
+            }
+        }
+        snd.truncate(len-n+1);
+        return snd.to_gen();
+    } else if (gv.front().type!=_VECT)
+        return gensizeerr("Failed to read the WAV file");
     vecteur &s=*gv.front()._VECTptr;
-    int n=gv.back().val,len=s.size();
+    int len=s.size();
     if (n>len)
         return gensizeerr("Filter length exceeds array size");
+    vector<double> x;
+    if (has_approx_entry(s) && vecteur2doubles(s,x,contextptr)) {
+        vector<double> res(len-n+1);
+        double acc=0;
+        for (int i=0;i<n-1;++i) acc+=x[i];
+        for (int i=0;i<=len-n;++i) {
+            acc+=x[i+n-1];
+            res[i]=acc/n;
+            acc-=x[i];
+        }
+        return doubles2vecteur(res);
+    }
     vecteur res(len-n+1);
     gen acc(0);
     for (int i=0;i<n;++i) acc+=s[i];
@@ -629,12 +1219,34 @@ define_unary_function_ptr5(at_moving_average,alias_at_moving_average,&__moving_a
 
 gen _rms(const gen &g,GIAC_CONTEXT) {
 	if (g.type==_STRNG && g.subtype==-1) return g;
+	audio_buffer snd;
+	if (load_audio(g,snd)) {
+		// root mean square of each channel
+		int nc=snd.channels(),len=snd.frames();
+		if (len==0)
+			return gensizeerr("The list is empty");
+		vecteur res(nc);
+		vector<double> chan;
+		for (int c=0;c<nc;++c) {
+			snd.read_channel(c,0,len,chan);
+			double sum=0;
+			for (int i=0;i<len;++i) sum+=chan[i]*chan[i];
+			res[c]=std::sqrt(sum/len);
+		}
+		return nc==1?res.front():gen(res);
+	}
 	if (g.type!=_VECT)
 		return gentypeerr(contextptr);
 	const vecteur &gv=*g._VECTptr;
 	int n=gv.size();
 	if (n==0)
 		return gensizeerr("The list is empty");
+	vector<double> x;
+	if (has_approx_entry(gv) && vecteur2doubles(gv,x,contextptr)) {
+		double sum=0;
+		for (int i=0;i<n;++i) sum+=x[i]*x[i];
+		return std::sqrt(sum/n);
+	}
 	gen res(0);
 	for (const_iterateur it=gv.begin();it!=gv.end();++it) {
 		gen rp=re(*it,contextptr);
@@ -648,47 +1260,150 @@ static const char _rms_s []="rms";
 static define_unary_function_eval (__rms,&_rms,_rms_s);
 define_unary_function_ptr5(at_rms,alias_at_rms,&__rms,0,true)
 
+/* incremental writer of 8 or 16-bit PCM WAV files, the chunk sizes in the
+ * header are filled in when the file is closed */
+class wav_writer {
+    FILE *m_file;
+    int m_channels,m_bits;
+    size_t m_frames;
+    vector<unsigned char> m_buf;
+    void put(unsigned v,int len) { for (int i=0;i<len;++i,v>>=8) m_buf.push_back(v&255); }
+    bool flush() { bool ok=m_buf.empty() || fwrite(&m_buf.front(),1,m_buf.size(),m_file)==m_buf.size(); m_buf.clear(); return ok; }
+public:
+    wav_writer() { m_file=NULL; m_channels=m_bits=0; m_frames=0; }
+    ~wav_writer() { close(); }
+    bool open(const string &filename,int nc,int bd,int sr);
+    bool write(const vector<const float*> &chans,int count);
+    bool close();
+    size_t frames() const { return m_frames; }
+};
+
+bool wav_writer::open(const string &filename,int nc,int bd,int sr) {
+    close();
+    if ((m_file=fopen(filename.c_str(),"wb"))==NULL)
+        return false;
+    m_channels=nc;
+    m_bits=bd;
+    m_frames=0;
+    int align=nc*bd/8;
+    m_buf.assign((const unsigned char*)"RIFF",(const unsigned char*)"RIFF"+4);
+    put(36,4);
+    m_buf.insert(m_buf.end(),(const unsigned char*)"WAVEfmt ",(const unsigned char*)"WAVEfmt "+8);
+    put(16,4);
+    put(1,2);
+    put(nc,2);
+    put(sr,4);
+    put(sr*align,4);
+    put(align,2);
+    put(bd,2);
+    m_buf.insert(m_buf.end(),(const unsigned char*)"data",(const unsigned char*)"data"+4);
+    put(0,4);
+    return flush();
+}
+
+/* interleave and write the first count samples of each channel */
+bool wav_writer::write(const vector<const float*> &chans,int count) {
+    double fac=std::pow(2.0,m_bits-1)-1.0;
+    m_buf.reserve((size_t)count*m_channels*(m_bits/8));
+    for (int i=0;i<count;++i) {
+        for (int c=0;c<m_channels;++c) {
+            int k=std::floor(fac*std::max(-1.0,std::min(1.0,(double)chans[c][i])));
+            if (m_bits==8) k+=127;
+            put(k,m_bits/8);
+        }
+    }
+    m_frames+=count;
+    return flush();
+}
+
+/* fill in the chunk sizes and close the file */
+bool wav_writer::close() {
+    if (m_file==NULL)
+        return true;
+    unsigned dlen=m_frames*m_channels*(m_bits/8);
+    m_buf.clear();
+    put(36+dlen,4);
+    bool ok=fseek(m_file,4,SEEK_SET)==0 && flush();
+    put(dlen,4);
+    ok=ok && fseek(m_file,40,SEEK_SET)==0 && flush();
+    ok=fclose(m_file)==0 && ok;
+    m_file=NULL;
+    return ok;
+}
+
+#ifdef HAVE_LIBSAMPLERATE
+#define RESAMPLE_BLOCK 8192
+
+struct resample_channel {
+    SRC_STATE *state;
+    vector<float> in,out,pending;
+    int error;
+};
+
+struct resample_data {
+    const audio_buffer *snd;
+    vector<resample_channel> chans;
+    double ratio;
+    int start,count;
+    bool last;
+};
+
+/* feed the current block of each channel to its converter and collect the output */
+static void resample_block(int first,int last,int thread,void *ptr) {
+    resample_data *d=(resample_data*)ptr;
+    vector<double> block;
+    for (int c=first;c<last;++c) {
+        resample_channel &ch=d->chans[c];
+        d->snd->read_channel(c,d->start,d->count,block);
+        ch.in.assign(block.begin(),block.end());
+        SRC_DATA sd;
+        sd.src_ratio=d->ratio;
+        sd.end_of_input=d->last?1:0;
+        long used=0;
+        do {
+            sd.data_in=ch.in.empty()?NULL:&ch.in.front()+used;
+            sd.input_frames=d->count-used;
+            sd.data_out=&ch.out.front();
+            sd.output_frames=ch.out.size();
+            if ((ch.error=src_process(ch.state,&sd))!=0)
+                break;
+            used+=sd.input_frames_used;
+            ch.pending.insert(ch.pending.end(),ch.out.begin(),ch.out.begin()+sd.output_frames_gen);
+        } while (used<d->count || (d->last && sd.output_frames_gen>0));
+    }
+}
+#endif
+
 gen _resample(const gen &g,GIAC_CONTEXT) {
     if (g.type==_STRNG && g.subtype==-1) return g;
 #ifndef HAVE_LIBSAMPLERATE
     *logptr(contextptr) << "Error: libsamplerate is required for resampling audio\n";
     return vecteur(0);
 #else
-    if (g.type!=_VECT)
+    if (g.type!=_VECT && g.type!=_STRNG)
         return gentypeerr(contextptr);
-    int nc,bd,sr,len;
-    const gen &snd=g.subtype==_SEQ__VECT?g._VECTptr->front():g;
-    if (!is_sound_data(snd,nc,bd,sr,len))
+    bool isseq=g.type==_VECT && g.subtype==_SEQ__VECT;
+    audio_buffer snd;
+    if (!load_audio(isseq?g._VECTptr->front():g,snd))
         return gentypeerr(contextptr);
     int nsr=44100;
     int quality=2;
-    if (g.subtype==_SEQ__VECT) {
+    string filename;
+    if (isseq) {
         const vecteur &gv=*g._VECTptr;
         if (gv.size()<2 || !gv[1].is_integer() || (nsr=gv[1].val)<1)
             return gensizeerr(contextptr);
-        if (gv.size()>2) {
-            if (!gv[2].is_integer() || (quality=gv[2].val)<0 || (quality>4))
+        const_iterateur it=gv.begin()+2;
+        if (it!=gv.end() && it->is_integer()) {
+            if ((quality=it->val)<0 || (quality>4))
                 return gensizeerr(contextptr);
+            ++it;
         }
+        if (it!=gv.end() && it->type==_STRNG)
+            filename=make_absolute_file_path(graphe::genstring2str(*(it++)));
+        if (it!=gv.end())
+            return gensizeerr(contextptr);
     }
-    matrice chdata;
-    for (int i=1;i<=nc;++i) {
-        vecteur ch=decode_chdata(*snd._VECTptr->at(i)._VECTptr,bd);
-        chdata.push_back(ch);
-    }
-    SRC_DATA data;
-    data.src_ratio=double(nsr)/double(sr);
-    int nlen=(int)std::floor(len*data.src_ratio);
-    data.input_frames=len;
-    data.output_frames=nlen;
-    float *indata=new float[len*nc];
-    data.data_out=new float[nlen*nc];
-    for (int i=0;i<len;++i) {
-        for (int j=0;j<nc;++j) {
-            indata[i*nc+j]=_evalf(chdata[j][i],contextptr).DOUBLE_val();
-        }
-    }
-    data.data_in=indata;
     switch(quality) {
     case 0:
         quality=SRC_LINEAR;
@@ -708,22 +1423,82 @@ gen _resample(const gen &g,GIAC_CONTEXT) {
     default:
         assert(false);
     }
-    src_simple(&data,quality,nc);
-    matrice output=*_matrix(makesequence(nc,nlen,0),contextptr)._VECTptr;
-    for (int i=0;i<nlen;++i) {
-        for (int j=0;j<nc;++j) {
-            output[j]._VECTptr->at(i)=data.data_out[i*nc+j];
+    GT_PROFILE(prof,"resample");
+    int nc=snd.channels(),len=snd.frames(),bd=snd.bit_depth(),error=0;
+    resample_data data;
+    data.snd=&snd;
+    data.ratio=double(nsr)/double(snd.samplerate());
+    if (src_is_valid_ratio(data.ratio)==0)
+        return gensizeerr(contextptr);
+    /* the output is cut to the length of the one-shot conversion */
+    longlong nlen=std::floor(len*data.ratio),written=0;
+    data.chans.resize(nc);
+    for (int c=0;c<nc;++c) {
+        resample_channel &ch=data.chans[c];
+        ch.out.resize(std::ceil(RESAMPLE_BLOCK*data.ratio)+256);
+        ch.error=0;
+        if ((ch.state=src_new(quality,1,&ch.error))==NULL)
+            error=ch.error;
+    }
+    wav_writer wav;
+    vector<vector<double> > output;
+    if (!filename.empty()) {
+        if (error==0 && !wav.open(filename,nc,bd,nsr))
+            error=-1;
+    } else output.resize(nc);
+    /* channels are converted independently and in parallel, block by block,
+     * the frames produced by all channels are emitted after each block */
+    for (data.start=0;error==0;data.start+=RESAMPLE_BLOCK) {
+        data.count=std::min(RESAMPLE_BLOCK,len-data.start);
+        data.last=data.start+data.count>=len;
+        graphe::parallel_for(nc,resample_block,&data,graphe::thread_count(nc),1);
+        longlong avail=nlen-written;
+        for (int c=0;c<nc;++c) {
+            if (data.chans[c].error!=0)
+                error=data.chans[c].error;
+            avail=std::min(avail,(longlong)data.chans[c].pending.size());
+        }
+        if (error!=0)
+            break;
+        if (filename.empty()) {
+            for (int c=0;c<nc;++c) {
+                output[c].insert(output[c].end(),data.chans[c].pending.begin(),data.chans[c].pending.begin()+avail);
+            }
+        } else {
+            vector<const float*> chans(nc);
+            for (int c=0;c<nc;++c) {
+                chans[c]=data.chans[c].pending.empty()?NULL:&data.chans[c].pending.front();
+            }
+            if (!wav.write(chans,avail))
+                error=-1;
         }
+        for (int c=0;c<nc;++c) {
+            data.chans[c].pending.erase(data.chans[c].pending.begin(),data.chans[c].pending.begin()+avail);
+        }
+        written+=avail;
+        if (data.last)
+            break;
     }
-    delete[] indata;
-    delete[] data.data_out;
-    vecteur header=*snd._VECTptr->front()._VECTptr;
+    for (int c=0;c<nc;++c) {
+        if (data.chans[c].state!=NULL)
+            src_delete(data.chans[c].state);
+    }
+    if (!filename.empty() && !wav.close() && error==0)
+        error=-1;
+    if (error<0)
+        return gensizeerr("Failed to write the WAV file");
+    if (error>0)
+        return gensizeerr(src_strerror(error));
+    if (!filename.empty())
+        return gen(written);
+    vecteur header(4),ret;
+    header[0]=nc;
+    header[1]=bd;
     header[2]=nsr;
-    header[3]=(bd*nc*nlen)/8;
-    vecteur ret;
+    header[3]=gen(((longlong)bd*nc*written)/8);
     ret.push_back(header);
-    for (const_iterateur it=output.begin();it!=output.end();++it) {
-        ret.push_back(encode_chdata(*it->_VECTptr,bd,1.0,contextptr));
+    for (int c=0;c<nc;++c) {
+        ret.push_back(encode_chdata_double(output[c],bd,1.0));
     }
     return ret;
 #endif
@@ -769,9 +1544,54 @@ gen _convolution(const gen &g,GIAC_CONTEXT) {
         c=subst(c,tvar,var-T,false,contextptr)*_Heaviside(var-T,contextptr);
         return c;
     }
+    int nc,bd,sr,slen,fnc,fbd,fsr,flen;
+    if (args.size()==2 && is_sound_data(args.front(),nc,bd,sr,slen)) {
+        // convolve each channel of an audio clip with a filter given as a list or as audio
+        const vecteur &snd=*args.front()._VECTptr;
+        vector<vector<double> > x(nc),h,y;
+        for (int c=0;c<nc;++c) {
+            if (!decode_chdata_double(*snd[c+1]._VECTptr,bd,x[c]))
+                return gensizeerr(contextptr);
+        }
+        if (is_sound_data(args.back(),fnc,fbd,fsr,flen)) {
+            if (fsr!=sr || (fnc!=1 && fnc!=nc))
+                return gendimerr(contextptr);
+            h.resize(fnc);
+            for (int c=0;c<fnc;++c) {
+                if (!decode_chdata_double(*args.back()._VECTptr->at(c+1)._VECTptr,fbd,h[c]))
+                    return gensizeerr(contextptr);
+            }
+        } else {
+            h.resize(1);
+            if (args.back().type!=_VECT || !vecteur2doubles(*args.back()._VECTptr,h.front(),contextptr))
+                return gentypeerr(contextptr);
+        }
+        convolve_buffers(x,h,y);
+        // scale down to avoid clipping
+        double peak=1.0;
+        for (vector<vector<double> >::const_iterator it=y.begin();it!=y.end();++it) {
+            for (vector<double>::const_iterator jt=it->begin();jt!=it->end();++jt) {
+                peak=std::max(peak,std::abs(*jt));
+            }
+        }
+        vecteur header=*snd.front()._VECTptr,ret;
+        header[3]=(bd*nc*(int)y.front().size())/8;
+        ret.reserve(nc+1);
+        ret.push_back(header);
+        for (int c=0;c<nc;++c) {
+            ret.push_back(encode_chdata_double(y[c],bd,1.0/peak));
+        }
+        return ret;
+    }
     // convolve sequences
     if (args.size()!=2 || args.front().type!=_VECT || args.back().type!=_VECT)
         return gensizeerr(contextptr);
+    vector<vector<double> > x(1),h(1),y;
+    if (vecteur2doubles(*args.front()._VECTptr,x.front(),contextptr) &&
+            vecteur2doubles(*args.back()._VECTptr,h.front(),contextptr)) {
+        convolve_buffers(x,h,y);
+        return doubles2vecteur(y.front());
+    }
     vecteur A=*args.front()._VECTptr,B=*args.back()._VECTptr;
     int lenA=A.size(),lenB=B.size(),len=2*nextpow2(std::max(lenA,lenB));
     A.resize(len-1,0);
@@ -24,6 +24,9 @@
 #include "first.h"
 #include "gen.h"
 #include "unary.h"
+#include <vector>
+#include <complex>
+#include <string>
 
 #ifndef NO_NAMESPACE_GIAC
 namespace giac {
@@ -34,6 +37,65 @@ enum filter_type {
     _HIGHPASS_FILTER
 };
 
+enum audio_format {
+    _AUDIO_U8,
+    _AUDIO_S16,
+    _AUDIO_S24,
+    _AUDIO_F32
+};
+
+/* interleaved audio samples stored as 8, 16 or 24-bit integers or 32-bit floats,
+ * the samples of a WAV file are mapped into memory and decoded only when accessed */
+class audio_buffer {
+    struct source;
+    source *m_source; // mapped WAV file
+    const unsigned char *m_data; // raw interleaved samples, owned or mapped
+    std::vector<unsigned char> m_raw;
+    std::vector<float> m_samples; // floating-point copy for in-place processing
+    audio_format m_format;
+    int m_channels,m_rate,m_frames;
+    audio_buffer(const audio_buffer &other);
+    audio_buffer &operator =(const audio_buffer &other);
+    int sample_size() const { return m_format==_AUDIO_U8?1:(m_format==_AUDIO_S16?2:(m_format==_AUDIO_S24?3:4)); }
+public:
+    audio_buffer() { m_source=NULL; m_data=NULL; m_format=_AUDIO_S16; m_channels=m_rate=m_frames=0; }
+    ~audio_buffer() { close(); }
+    bool assign(const gen &g);
+    bool open(const std::string &filename);
+    void close();
+    int channels() const { return m_channels; }
+    int samplerate() const { return m_rate; }
+    int frames() const { return m_frames; }
+    audio_format format() const { return m_format; }
+    int bit_depth() const { return m_format==_AUDIO_U8?8:16; } // bit depth of the sound data
+    double sample(int frame,int chan) const;
+    void read_channel(int chan,int start,int len,std::vector<double> &res) const;
+    float *samples();
+    double peak() const;
+    void truncate(int len);
+    gen to_gen(double ratio=1.0) const;
+};
+
+/* radix-2 FFT of real double buffers of length n (a power of two, at least 2),
+ * the plan is read-only after construction and may be shared between threads */
+class fft_plan {
+    int n;
+    std::vector<std::complex<double> > w; // w[k]=exp(-2*pi*i*k/n) for 0<=k<n/2
+    std::vector<int> rev; // bit-reversal permutation of 0,..,n/2-1
+    void transform(std::complex<double> *a,bool inverse) const;
+public:
+    fft_plan(int len);
+    int size() const { return n; }
+    /* X[0..n/2] receives the nonredundant half of the spectrum of x[0..n-1] */
+    void forward(const double *x,std::complex<double> *X) const;
+    /* recovers x[0..n-1] from the half spectrum X[0..n/2], X is destroyed */
+    void inverse(std::complex<double> *X,double *x) const;
+};
+
+void convolve_buffers(const std::vector<std::vector<double> > &x,const std::vector<std::vector<double> > &h,
+                      std::vector<std::vector<double> > &y);
+bool decode_chdata_double(const vecteur &data,int bd,std::vector<double> &res);
+vecteur encode_chdata_double(const std::vector<double> &data,int bd,double ratio);
 bool is_sound_data(const gen &g,int &nc,int &bd,int &sr,int &len);
 vecteur decode_chdata(const vecteur &data,int bd,int start=0,int len=-1);
 vecteur encode_chdata(const vecteur &data,int bd,double ratio,GIAC_CONTEXT);